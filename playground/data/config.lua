@@ -8,5 +8,6 @@ Config = {
 	},
 	JobSystem = {
 		-- ThreadCount = 2,
+		-- MainThreadBudgetMs = 2.0,
 	}
 }
\ No newline at end of file
@@ -3,14 +3,17 @@
 
 layout(location = 0) in vec4 vs_in_pos_modelSpace;
 layout(location = 1) in vec4 vs_in_colour;
-layout(location = 2) in mat4 vs_in_instance_modelmat;
+layout(location = 2) in vec4 vs_in_instance_transformRow0;	// instance transform is stored as 3 rows, see shared.vs
+layout(location = 3) in vec4 vs_in_instance_transformRow1;
+layout(location = 4) in vec4 vs_in_instance_transformRow2;
 
 out vec4 out_colour;
 
 void main()
 {
+	mat4 modelMat = transpose(mat4(vs_in_instance_transformRow0, vs_in_instance_transformRow1, vs_in_instance_transformRow2, vec4(0.0, 0.0, 0.0, 1.0)));
 	vec4 pos = vec4(vs_in_pos_modelSpace.xyz,1);
-	vec4 v = ProjectionViewMatrix * vs_in_instance_modelmat * pos; 
+	vec4 v = ProjectionViewMatrix * modelMat * pos; 
     out_colour = vs_in_colour;
     gl_Position = v;
 }
@@ -1,4 +1,8 @@
 // Global uniforms
+#define SHADOW_CASCADE_COUNT 4		// must match Renderer::c_shadowCascadeCount
+#define CLUSTER_GRID_X 16			// must match LightClusters
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
 
 struct LightInfo
 {
@@ -12,11 +16,30 @@ layout(std140, binding = 0) uniform Globals
 {
 	mat4 ProjectionViewMatrix;
 	vec4 CameraPosition;	// World Space
-	LightInfo Lights[64];
+	vec4 ClusterDepthParams;	// x = slice scale, y = slice bias
 	int LightCount;
+	int DirectionalLightCount;	// directional lights come first in Lights
 	float HDRExposure;
 	float ShadowBias;
 	float CubeShadowBias;
+	mat4 ShadowCascadeMatrices[SHADOW_CASCADE_COUNT];
+	vec4 ShadowCascadeSplits;	// far view depth of each cascade
+};
+
+// every light, point lights are found through the cluster they touch
+layout(std430, binding = 0) readonly buffer LightData
+{
+	LightInfo Lights[];
+};
+
+layout(std430, binding = 1) readonly buffer LightClusterData
+{
+	uvec2 LightClusters[];		// first index, count
+};
+
+layout(std430, binding = 2) readonly buffer LightIndexData
+{
+	uint LightIndices[];
 };
 
 uniform mat4 ShadowLightSpaceMatrix;
@@ -0,0 +1,14 @@
+// Material constants table, indexed per instance
+
+struct MaterialInfo
+{
+	vec4 DiffuseOpacity;
+	vec4 Specular;		// r,g,b,strength
+	float Shininess;
+};
+
+// storage buffer rather than a UBO, the table is larger than the minimum GL_MAX_UNIFORM_BLOCK_SIZE (16k)
+layout(std430, binding = 3) readonly buffer MaterialTable
+{
+	MaterialInfo Materials[];
+};
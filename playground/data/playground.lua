@@ -12,6 +12,7 @@ local Sponza = Graphics.LoadModel("sponza.obj")
 local LightModel = Graphics.LoadModel("sphere.fbx")
 local IslandModel = Graphics.LoadModel("islands_low.fbx")
 local Container = Graphics.LoadModel("container.fbx")
+local SceneInstances = {}
 
 local Lights = {}
 local lightCount = 1
@@ -102,6 +103,20 @@ function Playground:Init()
 
 	Graphics.SetClearColour(0.1,0.1,0.1)
 	Graphics.SetShadowShader(DiffuseShader, ShadowShader)
+
+	-- the scenery never changes, so it is created once instead of drawn every frame
+	table.insert(SceneInstances, Graphics.CreateModelInstance(0.0,1.5,0.0,1.0,1.0,1.0,1.0,0.4,IslandModel,DiffuseShader,true))
+	table.insert(SceneInstances, Graphics.CreateModelInstance(0.0,0.5,0.0,1.0,1.0,1.0,1.0,0.2,Sponza,DiffuseShader,true))
+	local width = 64
+	local numPerWidth = 4
+	local scale = 1
+	local halfWidth = width / 2.0
+	local gap = width / numPerWidth
+	for z=1,numPerWidth do
+		for x=1,numPerWidth do
+			table.insert(SceneInstances, Graphics.CreateModelInstance(-halfWidth + (x * gap),0.0,-halfWidth + (z*gap) - 14,1.0,1.0,1.0,1.0,1.0 * scale,Container,DiffuseShader,false))
+		end
+	end
 end
 
 function DrawGrid(startX,endX,stepX,startZ,endZ,stepZ,yAxis)
@@ -192,9 +207,6 @@ function Playground:Tick()
 	DrawGrid(-512,512,32,-512,512,32,-40.0)
 	Graphics.DebugDrawAxis(0.0,32.0,0.0,8.0)
 
-	Graphics.DrawModel(0.0,1.5,0.0,1.0,1.0,1.0,1.0,0.4,IslandModel,DiffuseShader)
-	Graphics.DrawModel(0.0,0.5,0.0,1.0,1.0,1.0,1.0,0.2,Sponza,DiffuseShader)
-
 	local attenua = Playground:GetAttenuation(32);
 	local brightness = 8
 	Graphics.PointLight(-123, 32, -40, 1.0 * brightness, 0.61 * brightness, 0.17 * brightness, 0.01, attenua[1], attenua[2], attenua[3])
@@ -206,20 +218,13 @@ function Playground:Tick()
 	Graphics.PointLight(-241.25, 33.5, 82.3, 0.16 * brightness, 0.73 * brightness, 1.0 * brightness, 0.01, attenua[1], attenua[2], attenua[3])
 	Graphics.PointLight(226.25, 33.5, -88.3, 0.16 * brightness, 0.73 * brightness, 1.0 * brightness, 0.01, attenua[1], attenua[2], attenua[3])
 	Graphics.PointLight(226.25, 33.5, 82.3, 0.16 * brightness, 0.73 * brightness, 1.0 * brightness, 0.01, attenua[1], attenua[2], attenua[3])
-
-	local width = 64
-	local numPerWidth = 4
-	local scale = 1
-	local halfWidth = width / 2.0
-	local gap = width / numPerWidth
-	for z=1,numPerWidth do
-		for x=1,numPerWidth do
-			Graphics.DrawModel(-halfWidth + (x * gap),0.0,-halfWidth + (z*gap) - 14,1.0,1.0,1.0,1.0,1.0 * scale,Container,DiffuseShader)
-		end
-	end
 end
 
 function Playground:Shutdown()
+	for i=1,#SceneInstances do
+		Graphics.DestroyModelInstance(SceneInstances[i])
+	end
+	SceneInstances = {}
 end
 
 function Playground:new()
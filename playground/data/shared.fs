@@ -1,6 +1,7 @@
 // smol renderer shared fragment shader data
 
 #pragma sde include "global_uniforms.h"
+#pragma sde include "material_table.h"
 
 // utility functions
 const float c_gamma = 2.2;
@@ -15,6 +16,16 @@ vec3 linearToSRGB(vec3 v)
 	return pow(v.rgb, vec3(1.0 / c_gamma));
 }
 
+// cluster in LightClusters containing a world space position, must match LightClusters on the cpu
+uint GetLightCluster(vec3 worldPosition)
+{
+	vec4 clipPosition = ProjectionViewMatrix * vec4(worldPosition, 1.0);
+	vec2 ndc = clipPosition.xy / clipPosition.w;
+	uvec2 tile = uvec2(clamp((ndc * 0.5 + 0.5) * vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y), vec2(0.0), vec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1)));
+	uint slice = uint(clamp(log(clipPosition.w) * ClusterDepthParams.x + ClusterDepthParams.y, 0.0, float(CLUSTER_GRID_Z - 1)));	// w = view depth
+	return (slice * CLUSTER_GRID_Y + tile.y) * CLUSTER_GRID_X + tile.x;
+}
+
 // from https://knarkowicz.wordpress.com/2016/01/06/aces-filmic-tone-mapping-curve/
 vec3 Tonemap_ACESFilm(vec3 x)
 {
@@ -1,15 +1,32 @@
 // smol renderer shared vertex shader data
 
 // Shared mesh layout
-layout(location = 0) in vec3 vs_in_position;
-layout(location = 1) in vec3 vs_in_normal;
-layout(location = 2) in vec3 vs_in_tangent;
-layout(location = 3) in vec2 vs_in_uv;
-layout(location = 4) in mat4 vs_in_instance_modelmat;
-layout(location = 8) in vec4 vs_in_instance_colour;
+layout(location = 0) in vec3 vs_in_position;		// snorm16 relative to the part bounds, the decode is part of the instance transform
+layout(location = 1) in vec2 vs_in_normal;			// octahedral snorm16, use OctahedralDecode
+layout(location = 2) in vec2 vs_in_tangent;
+layout(location = 3) in vec2 vs_in_uv;				// half floats
+layout(location = 4) in vec4 vs_in_instance_transformRow0;	// instance transform is stored as 3 rows
+layout(location = 5) in vec4 vs_in_instance_transformRow1;
+layout(location = 6) in vec4 vs_in_instance_transformRow2;
+layout(location = 7) in vec4 vs_in_instance_colour;			// stored as half floats
+layout(location = 8) in uint vs_in_instance_material;		// index into the material table
 
 #pragma sde include "global_uniforms.h"
 
+// must match Render::OctahedralDecode
+vec3 OctahedralDecode(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+mat4 InstanceModelMatrix()
+{
+	return transpose(mat4(vs_in_instance_transformRow0, vs_in_instance_transformRow1, vs_in_instance_transformRow2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
 mat3 CalculateTBN(mat4 modelMat, vec3 tangent, vec3 normal)
 {
 	// Gram-shmidt from https://learnopengl.com
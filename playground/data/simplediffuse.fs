@@ -3,26 +3,35 @@
 
 in vec4 vs_out_colour;
 in vec3 vs_out_normal;
-in vec4 vs_out_positionLightSpace;
 in vec2 vs_out_uv;
 in vec3 vs_out_position;
 in mat3 vs_out_tbnMatrix;
+flat in uint vs_out_material;
 out vec4 fs_out_colour;
 
-uniform vec4 MeshDiffuseOpacity;
-uniform vec4 MeshSpecular;	//r,g,b,strength
-uniform float MeshShininess;
-
 uniform sampler2D DiffuseTexture;
 uniform sampler2D NormalsTexture;
 uniform sampler2D SpecularTexture;
 uniform sampler2D ShadowMapTexture;
 uniform samplerCube ShadowCubeMapTexture;
 
-float CalculateShadows(vec3 normal, vec4 lightSpacePos)
+float CalculateShadows(vec3 normal, vec3 pixelWorldSpace)
 {
+	// pick the first cascade that covers this pixel, clip w = view depth
+	float viewDepth = (ProjectionViewMatrix * vec4(pixelWorldSpace, 1.0)).w;
+	int cascade = 0;
+	while(cascade < SHADOW_CASCADE_COUNT && viewDepth > ShadowCascadeSplits[cascade])
+	{
+		++cascade;
+	}
+	if(cascade == SHADOW_CASCADE_COUNT)
+	{
+		return 0.0;
+	}
+
 	// perform perspective divide
-	vec3 projCoords = vs_out_positionLightSpace.xyz / vs_out_positionLightSpace.w;
+	vec4 lightSpacePos = ShadowCascadeMatrices[cascade] * vec4(pixelWorldSpace, 1.0);
+	vec3 projCoords = lightSpacePos.xyz / lightSpacePos.w;
 	
 	// transform from ndc space since depth map is 0-1
 	projCoords = projCoords * 0.5 + 0.5;	
@@ -33,15 +42,22 @@ float CalculateShadows(vec3 normal, vec4 lightSpacePos)
 		return 0.0;
 	}
 
+	// cascades are packed 2x2 into the shadow map, keep pcf samples inside this one
+	vec2 texelSize = 1.0 / textureSize(ShadowMapTexture, 0);
+	vec2 cascadeOffset = vec2(cascade % 2, cascade / 2) * 0.5;
+	vec2 cascadeMin = cascadeOffset + texelSize * 0.5;
+	vec2 cascadeMax = cascadeOffset + 0.5 - texelSize * 0.5;
+	vec2 cascadeUV = cascadeOffset + projCoords.xy * 0.5;
+
 	// simple pcf
 	float currentDepth = projCoords.z;
 	float shadow = 0.0;
-	vec2 texelSize = 1.0 / textureSize(ShadowMapTexture, 0);
 	for(int x = -1; x <= 1; ++x)
 	{
 		for(int y = -1; y <= 1; ++y)
 		{
-			float pcfDepth = texture(ShadowMapTexture, projCoords.xy + vec2(x, y) * texelSize).r; 
+			vec2 sampleUV = clamp(cascadeUV + vec2(x, y) * texelSize, cascadeMin, cascadeMax);
+			float pcfDepth = texture(ShadowMapTexture, sampleUV).r; 
 			shadow += currentDepth - ShadowBias > pcfDepth ? 1.0 : 0.0;        
 		}    
 	}
@@ -83,12 +99,58 @@ float CalculateCubeShadows(vec3 normal, vec3 pixelWorldSpace, vec3 lightPosition
 
 	return shadow;
 }
+
+vec3 CalculateLight(int i, vec3 finalNormal, vec3 diffuseTex, vec3 specularTex, MaterialInfo material)
+{
+	float attenuation;
+	vec3 lightDir;
+	float shadow = 0.0;
+	if(Lights[i].Position.w == 0.0)		// directional light
+	{
+		attenuation = 1.0;
+		lightDir = normalize(Lights[i].Position.xyz);
+		if(Lights[i].ShadowParams.x != 0.0)
+		{
+			shadow = CalculateShadows(finalNormal, vs_out_position);
+		}
+	}
+	else	// point light
+	{
+		float lightDistance = length(Lights[i].Position.xyz - vs_out_position);
+		attenuation = 1.0 / (Lights[i].Attenuation[0] + 
+							(Lights[i].Attenuation[1] * lightDistance) + 
+							(Lights[i].Attenuation[2] * (lightDistance * lightDistance)));
+		lightDir = normalize(Lights[i].Position.xyz - vs_out_position);
+		if(Lights[i].ShadowParams.x != 0.0)
+		{
+			shadow = CalculateCubeShadows(finalNormal,vs_out_position, Lights[i].Position.xyz, Lights[i].ShadowParams.y);
+		}
+	}
+
+	// diffuse light
+	float diffuseFactor = max(dot(finalNormal, lightDir),0.0);
+	vec3 diffuse = material.DiffuseOpacity.rgb * diffuseTex * Lights[i].ColourAndAmbient.rgb * diffuseFactor;
+
+	// ambient light
+	vec3 ambient = diffuseTex * Lights[i].ColourAndAmbient.rgb * Lights[i].ColourAndAmbient.a;
+
+	// specular light 
+	vec3 viewDir = normalize(CameraPosition.xyz - vs_out_position);
+	vec3 reflectDir = normalize(reflect(-lightDir, finalNormal));  
+	float specFactor = pow(max(dot(viewDir, reflectDir), 0.0), material.Shininess);
+	vec3 specularColour = material.Specular.rgb * Lights[i].ColourAndAmbient.rgb;
+	vec3 specular = material.Specular.a * specFactor * specularColour * specularTex; 
+
+	vec3 diffuseSpec = (1.0-shadow) * (diffuse + specular);
+	return attenuation * (ambient + diffuseSpec);
+}
  
 void main()
 {
 	// early out if we can
+	MaterialInfo material = Materials[vs_out_material];
 	vec4 diffuseTex = srgbToLinear(texture(DiffuseTexture, vs_out_uv));	
-	if(diffuseTex.a == 0.0 || MeshDiffuseOpacity.a == 0.0)
+	if(diffuseTex.a == 0.0 || material.DiffuseOpacity.a == 0.0)
 		discard;
 
 	vec3 finalColour = vec3(0.0);
@@ -99,52 +161,18 @@ void main()
 	finalNormal = finalNormal * 2.0 - 1.0;   
 	finalNormal = normalize(vs_out_tbnMatrix * finalNormal);
 
-	for(int i=0;i<LightCount;++i)
+	// directional lights light everything, point lights come from this pixel's cluster
+	for(int i=0;i<DirectionalLightCount;++i)
 	{
-		float attenuation;
-		vec3 lightDir;
-		float shadow = 0.0;
-		if(Lights[i].Position.w == 0.0)		// directional light
-		{
-			attenuation = 1.0;
-			lightDir = normalize(Lights[i].Position.xyz);
-			if(Lights[i].ShadowParams.x != 0.0)
-			{
-				shadow = CalculateShadows(finalNormal, vs_out_positionLightSpace);
-			}
-		}
-		else	// point light
-		{
-			float lightDistance = length(Lights[i].Position.xyz - vs_out_position);
-			attenuation = 1.0 / (Lights[i].Attenuation[0] + 
-								(Lights[i].Attenuation[1] * lightDistance) + 
-								(Lights[i].Attenuation[2] * (lightDistance * lightDistance)));
-			lightDir = normalize(Lights[i].Position.xyz - vs_out_position);
-			if(Lights[i].ShadowParams.x != 0.0)
-			{
-				shadow = CalculateCubeShadows(finalNormal,vs_out_position, Lights[i].Position.xyz, Lights[i].ShadowParams.y);
-			}
-		}
-
-		// diffuse light
-		float diffuseFactor = max(dot(finalNormal, lightDir),0.0);
-		vec3 diffuse = MeshDiffuseOpacity.rgb * diffuseTex.rgb * Lights[i].ColourAndAmbient.rgb * diffuseFactor;
-
-		// ambient light
-		vec3 ambient = diffuseTex.rgb * Lights[i].ColourAndAmbient.rgb * Lights[i].ColourAndAmbient.a;
-
-		// specular light 
-		vec3 viewDir = normalize(CameraPosition.xyz - vs_out_position);
-		vec3 reflectDir = normalize(reflect(-lightDir, finalNormal));  
-		float specFactor = pow(max(dot(viewDir, reflectDir), 0.0), MeshShininess);
-		vec3 specularColour = MeshSpecular.rgb * Lights[i].ColourAndAmbient.rgb;
-		vec3 specular = MeshSpecular.a * specFactor * specularColour * specularTex; 
-
-		vec3 diffuseSpec = (1.0-shadow) * (diffuse + specular);
-		finalColour += attenuation * (ambient + diffuseSpec);
+		finalColour += CalculateLight(i, finalNormal, diffuseTex.rgb, specularTex, material);
+	}
+	uvec2 cluster = LightClusters[GetLightCluster(vs_out_position)];
+	for(uint i=0;i<cluster.y;++i)
+	{
+		finalColour += CalculateLight(int(LightIndices[cluster.x + i]), finalNormal, diffuseTex.rgb, specularTex, material);
 	}
 	
 	// tonemap
 	finalColour = Tonemap_ACESFilm(vs_out_colour.rgb * finalColour * HDRExposure);
-	fs_out_colour = vec4(linearToSRGB(finalColour),MeshDiffuseOpacity.a * diffuseTex.a);
+	fs_out_colour = vec4(linearToSRGB(finalColour),material.DiffuseOpacity.a * diffuseTex.a);
 }
\ No newline at end of file
@@ -3,21 +3,23 @@
 
 out vec4 vs_out_colour;
 out vec3 vs_out_normal;
-out vec4 vs_out_positionLightSpace;
 out vec2 vs_out_uv;
 out vec3 vs_out_position;
 out mat3 vs_out_tbnMatrix;
+flat out uint vs_out_material;
 
 void main()
 {
 	vec4 pos = vec4(vs_in_position,1);
-	vec4 worldSpacePos = vs_in_instance_modelmat * pos;
+	mat4 modelMat = InstanceModelMatrix();
+	vec4 worldSpacePos = modelMat * pos;
 	vec4 viewSpacePos = ProjectionViewMatrix * worldSpacePos; 
     vs_out_colour = vs_in_instance_colour;
-	vs_out_normal = mat3(transpose(inverse(vs_in_instance_modelmat))) * vs_in_normal; 
+	vec3 normal = OctahedralDecode(vs_in_normal);
+	vs_out_normal = mat3(transpose(inverse(modelMat))) * normal; 
 	vs_out_uv = vs_in_uv;
 	vs_out_position = worldSpacePos.xyz;
-	vs_out_positionLightSpace = ShadowLightSpaceMatrix * worldSpacePos;
-	vs_out_tbnMatrix = CalculateTBN(vs_in_instance_modelmat, vs_in_tangent, vs_in_normal);
+	vs_out_tbnMatrix = CalculateTBN(modelMat, OctahedralDecode(vs_in_tangent), normal);
+	vs_out_material = vs_in_instance_material;
     gl_Position = viewSpacePos;
 }
@@ -3,11 +3,13 @@
 
 out vec3 vs_out_position;
 out vec2 vs_out_uv;
+flat out uint vs_out_material;
 
 void main()
 {
-	vec4 worldPos = vs_in_instance_modelmat * vec4(vs_in_position,1);
+	vec4 worldPos = InstanceModelMatrix() * vec4(vs_in_position,1);
 	vs_out_position = worldPos.xyz;
 	vs_out_uv = vs_in_uv;
+	vs_out_material = vs_in_instance_material;
 	gl_Position = ShadowLightSpaceMatrix * worldPos; 
 }
@@ -0,0 +1,67 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#include "radix_sort.h"
+#include "kernel/assert.h"
+#include "core/profiler.h"
+#include <string.h>
+
+namespace Core
+{
+	void RadixSort(SortKeyIndex* values, SortKeyIndex* scratch, size_t count)
+	{
+		SDE_PROF_EVENT();
+		SDE_ASSERT(count < 0xffffffff, "Too many values");
+		if (count < 2)
+		{
+			return;
+		}
+
+		// build histograms for all 8 passes in one go
+		const uint32_t c_passes = sizeof(uint64_t);
+		uint32_t histograms[c_passes][256] = { 0 };
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint64_t key = values[i].m_key;
+			for (uint32_t pass = 0; pass < c_passes; ++pass)
+			{
+				histograms[pass][(key >> (pass * 8)) & 0xff]++;
+			}
+		}
+
+		SortKeyIndex* src = values;
+		SortKeyIndex* dst = scratch;
+		for (uint32_t pass = 0; pass < c_passes; ++pass)
+		{
+			const uint32_t shift = pass * 8;
+			uint32_t* histogram = histograms[pass];
+			if (histogram[(src[0].m_key >> shift) & 0xff] == count)
+			{
+				continue;	// every key has the same digit, nothing to do
+			}
+
+			// histogram -> offsets
+			uint32_t offset = 0;
+			for (uint32_t digit = 0; digit < 256; ++digit)
+			{
+				uint32_t digitCount = histogram[digit];
+				histogram[digit] = offset;
+				offset += digitCount;
+			}
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				dst[histogram[(src[i].m_key >> shift) & 0xff]++] = src[i];
+			}
+			SortKeyIndex* temp = src;
+			src = dst;
+			dst = temp;
+		}
+
+		if (src != values)
+		{
+			memcpy(values, src, count * sizeof(SortKeyIndex));
+		}
+	}
+}
@@ -47,4 +47,33 @@ namespace Kernel
 	{
 		return SDL_AtomicGet(&GetInternal().m_atomic);
 	}
+
+	AtomicPtr::AtomicPtr()
+		: m_ptr(nullptr)
+	{
+	}
+
+	AtomicPtr::AtomicPtr(void* initialValue)
+		: m_ptr(initialValue)
+	{
+	}
+
+	AtomicPtr::~AtomicPtr()
+	{
+	}
+
+	void* AtomicPtr::Set(void* v)
+	{
+		return SDL_AtomicSetPtr((void**)&m_ptr, v);
+	}
+
+	bool AtomicPtr::CAS(void* oldVal, void* newVal)
+	{
+		return SDL_AtomicCASPtr((void**)&m_ptr, oldVal, newVal);
+	}
+
+	void* AtomicPtr::Get()
+	{
+		return SDL_AtomicGetPtr((void**)&m_ptr);
+	}
 }
\ No newline at end of file
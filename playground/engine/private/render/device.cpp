@@ -58,6 +58,8 @@ namespace Render
 		// Setting this here allows all point sprite shaders to set the sprite size
 		// dynamically.
 		glEnable(GL_PROGRAM_POINT_SIZE);
+
+		InvalidateStateCache();
 	}
 
 	Device::~Device()
@@ -66,6 +68,47 @@ namespace Render
 		m_context = nullptr;
 	}
 
+	// Forget everything, the next call to set any state always reaches GL
+	void Device::InvalidateStateCache()
+	{
+		m_stateCache.m_program = c_unknownHandle;
+		m_stateCache.m_vertexArray = c_unknownHandle;
+		m_stateCache.m_indirectBuffer = c_unknownHandle;
+		for (auto& t : m_stateCache.m_textures)
+		{
+			t = c_unknownHandle;
+		}
+		for (auto& ubo : m_stateCache.m_uniformBuffers)
+		{
+			ubo = { c_unknownHandle, 0, 0 };
+		}
+		for (auto& ssbo : m_stateCache.m_storageBuffers)
+		{
+			ssbo = { c_unknownHandle, 0, 0 };
+		}
+		m_stateCache.m_blending = c_unknownState;
+		m_stateCache.m_depthTest = c_unknownState;
+		m_stateCache.m_depthWrite = c_unknownState;
+		m_stateCache.m_cullEnabled = c_unknownState;
+		m_stateCache.m_cullFace = c_unknownState;
+		m_stateCache.m_frontFaceCCW = c_unknownState;
+		m_stateCache.m_samplerUniforms.clear();
+		m_stateCache.m_instanceAttributes.clear();
+	}
+
+	inline bool Device::IsStateChange(bool changed)
+	{
+		if (changed)
+		{
+			++m_stateStats.m_callsIssued;
+		}
+		else
+		{
+			++m_stateStats.m_callsFiltered;
+		}
+		return changed;
+	}
+
 	void Device::SetViewport(glm::ivec2 pos, glm::ivec2 size)
 	{
 		glViewport(pos.x, pos.y, size.x, size.y);
@@ -117,6 +160,27 @@ namespace Render
 		SDE_RENDER_PROCESS_GL_ERRORS("glNamedFramebufferTextureLayer");
 	}
 
+	void Device::CopyFramebufferDepth(const FrameBuffer& src, const FrameBuffer& dst, glm::ivec2 pos, glm::ivec2 size)
+	{
+		glCopyImageSubData(src.GetDepthStencil()->GetHandle(), GL_TEXTURE_2D, 0, pos.x, pos.y, 0,
+			dst.GetDepthStencil()->GetHandle(), GL_TEXTURE_2D, 0, pos.x, pos.y, 0, size.x, size.y, 1);
+		SDE_RENDER_PROCESS_GL_ERRORS("glCopyImageSubData");
+	}
+
+	void Device::CopyFramebufferDepth(const FrameBuffer& src, const FrameBuffer& dst, uint32_t cubeFace)
+	{
+		const glm::ivec2 size = src.Dimensions();
+		glCopyImageSubData(src.GetDepthStencil()->GetHandle(), GL_TEXTURE_CUBE_MAP, 0, 0, 0, cubeFace,
+			dst.GetDepthStencil()->GetHandle(), GL_TEXTURE_CUBE_MAP, 0, 0, 0, cubeFace, size.x, size.y, 1);
+		SDE_RENDER_PROCESS_GL_ERRORS("glCopyImageSubData");
+	}
+
+	void Device::CopyBufferData(const RenderBuffer& src, size_t srcOffset, const RenderBuffer& dst, size_t dstOffset, size_t size)
+	{
+		glCopyNamedBufferSubData(src.GetHandle(), dst.GetHandle(), srcOffset, dstOffset, size);
+		SDE_RENDER_PROCESS_GL_ERRORS("glCopyNamedBufferSubData");
+	}
+
 	void Device::FlushContext()
 	{
 		glFlush();	// Ensures any writes in shared contexts are pushed to all of them
@@ -174,8 +238,19 @@ namespace Render
 		}
 	}
 
+	void Device::SetScissorRect(glm::ivec2 pos, glm::ivec2 size)
+	{
+		glScissor(pos.x, pos.y, size.x, size.y);
+		SDE_RENDER_PROCESS_GL_ERRORS("glScissor");
+	}
+
 	void Device::SetBlending(bool enabled)
 	{
+		if (!IsStateChange(m_stateCache.m_blending != (int8_t)enabled))
+		{
+			return;
+		}
+		m_stateCache.m_blending = enabled;
 		if (enabled)
 		{
 			// Todo - separate
@@ -193,58 +268,83 @@ namespace Render
 		}
 	}
 
-	void Device::SetFrontfaceCulling(bool enabled, bool frontFaceCCW)
+	// cullMode 0 = off, 1 = back faces, 2 = front faces
+	void Device::SetCulling(int8_t cullMode, bool frontFaceCCW)
 	{
-		if (enabled)
+		auto& cache = m_stateCache;
+		const bool enableChanged = cache.m_cullEnabled != (int8_t)(cullMode != 0);
+		const bool faceChanged = cullMode != 0 && cache.m_cullFace != cullMode;
+		const bool windingChanged = cache.m_frontFaceCCW != (int8_t)frontFaceCCW;
+		if (!IsStateChange(enableChanged || faceChanged || windingChanged))
 		{
-			glEnable(GL_CULL_FACE);
-			SDE_RENDER_PROCESS_GL_ERRORS("glEnable");
-			glCullFace(GL_FRONT);
-			SDE_RENDER_PROCESS_GL_ERRORS("glCullFace");
+			return;
 		}
-		else
+		if (enableChanged)
 		{
-			glDisable(GL_CULL_FACE);
-			SDE_RENDER_PROCESS_GL_ERRORS("glDisable");
+			if (cullMode != 0)
+			{
+				glEnable(GL_CULL_FACE);
+				SDE_RENDER_PROCESS_GL_ERRORS("glEnable");
+			}
+			else
+			{
+				glDisable(GL_CULL_FACE);
+				SDE_RENDER_PROCESS_GL_ERRORS("glDisable");
+			}
 		}
-
-		glFrontFace(frontFaceCCW ? GL_CCW : GL_CW);
-		SDE_RENDER_PROCESS_GL_ERRORS("glFrontFace");
-	}
-
-	void Device::SetBackfaceCulling(bool enabled, bool frontFaceCCW)
-	{
-		if (enabled)
+		if (faceChanged)
 		{
-			glEnable(GL_CULL_FACE);
-			SDE_RENDER_PROCESS_GL_ERRORS("glEnable");
-			glCullFace(GL_BACK);
+			glCullFace(cullMode == 1 ? GL_BACK : GL_FRONT);
 			SDE_RENDER_PROCESS_GL_ERRORS("glCullFace");
 		}
-		else
+		if (windingChanged)
 		{
-			glDisable(GL_CULL_FACE);
-			SDE_RENDER_PROCESS_GL_ERRORS("glDisable");
+			glFrontFace(frontFaceCCW ? GL_CCW : GL_CW);
+			SDE_RENDER_PROCESS_GL_ERRORS("glFrontFace");
 		}
+		cache.m_cullEnabled = cullMode != 0;
+		cache.m_cullFace = cullMode != 0 ? cullMode : cache.m_cullFace;	// cull face is left alone while culling is off
+		cache.m_frontFaceCCW = frontFaceCCW;
+	}
+
+	void Device::SetFrontfaceCulling(bool enabled, bool frontFaceCCW)
+	{
+		SetCulling(enabled ? 2 : 0, frontFaceCCW);
+	}
 
-		glFrontFace(frontFaceCCW ? GL_CCW : GL_CW);
-		SDE_RENDER_PROCESS_GL_ERRORS("glFrontFace");
+	void Device::SetBackfaceCulling(bool enabled, bool frontFaceCCW)
+	{
+		SetCulling(enabled ? 1 : 0, frontFaceCCW);
 	}
 
 	void Device::SetDepthState(bool enabled, bool writeEnabled)
 	{
-		if (enabled)
+		const bool testChanged = m_stateCache.m_depthTest != (int8_t)enabled;
+		const bool writeChanged = m_stateCache.m_depthWrite != (int8_t)writeEnabled;
+		if (!IsStateChange(testChanged || writeChanged))
 		{
-			glEnable(GL_DEPTH_TEST);
-			SDE_RENDER_PROCESS_GL_ERRORS("glEnable");
+			return;
 		}
-		else
+		if (testChanged)
 		{
-			glDisable(GL_DEPTH_TEST);
-			SDE_RENDER_PROCESS_GL_ERRORS("glDisable");
+			if (enabled)
+			{
+				glEnable(GL_DEPTH_TEST);
+				SDE_RENDER_PROCESS_GL_ERRORS("glEnable");
+			}
+			else
+			{
+				glDisable(GL_DEPTH_TEST);
+				SDE_RENDER_PROCESS_GL_ERRORS("glDisable");
+			}
+		}
+		if (writeChanged)
+		{
+			glDepthMask(writeEnabled);
+			SDE_RENDER_PROCESS_GL_ERRORS("glDepthMask");
 		}
-		glDepthMask(writeEnabled);
-		SDE_RENDER_PROCESS_GL_ERRORS("glDepthMask");
+		m_stateCache.m_depthTest = enabled;
+		m_stateCache.m_depthWrite = writeEnabled;
 	}
 
 	void Device::ClearColourDepthTarget(const glm::vec4& colour, float depth)
@@ -257,28 +357,60 @@ namespace Render
 		SDE_RENDER_PROCESS_GL_ERRORS("glClear");
 	}
 
-	void Device::SetArraySampler(uint32_t uniformHandle, uint32_t textureHandle, uint32_t textureUnit)
+	void Device::BindTextureUnit(uint32_t textureHandle, uint32_t textureUnit)
 	{
-		SDE_ASSERT(uniformHandle != -1);
-		SDE_ASSERT(textureHandle != 0);
-
+		const bool cached = textureUnit < c_maxCachedTextureUnits;
+		if (!IsStateChange(!cached || m_stateCache.m_textures[textureUnit] != textureHandle))
+		{
+			return;
+		}
 		glBindTextureUnit(textureUnit, textureHandle);
 		SDE_RENDER_PROCESS_GL_ERRORS("glBindTextureUnit");
+		if (cached)
+		{
+			m_stateCache.m_textures[textureUnit] = textureHandle;
+		}
+	}
 
+	// sampler uniforms belong to the bound program, so they are cached per program
+	void Device::SetSamplerUniform(uint32_t uniformHandle, uint32_t textureUnit)
+	{
+		const uint32_t program = m_stateCache.m_program;
+		const uint64_t key = ((uint64_t)program << 32) | uniformHandle;
+		auto found = m_stateCache.m_samplerUniforms.find(key);
+		const bool cached = found != m_stateCache.m_samplerUniforms.end();
+		if (!IsStateChange(program == c_unknownHandle || !cached || found->second != textureUnit))
+		{
+			return;
+		}
 		glUniform1i(uniformHandle, textureUnit);
 		SDE_RENDER_PROCESS_GL_ERRORS("glUniform1i");
+		if (cached)
+		{
+			found->second = textureUnit;
+		}
+		else if (program != c_unknownHandle)
+		{
+			m_stateCache.m_samplerUniforms.insert({ key, textureUnit });
+		}
 	}
 
-	void Device::SetSampler(uint32_t uniformHandle, uint32_t textureHandle, uint32_t textureUnit)
+	void Device::SetArraySampler(uint32_t uniformHandle, uint32_t textureHandle, uint32_t textureUnit)
 	{
 		SDE_ASSERT(uniformHandle != -1);
 		SDE_ASSERT(textureHandle != 0);
 
-		glBindTextureUnit(textureUnit, textureHandle);
-		SDE_RENDER_PROCESS_GL_ERRORS("glBindTextureUnit");
+		BindTextureUnit(textureHandle, textureUnit);
+		SetSamplerUniform(uniformHandle, textureUnit);
+	}
 
-		glUniform1i(uniformHandle, textureUnit);
-		SDE_RENDER_PROCESS_GL_ERRORS("glUniform1i");
+	void Device::SetSampler(uint32_t uniformHandle, uint32_t textureHandle, uint32_t textureUnit)
+	{
+		SDE_ASSERT(uniformHandle != -1);
+		SDE_ASSERT(textureHandle != 0);
+
+		BindTextureUnit(textureHandle, textureUnit);
+		SetSamplerUniform(uniformHandle, textureUnit);
 	}
 
 	void Device::SetUniformValue(uint32_t uniformHandle, const glm::mat4& matrix)
@@ -305,24 +437,55 @@ namespace Render
 	void Device::SetUniformValue(uint32_t uniformHandle, int32_t val)
 	{
 		SDE_ASSERT(uniformHandle != -1);
+		m_stateCache.m_samplerUniforms.erase(((uint64_t)m_stateCache.m_program << 32) | uniformHandle);	// may be a sampler
 		glUniform1i(uniformHandle, val);
 		SDE_RENDER_PROCESS_GL_ERRORS("glUniform1i");
 	}
 
 	void Device::BindShaderProgram(const ShaderProgram& program)
 	{
+		if (!IsStateChange(m_stateCache.m_program != program.GetHandle()))
+		{
+			return;
+		}
 		glUseProgram(program.GetHandle());
 		SDE_RENDER_PROCESS_GL_ERRORS("glUseProgram");
+		m_stateCache.m_program = program.GetHandle();
 	}
 
 	// vectorcount used to pass matrices (4x4 mat = 4 components, 4 vectorcount)
 	void Device::BindInstanceBuffer(const VertexArray& srcArray, const RenderBuffer& buffer, int vertexLayoutSlot, int components, size_t offset, size_t vectorCount)
+	{
+		BindInstanceBuffer(srcArray, buffer, vertexLayoutSlot, components, VertexDataType::Float, offset, components * sizeof(float) * vectorCount);
+	}
+
+	void Device::BindInstanceBuffer(const VertexArray& srcArray, const RenderBuffer& buffer, int vertexLayoutSlot, int components, VertexDataType type, size_t offset, size_t stride)
 	{
 		SDE_ASSERT(buffer.GetHandle() != 0);
 		SDE_ASSERT(components <= 4);
 
 		BindVertexArray(srcArray);
 
+		// attribute bindings are vertex array state, they only need setting again if the buffer or layout changes
+		const InstanceAttribute attribute = { buffer.GetHandle(), components, type, offset, stride };
+		const uint64_t key = ((uint64_t)srcArray.GetHandle() << 32) | (uint32_t)vertexLayoutSlot;
+		auto found = m_stateCache.m_instanceAttributes.find(key);
+		const bool cached = found != m_stateCache.m_instanceAttributes.end();
+		const bool changed = !cached || found->second.m_buffer != attribute.m_buffer || found->second.m_components != components ||
+			found->second.m_type != type || found->second.m_offset != offset || found->second.m_stride != stride;
+		if (!IsStateChange(changed))
+		{
+			return;
+		}
+		if (cached)
+		{
+			found->second = attribute;
+		}
+		else
+		{
+			m_stateCache.m_instanceAttributes.insert({ key, attribute });
+		}
+
 		glBindBuffer(GL_ARRAY_BUFFER, buffer.GetHandle());		// bind the vbo
 		SDE_RENDER_PROCESS_GL_ERRORS("glBindBuffer");
 
@@ -330,9 +493,17 @@ namespace Render
 		SDE_RENDER_PROCESS_GL_ERRORS("glEnableVertexAttribArray");
 
 		// send the data (we have to send it 4 components at a time)
-		// always float, never normalised
-		glVertexAttribPointer(vertexLayoutSlot, components, GL_FLOAT, GL_FALSE, components * sizeof(float) * (int)vectorCount, (void*)offset);
-		SDE_RENDER_PROCESS_GL_ERRORS("glVertexAttribPointer");
+		// never normalised, half floats are expanded to float by the vertex fetch, integers are passed through
+		if (type == VertexDataType::UnsignedInt)
+		{
+			glVertexAttribIPointer(vertexLayoutSlot, components, VertexArray::TranslateDataType(type), (GLsizei)stride, (void*)offset);
+			SDE_RENDER_PROCESS_GL_ERRORS("glVertexAttribIPointer");
+		}
+		else
+		{
+			glVertexAttribPointer(vertexLayoutSlot, components, VertexArray::TranslateDataType(type), GL_FALSE, (GLsizei)stride, (void*)offset);
+			SDE_RENDER_PROCESS_GL_ERRORS("glVertexAttribPointer");
+		}
 
 		glVertexAttribDivisor(vertexLayoutSlot, 1);
 		SDE_RENDER_PROCESS_GL_ERRORS("glVertexAttribDivisor");
@@ -344,8 +515,13 @@ namespace Render
 	void Device::BindVertexArray(const VertexArray& srcArray)
 	{
 		SDE_ASSERT(srcArray.GetHandle() != 0);
+		if (!IsStateChange(m_stateCache.m_vertexArray != srcArray.GetHandle()))
+		{
+			return;
+		}
 		glBindVertexArray(srcArray.GetHandle());
 		SDE_RENDER_PROCESS_GL_ERRORS("glBindVertexArray");
+		m_stateCache.m_vertexArray = srcArray.GetHandle();
 	}
 
 	void Device::DrawPrimitivesInstanced(PrimitiveType primitive, uint32_t vertexStart, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstInstance)
@@ -359,6 +535,54 @@ namespace Render
 		SDE_RENDER_PROCESS_GL_ERRORS("glDrawArraysInstanced");
 	}
 
+	void Device::DrawPrimitivesIndirect(PrimitiveType primitive, const RenderBuffer& commands, size_t offset, uint32_t commandCount)
+	{
+		SDE_PROF_EVENT();
+
+		auto primitiveType = TranslatePrimitiveType(primitive);
+		SDE_ASSERT(primitiveType != -1);
+
+		BindIndirectBuffer(commands);
+
+		// commands are tightly packed, stride 0
+		glMultiDrawArraysIndirect(primitiveType, (void*)offset, commandCount, 0);
+		SDE_RENDER_PROCESS_GL_ERRORS("glMultiDrawArraysIndirect");
+	}
+
+	void Device::DrawPrimitivesIndexedInstanced(PrimitiveType primitive, uint32_t indexStart, uint32_t indexCount, uint32_t instanceCount, uint32_t firstInstance)
+	{
+		SDE_PROF_EVENT();
+
+		auto primitiveType = TranslatePrimitiveType(primitive);
+		SDE_ASSERT(primitiveType != -1);
+
+		glDrawElementsInstancedBaseInstance(primitiveType, indexCount, GL_UNSIGNED_INT, (void*)(indexStart * sizeof(uint32_t)), instanceCount, firstInstance);
+		SDE_RENDER_PROCESS_GL_ERRORS("glDrawElementsInstancedBaseInstance");
+	}
+
+	void Device::DrawPrimitivesIndexedIndirect(PrimitiveType primitive, const RenderBuffer& commands, size_t offset, uint32_t commandCount)
+	{
+		SDE_PROF_EVENT();
+
+		auto primitiveType = TranslatePrimitiveType(primitive);
+		SDE_ASSERT(primitiveType != -1);
+
+		BindIndirectBuffer(commands);
+
+		glMultiDrawElementsIndirect(primitiveType, GL_UNSIGNED_INT, (void*)offset, commandCount, 0);
+		SDE_RENDER_PROCESS_GL_ERRORS("glMultiDrawElementsIndirect");
+	}
+
+	void Device::BindIndirectBuffer(const RenderBuffer& commands)
+	{
+		if (IsStateChange(m_stateCache.m_indirectBuffer != commands.GetHandle()))
+		{
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.GetHandle());
+			SDE_RENDER_PROCESS_GL_ERRORS("glBindBuffer");
+			m_stateCache.m_indirectBuffer = commands.GetHandle();
+		}
+	}
+
 	void Device::DrawPrimitives(PrimitiveType primitive, uint32_t vertexStart, uint32_t vertexCount)
 	{
 		auto primitiveType = TranslatePrimitiveType(primitive);
@@ -368,10 +592,50 @@ namespace Render
 		SDE_RENDER_PROCESS_GL_ERRORS("glDrawArrays");
 	}
 
+	// target = GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER, size = -1 binds the whole buffer
+	void Device::BindBufferRange(uint32_t target, uint32_t bindingIndex, uint32_t bufferHandle, size_t offset, size_t size)
+	{
+		BufferBinding* bindings = target == GL_UNIFORM_BUFFER ? m_stateCache.m_uniformBuffers : m_stateCache.m_storageBuffers;
+		const uint32_t maxCached = target == GL_UNIFORM_BUFFER ? c_maxCachedUniformBuffers : c_maxCachedStorageBuffers;
+		if (bindingIndex < maxCached)
+		{
+			const auto& current = bindings[bindingIndex];
+			if (!IsStateChange(current.m_buffer != bufferHandle || current.m_offset != offset || current.m_size != size))
+			{
+				return;
+			}
+			bindings[bindingIndex] = { bufferHandle, offset, size };
+		}
+		else
+		{
+			IsStateChange(true);
+		}
+
+		if (size == (size_t)-1)
+		{
+			glBindBufferBase(target, bindingIndex, bufferHandle);
+			SDE_RENDER_PROCESS_GL_ERRORS("glBindBufferBase");
+		}
+		else
+		{
+			glBindBufferRange(target, bindingIndex, bufferHandle, offset, size);
+			SDE_RENDER_PROCESS_GL_ERRORS("glBindBufferRange");
+		}
+	}
+
 	void Device::SetUniforms(ShaderProgram& p, const RenderBuffer& ubo, uint32_t uboBindingIndex)
 	{
-		glBindBufferBase(GL_UNIFORM_BUFFER, uboBindingIndex, ubo.GetHandle());
-		SDE_RENDER_PROCESS_GL_ERRORS("glBindBufferBase");
+		BindBufferRange(GL_UNIFORM_BUFFER, uboBindingIndex, ubo.GetHandle(), 0, (size_t)-1);
+	}
+
+	void Device::SetUniforms(ShaderProgram& p, const RenderBuffer& ubo, uint32_t uboBindingIndex, size_t offset, size_t size)
+	{
+		BindBufferRange(GL_UNIFORM_BUFFER, uboBindingIndex, ubo.GetHandle(), offset, size);
+	}
+
+	void Device::SetStorageBuffer(const RenderBuffer& ssbo, uint32_t bindingIndex, size_t offset, size_t size)
+	{
+		BindBufferRange(GL_SHADER_STORAGE_BUFFER, bindingIndex, ssbo.GetHandle(), offset, size);
 	}
 
 	void Device::BindUniformBufferIndex(ShaderProgram& p, const char* bufferName, uint32_t bindingIndex)
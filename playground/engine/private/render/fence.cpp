@@ -0,0 +1,79 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#include "fence.h"
+#include "utils.h"
+#include "core/profiler.h"
+#include <glew.h>
+#include <utility>
+
+namespace Render
+{
+	const GLuint64 c_fenceWaitTimeout = 1000000;	// 1ms in nanoseconds, between checks
+
+	Fence::~Fence()
+	{
+		Destroy();
+	}
+
+	Fence::Fence(Fence&& other)
+	{
+		std::swap(m_sync, other.m_sync);
+	}
+
+	Fence& Fence::operator=(Fence&& other)
+	{
+		std::swap(m_sync, other.m_sync);
+		return *this;
+	}
+
+	void Fence::Destroy()
+	{
+		if (m_sync != nullptr)
+		{
+			glDeleteSync(static_cast<GLsync>(m_sync));
+			SDE_RENDER_PROCESS_GL_ERRORS("glDeleteSync");
+			m_sync = nullptr;
+		}
+	}
+
+	void Fence::Insert()
+	{
+		Destroy();
+		m_sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		SDE_RENDER_PROCESS_GL_ERRORS("glFenceSync");
+	}
+
+	bool Fence::IsPending()
+	{
+		if (m_sync != nullptr)
+		{
+			GLenum result = glClientWaitSync(static_cast<GLsync>(m_sync), 0, 0);
+			SDE_RENDER_PROCESS_GL_ERRORS("glClientWaitSync");
+			if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+			{
+				Destroy();
+			}
+		}
+		return m_sync != nullptr;
+	}
+
+	void Fence::Wait()
+	{
+		SDE_PROF_STALL("WaitForFence");
+		if (m_sync != nullptr)
+		{
+			// flush on the first wait in case the fence was never submitted
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			GLenum result = GL_TIMEOUT_EXPIRED;
+			while (result == GL_TIMEOUT_EXPIRED)
+			{
+				result = glClientWaitSync(static_cast<GLsync>(m_sync), flags, c_fenceWaitTimeout);
+				SDE_RENDER_PROCESS_GL_ERRORS("glClientWaitSync");
+				flags = 0;
+			}
+			Destroy();
+		}
+	}
+}
@@ -3,10 +3,13 @@ SDLEngine
 Matt Hoyle
 */
 #include "material.h"
+#include "shader_program.h"
 #include "core/string_hashing.h"
 
 namespace Render
 {
+	const size_t c_maxCompiledPrograms = 4;
+
 	Material::Material()
 	{
 
@@ -21,5 +24,45 @@ namespace Render
 	{
 		const uint32_t hash = Core::StringHashing::GetHash(name.c_str());
 		m_samplers[hash] = { name, handle };
+		++m_samplersVersion;
+	}
+
+	const Material::Compiled& Material::Compile(ShaderProgram& p) const
+	{
+		Compiled* compiled = nullptr;
+		Compiled* oldest = nullptr;
+		for (auto& c : m_compiled)
+		{
+			if (c.m_programSerial == p.GetSerial())
+			{
+				compiled = &c;
+				break;
+			}
+			oldest = (oldest == nullptr || c.m_programSerial < oldest->m_programSerial) ? &c : oldest;
+		}
+		if (compiled == nullptr)
+		{
+			// programs that were reloaded are never seen again, so replace the oldest once full
+			compiled = m_compiled.size() < c_maxCompiledPrograms ? &m_compiled.emplace_back() : oldest;
+		}
+		else if (compiled->m_uniformsVersion == m_uniforms.GetVersion() && compiled->m_samplersVersion == m_samplersVersion)
+		{
+			return *compiled;
+		}
+
+		compiled->m_programSerial = p.GetSerial();
+		compiled->m_uniformsVersion = m_uniforms.GetVersion();
+		compiled->m_samplersVersion = m_samplersVersion;
+		compiled->m_uniforms.Compile(m_uniforms, p);
+		compiled->m_samplers.clear();
+		for (const auto& s : m_samplers)
+		{
+			uint32_t uniformHandle = p.GetUniformHandle(s.second.m_name.c_str(), s.first);
+			if (uniformHandle != -1)
+			{
+				compiled->m_samplers.push_back({ uniformHandle, s.second.m_handle, s.first });
+			}
+		}
+		return *compiled;
 	}
 }
\ No newline at end of file
@@ -22,6 +22,17 @@ namespace Render
 			it.Destroy();
 		}
 		m_vertexStreams.clear();
+		m_indices.Destroy();
 		m_vertices.Destroy();
 	}
+
+	uint32_t Mesh::SelectLod(float maxError) const
+	{
+		uint32_t lod = 0;
+		while (lod < m_lods.size() && m_lods[lod].m_error <= maxError)
+		{
+			++lod;
+		}
+		return lod;
+	}
 }
\ No newline at end of file
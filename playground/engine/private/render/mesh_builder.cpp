@@ -4,9 +4,14 @@ Matt Hoyle
 */
 
 #include "mesh_builder.h"
+#include "vertex_encoding.h"
 #include "utils.h"
 #include "math/glm_headers.h"
 #include "core/profiler.h"
+#include "core/flat_hash_map.h"
+#include <cstring>
+#include <algorithm>
+#include <cfloat>
 
 namespace Render
 {
@@ -74,15 +79,71 @@ namespace Render
 		streamData.insert(streamData.end(), glm::value_ptr(v2), glm::value_ptr(v2) + 4);
 	}
 
-	uint32_t MeshBuilder::AddVertexStream(int32_t componentCount, size_t reserveMemory)
+	void MeshBuilder::SetVertexData(uint32_t vertexStream, float v)
+	{
+		SDE_ASSERT(vertexStream < m_streams.size());
+		SDE_ASSERT(m_streams[vertexStream].m_componentCount == 1);
+		m_streams[vertexStream].m_streamData.push_back(v);
+	}
+
+	void MeshBuilder::SetVertexData(uint32_t vertexStream, const glm::vec2& v)
+	{
+		SDE_ASSERT(vertexStream < m_streams.size());
+		SDE_ASSERT(m_streams[vertexStream].m_componentCount == 2);
+		auto& streamData = m_streams[vertexStream].m_streamData;
+		streamData.insert(streamData.end(), glm::value_ptr(v), glm::value_ptr(v) + 2);
+	}
+
+	void MeshBuilder::SetVertexData(uint32_t vertexStream, const glm::vec3& v)
+	{
+		SDE_ASSERT(vertexStream < m_streams.size());
+		SDE_ASSERT(m_streams[vertexStream].m_componentCount == 3);
+		auto& streamData = m_streams[vertexStream].m_streamData;
+		streamData.insert(streamData.end(), glm::value_ptr(v), glm::value_ptr(v) + 3);
+	}
+
+	void MeshBuilder::SetVertexData(uint32_t vertexStream, const glm::vec4& v)
+	{
+		SDE_ASSERT(vertexStream < m_streams.size());
+		SDE_ASSERT(m_streams[vertexStream].m_componentCount == 4);
+		auto& streamData = m_streams[vertexStream].m_streamData;
+		streamData.insert(streamData.end(), glm::value_ptr(v), glm::value_ptr(v) + 4);
+	}
+
+	uint32_t MeshBuilder::EndVertex()
+	{
+		m_currentVertexIndex += 1;
+
+#ifdef SDE_DEBUG
+		for (const auto& stream : m_streams)
+		{
+			SDE_ASSERT((stream.m_streamData.size() / stream.m_componentCount) == m_currentVertexIndex);
+		}
+#endif
+		return m_currentVertexIndex - 1 - m_currentChunk.m_firstVertex;
+	}
+
+	void MeshBuilder::AddTriangleIndices(uint32_t i0, uint32_t i1, uint32_t i2)
+	{
+		const uint32_t first = m_currentChunk.m_firstVertex;
+		m_indices.push_back(first + i0);
+		m_indices.push_back(first + i1);
+		m_indices.push_back(first + i2);
+	}
+
+	uint32_t MeshBuilder::AddVertexStream(int32_t componentCount, size_t reserveMemory, VertexStreamEncoding encoding)
 	{
 		SDE_ASSERT(componentCount <= 4);
+		SDE_ASSERT(componentCount == 3 || (encoding != VertexStreamEncoding::BoundedSnorm16 && encoding != VertexStreamEncoding::OctahedralSnorm16));
 		SDE_ASSERT(m_chunks.size() == 0);
+		SDE_ASSERT(m_streams.size() < c_maxStreams, "Too many vertex streams");
 		
 		StreamDesc newStream;
 		newStream.m_componentCount = componentCount;
+		newStream.m_encoding = encoding;
+		newStream.m_decode = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 		newStream.m_streamData.reserve(reserveMemory);
-		m_streams.push_back(newStream);
+		m_streams.push_back(std::move(newStream));
 
 		return static_cast<uint32_t>( m_streams.size() - 1 );
 	}
@@ -93,6 +154,7 @@ namespace Render
 
 	void MeshBuilder::EndTriangle()
 	{
+		SDE_ASSERT(m_indices.size() == m_currentChunk.m_firstIndex, "Triangle soups and indexed triangles can't share a chunk");
 		m_currentVertexIndex += 3;
 
 		// Make sure all streams have data
@@ -110,11 +172,20 @@ namespace Render
 
 		m_currentChunk.m_firstVertex = m_currentVertexIndex;
 		m_currentChunk.m_lastVertex = m_currentVertexIndex;
+		m_currentChunk.m_firstIndex = static_cast<uint32_t>(m_indices.size());
+		m_currentChunk.m_lastIndex = m_currentChunk.m_firstIndex;
 	}
 
 	void MeshBuilder::EndChunk()
 	{
 		m_currentChunk.m_lastVertex = m_currentVertexIndex;
+		m_currentChunk.m_lastIndex = static_cast<uint32_t>(m_indices.size());
+#ifdef SDE_DEBUG
+		for (uint32_t i = m_currentChunk.m_firstIndex; i < m_currentChunk.m_lastIndex; ++i)
+		{
+			SDE_ASSERT(m_indices[i] < m_currentChunk.m_lastVertex, "Index out of range");
+		}
+#endif
 		if ((m_currentChunk.m_lastVertex - m_currentChunk.m_firstVertex) > 0)
 		{
 			m_chunks.push_back(std::move(m_currentChunk));
@@ -127,14 +198,14 @@ namespace Render
 		// If the mesh streams match, and the stream buffers are big enough, then we don't need to do anything
 		auto& streams = target.GetStreams();
 
-		if (streams.size() != m_streams.size())
+		if (streams.size() != m_buffers.size())
 		{
 			return true;
 		}
 
 		for (int32_t streamIndex = 0; streamIndex < streams.size(); ++streamIndex)
 		{
-			auto thisStreamSize = m_streams[streamIndex].m_streamData.size() * sizeof(float);
+			auto thisStreamSize = m_buffers[streamIndex].m_size;
 
 			if (streams[streamIndex].GetSize() < thisStreamSize)
 			{
@@ -146,6 +217,12 @@ namespace Render
 			}
 		}
 
+		const auto indicesSize = m_indices.size() * sizeof(uint32_t);
+		if (target.GetIndices().GetSize() < indicesSize || target.GetIndices().GetSize() > (indicesSize + c_maximumWaste))
+		{
+			return true;
+		}
+
 		return false;
 	}
 
@@ -159,12 +236,12 @@ namespace Render
 			s.Destroy();
 		}
 		streams.clear();
-		streams.resize(m_streams.size());
+		streams.resize(m_buffers.size());
 		int32_t streamIndex = 0;
-		for (const auto& streamIt : m_streams)
+		for (const auto& bufferIt : m_buffers)
 		{
 			auto& theBuffer = streams[streamIndex];
-			auto streamSize = streamIt.m_streamData.size() * sizeof(float);
+			auto streamSize = bufferIt.m_size;
 			if (streamSize < minVbSize)
 			{
 				streamSize = minVbSize;
@@ -176,7 +253,7 @@ namespace Render
 				streamSize += (streamSize % minVbSize);
 			}
 
-			auto streamBuffer = (void*)streamIt.m_streamData.data();
+			auto streamBuffer = (void*)bufferIt.m_data;
 			if (createDynamicMesh)
 			{
 				theBuffer.Create(streamBuffer,streamSize, RenderBufferType::VertexData, RenderBufferModification::Dynamic);
@@ -188,7 +265,18 @@ namespace Render
 			++streamIndex;
 		}
 
-		streamIndex = 0;
+		CreateIndexBuffer(target, createDynamicMesh);
+	}
+
+	void MeshBuilder::CreateIndexBuffer(Mesh& target, bool createDynamicMesh)
+	{
+		auto& indexBuffer = target.GetIndices();
+		indexBuffer.Destroy();
+		if (m_indices.size() > 0)
+		{
+			const auto modification = createDynamicMesh ? RenderBufferModification::Dynamic : RenderBufferModification::Static;
+			indexBuffer.Create((void*)m_indices.data(), m_indices.size() * sizeof(uint32_t), RenderBufferType::IndexData, modification);
+		}
 	}
 
 	bool MeshBuilder::CreateMesh(Mesh& target, bool createDynamicMesh, size_t minVbSize)
@@ -198,6 +286,8 @@ namespace Render
 		auto& streams = target.GetStreams();
 		auto& chunks = target.GetChunks();
 
+		EncodeStreams();
+		BuildBuffers();
 		if (ShouldRecreateMesh(target, minVbSize))
 		{
 			RecreateMesh(target, createDynamicMesh, minVbSize);
@@ -205,13 +295,16 @@ namespace Render
 		else
 		{
 			int32_t streamIndex = 0;
-			for (const auto& streamIt : m_streams)
+			for (const auto& bufferIt : m_buffers)
 			{
 				auto& theBuffer = streams[streamIndex];
-				auto streamSize = streamIt.m_streamData.size() * sizeof(float);
-				theBuffer.SetData(0, streamSize, (void*)streamIt.m_streamData.data());
+				theBuffer.SetData(0, bufferIt.m_size, bufferIt.m_data);
 				++streamIndex;
 			}
+			if (m_indices.size() > 0)
+			{
+				target.GetIndices().SetData(0, m_indices.size() * sizeof(uint32_t), m_indices.data());
+			}
 		}
 
 		// Populate chunks. We always rebuild this data
@@ -219,7 +312,22 @@ namespace Render
 		chunks.reserve(m_chunks.size());
 		for (const auto& chunk : m_chunks)
 		{
-			chunks.emplace_back(chunk.m_firstVertex, chunk.m_lastVertex - chunk.m_firstVertex, Render::PrimitiveType::Triangles);
+			chunks.emplace_back(chunk.m_firstVertex, chunk.m_lastVertex - chunk.m_firstVertex, chunk.m_firstIndex, chunk.m_lastIndex - chunk.m_firstIndex, Render::PrimitiveType::Triangles);
+		}
+
+		// lod errors were measured on the float positions, the mesh sees them through the position decode
+		auto& lods = target.GetLods();
+		lods.clear();
+		const float errorScale = m_lods.size() > 0 ? 1.0f / m_streams[m_lodPositionStream].m_decode.w : 1.0f;
+		for (const auto& lod : m_lods)
+		{
+			MeshLod meshLod;
+			meshLod.m_error = lod.m_error * errorScale;
+			for (const auto& chunk : lod.m_chunks)
+			{
+				meshLod.m_chunks.emplace_back(chunk.m_firstVertex, chunk.m_lastVertex - chunk.m_firstVertex, chunk.m_firstIndex, chunk.m_lastIndex - chunk.m_firstIndex, Render::PrimitiveType::Triangles);
+			}
+			lods.push_back(std::move(meshLod));
 		}
 
 		return true;
@@ -233,9 +341,415 @@ namespace Render
 		auto& streams = mesh.GetStreams();
 		for (const auto& streamIt : m_streams)
 		{
-			va.AddBuffer(streamIndex, &streams[streamIndex], VertexDataType::Float, streamIt.m_componentCount);
+			va.AddBuffer(streamIndex, &streams[streamIt.m_bufferIndex], GetEncodedType(streamIt), GetEncodedComponentCount(streamIt), streamIt.m_bufferOffset, streamIt.m_bufferStride);
 			++streamIndex;
 		}
+		if (mesh.GetIndices().GetHandle() != 0)
+		{
+			va.SetIndexBuffer(&mesh.GetIndices());
+		}
 		return va.Create();
 	}
+
+	VertexDataType MeshBuilder::GetEncodedType(const StreamDesc& stream)
+	{
+		switch (stream.m_encoding)
+		{
+		case VertexStreamEncoding::HalfFloat:
+			return VertexDataType::HalfFloat;
+		case VertexStreamEncoding::BoundedSnorm16:
+		case VertexStreamEncoding::OctahedralSnorm16:
+			return VertexDataType::ShortNormalised;
+		default:
+			return VertexDataType::Float;
+		}
+	}
+
+	// 16 bit streams are padded to a multiple of 4 bytes per vertex
+	uint8_t MeshBuilder::GetEncodedComponentCount(const StreamDesc& stream)
+	{
+		switch (stream.m_encoding)
+		{
+		case VertexStreamEncoding::HalfFloat:
+			return static_cast<uint8_t>((stream.m_componentCount + 1) & ~1);
+		case VertexStreamEncoding::BoundedSnorm16:
+			return 4;
+		case VertexStreamEncoding::OctahedralSnorm16:
+			return 2;
+		default:
+			return static_cast<uint8_t>(stream.m_componentCount);
+		}
+	}
+
+	const void* MeshBuilder::GetEncodedData(const StreamDesc& stream)
+	{
+		return stream.m_encoding == VertexStreamEncoding::Float ? (const void*)stream.m_streamData.data() : (const void*)stream.m_encodedData.data();
+	}
+
+	size_t MeshBuilder::GetEncodedSize(const StreamDesc& stream)
+	{
+		return stream.m_encoding == VertexStreamEncoding::Float ? stream.m_streamData.size() * sizeof(float) : stream.m_encodedData.size();
+	}
+
+	uint32_t MeshBuilder::GetEncodedVertexSize(const StreamDesc& stream)
+	{
+		const uint32_t componentSize = stream.m_encoding == VertexStreamEncoding::Float ? sizeof(float) : sizeof(uint16_t);
+		return GetEncodedComponentCount(stream) * componentSize;
+	}
+
+	// Works out which buffer each stream lives in, and interleaves the streams that share one
+	void MeshBuilder::BuildBuffers()
+	{
+		SDE_PROF_EVENT();
+		m_buffers.clear();
+		uint32_t firstInterleaved = static_cast<uint32_t>(m_streams.size());
+		if (m_layout == VertexBufferLayout::Interleaved)
+		{
+			firstInterleaved = 0;
+		}
+		else if (m_layout == VertexBufferLayout::InterleavedSplitPosition)
+		{
+			firstInterleaved = std::min(1u, firstInterleaved);
+		}
+
+		// streams before the interleaved ones get a tightly packed buffer each
+		for (uint32_t s = 0; s < firstInterleaved; ++s)
+		{
+			auto& stream = m_streams[s];
+			stream.m_bufferIndex = s;
+			stream.m_bufferOffset = 0;
+			stream.m_bufferStride = 0;
+			m_buffers.push_back({ GetEncodedData(stream), GetEncodedSize(stream) });
+		}
+		if (firstInterleaved == m_streams.size())
+		{
+			return;
+		}
+
+		uint32_t stride = 0;
+		for (uint32_t s = firstInterleaved; s < m_streams.size(); ++s)
+		{
+			auto& stream = m_streams[s];
+			stream.m_bufferIndex = firstInterleaved;
+			stream.m_bufferOffset = stride;
+			stride += GetEncodedVertexSize(stream);
+		}
+		const uint32_t vertexCount = m_currentVertexIndex;
+		m_interleavedData.resize(vertexCount * stride);
+		for (uint32_t s = firstInterleaved; s < m_streams.size(); ++s)
+		{
+			auto& stream = m_streams[s];
+			stream.m_bufferStride = stride;
+			const uint32_t vertexSize = GetEncodedVertexSize(stream);
+			const uint8_t* src = static_cast<const uint8_t*>(GetEncodedData(stream));
+			uint8_t* dst = m_interleavedData.data() + stream.m_bufferOffset;
+			for (uint32_t v = 0; v < vertexCount; ++v, src += vertexSize, dst += stride)
+			{
+				memcpy(dst, src, vertexSize);
+			}
+		}
+		m_buffers.push_back({ m_interleavedData.data(), m_interleavedData.size() });
+	}
+
+	glm::vec4 MeshBuilder::GetStreamDecode(uint32_t vertexStream) const
+	{
+		SDE_ASSERT(vertexStream < m_streams.size());
+		return m_streams[vertexStream].m_decode;
+	}
+
+	void MeshBuilder::EncodeStreams()
+	{
+		SDE_PROF_EVENT();
+		for (auto& stream : m_streams)
+		{
+			if (stream.m_encoding == VertexStreamEncoding::Float)
+			{
+				continue;
+			}
+			const uint32_t components = stream.m_componentCount;
+			const uint32_t vertexCount = static_cast<uint32_t>(stream.m_streamData.size() / components);
+			const uint32_t encodedComponents = GetEncodedComponentCount(stream);
+			stream.m_encodedData.resize(vertexCount * encodedComponents * sizeof(uint16_t));
+			uint16_t* out = reinterpret_cast<uint16_t*>(stream.m_encodedData.data());
+			const float* in = stream.m_streamData.data();
+			switch (stream.m_encoding)
+			{
+			case VertexStreamEncoding::HalfFloat:
+				for (uint32_t v = 0; v < vertexCount; ++v, in += components, out += encodedComponents)
+				{
+					for (uint32_t c = 0; c < encodedComponents; ++c)
+					{
+						out[c] = EncodeHalf(c < components ? in[c] : 0.0f);
+					}
+				}
+				break;
+			case VertexStreamEncoding::BoundedSnorm16:
+			{
+				// uniform scale around the bounds center, the largest axis uses the full range
+				glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+				for (uint32_t v = 0; v < vertexCount; ++v)
+				{
+					const glm::vec3 p(in[v * 3], in[v * 3 + 1], in[v * 3 + 2]);
+					boundsMin = glm::min(boundsMin, p);
+					boundsMax = glm::max(boundsMax, p);
+				}
+				const glm::vec3 center = vertexCount > 0 ? (boundsMin + boundsMax) * 0.5f : glm::vec3(0.0f);
+				const float halfExtent = vertexCount > 0 ? glm::compMax(boundsMax - center) : 0.0f;
+				const float scale = halfExtent > 0.0f ? halfExtent : 1.0f;
+				stream.m_decode = glm::vec4(center, scale);
+				for (uint32_t v = 0; v < vertexCount; ++v, in += 3, out += 4)
+				{
+					out[0] = static_cast<uint16_t>(EncodeSnorm16((in[0] - center.x) / scale));
+					out[1] = static_cast<uint16_t>(EncodeSnorm16((in[1] - center.y) / scale));
+					out[2] = static_cast<uint16_t>(EncodeSnorm16((in[2] - center.z) / scale));
+					out[3] = 0;
+				}
+				break;
+			}
+			case VertexStreamEncoding::OctahedralSnorm16:
+				for (uint32_t v = 0; v < vertexCount; ++v, in += 3, out += 2)
+				{
+					const glm::vec3 n(in[0], in[1], in[2]);
+					const glm::vec2 e = glm::dot(n, n) > 0.0f ? OctahedralEncode(n) : glm::vec2(0.0f);
+					out[0] = static_cast<uint16_t>(EncodeSnorm16(e.x));
+					out[1] = static_cast<uint16_t>(EncodeSnorm16(e.y));
+				}
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	MeshBuilder::OptimiseStats MeshBuilder::Optimise(uint32_t positionStream)
+	{
+		SDE_PROF_EVENT();
+		SDE_ASSERT(positionStream < m_streams.size());
+		SDE_ASSERT(m_streams[positionStream].m_componentCount == 3);
+		SDE_ASSERT(m_lods.size() == 0, "Optimise before generating lods, the vertex remap ignores them");
+		OptimiseStats stats;
+		const uint32_t vertexCount = m_currentVertexIndex;
+		const float* positions = m_streams[positionStream].m_streamData.data();
+		std::vector<uint32_t> scratch;
+		bool hasSoupChunks = false;
+		for (const auto& chunk : m_chunks)
+		{
+			uint32_t* chunkIndices = m_indices.data() + chunk.m_firstIndex;
+			const size_t indexCount = chunk.m_lastIndex - chunk.m_firstIndex;
+			if (indexCount == 0)
+			{
+				hasSoupChunks = true;
+				continue;
+			}
+			stats.m_before += AnalyseVertexCache(chunkIndices, indexCount, vertexCount);
+			scratch.resize(indexCount);
+			OptimiseVertexCache(scratch.data(), chunkIndices, indexCount, vertexCount);
+			OptimiseOverdraw(chunkIndices, scratch.data(), indexCount, positions, sizeof(float) * 3, vertexCount);
+			stats.m_after += AnalyseVertexCache(chunkIndices, indexCount, vertexCount);
+		}
+		if (m_indices.size() == 0 || hasSoupChunks)
+		{
+			return stats;	// soup vertices can't be moved
+		}
+
+		// vertices in order of first use, unreferenced ones are dropped
+		std::vector<uint32_t> remap(vertexCount);
+		const uint32_t usedVertices = OptimiseVertexFetchRemap(remap.data(), m_indices.data(), m_indices.size(), vertexCount);
+		for (auto& stream : m_streams)
+		{
+			const int32_t components = stream.m_componentCount;
+			std::vector<float> remapped(usedVertices * components);
+			for (uint32_t v = 0; v < vertexCount; ++v)
+			{
+				if (remap[v] != -1)
+				{
+					memcpy(&remapped[remap[v] * components], &stream.m_streamData[v * components], components * sizeof(float));
+				}
+			}
+			stream.m_streamData = std::move(remapped);
+		}
+		for (auto& index : m_indices)
+		{
+			index = remap[index];
+		}
+		for (auto& chunk : m_chunks)
+		{
+			if (chunk.m_lastIndex > chunk.m_firstIndex)
+			{
+				auto range = std::minmax_element(m_indices.begin() + chunk.m_firstIndex, m_indices.begin() + chunk.m_lastIndex);
+				chunk.m_firstVertex = *range.first;
+				chunk.m_lastVertex = *range.second + 1;
+			}
+		}
+		m_currentVertexIndex = usedVertices;
+		return stats;
+	}
+
+	uint32_t MeshBuilder::GenerateLods(uint32_t positionStream, uint32_t lodCount, float lodReduction)
+	{
+		SDE_PROF_EVENT();
+		SDE_ASSERT(positionStream < m_streams.size());
+		SDE_ASSERT(m_streams[positionStream].m_componentCount == 3);
+		SDE_ASSERT(m_lods.size() == 0, "Lods were already generated");
+		const float c_minLodReduction = 0.85f;		// levels keeping more of the previous index count are dropped
+		const float c_maxLodError = 0.1f;			// relative to the largest half extent, past this the surface starts folding
+		if (m_chunks.size() == 0)
+		{
+			return 1;
+		}
+		for (const auto& chunk : m_chunks)
+		{
+			if (chunk.m_lastIndex == chunk.m_firstIndex)
+			{
+				return 1;	// soups have nothing to simplify
+			}
+		}
+
+		const uint32_t vertexCount = m_currentVertexIndex;
+		const float* positions = m_streams[positionStream].m_streamData.data();
+		glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			const glm::vec3 p(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+			boundsMin = glm::min(boundsMin, p);
+			boundsMax = glm::max(boundsMax, p);
+		}
+		const float maxError = glm::compMax(boundsMax - boundsMin) * 0.5f * c_maxLodError;
+
+		// each level is simplified from the one before, so the errors add up
+		m_lodPositionStream = positionStream;
+		std::vector<uint32_t> simplified, optimised;
+		float previousError = 0.0f;
+		for (uint32_t lod = 1; lod < lodCount && previousError < maxError; ++lod)
+		{
+			const auto& previousChunks = m_lods.size() > 0 ? m_lods.back().m_chunks : m_chunks;
+			LodDesc newLod;
+			newLod.m_error = previousError;
+			const size_t firstNewIndex = m_indices.size();
+			size_t previousIndexCount = 0, newIndexCount = 0;
+			bool emptyChunk = false;
+			for (const auto& chunk : previousChunks)
+			{
+				const size_t indexCount = chunk.m_lastIndex - chunk.m_firstIndex;
+				const size_t targetCount = static_cast<size_t>(indexCount * lodReduction) / 3 * 3;
+				float error = 0.0f;
+				simplified.resize(indexCount);
+				const size_t simplifiedCount = SimplifyMesh(simplified.data(), m_indices.data() + chunk.m_firstIndex, indexCount,
+					positions, sizeof(float) * 3, vertexCount, targetCount, maxError - previousError, &error);
+				optimised.resize(simplifiedCount);
+				OptimiseVertexCache(optimised.data(), simplified.data(), simplifiedCount, vertexCount);
+
+				ChunkDesc lodChunk = chunk;
+				lodChunk.m_firstIndex = static_cast<uint32_t>(m_indices.size());
+				m_indices.insert(m_indices.end(), optimised.begin(), optimised.end());
+				lodChunk.m_lastIndex = static_cast<uint32_t>(m_indices.size());
+				newLod.m_chunks.push_back(lodChunk);
+				newLod.m_error = std::max(newLod.m_error, previousError + error);
+				previousIndexCount += indexCount;
+				newIndexCount += simplifiedCount;
+				emptyChunk |= simplifiedCount == 0;
+			}
+
+			// an empty chunk would draw as a soup
+			if (emptyChunk || newIndexCount > previousIndexCount * c_minLodReduction)
+			{
+				m_indices.resize(firstNewIndex);
+				break;
+			}
+			previousError = newLod.m_error;
+			m_lods.push_back(std::move(newLod));
+		}
+		return static_cast<uint32_t>(m_lods.size()) + 1;
+	}
+
+	// Hash of every component in every stream. -0 and 0 are treated as the same value
+	uint64_t MeshBuilder::HashVertex(uint32_t vertex) const
+	{
+		uint64_t hash = 0;
+		for (const auto& stream : m_streams)
+		{
+			const float* v = &stream.m_streamData[vertex * stream.m_componentCount];
+			for (int32_t c = 0; c < stream.m_componentCount; ++c)
+			{
+				const float value = v[c] == 0.0f ? 0.0f : v[c];
+				uint32_t bits;
+				memcpy(&bits, &value, sizeof(bits));
+				hash = Core::FlatHashMix(hash ^ bits);
+			}
+		}
+		return hash;
+	}
+
+	bool MeshBuilder::VerticesEqual(uint32_t v0, uint32_t v1) const
+	{
+		for (const auto& stream : m_streams)
+		{
+			const float* a = &stream.m_streamData[v0 * stream.m_componentCount];
+			const float* b = &stream.m_streamData[v1 * stream.m_componentCount];
+			for (int32_t c = 0; c < stream.m_componentCount; ++c)
+			{
+				if (a[c] != b[c])
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	uint32_t MeshBuilder::WeldVertices()
+	{
+		SDE_PROF_EVENT();
+		SDE_ASSERT(m_indices.size() == 0, "Only triangle soups can be welded");
+		const uint32_t vertexCount = m_currentVertexIndex;
+
+		// open addressing, table is at least twice the vertex count so probes stay short
+		uint32_t tableSize = 16;
+		while (tableSize < vertexCount * 2)
+		{
+			tableSize *= 2;
+		}
+		const uint32_t c_emptySlot = -1;
+		std::vector<uint32_t> table(tableSize, c_emptySlot);
+
+		// unique vertices are compacted in place, a vertex is never moved past its original position
+		m_indices.resize(vertexCount);
+		uint32_t uniqueCount = 0;
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			uint32_t slot = static_cast<uint32_t>(HashVertex(v)) & (tableSize - 1);
+			while (table[slot] != c_emptySlot && !VerticesEqual(table[slot], v))
+			{
+				slot = (slot + 1) & (tableSize - 1);
+			}
+			if (table[slot] == c_emptySlot)
+			{
+				if (uniqueCount != v)
+				{
+					for (auto& stream : m_streams)
+					{
+						float* data = stream.m_streamData.data();
+						memcpy(data + uniqueCount * stream.m_componentCount, data + v * stream.m_componentCount, stream.m_componentCount * sizeof(float));
+					}
+				}
+				table[slot] = uniqueCount++;
+			}
+			m_indices[v] = table[slot];
+		}
+		for (auto& stream : m_streams)
+		{
+			stream.m_streamData.resize(uniqueCount * stream.m_componentCount);
+		}
+
+		// each soup vertex became one index. vertices are shared between chunks, so every chunk references all of them
+		for (auto& chunk : m_chunks)
+		{
+			chunk.m_firstIndex = chunk.m_firstVertex;
+			chunk.m_lastIndex = chunk.m_lastVertex;
+			chunk.m_firstVertex = 0;
+			chunk.m_lastVertex = uniqueCount;
+		}
+		m_currentVertexIndex = uniqueCount;
+		return uniqueCount;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,860 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#include "mesh_optimiser.h"
+#include "kernel/assert.h"
+#include "core/profiler.h"
+#include "math/glm_headers.h"
+#include "core/flat_hash_map.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+namespace Render
+{
+	// FIFO post-transform cache. A vertex is cached if it missed within the last cacheSize misses
+	class VertexCacheSimulator
+	{
+	public:
+		VertexCacheSimulator(uint32_t vertexCount, uint32_t cacheSize)
+			: m_timestamps(vertexCount, 0)
+			, m_timestamp(cacheSize + 1)
+			, m_cacheSize(cacheSize)
+		{
+		}
+		void Flush() { m_timestamp += m_cacheSize + 1; }
+		uint32_t Triangle(const uint32_t* t)
+		{
+			uint32_t misses = 0;
+			for (uint32_t i = 0; i < 3; ++i)
+			{
+				if (m_timestamp - m_timestamps[t[i]] > m_cacheSize)
+				{
+					m_timestamps[t[i]] = ++m_timestamp;
+					++misses;
+				}
+			}
+			return misses;
+		}
+		bool WasUsed(uint32_t v) const { return m_timestamps[v] != 0; }
+	private:
+		std::vector<uint32_t> m_timestamps;
+		uint32_t m_timestamp;
+		uint32_t m_cacheSize;
+	};
+
+	VertexCacheStats AnalyseVertexCache(const uint32_t* indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		SDE_PROF_EVENT();
+		SDE_ASSERT(indexCount % 3 == 0);
+		VertexCacheStats stats;
+		VertexCacheSimulator cache(vertexCount, cacheSize);
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			stats.m_transformedVertices += cache.Triangle(indices + i);
+		}
+		stats.m_triangleCount = static_cast<uint32_t>(indexCount / 3);
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			stats.m_vertexCount += cache.WasUsed(v) ? 1 : 0;
+		}
+		return stats;
+	}
+
+	namespace ForsythScore
+	{
+		const uint32_t c_cacheSize = 32;		// modelled LRU size, larger than the real cache on purpose
+		const float c_cacheDecayPower = 1.5f;
+		const float c_lastTriangleScore = 0.75f;
+		const float c_valenceBoostScale = 2.0f;
+		const float c_valenceBoostPower = 0.5f;
+		const uint32_t c_maxValenceTable = 32;
+
+		struct Tables
+		{
+			Tables()
+			{
+				for (uint32_t p = 0; p < c_cacheSize; ++p)
+				{
+					const float scaler = 1.0f / (c_cacheSize - 3);
+					m_cache[p] = p < 3 ? c_lastTriangleScore : std::pow(1.0f - (p - 3) * scaler, c_cacheDecayPower);
+				}
+				m_valence[0] = 0.0f;
+				for (uint32_t v = 1; v < c_maxValenceTable; ++v)
+				{
+					m_valence[v] = c_valenceBoostScale * std::pow((float)v, -c_valenceBoostPower);
+				}
+			}
+			float m_cache[c_cacheSize];
+			float m_valence[c_maxValenceTable];
+		};
+
+		// vertices with no triangles left score -1 so they never attract anything
+		inline float Score(const Tables& t, int32_t cachePosition, uint32_t remainingTriangles)
+		{
+			if (remainingTriangles == 0)
+			{
+				return -1.0f;
+			}
+			const float cacheScore = cachePosition >= 0 ? t.m_cache[cachePosition] : 0.0f;
+			const float valenceScore = remainingTriangles < c_maxValenceTable ? t.m_valence[remainingTriangles] : c_valenceBoostScale * std::pow((float)remainingTriangles, -c_valenceBoostPower);
+			return cacheScore + valenceScore;
+		}
+	}
+
+	void OptimiseVertexCache(uint32_t* dst, const uint32_t* indices, size_t indexCount, uint32_t vertexCount)
+	{
+		SDE_PROF_EVENT();
+		SDE_ASSERT(indexCount % 3 == 0);
+		SDE_ASSERT(dst != indices, "OptimiseVertexCache can't run in place");
+		using namespace ForsythScore;
+		static const Tables s_tables;
+		const uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+		if (triangleCount == 0)
+		{
+			return;
+		}
+
+		// triangles using each vertex, live triangles are kept at the front of each range
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		std::vector<uint32_t> remaining(vertexCount, 0);
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			SDE_ASSERT(indices[i] < vertexCount, "Index out of range");
+			remaining[indices[i]]++;
+		}
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+		}
+		std::vector<uint32_t> adjacency(indexCount);
+		{
+			std::vector<uint32_t> writeOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < indexCount; ++i)
+			{
+				adjacency[writeOffsets[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		std::vector<int32_t> cachePosition(vertexCount, -1);
+		std::vector<float> vertexScore(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			vertexScore[v] = Score(s_tables, -1, remaining[v]);
+		}
+		std::vector<float> triangleScore(triangleCount);
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		uint32_t bestTriangle = 0;
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			const uint32_t* tri = indices + t * 3;
+			triangleScore[t] = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+			if (triangleScore[t] > triangleScore[bestTriangle])
+			{
+				bestTriangle = t;
+			}
+		}
+
+		uint32_t cache[c_cacheSize + 3];
+		uint32_t newCache[c_cacheSize + 3];
+		uint32_t cacheCount = 0;
+		uint32_t nextUnemitted = 0;
+		for (uint32_t written = 0; written < triangleCount; ++written)
+		{
+			// nothing adjacent to the cache, fall back to the next triangle in input order
+			if (bestTriangle == -1)
+			{
+				while (emitted[nextUnemitted])
+				{
+					++nextUnemitted;
+				}
+				bestTriangle = nextUnemitted;
+			}
+			const uint32_t* tri = indices + bestTriangle * 3;
+			dst[written * 3] = tri[0];
+			dst[written * 3 + 1] = tri[1];
+			dst[written * 3 + 2] = tri[2];
+			emitted[bestTriangle] = 1;
+
+			// remove the triangle from its vertices, then push them to the front of the cache
+			uint32_t newCacheCount = 0;
+			for (uint32_t i = 0; i < 3; ++i)
+			{
+				const uint32_t v = tri[i];
+				uint32_t* adj = &adjacency[adjacencyOffsets[v]];
+				for (uint32_t a = 0; a < remaining[v]; ++a)
+				{
+					if (adj[a] == bestTriangle)
+					{
+						std::swap(adj[a], adj[remaining[v] - 1]);
+						remaining[v]--;
+						break;
+					}
+				}
+				if (std::find(newCache, newCache + newCacheCount, v) == newCache + newCacheCount)
+				{
+					newCache[newCacheCount++] = v;
+				}
+			}
+			for (uint32_t c = 0; c < cacheCount; ++c)
+			{
+				const uint32_t v = cache[c];
+				if (v != tri[0] && v != tri[1] && v != tri[2])
+				{
+					newCache[newCacheCount++] = v;
+				}
+			}
+
+			// rescore everything that moved (including vertices pushed out), and pick the best triangle touching the cache
+			bestTriangle = -1;
+			float bestScore = -1.0f;
+			for (uint32_t c = 0; c < newCacheCount; ++c)
+			{
+				const uint32_t v = newCache[c];
+				cachePosition[v] = c < c_cacheSize ? c : -1;
+				const float newScore = Score(s_tables, cachePosition[v], remaining[v]);
+				const float delta = newScore - vertexScore[v];
+				vertexScore[v] = newScore;
+				const uint32_t* adj = &adjacency[adjacencyOffsets[v]];
+				for (uint32_t a = 0; a < remaining[v]; ++a)
+				{
+					triangleScore[adj[a]] += delta;
+				}
+			}
+			for (uint32_t c = 0; c < newCacheCount && c < c_cacheSize; ++c)
+			{
+				const uint32_t v = newCache[c];
+				const uint32_t* adj = &adjacency[adjacencyOffsets[v]];
+				for (uint32_t a = 0; a < remaining[v]; ++a)
+				{
+					if (triangleScore[adj[a]] > bestScore)
+					{
+						bestScore = triangleScore[adj[a]];
+						bestTriangle = adj[a];
+					}
+				}
+			}
+			cacheCount = std::min(newCacheCount, c_cacheSize);
+			std::copy(newCache, newCache + cacheCount, cache);
+		}
+	}
+
+	void OptimiseOverdraw(uint32_t* dst, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, uint32_t vertexCount, float threshold)
+	{
+		SDE_PROF_EVENT();
+		SDE_ASSERT(indexCount % 3 == 0);
+		SDE_ASSERT(dst != indices, "OptimiseOverdraw can't run in place");
+		const uint32_t c_cacheSize = 16;
+		const uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+		if (triangleCount == 0)
+		{
+			return;
+		}
+
+		// hard boundaries where the input order starts over (all 3 vertices missed)
+		VertexCacheSimulator cache(vertexCount, c_cacheSize);
+		std::vector<uint32_t> hardBoundaries;
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			if (cache.Triangle(indices + t * 3) == 3)
+			{
+				hardBoundaries.push_back(t);
+			}
+		}
+		if (hardBoundaries.empty() || hardBoundaries[0] != 0)
+		{
+			hardBoundaries.insert(hardBoundaries.begin(), 0);
+		}
+		hardBoundaries.push_back(triangleCount);
+
+		// soft boundaries, cut as soon as a cluster (drawn from a cold cache) is within threshold of the hard cluster ACMR
+		std::vector<uint32_t> clusters;
+		for (size_t h = 0; h + 1 < hardBoundaries.size(); ++h)
+		{
+			const uint32_t first = hardBoundaries[h], end = hardBoundaries[h + 1];
+			cache.Flush();
+			uint32_t hardMisses = 0;
+			for (uint32_t t = first; t < end; ++t)
+			{
+				hardMisses += cache.Triangle(indices + t * 3);
+			}
+			const float targetAcmr = threshold * hardMisses / (end - first);
+
+			cache.Flush();
+			clusters.push_back(first);
+			uint32_t clusterStart = first, clusterMisses = 0;
+			for (uint32_t t = first; t < end; ++t)
+			{
+				clusterMisses += cache.Triangle(indices + t * 3);
+				if (t + 1 < end && clusterMisses <= targetAcmr * (t + 1 - clusterStart))
+				{
+					clusterStart = t + 1;
+					clusterMisses = 0;
+					clusters.push_back(clusterStart);
+					cache.Flush();
+				}
+			}
+		}
+		clusters.push_back(triangleCount);
+
+		// area weighted centroid + normal per cluster
+		auto position = [&](uint32_t v) {
+			const float* p = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + v * positionStride);
+			return glm::vec3(p[0], p[1], p[2]);
+		};
+		const size_t clusterCount = clusters.size() - 1;
+		std::vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.0f));
+		std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+		glm::vec3 meshCentroid(0.0f);
+		float meshArea = 0.0f;
+		for (size_t c = 0; c < clusterCount; ++c)
+		{
+			float clusterArea = 0.0f;
+			for (uint32_t t = clusters[c]; t < clusters[c + 1]; ++t)
+			{
+				const glm::vec3 p0 = position(indices[t * 3]), p1 = position(indices[t * 3 + 1]), p2 = position(indices[t * 3 + 2]);
+				const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+				const float area = glm::length(n);
+				clusterCentroid[c] += (p0 + p1 + p2) * (area / 3.0f);
+				clusterNormal[c] += n;
+				clusterArea += area;
+			}
+			meshCentroid += clusterCentroid[c];
+			meshArea += clusterArea;
+			clusterCentroid[c] = clusterArea > 0.0f ? clusterCentroid[c] / clusterArea : position(indices[clusters[c] * 3]);
+		}
+		meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : meshCentroid;
+
+		// clusters facing away from the middle of the mesh are likely to occlude the rest, draw them first
+		std::vector<float> sortKeys(clusterCount);
+		std::vector<uint32_t> order(clusterCount);
+		for (size_t c = 0; c < clusterCount; ++c)
+		{
+			const float normalLength = glm::length(clusterNormal[c]);
+			sortKeys[c] = normalLength > 0.0f ? glm::dot(clusterCentroid[c] - meshCentroid, clusterNormal[c] / normalLength) : 0.0f;
+			order[c] = static_cast<uint32_t>(c);
+		}
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return sortKeys[a] > sortKeys[b];
+		});
+
+		uint32_t* out = dst;
+		for (uint32_t c : order)
+		{
+			const uint32_t* first = indices + clusters[c] * 3;
+			const uint32_t* last = indices + clusters[c + 1] * 3;
+			out = std::copy(first, last, out);
+		}
+	}
+
+	uint32_t OptimiseVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, uint32_t vertexCount)
+	{
+		SDE_PROF_EVENT();
+		std::fill(remap, remap + vertexCount, (uint32_t)-1);
+		uint32_t nextVertex = 0;
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			SDE_ASSERT(indices[i] < vertexCount, "Index out of range");
+			if (remap[indices[i]] == -1)
+			{
+				remap[indices[i]] = nextVertex++;
+			}
+		}
+		return nextVertex;
+	}
+
+	namespace Simplification
+	{
+		// What a position vertex may collapse into
+		enum VertexKind : uint8_t
+		{
+			Manifold,	// any neighbour
+			Border,		// on a single open boundary, only along it
+			Seam,		// 2 wedges split by a uv/normal seam, only along the seam
+			Locked,		// ends of borders/seams + anything more complicated
+		};
+
+		const double c_borderWeight = 10.0;		// open edges are pinned by planes perpendicular to them
+		const float c_maxNormalChange = 0.25f;	// cosine of the largest rotation a collapse may apply to a triangle
+
+		// Weighted sum of squared distances to planes, p.A.p + 2b.p + c
+		struct Quadric
+		{
+			double m_a00 = 0.0, m_a11 = 0.0, m_a22 = 0.0, m_a01 = 0.0, m_a02 = 0.0, m_a12 = 0.0;
+			double m_b0 = 0.0, m_b1 = 0.0, m_b2 = 0.0;
+			double m_c = 0.0;
+			double m_weight = 0.0;
+
+			static Quadric FromPlane(const glm::dvec3& n, double d, double weight)
+			{
+				Quadric q;
+				q.m_a00 = weight * n.x * n.x;	q.m_a11 = weight * n.y * n.y;	q.m_a22 = weight * n.z * n.z;
+				q.m_a01 = weight * n.x * n.y;	q.m_a02 = weight * n.x * n.z;	q.m_a12 = weight * n.y * n.z;
+				q.m_b0 = weight * n.x * d;		q.m_b1 = weight * n.y * d;		q.m_b2 = weight * n.z * d;
+				q.m_c = weight * d * d;
+				q.m_weight = weight;
+				return q;
+			}
+			Quadric& operator+=(const Quadric& q)
+			{
+				m_a00 += q.m_a00;	m_a11 += q.m_a11;	m_a22 += q.m_a22;
+				m_a01 += q.m_a01;	m_a02 += q.m_a02;	m_a12 += q.m_a12;
+				m_b0 += q.m_b0;		m_b1 += q.m_b1;		m_b2 += q.m_b2;
+				m_c += q.m_c;
+				m_weight += q.m_weight;
+				return *this;
+			}
+			// mean squared distance, so the error is in position units squared regardless of area
+			double Error(const glm::dvec3& p) const
+			{
+				const double rx = m_a00 * p.x + m_a01 * p.y + m_a02 * p.z;
+				const double ry = m_a01 * p.x + m_a11 * p.y + m_a12 * p.z;
+				const double rz = m_a02 * p.x + m_a12 * p.y + m_a22 * p.z;
+				const double e = p.x * rx + p.y * ry + p.z * rz + 2.0 * (m_b0 * p.x + m_b1 * p.y + m_b2 * p.z) + m_c;
+				return m_weight > 0.0 ? std::abs(e) / m_weight : 0.0;
+			}
+		};
+
+		struct Collapse
+		{
+			uint32_t m_from;	// position vertices
+			uint32_t m_to;
+			float m_error;		// squared
+		};
+
+		inline uint64_t EdgeKey(uint32_t a, uint32_t b)
+		{
+			return ((uint64_t)a << 32) | b;
+		}
+
+		inline bool HasEdge(const std::vector<uint64_t>& sortedEdges, uint32_t a, uint32_t b)
+		{
+			return std::binary_search(sortedEdges.begin(), sortedEdges.end(), EdgeKey(a, b));
+		}
+
+		// neighbours along a border or seam, a third distinct neighbour marks the vertex as too complex
+		inline void AddLoopNeighbour(glm::uvec2& loop, uint8_t& overflow, uint32_t n)
+		{
+			if (loop.x == n || loop.y == n)
+			{
+				return;
+			}
+			if (loop.x == -1)
+			{
+				loop.x = n;
+			}
+			else if (loop.y == -1)
+			{
+				loop.y = n;
+			}
+			else
+			{
+				overflow = 1;
+			}
+		}
+	}
+
+	size_t SimplifyMesh(uint32_t* dst, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, uint32_t vertexCount,
+		size_t targetIndexCount, float targetError, float* resultError)
+	{
+		SDE_PROF_EVENT();
+		SDE_ASSERT(indexCount % 3 == 0);
+		SDE_ASSERT(dst != indices, "SimplifyMesh can't run in place");
+		using namespace Simplification;
+		auto position = [&](uint32_t v) {
+			const float* p = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + v * positionStride);
+			return glm::vec3(p[0], p[1], p[2]);
+		};
+
+		// referenced vertices sharing a position are wedges of one position vertex (the first seen)
+		// wedgeNext links the wedges of each position vertex into a loop
+		std::vector<uint32_t> remap(vertexCount, (uint32_t)-1);
+		std::vector<uint32_t> wedgeNext(vertexCount, (uint32_t)-1);
+		{
+			uint32_t tableSize = 16;
+			while (tableSize < vertexCount * 2)
+			{
+				tableSize *= 2;
+			}
+			std::vector<uint32_t> table(tableSize, (uint32_t)-1);
+			for (size_t i = 0; i < indexCount; ++i)
+			{
+				const uint32_t v = indices[i];
+				SDE_ASSERT(v < vertexCount, "Index out of range");
+				if (remap[v] != -1)
+				{
+					continue;
+				}
+				const glm::vec3 p = position(v);
+				uint64_t hash = 0;
+				for (int c = 0; c < 3; ++c)
+				{
+					const float value = p[c] == 0.0f ? 0.0f : p[c];		// -0 == 0
+					uint32_t bits;
+					memcpy(&bits, &value, sizeof(bits));
+					hash = Core::FlatHashMix(hash ^ bits);
+				}
+				uint32_t slot = static_cast<uint32_t>(hash) & (tableSize - 1);
+				while (table[slot] != -1 && position(table[slot]) != p)
+				{
+					slot = (slot + 1) & (tableSize - 1);
+				}
+				if (table[slot] == -1)
+				{
+					table[slot] = v;
+					remap[v] = v;
+					wedgeNext[v] = v;
+				}
+				else
+				{
+					const uint32_t first = table[slot];
+					remap[v] = first;
+					wedgeNext[v] = wedgeNext[first];
+					wedgeNext[first] = v;
+				}
+			}
+		}
+
+		// triangles that are already degenerate would break the adjacency walks, drop them up front
+		std::vector<uint32_t> current;
+		current.reserve(indexCount);
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			const uint32_t p0 = remap[indices[i]], p1 = remap[indices[i + 1]], p2 = remap[indices[i + 2]];
+			if (p0 != p1 && p0 != p2 && p1 != p2)
+			{
+				current.insert(current.end(), indices + i, indices + i + 3);
+			}
+		}
+
+		// an edge is open if no triangle uses it in the other direction
+		// open position edges are borders, edges only open between wedges are seams
+		std::vector<uint64_t> wedgeEdges(current.size()), positionEdges(current.size());
+		for (size_t i = 0; i < current.size(); i += 3)
+		{
+			for (uint32_t e = 0; e < 3; ++e)
+			{
+				const uint32_t a = current[i + e], b = current[i + (e + 1) % 3];
+				wedgeEdges[i + e] = EdgeKey(a, b);
+				positionEdges[i + e] = EdgeKey(remap[a], remap[b]);
+			}
+		}
+		std::sort(wedgeEdges.begin(), wedgeEdges.end());
+		std::sort(positionEdges.begin(), positionEdges.end());
+
+		std::vector<Quadric> quadrics(vertexCount);
+		std::vector<uint8_t> openOut(vertexCount, 0), openIn(vertexCount, 0);
+		std::vector<glm::uvec2> borderLoops(vertexCount, glm::uvec2(-1));	// x = next, y = previous
+		std::vector<glm::uvec2> seamLoops(vertexCount, glm::uvec2(-1));
+		std::vector<uint8_t> seamOverflow(vertexCount, 0);
+		for (size_t i = 0; i < current.size(); i += 3)
+		{
+			const uint32_t* tri = &current[i];
+			const glm::dvec3 p0(position(tri[0])), p1(position(tri[1])), p2(position(tri[2]));
+			glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const double doubleArea = glm::length(normal);
+			if (doubleArea > 0.0)
+			{
+				normal /= doubleArea;
+				const Quadric q = Quadric::FromPlane(normal, -glm::dot(normal, p0), doubleArea * 0.5);
+				for (uint32_t c = 0; c < 3; ++c)
+				{
+					quadrics[remap[tri[c]]] += q;
+				}
+			}
+			for (uint32_t e = 0; e < 3; ++e)
+			{
+				const uint32_t a = tri[e], b = tri[(e + 1) % 3];
+				const uint32_t pa = remap[a], pb = remap[b];
+				if (!HasEdge(positionEdges, pb, pa))
+				{
+					openOut[pa] = static_cast<uint8_t>(std::min(openOut[pa] + 1, 2));		// 2 = more than one
+					openIn[pb] = static_cast<uint8_t>(std::min(openIn[pb] + 1, 2));
+					borderLoops[pa].x = pb;
+					borderLoops[pb].y = pa;
+					const glm::dvec3 ea(position(a)), edge = glm::dvec3(position(b)) - ea;
+					const double edgeLength = glm::length(edge);
+					if (doubleArea > 0.0 && edgeLength > 0.0)
+					{
+						const glm::dvec3 edgeNormal = glm::normalize(glm::cross(edge, normal));
+						const Quadric q = Quadric::FromPlane(edgeNormal, -glm::dot(edgeNormal, ea), edgeLength * edgeLength * c_borderWeight);
+						quadrics[pa] += q;
+						quadrics[pb] += q;
+					}
+				}
+				else if (!HasEdge(wedgeEdges, b, a))
+				{
+					AddLoopNeighbour(seamLoops[pa], seamOverflow[pa], pb);
+					AddLoopNeighbour(seamLoops[pb], seamOverflow[pb], pa);
+				}
+			}
+		}
+
+		std::vector<uint8_t> kind(vertexCount, Locked);
+		std::vector<glm::uvec2> loops(vertexCount, glm::uvec2(-1));
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			if (remap[v] != v)
+			{
+				continue;
+			}
+			uint32_t wedgeCount = 0;
+			uint32_t w = v;
+			do
+			{
+				++wedgeCount;
+				w = wedgeNext[w];
+			} while (w != v);
+			const bool onSeam = seamLoops[v].x != -1;
+			const bool simpleSeam = seamLoops[v].y != -1 && !seamOverflow[v];
+			if (openOut[v] == 0 && openIn[v] == 0)
+			{
+				if (wedgeCount == 1 && !onSeam)
+				{
+					kind[v] = Manifold;
+				}
+				else if (wedgeCount == 2 && simpleSeam)
+				{
+					kind[v] = Seam;
+					loops[v] = seamLoops[v];
+				}
+			}
+			else if (openOut[v] == 1 && openIn[v] == 1 && wedgeCount == 1 && !onSeam && borderLoops[v].x != borderLoops[v].y)
+			{
+				kind[v] = Border;
+				loops[v] = borderLoops[v];
+			}
+		}
+		auto canCollapse = [&](uint32_t from, uint32_t to) {
+			switch (kind[from])
+			{
+			case Manifold:
+				return true;
+			case Border:
+			case Seam:
+				return kind[to] == kind[from] && (loops[from].x == to || loops[from].y == to) && loops[from].x != loops[from].y;
+			default:
+				return false;
+			}
+		};
+
+		// each pass ranks every edge, then performs the cheapest collapses whose neighbourhoods don't overlap
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+		std::vector<uint32_t> adjacency;
+		std::vector<uint32_t> wedgeTarget(vertexCount);
+		std::vector<uint8_t> touched(vertexCount);
+		std::vector<Collapse> collapses;
+		std::vector<uint32_t> fromNeighbours, toNeighbours, sharedNeighbours;
+		const double maxErrorSq = (double)targetError * targetError;
+		float maxError = 0.0f;
+		while (current.size() > targetIndexCount)
+		{
+			// triangles around each position vertex
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (uint32_t i : current)
+			{
+				adjacencyOffsets[remap[i] + 1]++;
+			}
+			for (uint32_t v = 0; v < vertexCount; ++v)
+			{
+				adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+			}
+			adjacency.resize(current.size());
+			{
+				std::vector<uint32_t> writeOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (size_t i = 0; i < current.size(); ++i)
+				{
+					adjacency[writeOffsets[remap[current[i]]]++] = static_cast<uint32_t>(i / 3);
+				}
+			}
+
+			// the cheaper valid direction of each edge. interior edges are seen twice, the duplicate is skipped when performing
+			collapses.clear();
+			for (size_t i = 0; i < current.size(); i += 3)
+			{
+				for (uint32_t e = 0; e < 3; ++e)
+				{
+					const uint32_t a = remap[current[i + e]], b = remap[current[i + (e + 1) % 3]];
+					Collapse best = { 0, 0, -1.0f };
+					if (canCollapse(a, b))
+					{
+						best = { a, b, (float)quadrics[a].Error(glm::dvec3(position(b))) };
+					}
+					if (canCollapse(b, a))
+					{
+						const float error = (float)quadrics[b].Error(glm::dvec3(position(a)));
+						if (best.m_error < 0.0f || error < best.m_error)
+						{
+							best = { b, a, error };
+						}
+					}
+					if (best.m_error >= 0.0f)
+					{
+						collapses.push_back(best);
+					}
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& c0, const Collapse& c1) {
+				return c0.m_error < c1.m_error;
+			});
+
+			const size_t trianglesToRemove = (current.size() - targetIndexCount) / 3;
+			size_t trianglesRemoved = 0;
+			uint32_t collapseCount = 0;
+			std::fill(touched.begin(), touched.end(), 0);
+			for (uint32_t v = 0; v < vertexCount; ++v)
+			{
+				wedgeTarget[v] = v;
+			}
+			for (const auto& collapse : collapses)
+			{
+				if (collapse.m_error > maxErrorSq || trianglesRemoved >= trianglesToRemove)
+				{
+					break;
+				}
+				const uint32_t from = collapse.m_from, to = collapse.m_to;
+				if (touched[from] || touched[to])
+				{
+					continue;
+				}
+
+				// reject collapses that flip a remaining triangle, or turn it far enough to fold over a few passes later
+				const glm::vec3 target = position(to);
+				bool flips = false;
+				for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1] && !flips; ++a)
+				{
+					const uint32_t* tri = &current[adjacency[a] * 3];
+					if (remap[tri[0]] == to || remap[tri[1]] == to || remap[tri[2]] == to)
+					{
+						continue;	// removed by the collapse
+					}
+					glm::vec3 p[3] = { position(tri[0]), position(tri[1]), position(tri[2]) };
+					const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+					for (uint32_t c = 0; c < 3; ++c)
+					{
+						p[c] = remap[tri[c]] == from ? target : p[c];
+					}
+					const glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+					flips = glm::dot(before, after) <= c_maxNormalChange * glm::length(before) * glm::length(after);
+				}
+				if (flips)
+				{
+					continue;
+				}
+
+				// link condition, the only neighbours the two vertices share must be the ones opposite the edge
+				// anything else would fold the surface onto itself
+				auto gatherNeighbours = [&](uint32_t v, std::vector<uint32_t>& neighbours) {
+					neighbours.clear();
+					for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; ++a)
+					{
+						const uint32_t* tri = &current[adjacency[a] * 3];
+						for (uint32_t c = 0; c < 3; ++c)
+						{
+							if (remap[tri[c]] != v)
+							{
+								neighbours.push_back(remap[tri[c]]);
+							}
+						}
+					}
+					std::sort(neighbours.begin(), neighbours.end());
+					neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+				};
+				gatherNeighbours(from, fromNeighbours);
+				gatherNeighbours(to, toNeighbours);
+				uint32_t sharedTriangles = 0;
+				for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; ++a)
+				{
+					const uint32_t* tri = &current[adjacency[a] * 3];
+					sharedTriangles += (remap[tri[0]] == to || remap[tri[1]] == to || remap[tri[2]] == to) ? 1 : 0;
+				}
+				sharedNeighbours.clear();
+				std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(), toNeighbours.begin(), toNeighbours.end(), std::back_inserter(sharedNeighbours));
+				if (sharedNeighbours.size() != sharedTriangles)
+				{
+					continue;
+				}
+
+				// each wedge moves to the wedge of the target it shares a triangle with, keeping seams intact
+				bool mapped = true;
+				uint32_t w = from;
+				do
+				{
+					uint32_t wedge = -1;
+					for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1] && wedge == -1; ++a)
+					{
+						const uint32_t* tri = &current[adjacency[a] * 3];
+						if (tri[0] == w || tri[1] == w || tri[2] == w)
+						{
+							for (uint32_t c = 0; c < 3; ++c)
+							{
+								wedge = remap[tri[c]] == to ? tri[c] : wedge;
+							}
+						}
+					}
+					mapped = wedge != -1;
+					wedgeTarget[w] = wedge;
+					w = wedgeNext[w];
+				} while (w != from && mapped);
+				if (!mapped)
+				{
+					w = from;
+					do
+					{
+						wedgeTarget[w] = w;
+						w = wedgeNext[w];
+					} while (w != from);
+					continue;
+				}
+
+				quadrics[to] += quadrics[from];
+				if (kind[from] == Border || kind[from] == Seam)
+				{
+					// the loop skips over the collapsed vertex
+					const uint32_t other = loops[from].x == to ? loops[from].y : loops[from].x;
+					loops[other] = glm::uvec2(loops[other].x == from ? to : loops[other].x, loops[other].y == from ? to : loops[other].y);
+					loops[to] = glm::uvec2(loops[to].x == from ? other : loops[to].x, loops[to].y == from ? other : loops[to].y);
+				}
+
+				// the whole neighbourhood is locked so the triangles checked above can't change again this pass
+				for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; ++a)
+				{
+					const uint32_t* tri = &current[adjacency[a] * 3];
+					touched[remap[tri[0]]] = touched[remap[tri[1]]] = touched[remap[tri[2]]] = 1;
+				}
+				touched[to] = 1;
+				trianglesRemoved += kind[from] == Border ? 1 : 2;
+				maxError = std::max(maxError, collapse.m_error);
+				++collapseCount;
+			}
+			if (collapseCount == 0)
+			{
+				break;
+			}
+
+			// remap the wedges + drop the triangles that collapsed
+			size_t written = 0;
+			for (size_t i = 0; i < current.size(); i += 3)
+			{
+				const uint32_t i0 = wedgeTarget[current[i]], i1 = wedgeTarget[current[i + 1]], i2 = wedgeTarget[current[i + 2]];
+				if (remap[i0] != remap[i1] && remap[i0] != remap[i2] && remap[i1] != remap[i2])
+				{
+					current[written++] = i0;
+					current[written++] = i1;
+					current[written++] = i2;
+				}
+			}
+			current.resize(written);
+		}
+
+		std::copy(current.begin(), current.end(), dst);
+		if (resultError != nullptr)
+		{
+			*resultError = std::sqrt(maxError);
+		}
+		return current.size();
+	}
+}
@@ -32,6 +32,8 @@ namespace Render
 			return GL_ELEMENT_ARRAY_BUFFER;
 		case RenderBufferType::UniformData:
 			return GL_UNIFORM_BUFFER;
+		case RenderBufferType::StorageData:
+			return GL_SHADER_STORAGE_BUFFER;
 		default:
 			return -1;
 		}
@@ -110,7 +112,7 @@ namespace Render
 		return Create(nullptr, bufferSize, type, modification, usePersistentMapping);
 	}
 
-	void RenderBuffer::SetData(size_t offset, size_t size, void* srcData)
+	void RenderBuffer::SetData(size_t offset, size_t size, const void* srcData)
 	{
 		SDE_PROF_EVENT();
 		SDE_ASSERT(offset < m_bufferSize);
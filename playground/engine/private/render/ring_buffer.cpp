@@ -0,0 +1,22 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#include "ring_buffer.h"
+#include "core/profiler.h"
+
+namespace Render
+{
+	bool RingBuffer::Create(size_t partitionSize, uint32_t partitionCount, size_t alignment, RenderBufferType type)
+	{
+		SDE_PROF_EVENT();
+		m_allocator = std::make_unique<RingBufferAllocator<Fence>>(partitionSize, partitionCount, alignment);
+		return m_buffer.Create(m_allocator->TotalSize(), type, RenderBufferModification::Dynamic, true);
+	}
+
+	void* RingBuffer::GetWritePointer(size_t offset)
+	{
+		SDE_ASSERT(offset < m_buffer.GetSize());
+		return static_cast<uint8_t*>(m_buffer.GetMappedPointer()) + offset;
+	}
+}
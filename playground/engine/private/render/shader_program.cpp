@@ -7,12 +7,16 @@ Matt Hoyle
 #include "utils.h"
 #include "core/string_hashing.h"
 #include "core/profiler.h"
+#include "kernel/atomics.h"
 #include <memory>
 
 namespace Render
 {
+	Kernel::AtomicInt32 s_lastSerial = 0;
+
 	ShaderProgram::ShaderProgram()
 		: m_handle(0)
+		, m_serial(0)
 	{
 	}
 
@@ -41,6 +45,7 @@ namespace Render
 
 		glLinkProgram(m_handle);
 		SDE_RENDER_PROCESS_GL_ERRORS_RET("glLinkProgram");
+		m_serial = s_lastSerial.Add(1) + 1;		// shaders can be compiled on any thread
 
 		// check the results
 		int32_t linkResult = 0, logLength = 0;
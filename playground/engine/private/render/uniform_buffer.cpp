@@ -2,6 +2,7 @@
 #include "render/device.h"
 #include "render/shader_program.h"
 #include "core/string_hashing.h"
+#include <string.h>
 
 namespace Render
 {
@@ -54,23 +55,94 @@ namespace Render
 	{
 		const uint32_t hash = Core::StringHashing::GetHash(name.c_str());
 		m_intValues[hash] = { name, value };
+		++m_version;
 	}
 
 	void UniformBuffer::SetValue(std::string name, float value)
 	{
 		const uint32_t hash = Core::StringHashing::GetHash(name.c_str());
 		m_floatValues[hash] = { name, value };
+		++m_version;
 	}
 
 	void UniformBuffer::SetValue(std::string name, const glm::mat4& value)
 	{
 		const uint32_t hash = Core::StringHashing::GetHash(name.c_str());
 		m_mat4Values[hash] = { name, value };
+		++m_version;
 	}
 
 	void UniformBuffer::SetValue(std::string name, const glm::vec4& value)
 	{
 		const uint32_t hash = Core::StringHashing::GetHash(name.c_str());
 		m_vec4Values[hash] = { name, value };
+		++m_version;
+	}
+
+	template<class T>
+	void CompiledUniformBuffer::CompileValues(const T& values, ValueType type, Render::ShaderProgram& p)
+	{
+		for (const auto& it : values)
+		{
+			auto uniformHandle = p.GetUniformHandle(it.second.m_name.c_str(), it.first);
+			if (uniformHandle != -1)
+			{
+				const uint32_t offset = static_cast<uint32_t>(m_values.size());
+				m_values.resize(offset + sizeof(it.second.m_value));
+				memcpy(m_values.data() + offset, &it.second.m_value, sizeof(it.second.m_value));
+				m_bindings.push_back({ uniformHandle, type, offset });
+			}
+		}
+	}
+
+	// uniforms the program does not use are dropped here
+	void CompiledUniformBuffer::Compile(const UniformBuffer& values, Render::ShaderProgram& p)
+	{
+		m_bindings.clear();
+		m_values.clear();
+		CompileValues(values.FloatValues(), ValueType::Float, p);
+		CompileValues(values.Vec4Values(), ValueType::Vec4, p);
+		CompileValues(values.Mat4Values(), ValueType::Mat4, p);
+		CompileValues(values.IntValues(), ValueType::Int, p);
+	}
+
+	void CompiledUniformBuffer::Apply(Render::Device& d) const
+	{
+		const uint8_t* values = m_values.data();
+		for (const auto& b : m_bindings)
+		{
+			// the blob is only byte aligned, copy out before use
+			switch (b.m_type)
+			{
+			case ValueType::Float:
+			{
+				float v;
+				memcpy(&v, values + b.m_offset, sizeof(v));
+				d.SetUniformValue(b.m_location, v);
+				break;
+			}
+			case ValueType::Vec4:
+			{
+				glm::vec4 v;
+				memcpy(&v, values + b.m_offset, sizeof(v));
+				d.SetUniformValue(b.m_location, v);
+				break;
+			}
+			case ValueType::Mat4:
+			{
+				glm::mat4 v;
+				memcpy(&v, values + b.m_offset, sizeof(v));
+				d.SetUniformValue(b.m_location, v);
+				break;
+			}
+			case ValueType::Int:
+			{
+				int32_t v;
+				memcpy(&v, values + b.m_offset, sizeof(v));
+				d.SetUniformValue(b.m_location, v);
+				break;
+			}
+			}
+		}
 	}
 }
\ No newline at end of file
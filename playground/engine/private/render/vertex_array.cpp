@@ -11,11 +11,15 @@ namespace Render
 {
 	// this must match the enum VertexDataType
 	constexpr uint32_t VertexDataTypeSizes[] = {
-		sizeof(float)
+		sizeof(float),
+		sizeof(uint16_t),
+		sizeof(uint32_t),
+		sizeof(int16_t)
 	};
 
 	VertexArray::VertexArray()
-		: m_handle(0)
+		: m_indexBuffer(nullptr)
+		, m_handle(0)
 	{
 	}
 
@@ -48,12 +52,18 @@ namespace Render
 		m_descriptors.push_back(newDesc);
 	}
 
-	inline uint32_t VertexArray::TranslateDataType(VertexDataType type) const
+	uint32_t VertexArray::TranslateDataType(VertexDataType type)
 	{
 		switch (type)
 		{
 		case VertexDataType::Float:
 			return GL_FLOAT;
+		case VertexDataType::HalfFloat:
+			return GL_HALF_FLOAT;
+		case VertexDataType::UnsignedInt:
+			return GL_UNSIGNED_INT;
+		case VertexDataType::ShortNormalised:
+			return GL_SHORT;
 		default:
 			return -1;
 		}
@@ -77,15 +87,31 @@ namespace Render
 			uint32_t glDataType = TranslateDataType(it->m_dataType);
 			SDE_ASSERT(glDataType != -1);
 
-			// set the array format
-			glVertexArrayAttribFormat(m_handle, it->m_attribIndex, it->m_componentCount, glDataType, false, (GLuint)it->m_offset);
-			SDE_RENDER_PROCESS_GL_ERRORS_RET("glVertexArrayAttribFormat");
+			// set the array format. each attribute has its own binding, the offset is applied to the binding above
+			if (it->m_dataType == VertexDataType::UnsignedInt)
+			{
+				glVertexArrayAttribIFormat(m_handle, it->m_attribIndex, it->m_componentCount, glDataType, 0);
+				SDE_RENDER_PROCESS_GL_ERRORS_RET("glVertexArrayAttribIFormat");
+			}
+			else
+			{
+				const bool normalised = it->m_dataType == VertexDataType::ShortNormalised;
+				glVertexArrayAttribFormat(m_handle, it->m_attribIndex, it->m_componentCount, glDataType, normalised, 0);
+				SDE_RENDER_PROCESS_GL_ERRORS_RET("glVertexArrayAttribFormat");
+			}
 
 			// enable the stream
 			glEnableVertexArrayAttrib(m_handle, it->m_attribIndex);
 			SDE_RENDER_PROCESS_GL_ERRORS_RET("glEnableVertexArrayAttrib");
 		}
 
+		// the element buffer binding is part of the VAO state
+		if (m_indexBuffer != nullptr && m_indexBuffer->GetHandle() != 0)
+		{
+			glVertexArrayElementBuffer(m_handle, m_indexBuffer->GetHandle());
+			SDE_RENDER_PROCESS_GL_ERRORS_RET("glVertexArrayElementBuffer");
+		}
+
 		return true;
 	}
 
@@ -3,69 +3,51 @@ SDLEngine
 Matt Hoyle
 */
 #include "asset_system.h"
+#include "job_system.h"
 #include "assets/asset_serialiser.h"
+#include "core/system_enumerator.h"
 
 namespace SDE
 {
 	AssetSystem::AssetSystem()
 		: m_assetsRoot("assets")
+		, m_jobSystem(nullptr)
 	{
-		m_pendingJobs.reserve(128);
-		m_completedJobs.reserve(128);
 		m_database = std::make_unique<Assets::AssetDatabase>();
 	}
 
 	AssetSystem::~AssetSystem()
 	{
-		SDE_ASSERT(m_pendingJobs.size() == 0);
-		SDE_ASSERT(m_completedJobs.size() == 0);
 	}
 
-	std::shared_ptr<Assets::Asset> AssetSystem::GetAsset(const std::string& assetID)
+	bool AssetSystem::PreInit(Core::ISystemEnumerator& systemEnumerator)
 	{
-		return m_database->GetAsset(assetID);
+		m_jobSystem = (JobSystem*)systemEnumerator.GetSystem("Jobs");
+		return true;
 	}
 
-	void AssetSystem::LoadAsset(const char* assetName, std::function<void(const std::string&, bool)> onComplete)
+	std::shared_ptr<Assets::Asset> AssetSystem::GetAsset(const std::string& assetID)
 	{
-		LoadingJobDescriptor newJob;
-		newJob.m_assetID = assetName;
-		newJob.m_loadResult = false;
-		newJob.m_then = onComplete;
-		m_pendingJobs.push_back(newJob);
+		return m_database->GetAsset(assetID);
 	}
 
-	bool AssetSystem::Tick()
+	void AssetSystem::LoadAsset(const char* assetName, std::function<void(const std::string&, bool)> onComplete)
 	{
-		// fake job system
-		for (auto &pending : m_pendingJobs)
-		{
+		// Serialise on a job thread, onComplete is called on the main thread once the job is complete
+		auto loadResult = std::make_shared<bool>(false);
+		std::string assetID = assetName;
+		m_jobSystem->PushJob([this, assetID, loadResult]() {
 			Assets::AssetSerialiser serialiser(*m_database, m_creator);
-			bool loadResult = serialiser.Load(m_assetsRoot.c_str(), pending.m_assetID.c_str());
-			pending.m_loadResult = loadResult;
-			m_completedJobs.push_back(pending);
-		}
-		m_pendingJobs.clear();
-
-		// fake job completion
-		for (auto& completed : m_completedJobs)
-		{
-			completed.m_then(completed.m_assetID, completed.m_loadResult);
-		}
-		m_completedJobs.clear();
-
-		return true;
+			*loadResult = serialiser.Load(m_assetsRoot.c_str(), assetID.c_str());
+		}, [assetID, loadResult, onComplete]() {
+			onComplete(assetID, *loadResult);
+		});
 	}
 
 	void AssetSystem::Shutdown()
 	{
-		// todo: wait on pending jobs, or cancel them?
-		m_pendingJobs.clear();
-		m_completedJobs.clear();
-
+		// pending jobs/continuations are dropped by the job system
 		// clear out the db, all assets should unload unless something leaks
 		m_database = nullptr;
 	}
-
-
 }
\ No newline at end of file
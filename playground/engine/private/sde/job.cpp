@@ -3,6 +3,7 @@ SDLEngine
 Matt Hoyle
 */
 #include "job.h"
+#include "job_system.h"
 #include "kernel/assert.h"
 
 namespace SDE
@@ -14,6 +15,14 @@ namespace SDE
 		SDE_ASSERT(parent != nullptr);
 	}
 
+	Job::Job(JobSystem* parent, JobThreadFunction threadFn, MainThreadFunction thenFn)
+		: m_parent(parent)
+		, m_threadFn(threadFn)
+		, m_thenFn(thenFn)
+	{
+		SDE_ASSERT(parent != nullptr);
+	}
+
 	Job::Job()
 		: m_parent(nullptr)
 	{
@@ -23,5 +32,9 @@ namespace SDE
 	void Job::Run()
 	{
 		m_threadFn();
+		if (m_thenFn)
+		{
+			m_parent->RunOnMainThread(std::move(m_thenFn));
+		}
 	}
 }
\ No newline at end of file
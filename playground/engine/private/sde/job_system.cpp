@@ -9,11 +9,15 @@ Matt Hoyle
 #include "render_system.h"
 #include "render/device.h"
 #include "sde/config_system.h"
+#include <memory>
 
 namespace SDE
 {
 	JobSystem::JobSystem()
-		: m_threadCount(8)
+		: m_configSystem(nullptr)
+		, m_renderSystem(nullptr)
+		, m_threadCount(8)
+		, m_mainThreadBudgetMs(2.0)
 		, m_jobThreadTrigger(0)
 		, m_jobThreadStopRequested(0)
 	{
@@ -37,6 +41,7 @@ namespace SDE
 		if (jobSys.valid())
 		{
 			m_threadCount = jobSys["ThreadCount"].get_or(m_threadCount);
+			m_mainThreadBudgetMs = jobSys["MainThreadBudgetMs"].get_or(m_mainThreadBudgetMs);
 		}
 	}
 
@@ -49,21 +54,30 @@ namespace SDE
 
 	bool JobSystem::PostInit()
 	{
-		LoadConfig(m_configSystem);
+		if (m_configSystem != nullptr)
+		{
+			LoadConfig(m_configSystem);
+		}
 
 		// Create shared GL contexts for each job thread on the main thread
-		// This allows us to call *some* gl functions from workers
-		auto renderDevice = m_renderSystem->GetDevice();
+		// This allows us to call *some* gl functions from workers. Without a render system (i.e. tests) the jobs get no context
 		std::vector<void*> workerContexts;
-		for (int w = 0; w < m_threadCount; ++w)
+		if (m_renderSystem != nullptr)
 		{
-			workerContexts.push_back(renderDevice->CreateSharedGLContext());
+			auto renderDevice = m_renderSystem->GetDevice();
+			for (int w = 0; w < m_threadCount; ++w)
+			{
+				workerContexts.push_back(renderDevice->CreateSharedGLContext());
+			}
+			// Creating a context sets it by default, so make sure we reset the main thread context
+			renderDevice->SetGLContext(renderDevice->GetGLContext());
 		}
-		// Creating a context sets it by default, so make sure we reset the main thread context
-		renderDevice->SetGLContext(renderDevice->GetGLContext());
 		auto jobInit = [this, workerContexts](uint32_t threadIndex)
 		{
-			m_renderSystem->GetDevice()->SetGLContext(workerContexts[threadIndex]);
+			if (m_renderSystem != nullptr)
+			{
+				m_renderSystem->GetDevice()->SetGLContext(workerContexts[threadIndex]);
+			}
 		};
 
 		auto jobThread = [this](uint32_t threadIndex)
@@ -109,6 +123,18 @@ namespace SDE
 
 		// Stop the threadpool, no more jobs will be taken after this
 		m_threadPool.Stop();
+
+		// Any continuations left over are dropped, the systems they reference may already be gone
+		m_mainThreadCallbacks.RemoveAll();
+	}
+
+	bool JobSystem::Tick()
+	{
+		SDE_PROF_EVENT();
+
+		// Finish off async work. Anything over budget spills to the next frame
+		m_mainThreadCallbacks.RunPending(m_mainThreadBudgetMs / 1000.0);
+		return true;
 	}
 
 	void JobSystem::PushJob(Job::JobThreadFunction threadFn)
@@ -119,4 +145,54 @@ namespace SDE
 		m_pendingJobs.PushJob(std::move(jobDesc));
 		m_jobThreadTrigger.Post();		// Trigger threads
 	}
+
+	void JobSystem::PushJob(Job::JobThreadFunction threadFn, Job::MainThreadFunction thenFn)
+	{
+		SDE_PROF_EVENT();
+
+		Job jobDesc(this, threadFn, thenFn);
+		m_pendingJobs.PushJob(std::move(jobDesc));
+		m_jobThreadTrigger.Post();		// Trigger threads
+	}
+
+	void JobSystem::RunInParallel(uint32_t chunkCount, const std::function<void(uint32_t)>& fn)
+	{
+		SDE_PROF_EVENT();
+		if (chunkCount == 0)
+		{
+			return;
+		}
+		struct SharedState
+		{
+			Kernel::AtomicInt32 m_nextChunk = 0;
+			Kernel::AtomicInt32 m_chunksDone = 0;
+			Kernel::Semaphore m_allDone { 0 };		// posted once by whoever finishes the last chunk
+		};
+		auto state = std::make_shared<SharedState>();	// jobs that start late only touch this
+		auto runChunks = [state, chunkCount, &fn]() {
+			int32_t chunk = 0;
+			while ((chunk = state->m_nextChunk.Add(1)) < static_cast<int32_t>(chunkCount))
+			{
+				fn(chunk);
+				if (state->m_chunksDone.Add(1) == static_cast<int32_t>(chunkCount) - 1)
+				{
+					state->m_allDone.Post();
+				}
+			}
+		};
+		for (uint32_t j = 1; j < chunkCount; ++j)
+		{
+			PushJob(runChunks);
+		}
+		runChunks();
+		{
+			SDE_PROF_STALL("WaitForJobs");
+			state->m_allDone.Wait();
+		}
+	}
+
+	void JobSystem::RunOnMainThread(MainThreadQueue::Callback fn)
+	{
+		m_mainThreadCallbacks.Push(std::move(fn));
+	}
 }
\ No newline at end of file
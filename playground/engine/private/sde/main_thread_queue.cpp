@@ -0,0 +1,114 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#include "main_thread_queue.h"
+#include "core/profiler.h"
+#include "core/timer.h"
+
+namespace SDE
+{
+	MainThreadQueue::MainThreadQueue()
+		: m_readyHead(nullptr)
+		, m_readyTail(nullptr)
+		, m_pendingCount(0)
+	{
+	}
+
+	MainThreadQueue::~MainThreadQueue()
+	{
+		RemoveAll();
+	}
+
+	void MainThreadQueue::Push(Callback&& fn)
+	{
+		Node* newNode = new Node{ std::move(fn), nullptr };
+		m_pendingCount.Add(1);
+
+		// push onto the incoming stack. no ABA problem here since the consumer only ever takes the whole list
+		void* oldHead = nullptr;
+		do
+		{
+			oldHead = m_incoming.Get();
+			newNode->m_next = static_cast<Node*>(oldHead);
+		} while (!m_incoming.CAS(oldHead, newNode));
+	}
+
+	void MainThreadQueue::AcquireIncoming()
+	{
+		// steal the entire incoming stack
+		void* incoming = nullptr;
+		do
+		{
+			incoming = m_incoming.Get();
+		} while (incoming != nullptr && !m_incoming.CAS(incoming, nullptr));
+
+		// the stack is newest-first, reverse it and append to the ready list
+		Node* reversedHead = nullptr;
+		Node* reversedTail = static_cast<Node*>(incoming);
+		Node* current = static_cast<Node*>(incoming);
+		while (current != nullptr)
+		{
+			Node* next = current->m_next;
+			current->m_next = reversedHead;
+			reversedHead = current;
+			current = next;
+		}
+		if (reversedHead != nullptr)
+		{
+			if (m_readyTail != nullptr)
+			{
+				m_readyTail->m_next = reversedHead;
+			}
+			else
+			{
+				m_readyHead = reversedHead;
+			}
+			m_readyTail = reversedTail;
+		}
+	}
+
+	uint32_t MainThreadQueue::RunPending(double budgetSeconds)
+	{
+		SDE_PROF_EVENT();
+
+		AcquireIncoming();
+
+		Core::Timer timer;
+		const double startTime = timer.GetSeconds();
+		uint32_t callbacksRan = 0;
+		while (m_readyHead != nullptr)
+		{
+			Node* toRun = m_readyHead;
+			m_readyHead = toRun->m_next;
+			if (m_readyHead == nullptr)
+			{
+				m_readyTail = nullptr;
+			}
+
+			toRun->m_fn();
+			delete toRun;
+			m_pendingCount.Add(-1);
+			++callbacksRan;
+
+			if ((timer.GetSeconds() - startTime) >= budgetSeconds)
+			{
+				break;
+			}
+		}
+		return callbacksRan;
+	}
+
+	void MainThreadQueue::RemoveAll()
+	{
+		AcquireIncoming();
+		while (m_readyHead != nullptr)
+		{
+			Node* next = m_readyHead->m_next;
+			delete m_readyHead;
+			m_readyHead = next;
+			m_pendingCount.Add(-1);
+		}
+		m_readyTail = nullptr;
+	}
+}
\ No newline at end of file
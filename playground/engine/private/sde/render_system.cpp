@@ -85,6 +85,8 @@ namespace SDE
 
 		for (auto renderPass : m_passes)
 		{
+			// passes may draw with their own GL code or delete objects between frames, so never trust the cached state
+			m_device->InvalidateStateCache();
 			renderPass.m_pass->RenderAll(*m_device);
 			renderPass.m_pass->Reset();
 		}
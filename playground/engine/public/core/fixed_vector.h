@@ -0,0 +1,65 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#pragma once
+
+#include "kernel/base_types.h"
+#include <type_traits>
+#include <utility>
+
+namespace Core
+{
+	// Vector with a hard capacity of N elements, all stored inline. Never allocates
+	// Overflowing is an error (asserts), so only use it where the upper bound is known
+	// Interface is a subset of std::vector; iterators are raw pointers
+	template< class T, uint32_t N >
+	class FixedVector
+	{
+	public:
+		static_assert(N > 0, "FixedVector must have some capacity");
+		using value_type = T;
+		using iterator = T*;
+		using const_iterator = const T*;
+
+		FixedVector();
+		~FixedVector();
+		FixedVector(const FixedVector& other);
+		FixedVector(FixedVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value);
+		FixedVector& operator=(const FixedVector& other);
+		FixedVector& operator=(FixedVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value);
+
+		inline size_t size() const { return m_size; }
+		inline size_t capacity() const { return N; }
+		inline bool empty() const { return m_size == 0; }
+		inline bool full() const { return m_size == N; }
+
+		inline T* data() { return reinterpret_cast<T*>(m_storage); }
+		inline const T* data() const { return reinterpret_cast<const T*>(m_storage); }
+		inline T& operator[](size_t index);
+		inline const T& operator[](size_t index) const;
+		inline T& front() { return (*this)[0]; }
+		inline const T& front() const { return (*this)[0]; }
+		inline T& back() { return (*this)[m_size - 1]; }
+		inline const T& back() const { return (*this)[m_size - 1]; }
+
+		inline iterator begin() { return data(); }
+		inline iterator end() { return data() + m_size; }
+		inline const_iterator begin() const { return data(); }
+		inline const_iterator end() const { return data() + m_size; }
+
+		void push_back(const T& v);
+		void push_back(T&& v);
+		template< class... Args >
+		T& emplace_back(Args&&... args);
+		void pop_back();
+		void clear();
+		void resize(size_t count);
+
+	private:
+		uint32_t m_size;
+		alignas(T) uint8_t m_storage[sizeof(T) * N];
+	};
+}
+
+#include "fixed_vector.inl"
\ No newline at end of file
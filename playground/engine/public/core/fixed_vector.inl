@@ -0,0 +1,134 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+
+#include "kernel/assert.h"
+#include <new>
+
+namespace Core
+{
+	template< class T, uint32_t N >
+	FixedVector<T, N>::FixedVector()
+		: m_size(0)
+	{
+	}
+
+	template< class T, uint32_t N >
+	FixedVector<T, N>::~FixedVector()
+	{
+		clear();
+	}
+
+	template< class T, uint32_t N >
+	FixedVector<T, N>::FixedVector(const FixedVector& other)
+		: FixedVector()
+	{
+		*this = other;
+	}
+
+	template< class T, uint32_t N >
+	FixedVector<T, N>::FixedVector(FixedVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value)
+		: FixedVector()
+	{
+		*this = std::move(other);
+	}
+
+	template< class T, uint32_t N >
+	FixedVector<T, N>& FixedVector<T, N>::operator=(const FixedVector& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			for (const auto& v : other)
+			{
+				new (data() + m_size) T(v);
+				++m_size;
+			}
+		}
+		return *this;
+	}
+
+	template< class T, uint32_t N >
+	FixedVector<T, N>& FixedVector<T, N>::operator=(FixedVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value)
+	{
+		if (this != &other)
+		{
+			clear();
+			for (auto& v : other)
+			{
+				new (data() + m_size) T(std::move(v));
+				++m_size;
+			}
+			other.clear();
+		}
+		return *this;
+	}
+
+	template< class T, uint32_t N >
+	inline T& FixedVector<T, N>::operator[](size_t index)
+	{
+		SDE_ASSERT(index < m_size, "Index out of range");
+		return data()[index];
+	}
+
+	template< class T, uint32_t N >
+	inline const T& FixedVector<T, N>::operator[](size_t index) const
+	{
+		SDE_ASSERT(index < m_size, "Index out of range");
+		return data()[index];
+	}
+
+	template< class T, uint32_t N >
+	void FixedVector<T, N>::push_back(const T& v)
+	{
+		emplace_back(v);
+	}
+
+	template< class T, uint32_t N >
+	void FixedVector<T, N>::push_back(T&& v)
+	{
+		emplace_back(std::move(v));
+	}
+
+	template< class T, uint32_t N >
+	template< class... Args >
+	T& FixedVector<T, N>::emplace_back(Args&&... args)
+	{
+		SDE_ASSERT(m_size < N, "FixedVector is full");
+		new (data() + m_size) T(std::forward<Args>(args)...);
+		return data()[m_size++];
+	}
+
+	template< class T, uint32_t N >
+	void FixedVector<T, N>::pop_back()
+	{
+		SDE_ASSERT(m_size > 0);
+		data()[--m_size].~T();
+	}
+
+	template< class T, uint32_t N >
+	void FixedVector<T, N>::clear()
+	{
+		for (uint32_t i = 0; i < m_size; ++i)
+		{
+			data()[i].~T();
+		}
+		m_size = 0;
+	}
+
+	template< class T, uint32_t N >
+	void FixedVector<T, N>::resize(size_t count)
+	{
+		SDE_ASSERT(count <= N, "FixedVector is too small");
+		while (m_size > count)
+		{
+			pop_back();
+		}
+		while (m_size < count)
+		{
+			new (data() + m_size) T();
+			++m_size;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#pragma once
+
+#include "kernel/base_types.h"
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+namespace Core
+{
+	// Final mixing step from murmur3, spreads entropy into the low and high bits
+	inline uint64_t FlatHashMix(uint64_t k)
+	{
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdull;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53ull;
+		k ^= k >> 33;
+		return k;
+	}
+
+	// Default hasher for the flat containers. Integer keys (i.e. 64 bit coordinate hashes) are mixed
+	// directly, anything else goes through std::hash first
+	template< class Key, class Enable = void >
+	struct FlatHash
+	{
+		inline uint64_t operator()(const Key& k) const { return FlatHashMix(static_cast<uint64_t>(std::hash<Key>()(k))); }
+	};
+
+	template< class Key >
+	struct FlatHash<Key, typename std::enable_if<std::is_integral<Key>::value || std::is_enum<Key>::value>::type>
+	{
+		inline uint64_t operator()(Key k) const { return FlatHashMix(static_cast<uint64_t>(k)); }
+	};
+
+	namespace FlatHashInternal
+	{
+		template< class Key, class Value >
+		struct MapPolicy
+		{
+			using SlotType = std::pair<Key, Value>;
+			static inline const Key& GetKey(const SlotType& s) { return s.first; }
+		};
+
+		template< class Key >
+		struct SetPolicy
+		{
+			using SlotType = Key;
+			static inline const Key& GetKey(const SlotType& s) { return s; }
+		};
+	}
+
+	// Open-addressing hash table, swiss-table style
+	// Each slot has a control byte (empty, deleted, or 7 bits of the hash). Control bytes are
+	// probed 16 at a time with SSE2, so most lookups touch one cache line of metadata + one slot
+	// Interface mirrors the std containers, but iterators + pointers are invalidated on insert!
+	template< class Key, class Policy, class Hasher >
+	class FlatHashTable
+	{
+	public:
+		using SlotType = typename Policy::SlotType;
+
+		template< bool IsConst >
+		class IteratorBase
+		{
+		public:
+			using Reference = typename std::conditional<IsConst, const SlotType&, SlotType&>::type;
+			using Pointer = typename std::conditional<IsConst, const SlotType*, SlotType*>::type;
+			IteratorBase() = default;
+			IteratorBase(const int8_t* ctrl, const int8_t* ctrlEnd, Pointer slot);
+			template< bool OtherConst, class = typename std::enable_if<IsConst && !OtherConst>::type >
+			IteratorBase(const IteratorBase<OtherConst>& other) : m_ctrl(other.m_ctrl), m_ctrlEnd(other.m_ctrlEnd), m_slot(other.m_slot) { }
+
+			Reference operator*() const { return *m_slot; }
+			Pointer operator->() const { return m_slot; }
+			IteratorBase& operator++();
+			bool operator==(const IteratorBase& other) const { return m_slot == other.m_slot; }
+			bool operator!=(const IteratorBase& other) const { return m_slot != other.m_slot; }
+
+		private:
+			template< bool > friend class IteratorBase;
+			void SkipFreeSlots();
+			const int8_t* m_ctrl = nullptr;
+			const int8_t* m_ctrlEnd = nullptr;
+			Pointer m_slot = nullptr;
+		};
+		using iterator = IteratorBase<false>;
+		using const_iterator = IteratorBase<true>;
+
+		FlatHashTable();
+		~FlatHashTable();
+		FlatHashTable(const FlatHashTable& other);
+		FlatHashTable(FlatHashTable&& other);
+		FlatHashTable& operator=(const FlatHashTable& other);
+		FlatHashTable& operator=(FlatHashTable&& other);
+
+		inline size_t size() const { return m_size; }
+		inline bool empty() const { return m_size == 0; }
+		inline size_t capacity() const { return m_capacity; }
+		void clear();
+		void reserve(size_t count);
+
+		iterator begin();
+		iterator end();
+		const_iterator begin() const;
+		const_iterator end() const;
+
+		iterator find(const Key& k);
+		const_iterator find(const Key& k) const;
+		size_t count(const Key& k) const;
+		std::pair<iterator, bool> insert(const SlotType& v);
+		std::pair<iterator, bool> insert(SlotType&& v);
+		size_t erase(const Key& k);
+
+	protected:
+		static const size_t c_notFound = (size_t)-1;
+		static const size_t c_groupWidth = 16;
+		size_t FindIndex(const Key& k, uint64_t hash) const;
+		size_t PrepareInsert(uint64_t hash);		// returns an index of a free slot + marks it as used
+		void Rehash(size_t newCapacity);
+		void Release();
+		inline iterator MakeIterator(size_t index) { return iterator(m_ctrl + index, m_ctrl + m_capacity, m_slots + index); }
+		inline const_iterator MakeIterator(size_t index) const { return const_iterator(m_ctrl + index, m_ctrl + m_capacity, m_slots + index); }
+
+		int8_t* m_ctrl;			// control bytes, one per slot
+		SlotType* m_slots;		// uninitialised until the control byte is set
+		size_t m_capacity;		// always 0 or a power of 2 >= c_groupWidth
+		size_t m_size;
+		size_t m_growthLeft;	// inserts until we need to rehash
+	};
+
+	template< class Key, class Value, class Hasher = FlatHash<Key> >
+	class FlatHashMap : public FlatHashTable<Key, FlatHashInternal::MapPolicy<Key, Value>, Hasher>
+	{
+	public:
+		Value& operator[](const Key& k);
+	};
+
+	template< class Key, class Hasher = FlatHash<Key> >
+	class FlatHashSet : public FlatHashTable<Key, FlatHashInternal::SetPolicy<Key>, Hasher>
+	{
+	};
+}
+
+#include "flat_hash_map.inl"
\ No newline at end of file
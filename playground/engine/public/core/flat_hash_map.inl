@@ -0,0 +1,428 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+
+#include "kernel/assert.h"
+#include <emmintrin.h>
+#include <intrin.h>
+#include <malloc.h>
+#include <string.h>
+#include <new>
+
+namespace Core
+{
+	namespace FlatHashInternal
+	{
+		// Control byte values. Full slots store the low 7 bits of the hash (so are always >= 0)
+		static const int8_t c_empty = -128;
+		static const int8_t c_deleted = -2;
+
+		// Bitmask of control bytes in a 16 byte group matching h2
+		inline uint32_t MatchGroup(const int8_t* group, int8_t h2)
+		{
+			const __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(group));
+			return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2))));
+		}
+
+		inline uint32_t MatchEmpty(const int8_t* group)
+		{
+			return MatchGroup(group, c_empty);
+		}
+
+		// empty and deleted are the only values < -1
+		inline uint32_t MatchEmptyOrDeleted(const int8_t* group)
+		{
+			const __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(group));
+			return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl)));
+		}
+
+		inline uint32_t LowestBit(uint32_t mask)
+		{
+			unsigned long result = 0;
+			_BitScanForward(&result, mask);
+			return result;
+		}
+
+		inline size_t MaxLoad(size_t capacity)
+		{
+			return capacity - capacity / 8;		// 7/8 load factor
+		}
+
+		inline int8_t H2(uint64_t hash) { return static_cast<int8_t>(hash & 0x7f); }
+		inline size_t H1(uint64_t hash) { return static_cast<size_t>(hash >> 7); }
+	}
+
+	template< class Key, class Policy, class Hasher >
+	template< bool IsConst >
+	FlatHashTable<Key, Policy, Hasher>::IteratorBase<IsConst>::IteratorBase(const int8_t* ctrl, const int8_t* ctrlEnd, Pointer slot)
+		: m_ctrl(ctrl)
+		, m_ctrlEnd(ctrlEnd)
+		, m_slot(slot)
+	{
+		SkipFreeSlots();
+	}
+
+	template< class Key, class Policy, class Hasher >
+	template< bool IsConst >
+	inline void FlatHashTable<Key, Policy, Hasher>::IteratorBase<IsConst>::SkipFreeSlots()
+	{
+		while (m_ctrl < m_ctrlEnd && *m_ctrl < 0)
+		{
+			++m_ctrl;
+			++m_slot;
+		}
+	}
+
+	template< class Key, class Policy, class Hasher >
+	template< bool IsConst >
+	inline typename FlatHashTable<Key, Policy, Hasher>::template IteratorBase<IsConst>& FlatHashTable<Key, Policy, Hasher>::IteratorBase<IsConst>::operator++()
+	{
+		++m_ctrl;
+		++m_slot;
+		SkipFreeSlots();
+		return *this;
+	}
+
+	template< class Key, class Policy, class Hasher >
+	FlatHashTable<Key, Policy, Hasher>::FlatHashTable()
+		: m_ctrl(nullptr)
+		, m_slots(nullptr)
+		, m_capacity(0)
+		, m_size(0)
+		, m_growthLeft(0)
+	{
+	}
+
+	template< class Key, class Policy, class Hasher >
+	FlatHashTable<Key, Policy, Hasher>::~FlatHashTable()
+	{
+		Release();
+	}
+
+	template< class Key, class Policy, class Hasher >
+	FlatHashTable<Key, Policy, Hasher>::FlatHashTable(const FlatHashTable& other)
+		: FlatHashTable()
+	{
+		*this = other;
+	}
+
+	template< class Key, class Policy, class Hasher >
+	FlatHashTable<Key, Policy, Hasher>::FlatHashTable(FlatHashTable&& other)
+		: FlatHashTable()
+	{
+		*this = std::move(other);
+	}
+
+	template< class Key, class Policy, class Hasher >
+	FlatHashTable<Key, Policy, Hasher>& FlatHashTable<Key, Policy, Hasher>::operator=(const FlatHashTable& other)
+	{
+		if (this != &other)
+		{
+			Release();
+			if (other.m_capacity > 0)
+			{
+				m_ctrl = static_cast<int8_t*>(_aligned_malloc(other.m_capacity, c_groupWidth));
+				m_slots = static_cast<SlotType*>(_aligned_malloc(other.m_capacity * sizeof(SlotType), alignof(SlotType) < 16 ? 16 : alignof(SlotType)));
+				memcpy(m_ctrl, other.m_ctrl, other.m_capacity);
+				for (size_t i = 0; i < other.m_capacity; ++i)
+				{
+					if (m_ctrl[i] >= 0)
+					{
+						new (m_slots + i) SlotType(other.m_slots[i]);
+					}
+				}
+				m_capacity = other.m_capacity;
+				m_size = other.m_size;
+				m_growthLeft = other.m_growthLeft;
+			}
+		}
+		return *this;
+	}
+
+	template< class Key, class Policy, class Hasher >
+	FlatHashTable<Key, Policy, Hasher>& FlatHashTable<Key, Policy, Hasher>::operator=(FlatHashTable&& other)
+	{
+		if (this != &other)
+		{
+			Release();
+			m_ctrl = other.m_ctrl;
+			m_slots = other.m_slots;
+			m_capacity = other.m_capacity;
+			m_size = other.m_size;
+			m_growthLeft = other.m_growthLeft;
+			other.m_ctrl = nullptr;
+			other.m_slots = nullptr;
+			other.m_capacity = 0;
+			other.m_size = 0;
+			other.m_growthLeft = 0;
+		}
+		return *this;
+	}
+
+	template< class Key, class Policy, class Hasher >
+	void FlatHashTable<Key, Policy, Hasher>::Release()
+	{
+		if (m_capacity > 0)
+		{
+			for (size_t i = 0; i < m_capacity; ++i)
+			{
+				if (m_ctrl[i] >= 0)
+				{
+					m_slots[i].~SlotType();
+				}
+			}
+			_aligned_free(m_ctrl);
+			_aligned_free(m_slots);
+		}
+		m_ctrl = nullptr;
+		m_slots = nullptr;
+		m_capacity = 0;
+		m_size = 0;
+		m_growthLeft = 0;
+	}
+
+	template< class Key, class Policy, class Hasher >
+	void FlatHashTable<Key, Policy, Hasher>::clear()
+	{
+		// keeps the memory around
+		for (size_t i = 0; i < m_capacity; ++i)
+		{
+			if (m_ctrl[i] >= 0)
+			{
+				m_slots[i].~SlotType();
+			}
+		}
+		if (m_capacity > 0)
+		{
+			memset(m_ctrl, FlatHashInternal::c_empty, m_capacity);
+		}
+		m_size = 0;
+		m_growthLeft = FlatHashInternal::MaxLoad(m_capacity);
+	}
+
+	template< class Key, class Policy, class Hasher >
+	void FlatHashTable<Key, Policy, Hasher>::reserve(size_t count)
+	{
+		size_t newCapacity = m_capacity > 0 ? m_capacity : c_groupWidth;
+		while (FlatHashInternal::MaxLoad(newCapacity) < count)
+		{
+			newCapacity *= 2;
+		}
+		if (newCapacity > m_capacity)
+		{
+			Rehash(newCapacity);
+		}
+	}
+
+	template< class Key, class Policy, class Hasher >
+	void FlatHashTable<Key, Policy, Hasher>::Rehash(size_t newCapacity)
+	{
+		SDE_ASSERT((newCapacity & (newCapacity - 1)) == 0 && newCapacity >= c_groupWidth, "Capacity must be a power of 2");
+		int8_t* oldCtrl = m_ctrl;
+		SlotType* oldSlots = m_slots;
+		const size_t oldCapacity = m_capacity;
+
+		m_ctrl = static_cast<int8_t*>(_aligned_malloc(newCapacity, c_groupWidth));
+		m_slots = static_cast<SlotType*>(_aligned_malloc(newCapacity * sizeof(SlotType), alignof(SlotType) < 16 ? 16 : alignof(SlotType)));
+		memset(m_ctrl, FlatHashInternal::c_empty, newCapacity);
+		m_capacity = newCapacity;
+		m_size = 0;
+		m_growthLeft = FlatHashInternal::MaxLoad(newCapacity);
+
+		// no need to check for duplicates, everything is unique
+		for (size_t i = 0; i < oldCapacity; ++i)
+		{
+			if (oldCtrl[i] >= 0)
+			{
+				const size_t index = PrepareInsert(Hasher()(Policy::GetKey(oldSlots[i])));
+				new (m_slots + index) SlotType(std::move(oldSlots[i]));
+				oldSlots[i].~SlotType();
+			}
+		}
+		if (oldCapacity > 0)
+		{
+			_aligned_free(oldCtrl);
+			_aligned_free(oldSlots);
+		}
+	}
+
+	template< class Key, class Policy, class Hasher >
+	inline size_t FlatHashTable<Key, Policy, Hasher>::FindIndex(const Key& k, uint64_t hash) const
+	{
+		using namespace FlatHashInternal;
+		if (m_capacity == 0)
+		{
+			return c_notFound;
+		}
+		// Groups are aligned to 16 slots and probed triangularly, this visits every group exactly once
+		const size_t mask = m_capacity - 1;
+		const int8_t h2 = H2(hash);
+		size_t group = H1(hash) & mask & ~(c_groupWidth - 1);
+		for (size_t probe = c_groupWidth; ; probe += c_groupWidth)
+		{
+			uint32_t matches = MatchGroup(m_ctrl + group, h2);
+			while (matches != 0)
+			{
+				const size_t index = group + LowestBit(matches);
+				if (Policy::GetKey(m_slots[index]) == k)
+				{
+					return index;
+				}
+				matches &= matches - 1;
+			}
+			if (MatchEmpty(m_ctrl + group) != 0 || probe >= m_capacity)
+			{
+				return c_notFound;
+			}
+			group = (group + probe) & mask;
+		}
+	}
+
+	template< class Key, class Policy, class Hasher >
+	size_t FlatHashTable<Key, Policy, Hasher>::PrepareInsert(uint64_t hash)
+	{
+		using namespace FlatHashInternal;
+		for (;;)
+		{
+			if (m_capacity > 0)
+			{
+				const size_t mask = m_capacity - 1;
+				size_t group = H1(hash) & mask & ~(c_groupWidth - 1);
+				for (size_t probe = c_groupWidth; ; probe += c_groupWidth)
+				{
+					const uint32_t freeSlots = MatchEmptyOrDeleted(m_ctrl + group);
+					if (freeSlots != 0)
+					{
+						const size_t index = group + LowestBit(freeSlots);
+						if (m_ctrl[index] == c_deleted || m_growthLeft > 0)	// reusing a tombstone doesn't use up any growth
+						{
+							m_growthLeft -= (m_ctrl[index] == c_empty) ? 1 : 0;
+							m_ctrl[index] = H2(hash);
+							++m_size;
+							return index;
+						}
+						break;
+					}
+					group = (group + probe) & mask;
+				}
+			}
+
+			// Out of space; if the table is mostly tombstones then rehashing in place is enough
+			const bool shouldGrow = m_capacity == 0 || m_size >= FlatHashInternal::MaxLoad(m_capacity) / 2;
+			Rehash(m_capacity == 0 ? c_groupWidth : (shouldGrow ? m_capacity * 2 : m_capacity));
+		}
+	}
+
+	template< class Key, class Policy, class Hasher >
+	typename FlatHashTable<Key, Policy, Hasher>::iterator FlatHashTable<Key, Policy, Hasher>::find(const Key& k)
+	{
+		const size_t index = FindIndex(k, Hasher()(k));
+		return index != c_notFound ? MakeIterator(index) : end();
+	}
+
+	template< class Key, class Policy, class Hasher >
+	typename FlatHashTable<Key, Policy, Hasher>::const_iterator FlatHashTable<Key, Policy, Hasher>::find(const Key& k) const
+	{
+		const size_t index = FindIndex(k, Hasher()(k));
+		return index != c_notFound ? MakeIterator(index) : end();
+	}
+
+	template< class Key, class Policy, class Hasher >
+	size_t FlatHashTable<Key, Policy, Hasher>::count(const Key& k) const
+	{
+		return FindIndex(k, Hasher()(k)) != c_notFound ? 1 : 0;
+	}
+
+	template< class Key, class Policy, class Hasher >
+	std::pair<typename FlatHashTable<Key, Policy, Hasher>::iterator, bool> FlatHashTable<Key, Policy, Hasher>::insert(const SlotType& v)
+	{
+		const uint64_t hash = Hasher()(Policy::GetKey(v));
+		size_t index = FindIndex(Policy::GetKey(v), hash);
+		if (index != c_notFound)
+		{
+			return { MakeIterator(index), false };
+		}
+		index = PrepareInsert(hash);
+		new (m_slots + index) SlotType(v);
+		return { MakeIterator(index), true };
+	}
+
+	template< class Key, class Policy, class Hasher >
+	std::pair<typename FlatHashTable<Key, Policy, Hasher>::iterator, bool> FlatHashTable<Key, Policy, Hasher>::insert(SlotType&& v)
+	{
+		const uint64_t hash = Hasher()(Policy::GetKey(v));
+		size_t index = FindIndex(Policy::GetKey(v), hash);
+		if (index != c_notFound)
+		{
+			return { MakeIterator(index), false };
+		}
+		index = PrepareInsert(hash);
+		new (m_slots + index) SlotType(std::move(v));
+		return { MakeIterator(index), true };
+	}
+
+	template< class Key, class Policy, class Hasher >
+	size_t FlatHashTable<Key, Policy, Hasher>::erase(const Key& k)
+	{
+		using namespace FlatHashInternal;
+		const size_t index = FindIndex(k, Hasher()(k));
+		if (index == c_notFound)
+		{
+			return 0;
+		}
+		m_slots[index].~SlotType();
+		--m_size;
+
+		// If the group still has an empty slot, no probe sequence can have passed through it, so the slot
+		// can go straight back to empty. Otherwise leave a tombstone so lookups keep probing
+		const int8_t* group = m_ctrl + (index & ~(c_groupWidth - 1));
+		if (MatchEmpty(group) != 0)
+		{
+			m_ctrl[index] = c_empty;
+			++m_growthLeft;
+		}
+		else
+		{
+			m_ctrl[index] = c_deleted;
+		}
+		return 1;
+	}
+
+	template< class Key, class Policy, class Hasher >
+	inline typename FlatHashTable<Key, Policy, Hasher>::iterator FlatHashTable<Key, Policy, Hasher>::begin()
+	{
+		return MakeIterator(0);
+	}
+
+	template< class Key, class Policy, class Hasher >
+	inline typename FlatHashTable<Key, Policy, Hasher>::iterator FlatHashTable<Key, Policy, Hasher>::end()
+	{
+		return iterator(m_ctrl + m_capacity, m_ctrl + m_capacity, m_slots + m_capacity);
+	}
+
+	template< class Key, class Policy, class Hasher >
+	inline typename FlatHashTable<Key, Policy, Hasher>::const_iterator FlatHashTable<Key, Policy, Hasher>::begin() const
+	{
+		return MakeIterator(0);
+	}
+
+	template< class Key, class Policy, class Hasher >
+	inline typename FlatHashTable<Key, Policy, Hasher>::const_iterator FlatHashTable<Key, Policy, Hasher>::end() const
+	{
+		return const_iterator(m_ctrl + m_capacity, m_ctrl + m_capacity, m_slots + m_capacity);
+	}
+
+	template< class Key, class Value, class Hasher >
+	Value& FlatHashMap<Key, Value, Hasher>::operator[](const Key& k)
+	{
+		const uint64_t hash = Hasher()(k);
+		size_t index = this->FindIndex(k, hash);
+		if (index == this->c_notFound)
+		{
+			index = this->PrepareInsert(hash);
+			new (this->m_slots + index) typename FlatHashMap::SlotType(k, Value());
+		}
+		return this->m_slots[index].second;
+	}
+}
\ No newline at end of file
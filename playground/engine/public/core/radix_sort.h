@@ -0,0 +1,21 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#pragma once
+
+#include "kernel/base_types.h"
+
+namespace Core
+{
+	// 64 bit sort key + index of whatever it refers to. Sort these instead of large structs
+	struct SortKeyIndex
+	{
+		uint64_t m_key;
+		uint32_t m_index;
+	};
+
+	// Stable LSD radix sort on m_key, 8 bits per pass. Passes where every key has the same byte are skipped,
+	// so keys that only use some of their bits are cheaper to sort. Scratch must hold at least count values
+	void RadixSort(SortKeyIndex* values, SortKeyIndex* scratch, size_t count);
+}
@@ -0,0 +1,79 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#pragma once
+
+#include "kernel/base_types.h"
+#include <vector>
+
+namespace Core
+{
+	// A SlotMap stores values densely (for fast iteration), and hands out 32 bit handles
+	// made of an index into an indirection table + a generation counter
+	// Removed slots are pushed to a free list and reused, and the generation is bumped
+	// so any stale handles pointing at the old value will fail to resolve
+	// A slot is retired instead of reused once its generation would wrap (after 4096 reuses), so a stale handle can
+	// never match a newer value. Retired slots cost 8 bytes each and still count towards c_maxValues
+	template< class ValueType >
+	class SlotMap
+	{
+	public:
+		using Handle = uint32_t;
+		static const uint32_t c_indexBits = 20;		// ~1 million live values
+		static const uint32_t c_generationBits = 32 - c_indexBits;
+		static const uint32_t c_indexMask = (1 << c_indexBits) - 1;
+		static const uint32_t c_generationMask = (1 << c_generationBits) - 1;
+		static const uint32_t c_maxValues = c_indexMask;	// last index reserved for invalid handles
+		static const Handle c_invalidHandle = (Handle)-1;
+
+		SlotMap();
+		~SlotMap();
+		SlotMap(const SlotMap&) = delete;
+		SlotMap(SlotMap&&) = default;
+		SlotMap& operator=(SlotMap&&) = default;
+
+		Handle Insert(ValueType&& v);
+		Handle Insert(const ValueType& v);
+		bool Remove(Handle h);
+		void Clear();
+		void Reserve(size_t count);
+
+		ValueType* Get(Handle h);
+		const ValueType* Get(Handle h) const;
+		bool IsValid(Handle h) const;
+
+		// Dense accessors. Order changes when values are removed!
+		size_t Size() const { return m_values.size(); }
+		ValueType& ValueAt(size_t denseIndex) { return m_values[denseIndex]; }
+		const ValueType& ValueAt(size_t denseIndex) const { return m_values[denseIndex]; }
+		Handle HandleAt(size_t denseIndex) const;
+
+		typename std::vector<ValueType>::iterator begin() { return m_values.begin(); }
+		typename std::vector<ValueType>::iterator end() { return m_values.end(); }
+		typename std::vector<ValueType>::const_iterator begin() const { return m_values.begin(); }
+		typename std::vector<ValueType>::const_iterator end() const { return m_values.end(); }
+
+		static inline uint32_t GetIndex(Handle h) { return h & c_indexMask; }
+		static inline uint32_t GetGeneration(Handle h) { return (h >> c_indexBits) & c_generationMask; }
+		static inline Handle MakeHandle(uint32_t index, uint32_t generation) { return (index & c_indexMask) | ((generation & c_generationMask) << c_indexBits); }
+
+	private:
+		struct Slot
+		{
+			uint32_t m_denseIndex;		// index into values if live, next free slot if not
+			uint32_t m_generation;
+		};
+		static const uint32_t c_endOfFreeList = (uint32_t)-1;
+		static const uint32_t c_retiredGeneration = (uint32_t)-1;	// never matches a handle generation
+		uint32_t AllocateSlot();
+		void ReleaseSlot(uint32_t slotIndex);
+
+		std::vector<Slot> m_slots;			// indirection table, indexed by handle
+		std::vector<ValueType> m_values;	// dense values
+		std::vector<uint32_t> m_valueSlots;	// dense index -> slot index, used to patch slots on removal
+		uint32_t m_freeListHead;
+	};
+}
+
+#include "slot_map.inl"
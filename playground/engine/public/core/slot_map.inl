@@ -0,0 +1,147 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+
+#include "kernel/assert.h"
+
+namespace Core
+{
+	template< class ValueType >
+	SlotMap<ValueType>::SlotMap()
+		: m_freeListHead(c_endOfFreeList)
+	{
+	}
+
+	template< class ValueType >
+	SlotMap<ValueType>::~SlotMap()
+	{
+	}
+
+	template< class ValueType >
+	void SlotMap<ValueType>::Reserve(size_t count)
+	{
+		m_slots.reserve(count);
+		m_values.reserve(count);
+		m_valueSlots.reserve(count);
+	}
+
+	template< class ValueType >
+	void SlotMap<ValueType>::Clear()
+	{
+		// Push every slot to the free list and bump generations so old handles are invalidated
+		m_values.clear();
+		m_valueSlots.clear();
+		m_freeListHead = c_endOfFreeList;
+		for (uint32_t s = 0; s < m_slots.size(); ++s)
+		{
+			if (m_slots[s].m_generation != c_retiredGeneration)
+			{
+				ReleaseSlot(s);
+			}
+		}
+	}
+
+	// Bumps the generation so stale handles fail, then pushes the slot to the free list
+	// Slots that run out of generations are retired rather than wrapping back to 0
+	template< class ValueType >
+	inline void SlotMap<ValueType>::ReleaseSlot(uint32_t slotIndex)
+	{
+		Slot& slot = m_slots[slotIndex];
+		if (slot.m_generation >= c_generationMask)
+		{
+			slot.m_generation = c_retiredGeneration;
+			return;
+		}
+		slot.m_generation = slot.m_generation + 1;
+		slot.m_denseIndex = m_freeListHead;
+		m_freeListHead = slotIndex;
+	}
+
+	template< class ValueType >
+	inline uint32_t SlotMap<ValueType>::AllocateSlot()
+	{
+		uint32_t slotIndex = m_freeListHead;
+		if (slotIndex != c_endOfFreeList)
+		{
+			m_freeListHead = m_slots[slotIndex].m_denseIndex;
+		}
+		else
+		{
+			SDE_ASSERT(m_slots.size() < c_maxValues, "SlotMap is full");
+			slotIndex = static_cast<uint32_t>(m_slots.size());
+			m_slots.push_back({ 0, 0 });
+		}
+		m_slots[slotIndex].m_denseIndex = static_cast<uint32_t>(m_values.size());
+		m_valueSlots.push_back(slotIndex);
+		return slotIndex;
+	}
+
+	template< class ValueType >
+	typename SlotMap<ValueType>::Handle SlotMap<ValueType>::Insert(ValueType&& v)
+	{
+		const uint32_t slotIndex = AllocateSlot();
+		m_values.emplace_back(std::move(v));
+		return MakeHandle(slotIndex, m_slots[slotIndex].m_generation);
+	}
+
+	template< class ValueType >
+	typename SlotMap<ValueType>::Handle SlotMap<ValueType>::Insert(const ValueType& v)
+	{
+		const uint32_t slotIndex = AllocateSlot();
+		m_values.push_back(v);
+		return MakeHandle(slotIndex, m_slots[slotIndex].m_generation);
+	}
+
+	template< class ValueType >
+	bool SlotMap<ValueType>::Remove(Handle h)
+	{
+		if (!IsValid(h))
+		{
+			return false;
+		}
+
+		// swap the last value into the hole and patch up its slot
+		const uint32_t slotIndex = GetIndex(h);
+		const uint32_t denseIndex = m_slots[slotIndex].m_denseIndex;
+		const uint32_t lastDenseIndex = static_cast<uint32_t>(m_values.size() - 1);
+		if (denseIndex != lastDenseIndex)
+		{
+			m_values[denseIndex] = std::move(m_values[lastDenseIndex]);
+			m_valueSlots[denseIndex] = m_valueSlots[lastDenseIndex];
+			m_slots[m_valueSlots[denseIndex]].m_denseIndex = denseIndex;
+		}
+		m_values.pop_back();
+		m_valueSlots.pop_back();
+
+		ReleaseSlot(slotIndex);
+		return true;
+	}
+
+	template< class ValueType >
+	inline bool SlotMap<ValueType>::IsValid(Handle h) const
+	{
+		const uint32_t slotIndex = GetIndex(h);
+		return h != c_invalidHandle && slotIndex < m_slots.size() && m_slots[slotIndex].m_generation == GetGeneration(h);
+	}
+
+	template< class ValueType >
+	inline ValueType* SlotMap<ValueType>::Get(Handle h)
+	{
+		return IsValid(h) ? &m_values[m_slots[GetIndex(h)].m_denseIndex] : nullptr;
+	}
+
+	template< class ValueType >
+	inline const ValueType* SlotMap<ValueType>::Get(Handle h) const
+	{
+		return IsValid(h) ? &m_values[m_slots[GetIndex(h)].m_denseIndex] : nullptr;
+	}
+
+	template< class ValueType >
+	inline typename SlotMap<ValueType>::Handle SlotMap<ValueType>::HandleAt(size_t denseIndex) const
+	{
+		SDE_ASSERT(denseIndex < m_valueSlots.size());
+		const uint32_t slotIndex = m_valueSlots[denseIndex];
+		return MakeHandle(slotIndex, m_slots[slotIndex].m_generation);
+	}
+}
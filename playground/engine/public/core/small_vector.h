@@ -0,0 +1,73 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#pragma once
+
+#include "kernel/base_types.h"
+#include <type_traits>
+#include <utility>
+
+namespace Core
+{
+	// Vector with inline storage for the first N elements. Only touches the heap if it grows past N
+	// Use for small per-object lists (mesh chunks, model parts, etc) that are nearly always tiny
+	// Interface is a subset of std::vector; iterators are raw pointers
+	template< class T, uint32_t N >
+	class SmallVector
+	{
+	public:
+		static_assert(N > 0, "SmallVector needs some inline storage, use std::vector instead");
+		using value_type = T;
+		using iterator = T*;
+		using const_iterator = const T*;
+
+		SmallVector();
+		~SmallVector();
+		SmallVector(const SmallVector& other);
+		SmallVector(SmallVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value);
+		SmallVector& operator=(const SmallVector& other);
+		SmallVector& operator=(SmallVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value);
+
+		inline size_t size() const { return m_size; }
+		inline size_t capacity() const { return m_capacity; }
+		inline bool empty() const { return m_size == 0; }
+		inline bool IsInline() const { return m_data == InlineData(); }
+
+		inline T* data() { return m_data; }
+		inline const T* data() const { return m_data; }
+		inline T& operator[](size_t index);
+		inline const T& operator[](size_t index) const;
+		inline T& front() { return (*this)[0]; }
+		inline const T& front() const { return (*this)[0]; }
+		inline T& back() { return (*this)[m_size - 1]; }
+		inline const T& back() const { return (*this)[m_size - 1]; }
+
+		inline iterator begin() { return m_data; }
+		inline iterator end() { return m_data + m_size; }
+		inline const_iterator begin() const { return m_data; }
+		inline const_iterator end() const { return m_data + m_size; }
+
+		void push_back(const T& v);
+		void push_back(T&& v);
+		template< class... Args >
+		T& emplace_back(Args&&... args);
+		void pop_back();
+		void clear();
+		void reserve(size_t count);
+		void resize(size_t count);
+
+	private:
+		inline T* InlineData() { return reinterpret_cast<T*>(m_inline); }
+		inline const T* InlineData() const { return reinterpret_cast<const T*>(m_inline); }
+		void Reallocate(size_t newCapacity);	// moves everything to a new heap block
+		void ReleaseHeap();
+
+		T* m_data;
+		uint32_t m_size;
+		uint32_t m_capacity;
+		alignas(T) uint8_t m_inline[sizeof(T) * N];
+	};
+}
+
+#include "small_vector.inl"
\ No newline at end of file
@@ -0,0 +1,198 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+
+#include "kernel/assert.h"
+#include <malloc.h>
+#include <new>
+
+namespace Core
+{
+	template< class T, uint32_t N >
+	SmallVector<T, N>::SmallVector()
+		: m_data(InlineData())
+		, m_size(0)
+		, m_capacity(N)
+	{
+	}
+
+	template< class T, uint32_t N >
+	SmallVector<T, N>::~SmallVector()
+	{
+		clear();
+		ReleaseHeap();
+	}
+
+	template< class T, uint32_t N >
+	SmallVector<T, N>::SmallVector(const SmallVector& other)
+		: SmallVector()
+	{
+		*this = other;
+	}
+
+	template< class T, uint32_t N >
+	SmallVector<T, N>::SmallVector(SmallVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value)
+		: SmallVector()
+	{
+		*this = std::move(other);
+	}
+
+	template< class T, uint32_t N >
+	SmallVector<T, N>& SmallVector<T, N>::operator=(const SmallVector& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			reserve(other.m_size);
+			for (const auto& v : other)
+			{
+				new (m_data + m_size) T(v);
+				++m_size;
+			}
+		}
+		return *this;
+	}
+
+	template< class T, uint32_t N >
+	SmallVector<T, N>& SmallVector<T, N>::operator=(SmallVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value)
+	{
+		if (this != &other)
+		{
+			clear();
+			if (!other.IsInline())
+			{
+				// steal the heap block
+				ReleaseHeap();
+				m_data = other.m_data;
+				m_size = other.m_size;
+				m_capacity = other.m_capacity;
+				other.m_data = other.InlineData();
+				other.m_size = 0;
+				other.m_capacity = N;
+			}
+			else
+			{
+				for (auto& v : other)
+				{
+					new (m_data + m_size) T(std::move(v));
+					++m_size;
+				}
+				other.clear();
+			}
+		}
+		return *this;
+	}
+
+	template< class T, uint32_t N >
+	inline T& SmallVector<T, N>::operator[](size_t index)
+	{
+		SDE_ASSERT(index < m_size, "Index out of range");
+		return m_data[index];
+	}
+
+	template< class T, uint32_t N >
+	inline const T& SmallVector<T, N>::operator[](size_t index) const
+	{
+		SDE_ASSERT(index < m_size, "Index out of range");
+		return m_data[index];
+	}
+
+	template< class T, uint32_t N >
+	void SmallVector<T, N>::Reallocate(size_t newCapacity)
+	{
+		SDE_ASSERT(newCapacity >= m_size);
+		T* newData = static_cast<T*>(_aligned_malloc(newCapacity * sizeof(T), alignof(T)));
+		for (uint32_t i = 0; i < m_size; ++i)
+		{
+			new (newData + i) T(std::move(m_data[i]));
+			m_data[i].~T();
+		}
+		ReleaseHeap();
+		m_data = newData;
+		m_capacity = static_cast<uint32_t>(newCapacity);
+	}
+
+	template< class T, uint32_t N >
+	void SmallVector<T, N>::ReleaseHeap()
+	{
+		if (!IsInline())
+		{
+			_aligned_free(m_data);
+			m_data = InlineData();
+			m_capacity = N;
+		}
+	}
+
+	template< class T, uint32_t N >
+	void SmallVector<T, N>::reserve(size_t count)
+	{
+		if (count > m_capacity)
+		{
+			Reallocate(count);
+		}
+	}
+
+	template< class T, uint32_t N >
+	void SmallVector<T, N>::push_back(const T& v)
+	{
+		emplace_back(v);
+	}
+
+	template< class T, uint32_t N >
+	void SmallVector<T, N>::push_back(T&& v)
+	{
+		emplace_back(std::move(v));
+	}
+
+	template< class T, uint32_t N >
+	template< class... Args >
+	T& SmallVector<T, N>::emplace_back(Args&&... args)
+	{
+		if (m_size == m_capacity)
+		{
+			// construct first in case args reference our own storage
+			T newValue(std::forward<Args>(args)...);
+			Reallocate(m_capacity * 2);
+			new (m_data + m_size) T(std::move(newValue));
+		}
+		else
+		{
+			new (m_data + m_size) T(std::forward<Args>(args)...);
+		}
+		return m_data[m_size++];
+	}
+
+	template< class T, uint32_t N >
+	void SmallVector<T, N>::pop_back()
+	{
+		SDE_ASSERT(m_size > 0);
+		m_data[--m_size].~T();
+	}
+
+	template< class T, uint32_t N >
+	void SmallVector<T, N>::clear()
+	{
+		// keeps any heap storage around
+		for (uint32_t i = 0; i < m_size; ++i)
+		{
+			m_data[i].~T();
+		}
+		m_size = 0;
+	}
+
+	template< class T, uint32_t N >
+	void SmallVector<T, N>::resize(size_t count)
+	{
+		while (m_size > count)
+		{
+			pop_back();
+		}
+		reserve(count);
+		while (m_size < count)
+		{
+			new (m_data + m_size) T();
+			++m_size;
+		}
+	}
+}
\ No newline at end of file
@@ -31,4 +31,20 @@ namespace Kernel
 		static const size_t c_storageAlign = 8;
 		std::aligned_storage<c_storageSize, c_storageAlign>::type m_storage;
 	};
+
+	// Atomic pointer, mainly used for lock-free linked lists
+	class AtomicPtr
+	{
+	public:
+		AtomicPtr();
+		AtomicPtr(void* initialValue);
+		~AtomicPtr();
+
+		void* Set(void* v);
+		bool CAS(void* oldVal, void* newVal);
+		void* Get();
+
+	private:
+		void* volatile m_ptr;
+	};
 }
\ No newline at end of file
@@ -28,6 +28,7 @@ namespace Math
 		glm::vec3 Size() const;
 
 		bool Intersects(const Box3& other) const;
+		Box3 Transformed(const glm::mat4& transform) const;		// axis-aligned box around the transformed box
 
 	private:
 		void Validate();
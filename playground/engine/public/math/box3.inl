@@ -72,4 +72,16 @@ namespace Math
 	{
 		return !(glm::any(glm::greaterThan(m_min, other.m_max)) || glm::any(glm::greaterThan(other.m_min, m_max)));
 	}
+
+	inline Box3 Box3::Transformed(const glm::mat4& transform) const
+	{
+		// transform the centre, the new extents are the sum of the extents along each transformed axis
+		const glm::vec3 center = (m_min + m_max) * 0.5f;
+		const glm::vec3 extents = (m_max - m_min) * 0.5f;
+		const glm::vec3 newCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+		const glm::vec3 newExtents = glm::abs(glm::vec3(transform[0])) * extents.x
+			+ glm::abs(glm::vec3(transform[1])) * extents.y
+			+ glm::abs(glm::vec3(transform[2])) * extents.z;
+		return Box3(newCenter - newExtents, newCenter + newExtents);
+	}
 }
\ No newline at end of file
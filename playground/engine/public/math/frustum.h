@@ -0,0 +1,56 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#pragma once
+
+#include "box3.h"
+#include "glm_headers.h"
+#include <emmintrin.h>
+
+namespace Math
+{
+	// 4 boxes (centre + half-extents) in SoA layout for batched frustum tests
+	struct Box4
+	{
+		__m128 m_centerX, m_centerY, m_centerZ;
+		__m128 m_extentsX, m_extentsY, m_extentsZ;
+	};
+
+	// 4 spheres in SoA layout for batched frustum tests
+	struct Sphere4
+	{
+		__m128 m_centerX, m_centerY, m_centerZ;
+		__m128 m_radius;
+	};
+
+	// View frustum as 6 normalised planes facing inwards (xyz = normal, w = distance)
+	// Tests are conservative; anything intersecting or inside the frustum is visible
+	class Frustum
+	{
+	public:
+		Frustum();
+		explicit Frustum(const glm::mat4& viewProjection);
+
+		bool IsBoxVisible(const Math::Box3& box) const;
+		bool IsBoxVisible(const glm::vec3& center, const glm::vec3& extents) const;
+		bool IsSphereVisible(const glm::vec3& center, float radius) const;
+
+		// returns a mask with bit n set if box/sphere n is visible
+		uint32_t AreBoxesVisible(const Box4& boxes) const;
+		uint32_t AreSpheresVisible(const Sphere4& spheres) const;
+
+		// Frustums that reject shadow casters whose shadow can never reach this frustum
+		// Planes the shadow could cross are disabled, so only test boxes that are already in the light's view
+		Frustum GetDirectionalShadowCasterFrustum(const glm::vec3& lightDirection) const;
+		Frustum GetPointShadowCasterFrustum(const glm::vec3& lightPosition) const;
+
+		const glm::vec4& GetPlane(uint32_t index) const { return m_planes[index]; }
+
+	private:
+		static const uint32_t c_planeCount = 6;
+		glm::vec4 m_planes[c_planeCount];		// left, right, bottom, top, near, far
+	};
+}
+
+#include "frustum.inl"
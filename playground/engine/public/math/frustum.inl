@@ -0,0 +1,131 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+
+#include <emmintrin.h>
+
+namespace Math
+{
+	inline Frustum::Frustum()
+	{
+		for (auto& p : m_planes)
+		{
+			p = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);	// everything is visible
+		}
+	}
+
+	// Gribb-Hartmann plane extraction, expects a GL style clip space (z in -w..w)
+	inline Frustum::Frustum(const glm::mat4& viewProjection)
+	{
+		const glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		const glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		const glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		const glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+		m_planes[0] = row3 + row0;
+		m_planes[1] = row3 - row0;
+		m_planes[2] = row3 + row1;
+		m_planes[3] = row3 - row1;
+		m_planes[4] = row3 + row2;
+		m_planes[5] = row3 - row2;
+		for (auto& p : m_planes)
+		{
+			p = p / glm::length(glm::vec3(p));
+		}
+	}
+
+	inline Frustum Frustum::GetDirectionalShadowCasterFrustum(const glm::vec3& lightDirection) const
+	{
+		// a box outside a plane stays outside when swept along a direction pointing away from it
+		Frustum result = *this;
+		for (auto& p : result.m_planes)
+		{
+			if (glm::dot(glm::vec3(p), lightDirection) > 0.0f)
+			{
+				p = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			}
+		}
+		return result;
+	}
+
+	inline Frustum Frustum::GetPointShadowCasterFrustum(const glm::vec3& lightPosition) const
+	{
+		// shadows extend away from the light, so a box outside a plane the light is inside of can't cast back in
+		Frustum result = *this;
+		for (auto& p : result.m_planes)
+		{
+			if (glm::dot(glm::vec3(p), lightPosition) + p.w < 0.0f)
+			{
+				p = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			}
+		}
+		return result;
+	}
+
+	inline bool Frustum::IsBoxVisible(const Math::Box3& box) const
+	{
+		const glm::vec3 center = (box.Min() + box.Max()) * 0.5f;
+		const glm::vec3 extents = (box.Max() - box.Min()) * 0.5f;
+		return IsBoxVisible(center, extents);
+	}
+
+	inline bool Frustum::IsBoxVisible(const glm::vec3& center, const glm::vec3& extents) const
+	{
+		for (const auto& p : m_planes)
+		{
+			// distance of the box corner furthest along the plane normal
+			const glm::vec3 normal(p);
+			const float d = glm::dot(normal, center) + glm::dot(glm::abs(normal), extents) + p.w;
+			if (d < 0.0f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	inline bool Frustum::IsSphereVisible(const glm::vec3& center, float radius) const
+	{
+		for (const auto& p : m_planes)
+		{
+			if (glm::dot(glm::vec3(p), center) + p.w < -radius)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	inline uint32_t Frustum::AreBoxesVisible(const Box4& b) const
+	{
+		const __m128 c_zero = _mm_setzero_ps();
+		const __m128 c_absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		__m128 outside = _mm_setzero_ps();
+		for (const auto& p : m_planes)
+		{
+			const __m128 nx = _mm_set1_ps(p.x), ny = _mm_set1_ps(p.y), nz = _mm_set1_ps(p.z);
+			__m128 d = _mm_add_ps(_mm_mul_ps(b.m_centerX, nx), _mm_set1_ps(p.w));
+			d = _mm_add_ps(d, _mm_mul_ps(b.m_centerY, ny));
+			d = _mm_add_ps(d, _mm_mul_ps(b.m_centerZ, nz));
+			d = _mm_add_ps(d, _mm_mul_ps(b.m_extentsX, _mm_and_ps(nx, c_absMask)));
+			d = _mm_add_ps(d, _mm_mul_ps(b.m_extentsY, _mm_and_ps(ny, c_absMask)));
+			d = _mm_add_ps(d, _mm_mul_ps(b.m_extentsZ, _mm_and_ps(nz, c_absMask)));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(d, c_zero));
+		}
+		return ~_mm_movemask_ps(outside) & 0xf;
+	}
+
+	inline uint32_t Frustum::AreSpheresVisible(const Sphere4& s) const
+	{
+		const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), s.m_radius);
+		__m128 outside = _mm_setzero_ps();
+		for (const auto& p : m_planes)
+		{
+			__m128 d = _mm_add_ps(_mm_mul_ps(s.m_centerX, _mm_set1_ps(p.x)), _mm_set1_ps(p.w));
+			d = _mm_add_ps(d, _mm_mul_ps(s.m_centerY, _mm_set1_ps(p.y)));
+			d = _mm_add_ps(d, _mm_mul_ps(s.m_centerZ, _mm_set1_ps(p.z)));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negRadius));
+		}
+		return ~_mm_movemask_ps(outside) & 0xf;
+	}
+}
@@ -6,6 +6,7 @@ Matt Hoyle
 
 #include "kernel/base_types.h"
 #include "math/glm_headers.h"
+#include "core/flat_hash_map.h"
 
 namespace Render
 {
@@ -15,6 +16,7 @@ namespace Render
 	class ShaderProgram;
 	class RenderBuffer;
 	class FrameBuffer;
+	enum class VertexDataType : uint8_t;
 
 	enum class PrimitiveType : uint32_t
 	{
@@ -24,9 +26,17 @@ namespace Render
 	};
 
 	// This represents the GL context for a window
+	// Redundant state changes are filtered against a cache of the last values set through the device.
+	// Anything that changes GL state behind its back (or deletes bound objects) must call InvalidateStateCache
 	class Device
 	{
 	public:
+		struct StateCacheStats
+		{
+			uint64_t m_callsIssued = 0;		// state changes that reached GL
+			uint64_t m_callsFiltered = 0;	// redundant state changes skipped
+		};
+
 		Device(Window& theWindow);
 		~Device();
 		void Present();
@@ -36,6 +46,7 @@ namespace Render
 		void SetGLContext(void* context);	// Sets context PER THREAD
 		void SetViewport(glm::ivec2 pos, glm::ivec2 size);
 		void SetScissorEnabled(bool enabled);
+		void SetScissorRect(glm::ivec2 pos, glm::ivec2 size);
 		void SetBlending(bool enabled);
 		void SetBackfaceCulling(bool enabled, bool frontFaceCCW);
 		void SetFrontfaceCulling(bool enabled, bool frontFaceCCW);
@@ -45,6 +56,9 @@ namespace Render
 		void ClearFramebufferDepth(const FrameBuffer& fb, float depth);
 		void DrawToFramebuffer(const FrameBuffer& fb);
 		void DrawToFramebuffer(const FrameBuffer& fb, uint32_t cubeFace);
+		void CopyFramebufferDepth(const FrameBuffer& src, const FrameBuffer& dst, glm::ivec2 pos, glm::ivec2 size);	// same region in both
+		void CopyFramebufferDepth(const FrameBuffer& src, const FrameBuffer& dst, uint32_t cubeFace);	// cubemap depth
+		void CopyBufferData(const RenderBuffer& src, size_t srcOffset, const RenderBuffer& dst, size_t dstOffset, size_t size);
 		void DrawToBackbuffer();
 		void SetUniformValue(uint32_t uniformHandle, const glm::mat4& matrix);
 		void SetUniformValue(uint32_t uniformHandle, const glm::vec4& val);
@@ -55,14 +69,68 @@ namespace Render
 		void BindShaderProgram(const ShaderProgram& program);
 		void BindVertexArray(const VertexArray& srcArray);
 		void BindInstanceBuffer(const VertexArray& srcArray, const RenderBuffer& buffer, int vertexLayoutSlot, int components, size_t offset = 0, size_t vectorCount=1);
+		void BindInstanceBuffer(const VertexArray& srcArray, const RenderBuffer& buffer, int vertexLayoutSlot, int components, VertexDataType type, size_t offset, size_t stride);
 		void DrawPrimitives(PrimitiveType primitive, uint32_t vertexStart, uint32_t vertexCount);
 		void DrawPrimitivesInstanced(PrimitiveType primitive, uint32_t vertexStart, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstInstance=0);
+		void DrawPrimitivesIndirect(PrimitiveType primitive, const RenderBuffer& commands, size_t offset, uint32_t commandCount);	// DrawArraysIndirectCommand array
+		void DrawPrimitivesIndexedInstanced(PrimitiveType primitive, uint32_t indexStart, uint32_t indexCount, uint32_t instanceCount, uint32_t firstInstance=0);	// 32 bit indices from the bound vertex array
+		void DrawPrimitivesIndexedIndirect(PrimitiveType primitive, const RenderBuffer& commands, size_t offset, uint32_t commandCount);	// DrawElementsIndirectCommand array
 		void BindUniformBufferIndex(ShaderProgram& p, const char* bufferName, uint32_t bindingIndex);
 		void SetUniforms(ShaderProgram& p, const RenderBuffer& ubo, uint32_t uboBindingIndex);
+		void SetUniforms(ShaderProgram& p, const RenderBuffer& ubo, uint32_t uboBindingIndex, size_t offset, size_t size);
+		void SetStorageBuffer(const RenderBuffer& ssbo, uint32_t bindingIndex, size_t offset, size_t size);	// binding set in the shader layout
+		void InvalidateStateCache();
+		const StateCacheStats& GetStateCacheStats() const { return m_stateStats; }
+		void ResetStateCacheStats() { m_stateStats = {}; }
 	private:
 		uint32_t TranslatePrimitiveType(PrimitiveType type) const;
+		bool IsStateChange(bool changed);
+		void SetCulling(int8_t cullMode, bool frontFaceCCW);
+		void BindTextureUnit(uint32_t textureHandle, uint32_t textureUnit);
+		void SetSamplerUniform(uint32_t uniformHandle, uint32_t textureUnit);
+		void BindBufferRange(uint32_t target, uint32_t bindingIndex, uint32_t bufferHandle, size_t offset, size_t size);
+		void BindIndirectBuffer(const RenderBuffer& commands);
+
+		static const uint32_t c_maxCachedTextureUnits = 32;
+		static const uint32_t c_maxCachedUniformBuffers = 16;
+		static const uint32_t c_maxCachedStorageBuffers = 8;
+		static const uint32_t c_unknownHandle = -1;
+		static const int8_t c_unknownState = -1;
+		struct BufferBinding
+		{
+			uint32_t m_buffer;
+			size_t m_offset;
+			size_t m_size;		// -1 = whole buffer
+		};
+		struct InstanceAttribute
+		{
+			uint32_t m_buffer;
+			int m_components;
+			VertexDataType m_type;
+			size_t m_offset;
+			size_t m_stride;
+		};
+		struct StateCache
+		{
+			uint32_t m_program;
+			uint32_t m_vertexArray;
+			uint32_t m_indirectBuffer;
+			uint32_t m_textures[c_maxCachedTextureUnits];
+			BufferBinding m_uniformBuffers[c_maxCachedUniformBuffers];
+			BufferBinding m_storageBuffers[c_maxCachedStorageBuffers];
+			int8_t m_blending;
+			int8_t m_depthTest;
+			int8_t m_depthWrite;
+			int8_t m_cullEnabled;
+			int8_t m_cullFace;		// 1 = back, 2 = front
+			int8_t m_frontFaceCCW;
+			Core::FlatHashMap<uint64_t, uint32_t> m_samplerUniforms;			// program + uniform -> texture unit
+			Core::FlatHashMap<uint64_t, InstanceAttribute> m_instanceAttributes;	// vertex array + slot -> instance buffer
+		};
 
 		Window& m_window;
 		void* m_context;
+		StateCache m_stateCache;
+		StateCacheStats m_stateStats;
 	};
 }
\ No newline at end of file
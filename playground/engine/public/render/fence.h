@@ -0,0 +1,28 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#pragma once
+
+namespace Render
+{
+	// A point in the GL command stream that the cpu can wait for
+	// Insert after the commands that must complete, then poll or wait. Only use on the thread that owns the context
+	class Fence
+	{
+	public:
+		Fence() = default;
+		~Fence();
+		Fence(const Fence&) = delete;
+		Fence(Fence&& other);
+		Fence& operator=(Fence&& other);
+
+		void Insert();			// replaces any previous fence
+		bool IsPending();		// true until the gpu has passed the fence
+		void Wait();			// blocks until the gpu has passed the fence
+
+	private:
+		void Destroy();
+		void* m_sync = nullptr;		// GLsync
+	};
+}
@@ -6,6 +6,7 @@ Matt Hoyle
 
 #include "uniform_buffer.h"
 #include "kernel/base_types.h"
+#include "core/small_vector.h"
 #include <memory>
 
 namespace Render
@@ -25,11 +26,32 @@ namespace Render
 			std::string m_name;
 			uint32_t m_handle;		// can be anything really
 		};
-		using Samplers = std::unordered_map<uint32_t, Sampler>;
+		using Samplers = Core::FlatHashMap<uint32_t, Sampler>;
 		void SetSampler(std::string name, uint32_t handle);
 		const Samplers& GetSamplers() const { return m_samplers; }
+
+		// The material resolved against one shader program, only samplers the program uses are kept
+		struct CompiledSampler
+		{
+			uint32_t m_location;
+			uint32_t m_handle;
+			uint32_t m_nameHash;		// key into the sampler map
+		};
+		struct Compiled
+		{
+			uint32_t m_programSerial = 0;
+			uint32_t m_uniformsVersion = 0;
+			uint32_t m_samplersVersion = 0;
+			CompiledUniformBuffer m_uniforms;
+			std::vector<CompiledSampler> m_samplers;
+		};
+		// Compiled data is cached per program and rebuilt if the material changes. Not thread safe
+		const Compiled& Compile(ShaderProgram& p) const;
+
 	private:
 		Samplers m_samplers;
 		UniformBuffer m_uniforms;
+		uint32_t m_samplersVersion = 0;
+		mutable Core::SmallVector<Compiled, 2> m_compiled;	// usually one shader + its shadow shader
 	};
 }
\ No newline at end of file
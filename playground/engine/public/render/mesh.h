@@ -8,26 +8,41 @@ Matt Hoyle
 #include "device.h"	// move primitive type from here!
 #include "render_buffer.h"
 #include "material.h"
+#include "core/small_vector.h"
 #include <memory>
 
 namespace Render
 {
 	class Material;
 
+	// Chunks with an index count are drawn from the mesh index buffer, otherwise straight from the vertex streams
 	struct MeshChunk
 	{
 		MeshChunk() 
-			: m_firstVertex(0), m_vertexCount(0), m_primitiveType(Render::PrimitiveType::Triangles) { }
+			: m_firstVertex(0), m_vertexCount(0), m_firstIndex(0), m_indexCount(0), m_primitiveType(Render::PrimitiveType::Triangles) { }
 		MeshChunk(uint32_t fv, uint32_t count, Render::PrimitiveType primitive) 
-			: m_firstVertex(fv), m_vertexCount(count), m_primitiveType(primitive) { }
+			: m_firstVertex(fv), m_vertexCount(count), m_firstIndex(0), m_indexCount(0), m_primitiveType(primitive) { }
+		MeshChunk(uint32_t fv, uint32_t count, uint32_t fi, uint32_t indexCount, Render::PrimitiveType primitive)
+			: m_firstVertex(fv), m_vertexCount(count), m_firstIndex(fi), m_indexCount(indexCount), m_primitiveType(primitive) { }
+		inline bool IsIndexed() const { return m_indexCount != 0; }
 		uint32_t m_firstVertex;
-		uint32_t m_vertexCount;
+		uint32_t m_vertexCount;		// vertices referenced by the chunk
+		uint32_t m_firstIndex;
+		uint32_t m_indexCount;		// absolute vertex indices, 32 bit
 		Render::PrimitiveType m_primitiveType;
 	};
 
+	// A coarser version of every chunk, drawn from the same vertices with its own index ranges
+	struct MeshLod
+	{
+		Core::SmallVector<MeshChunk, 1> m_chunks;	// one per chunk of the full mesh
+		float m_error;								// largest distance from the full mesh, in vertex position units
+	};
+
 	class Mesh
 	{
 	public:
+		using Chunks = Core::SmallVector<MeshChunk, 1>;	// nearly always a single chunk
 		Mesh();
 		~Mesh();
 
@@ -35,17 +50,28 @@ namespace Render
 
 		inline const Material& GetMaterial() const					{ return m_material; }
 		inline const std::vector<RenderBuffer>& GetStreams() const	{ return m_vertexStreams; }
+		inline const RenderBuffer& GetIndices() const				{ return m_indices; }
 		inline const VertexArray& GetVertexArray() const			{ return m_vertices; }
-		inline const std::vector<MeshChunk>& GetChunks() const		{ return m_chunks; }
+		inline const Chunks& GetChunks() const						{ return m_chunks; }
+		inline const std::vector<MeshLod>& GetLods() const			{ return m_lods; }
 		inline Material& GetMaterial() { return m_material; }
 		inline std::vector<RenderBuffer>& GetStreams()				{ return m_vertexStreams; }
+		inline RenderBuffer& GetIndices()							{ return m_indices; }
 		inline VertexArray& GetVertexArray()						{ return m_vertices; }		
-		inline std::vector<MeshChunk>& GetChunks()					{ return m_chunks; }
+		inline Chunks& GetChunks()									{ return m_chunks; }
+		inline std::vector<MeshLod>& GetLods()						{ return m_lods; }
+
+		// Level 0 is the full mesh (GetChunks), level n is GetLods()[n - 1]
+		inline uint32_t GetLodCount() const							{ return static_cast<uint32_t>(m_lods.size()) + 1; }
+		inline const Chunks& GetLodChunks(uint32_t lod) const		{ return lod == 0 ? m_chunks : m_lods[lod - 1].m_chunks; }
+		uint32_t SelectLod(float maxError) const;	// coarsest level whose error is within maxError (vertex position units)
 
 	private:
 		VertexArray m_vertices;
 		Material m_material;
 		std::vector<RenderBuffer> m_vertexStreams;
-		std::vector<MeshChunk> m_chunks;
+		RenderBuffer m_indices;		// empty if no chunks are indexed
+		Chunks m_chunks;
+		std::vector<MeshLod> m_lods;	// coarsest last
 	};
 }
\ No newline at end of file
@@ -7,20 +7,43 @@ Matt Hoyle
 #include "kernel/base_types.h"
 #include "math/glm_headers.h"
 #include "mesh.h"
+#include "mesh_optimiser.h"
+#include "core/fixed_vector.h"
+#include "core/small_vector.h"
 
 namespace Render
 {
+	// How a stream is stored in the vertex buffer. Data is always added as floats, encoding happens in CreateMesh
+	enum class VertexStreamEncoding : uint8_t
+	{
+		Float,
+		HalfFloat,				// 3 components are padded to 4
+		BoundedSnorm16,			// 3 components, snorm16 relative to the stream bounds (padded to 4), see GetStreamDecode
+		OctahedralSnorm16,		// unit vectors, 3 components in, 2 snorm16 out
+	};
+
+	// How streams are split between vertex buffers
+	enum class VertexBufferLayout : uint8_t
+	{
+		Separate,					// one buffer per stream
+		Interleaved,				// every stream in one buffer
+		InterleavedSplitPosition,	// stream 0 (position) on its own for depth only passes, the rest interleaved
+	};
+
 	// Helper for creating mesh objects
+	// Meshes can be built from triangle soups (step 3/4), or from indexed vertices (step 3b)
+	// Soups can be turned into indexed meshes with WeldVertices before creating the mesh
 	class MeshBuilder
 	{
 	public:
+		static const uint32_t c_maxStreams = 8;
 		MeshBuilder();
 		~MeshBuilder();
 
 		bool HasData();
 
 		// Step 1: Define streams
-		uint32_t AddVertexStream(int32_t componentCount, size_t reserveMemory = 0);
+		uint32_t AddVertexStream(int32_t componentCount, size_t reserveMemory = 0, VertexStreamEncoding encoding = VertexStreamEncoding::Float);
 
 		// Step 2: Define chunks
 		void BeginChunk();
@@ -35,31 +58,101 @@ namespace Render
 		void SetStreamData(uint32_t vertexStream, const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2);
 
 		void EndTriangle();
+
+		// Step 3b: Alternatively add vertices one at a time, then triangles that index them
+		void SetVertexData(uint32_t vertexStream, float v);
+		void SetVertexData(uint32_t vertexStream, const glm::vec2& v);
+		void SetVertexData(uint32_t vertexStream, const glm::vec3& v);
+		void SetVertexData(uint32_t vertexStream, const glm::vec4& v);
+		uint32_t EndVertex();	// returns the index relative to the start of the chunk
+		void AddTriangleIndices(uint32_t i0, uint32_t i1, uint32_t i2);	// relative to the start of the chunk
 		
 		void EndChunk();
 
+		// Optional: merge identical vertices of a triangle soup and replace them with an index stream
+		// Returns the number of unique vertices
+		uint32_t WeldVertices();
+
+		// Optional: reorder indexed chunks for the vertex cache + overdraw, then reorder vertices by first use
+		// positionStream must have 3 components. Cache stats are summed over every chunk
+		struct OptimiseStats
+		{
+			VertexCacheStats m_before;
+			VertexCacheStats m_after;
+		};
+		OptimiseStats Optimise(uint32_t positionStream);
+
+		// Optional, after Optimise: simplify the indexed chunks into coarser levels of detail that share the vertices
+		// Each level aims for lodReduction of the previous index count. Stops early once a level barely shrinks or the
+		// error gets too large. Returns the number of levels including the full mesh
+		uint32_t GenerateLods(uint32_t positionStream, uint32_t lodCount, float lodReduction = 0.5f);
+
 		// Step 5: Mesh creation
+		void SetBufferLayout(VertexBufferLayout layout) { m_layout = layout; }
 		bool CreateMesh(Mesh& target, bool createDynamicMesh=true, size_t minVbSize = 0);
 		bool CreateVertexArray(Mesh& mesh);	// this must happen on the main thread!
 
+		// BoundedSnorm16 streams decode as offset + value * scale, returns (offset, uniform scale). Valid after CreateMesh
+		// The scale is uniform so the decode can be folded into a transform without skewing normals
+		glm::vec4 GetStreamDecode(uint32_t vertexStream) const;
+
+		// Raw float data + absolute indices, for validating the builder passes
+		const std::vector<float>& GetStreamData(uint32_t vertexStream) const { return m_streams[vertexStream].m_streamData; }
+		const std::vector<uint32_t>& GetIndices() const { return m_indices; }
+
 	private:
 		bool ShouldRecreateMesh(Mesh& target, size_t minVbSize);
 		void RecreateMesh(Mesh& target, bool createDynamicMesh, size_t minVbSize);
+		void CreateIndexBuffer(Mesh& target, bool createDynamicMesh);
+		uint64_t HashVertex(uint32_t vertex) const;
+		bool VerticesEqual(uint32_t v0, uint32_t v1) const;
 
 		struct StreamDesc
 		{
 			int32_t m_componentCount;
+			VertexStreamEncoding m_encoding;
 			std::vector<float> m_streamData;
+			std::vector<uint8_t> m_encodedData;		// empty for float streams
+			glm::vec4 m_decode;						// offset + scale for bounded streams
+			uint32_t m_bufferIndex;					// set by BuildBuffers
+			uint32_t m_bufferOffset;
+			uint32_t m_bufferStride;				// 0 = tightly packed
 		};
+		struct BufferDesc
+		{
+			const void* m_data;
+			size_t m_size;
+		};
+		void EncodeStreams();
+		static VertexDataType GetEncodedType(const StreamDesc& stream);
+		static uint8_t GetEncodedComponentCount(const StreamDesc& stream);
+		static const void* GetEncodedData(const StreamDesc& stream);
+		static size_t GetEncodedSize(const StreamDesc& stream);
+		static uint32_t GetEncodedVertexSize(const StreamDesc& stream);
+		void BuildBuffers();
+
 		struct ChunkDesc
 		{
 			uint32_t m_firstVertex;
 			uint32_t m_lastVertex;
+			uint32_t m_firstIndex;
+			uint32_t m_lastIndex;	// first == last for soups
+		};
+		struct LodDesc
+		{
+			Core::SmallVector<ChunkDesc, 1> m_chunks;	// vertex ranges match the full chunks
+			float m_error;								// in float position units, before encoding
 		};
 
 		ChunkDesc m_currentChunk;
-		std::vector<StreamDesc> m_streams;
-		std::vector<ChunkDesc> m_chunks;
+		Core::FixedVector<StreamDesc, c_maxStreams> m_streams;
+		Core::SmallVector<ChunkDesc, 1> m_chunks;
+		std::vector<uint32_t> m_indices;	// absolute vertex indices, lod indices follow the full chunks
+		std::vector<LodDesc> m_lods;
+		uint32_t m_lodPositionStream = 0;
+		Core::FixedVector<BufferDesc, c_maxStreams> m_buffers;	// vertex buffers to create, built from the streams
+		std::vector<uint8_t> m_interleavedData;
+		VertexBufferLayout m_layout = VertexBufferLayout::Separate;
 		int m_currentVertexIndex;
 	};
 }
\ No newline at end of file
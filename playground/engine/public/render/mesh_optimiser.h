@@ -0,0 +1,51 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#pragma once
+
+#include "kernel/base_types.h"
+
+namespace Render
+{
+	// CPU passes over 32 bit triangle lists, no GL calls so they can run on any thread
+	// Indices are absolute, vertexCount is the size of the vertex buffer they reference
+
+	// Post-transform cache efficiency, simulated with a FIFO cache
+	struct VertexCacheStats
+	{
+		uint32_t m_transformedVertices = 0;		// cache misses
+		uint32_t m_triangleCount = 0;
+		uint32_t m_vertexCount = 0;				// unique vertices referenced
+		float ACMR() const { return m_triangleCount > 0 ? (float)m_transformedVertices / m_triangleCount : 0.0f; }	// 0.5 is ideal for regular grids, 3 is the worst
+		float ATVR() const { return m_vertexCount > 0 ? (float)m_transformedVertices / m_vertexCount : 0.0f; }		// 1 is ideal
+		VertexCacheStats& operator+=(const VertexCacheStats& s)
+		{
+			m_transformedVertices += s.m_transformedVertices;
+			m_triangleCount += s.m_triangleCount;
+			m_vertexCount += s.m_vertexCount;
+			return *this;
+		}
+	};
+	VertexCacheStats AnalyseVertexCache(const uint32_t* indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize = 16);
+
+	// Reorders triangles for vertex cache locality (Tom Forsyth's linear-speed algorithm). dst may not alias indices
+	void OptimiseVertexCache(uint32_t* dst, const uint32_t* indices, size_t indexCount, uint32_t vertexCount);
+
+	// Reorders clusters of a cache optimised list so outward facing clusters draw first, reducing overdraw
+	// Clusters are cut where it costs at most threshold * the current ACMR. dst may not alias indices
+	// positions = 3 floats per vertex, positionStride in bytes
+	void OptimiseOverdraw(uint32_t* dst, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, uint32_t vertexCount, float threshold = 1.05f);
+
+	// Builds a remap table that orders vertices by first use so fetches are sequential. Unused vertices map to -1
+	// Returns the number of vertices still referenced
+	uint32_t OptimiseVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, uint32_t vertexCount);
+
+	// Edge collapse simplification using quadric error metrics (Garland + Heckbert)
+	// Vertices are never moved or created, so the result indexes the same vertex buffer
+	// Vertices sharing a position (uv/normal seams) collapse together, open borders + seams only collapse along themselves
+	// Stops at targetIndexCount or when the next collapse would exceed targetError (position units). dst may not alias indices
+	// Returns the new index count, resultError gets the largest error of any collapse performed
+	size_t SimplifyMesh(uint32_t* dst, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, uint32_t vertexCount,
+		size_t targetIndexCount, float targetError, float* resultError = nullptr);
+}
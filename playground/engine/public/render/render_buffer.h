@@ -13,6 +13,7 @@ namespace Render
 		VertexData,
 		IndexData,
 		UniformData,	// UBO
+		StorageData,	// SSBO
 	};
 
 	enum class RenderBufferModification : uint32_t
@@ -32,10 +33,11 @@ namespace Render
 		bool Create(size_t bufferSize, RenderBufferType type, RenderBufferModification modification, bool usePersistentMapping=false);
 		bool Create(void* sourceData, size_t bufferSize, RenderBufferType type, RenderBufferModification modification, bool usePersistentMapping = false);
 		bool Destroy();
-		void SetData(size_t offset, size_t size, void* srcData);
+		void SetData(size_t offset, size_t size, const void* srcData);
 
 		inline uint32_t GetHandle() const { return m_handle; }
 		inline size_t GetSize() const { return m_bufferSize; }
+		inline void* GetMappedPointer() const { return m_persistentMappedBuffer; }	// null unless persistent mapped
 
 	private:
 		uint32_t TranslateStorageType(RenderBufferModification type) const;
@@ -0,0 +1,41 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#pragma once
+
+#include "render_buffer.h"
+#include "ring_buffer_allocator.h"
+#include "fence.h"
+#include <memory>
+
+namespace Render
+{
+	// Persistent mapped buffer split into fenced partitions, see RingBufferAllocator
+	// Write through GetWritePointer into the current partition, the gpu is never reading it
+	// Acquire + release partitions on the thread that owns the GL context, any thread may allocate + write
+	class RingBuffer
+	{
+	public:
+		static const size_t c_allocationFailed = RingBufferAllocator<Fence>::c_allocationFailed;
+
+		RingBuffer() = default;
+		RingBuffer(const RingBuffer&) = delete;
+		RingBuffer(RingBuffer&&) = delete;
+
+		bool Create(size_t partitionSize, uint32_t partitionCount, size_t alignment, RenderBufferType type);
+		uint32_t AcquirePartition() { return m_allocator->AcquirePartition(); }
+		size_t Allocate(uint32_t partition, size_t size) { return m_allocator->Allocate(partition, size); }
+		void ReleasePartition(uint32_t partition) { m_allocator->ReleasePartition(partition); }
+		void DiscardPartition(uint32_t partition) { m_allocator->DiscardPartition(partition); }
+		void* GetWritePointer(size_t offset);
+
+		const RenderBuffer& GetBuffer() const { return m_buffer; }
+		size_t PartitionSize() const { return m_allocator->PartitionSize(); }
+		uint32_t WaitCount() const { return m_allocator->WaitCount(); }
+
+	private:
+		RenderBuffer m_buffer;
+		std::unique_ptr<RingBufferAllocator<Fence>> m_allocator;
+	};
+}
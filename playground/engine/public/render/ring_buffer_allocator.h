@@ -0,0 +1,62 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#pragma once
+
+#include "kernel/base_types.h"
+#include <vector>
+
+namespace Render
+{
+	// Splits a buffer into partitions that are used in turn, usually one per frame
+	// Releasing a partition fences it, acquiring it again waits until the gpu has finished with it
+	// Allocations return offsets into the whole buffer. Only one thread may use a partition at a time
+	// FenceType needs Insert(), IsPending() and Wait(), see Render::Fence
+	template< class FenceType >
+	class RingBufferAllocator
+	{
+	public:
+		static const size_t c_allocationFailed = (size_t)-1;
+
+		RingBufferAllocator(size_t partitionSize, uint32_t partitionCount, size_t alignment);
+		RingBufferAllocator(const RingBufferAllocator&) = delete;
+		RingBufferAllocator(RingBufferAllocator&&) = delete;
+
+		uint32_t AcquirePartition();						// next partition in order, may wait on its fence
+		size_t Allocate(uint32_t partition, size_t size);	// c_allocationFailed if the partition is full
+		void ReleasePartition(uint32_t partition);			// call after the last gpu command using it
+		void DiscardPartition(uint32_t partition);			// release without a fence, the gpu never saw it
+
+		size_t PartitionSize() const { return m_partitionSize; }
+		uint32_t PartitionCount() const { return static_cast<uint32_t>(m_partitions.size()); }
+		size_t TotalSize() const { return m_partitionSize * m_partitions.size(); }
+		size_t UsedSize(uint32_t partition) const { return m_partitions[partition].m_used; }
+		uint32_t WaitCount() const { return m_waitCount; }	// how many times acquire had to wait on a fence
+		FenceType& GetFence(uint32_t partition) { return m_partitions[partition].m_fence; }
+
+	private:
+		struct Partition
+		{
+			FenceType m_fence;
+			size_t m_used = 0;
+			bool m_isAcquired = false;
+		};
+		std::vector<Partition> m_partitions;
+		size_t m_partitionSize;		// rounded up to the alignment so every partition starts aligned
+		size_t m_alignment;
+		uint32_t m_nextPartition = 0;
+		uint32_t m_waitCount = 0;
+	};
+
+	// Acts like a gpu that finishes the moment it is waited on, lets the allocator run without a context (i.e. tests)
+	struct NullFence
+	{
+		void Insert() { m_isPending = true; }
+		bool IsPending() { return m_isPending; }
+		void Wait() { m_isPending = false; }
+		bool m_isPending = false;
+	};
+}
+
+#include "ring_buffer_allocator.inl"
@@ -0,0 +1,67 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+
+#include "kernel/assert.h"
+
+namespace Render
+{
+	template< class FenceType >
+	RingBufferAllocator<FenceType>::RingBufferAllocator(size_t partitionSize, uint32_t partitionCount, size_t alignment)
+		: m_alignment(alignment)
+	{
+		SDE_ASSERT(partitionCount > 0 && alignment > 0);
+		m_partitionSize = ((partitionSize + alignment - 1) / alignment) * alignment;
+		m_partitions.resize(partitionCount);
+	}
+
+	template< class FenceType >
+	uint32_t RingBufferAllocator<FenceType>::AcquirePartition()
+	{
+		const uint32_t partition = m_nextPartition;
+		m_nextPartition = (m_nextPartition + 1) % PartitionCount();
+
+		auto& p = m_partitions[partition];
+		SDE_ASSERT(!p.m_isAcquired, "Ring buffer partition is still in use, add more partitions");
+		if (p.m_fence.IsPending())
+		{
+			p.m_fence.Wait();
+			++m_waitCount;
+		}
+		p.m_used = 0;
+		p.m_isAcquired = true;
+		return partition;
+	}
+
+	template< class FenceType >
+	size_t RingBufferAllocator<FenceType>::Allocate(uint32_t partition, size_t size)
+	{
+		auto& p = m_partitions[partition];
+		SDE_ASSERT(p.m_isAcquired, "Allocating from a partition that was not acquired");
+		const size_t offset = ((p.m_used + m_alignment - 1) / m_alignment) * m_alignment;
+		if (offset + size > m_partitionSize)
+		{
+			return c_allocationFailed;
+		}
+		p.m_used = offset + size;
+		return (partition * m_partitionSize) + offset;
+	}
+
+	template< class FenceType >
+	void RingBufferAllocator<FenceType>::ReleasePartition(uint32_t partition)
+	{
+		auto& p = m_partitions[partition];
+		SDE_ASSERT(p.m_isAcquired);
+		p.m_fence.Insert();
+		p.m_isAcquired = false;
+	}
+
+	template< class FenceType >
+	void RingBufferAllocator<FenceType>::DiscardPartition(uint32_t partition)
+	{
+		auto& p = m_partitions[partition];
+		SDE_ASSERT(p.m_isAcquired);
+		p.m_isAcquired = false;
+	}
+}
@@ -6,7 +6,7 @@ Matt Hoyle
 
 #include "kernel/base_types.h"
 #include <string>
-#include <unordered_map>
+#include "core/flat_hash_map.h"
 
 namespace Render
 {
@@ -28,9 +28,11 @@ namespace Render
 		uint32_t GetUniformBufferBlockIndex(const char* bufferName) const;
 
 		inline uint32_t GetHandle() const { return m_handle; }
+		inline uint32_t GetSerial() const { return m_serial; }	// unique per link, GL handles may be reused
 
 	private:
 		uint32_t m_handle;
-		std::unordered_map<uint32_t, uint32_t> m_uniformHandles;	// map of uniform name hash -> uniform handle
+		uint32_t m_serial;
+		Core::FlatHashMap<uint32_t, uint32_t> m_uniformHandles;	// map of uniform name hash -> uniform handle
 	};
 }
\ No newline at end of file
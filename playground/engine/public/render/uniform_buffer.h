@@ -1,8 +1,9 @@
 #pragma once
 
 #include "math/glm_headers.h"
-#include <unordered_map>
+#include "core/flat_hash_map.h"
 #include <string>
+#include <vector>
 
 namespace Render
 {
@@ -26,10 +27,10 @@ namespace Render
 			std::string m_name;
 			T m_value;
 		};
-		using FloatUniforms = std::unordered_map<uint32_t, Uniform<float>>;
-		using Vec4Uniforms = std::unordered_map<uint32_t, Uniform<glm::vec4>>;
-		using Mat4Uniforms = std::unordered_map<uint32_t, Uniform<glm::mat4>>;
-		using IntUniforms = std::unordered_map<uint32_t, Uniform<int32_t>>;
+		using FloatUniforms = Core::FlatHashMap<uint32_t, Uniform<float>>;
+		using Vec4Uniforms = Core::FlatHashMap<uint32_t, Uniform<glm::vec4>>;
+		using Mat4Uniforms = Core::FlatHashMap<uint32_t, Uniform<glm::mat4>>;
+		using IntUniforms = Core::FlatHashMap<uint32_t, Uniform<int32_t>>;
 		void SetValue(std::string name, float value);
 		void SetValue(std::string name, const glm::vec4& value);
 		void SetValue(std::string name, const glm::mat4& value);
@@ -38,11 +39,41 @@ namespace Render
 		const Vec4Uniforms& Vec4Values() const { return m_vec4Values; }
 		const Mat4Uniforms& Mat4Values() const { return m_mat4Values; }
 		const IntUniforms& IntValues() const { return m_intValues; }
+		uint32_t GetVersion() const { return m_version; }		// changes whenever a value is set
 
 	private:
 		FloatUniforms m_floatValues;
 		Vec4Uniforms m_vec4Values;
 		Mat4Uniforms m_mat4Values;
 		IntUniforms m_intValues;
+		uint32_t m_version = 0;
+	};
+
+	// A UniformBuffer resolved against one shader program
+	// Values the program uses are packed into one blob, applying them is a single loop with no hashing
+	class CompiledUniformBuffer
+	{
+	public:
+		void Compile(const UniformBuffer& values, Render::ShaderProgram& p);
+		void Apply(Render::Device& d) const;
+
+	private:
+		enum class ValueType : uint8_t
+		{
+			Float,
+			Vec4,
+			Mat4,
+			Int
+		};
+		struct Binding
+		{
+			uint32_t m_location;
+			ValueType m_type;
+			uint32_t m_offset;		// into m_values
+		};
+		template<class T> void CompileValues(const T& values, ValueType type, Render::ShaderProgram& p);
+
+		std::vector<Binding> m_bindings;
+		std::vector<uint8_t> m_values;
 	};
 }
\ No newline at end of file
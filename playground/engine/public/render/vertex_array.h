@@ -13,7 +13,10 @@ namespace Render
 
 	enum class VertexDataType : uint8_t
 	{
-		Float
+		Float,
+		HalfFloat,
+		UnsignedInt,		// not normalised or converted, read as uint in shaders
+		ShortNormalised		// int16, read as float in [-1,1]
 	};
 
 	// This represents the vertex format state used to render something
@@ -24,7 +27,9 @@ namespace Render
 		VertexArray();
 		~VertexArray();
 
+		// offset = byte offset of the first element in the buffer, stride = 0 for tightly packed. Interleave by sharing a buffer
 		void AddBuffer(uint8_t attribIndex, const RenderBuffer* srcBuffer, VertexDataType srcType, uint8_t components, uint32_t offset = 0, uint32_t stride = 0);
+		void SetIndexBuffer(const RenderBuffer* indexBuffer) { m_indexBuffer = indexBuffer; }	// 32 bit indices, optional
 		bool Create();		// Initialises the GL-side state for rendering. Call after buffers have been added!
 		void Destroy();
 
@@ -34,8 +39,9 @@ namespace Render
 		inline uint8_t GetStreamComponentCount(uint32_t streamIndex) const	{ return m_descriptors[streamIndex].m_componentCount; }
 		inline uint8_t GetStreamAttributeIndex(uint32_t streamIndex) const	{ return m_descriptors[streamIndex].m_attribIndex; }
 
+		static uint32_t TranslateDataType(VertexDataType type);	// returns the GL type
+
 	private:
-		uint32_t TranslateDataType(VertexDataType type) const;
 
 		struct VertexBufferDescriptor
 		{
@@ -47,6 +53,7 @@ namespace Render
 			uint8_t m_attribIndex;
 		};
 		std::vector<VertexBufferDescriptor> m_descriptors;
+		const RenderBuffer* m_indexBuffer;
 		uint32_t m_handle;	// gl handle
 	};
 }
\ No newline at end of file
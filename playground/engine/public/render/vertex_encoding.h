@@ -0,0 +1,48 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#pragma once
+
+#include "kernel/base_types.h"
+#include "math/glm_headers.h"
+#include <glm/gtc/packing.hpp>
+
+namespace Render
+{
+	// Vertex attribute quantisation, matches what GL does when fetching the encoded attribute
+	// Decoding is only needed on the CPU for validation, shaders get the same values from the vertex fetch
+
+	// snorm16 decodes as max(v / 32767, -1), so the worst case error is 0.5 / 32767 of the range (plus float rounding)
+	inline int16_t EncodeSnorm16(float v)		{ return static_cast<int16_t>(glm::packSnorm1x16(v)); }
+	inline float DecodeSnorm16(int16_t v)		{ return glm::unpackSnorm1x16(static_cast<uint16_t>(v)); }
+
+	// 11 significant bits, the relative error is at most 1 / 2048 in the normal range
+	inline uint16_t EncodeHalf(float v)			{ return glm::packHalf1x16(v); }
+	inline float DecodeHalf(uint16_t v)			{ return glm::unpackHalf1x16(v); }
+
+	// Octahedral unit vectors, the sphere is projected onto an octahedron then unfolded into [-1,1]^2
+	// See "A Survey of Efficient Representations for Independent Unit Vectors" (Cigolle et al.)
+	// Stored as 2 snorm16 the decoded vector is within 1e-4 of the original (see tests/render_tests.cpp)
+	inline glm::vec2 OctahedralEncode(glm::vec3 n)
+	{
+		n /= (glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z));
+		glm::vec2 e(n.x, n.y);
+		if (n.z < 0.0f)
+		{
+			const glm::vec2 signNotZero(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+			e = (1.0f - glm::abs(glm::vec2(e.y, e.x))) * signNotZero;
+		}
+		return e;
+	}
+
+	// must match OctahedralDecode in shared.vs
+	inline glm::vec3 OctahedralDecode(glm::vec2 e)
+	{
+		glm::vec3 n(e.x, e.y, 1.0f - glm::abs(e.x) - glm::abs(e.y));
+		const float t = glm::max(-n.z, 0.0f);
+		n.x += n.x >= 0.0f ? -t : t;
+		n.y += n.y >= 0.0f ? -t : t;
+		return glm::normalize(n);
+	}
+}
@@ -10,6 +10,8 @@ Matt Hoyle
 
 namespace SDE
 {
+	class JobSystem;
+
 	class AssetSystem : public Core::ISystem
 	{
 	public:
@@ -20,23 +22,13 @@ namespace SDE
 		void LoadAsset(const char* assetName, std::function<void(const std::string&, bool)> onComplete);
 		Assets::AssetCreator& GetCreator() { return m_creator; }
 
+		bool PreInit(Core::ISystemEnumerator& systemEnumerator) override;
 		void Shutdown() override;
-		bool Tick() override;
 
 	private:
-		struct LoadingJobDescriptor		// Async load data
-		{
-			std::string m_assetID;
-			bool m_loadResult;
-			std::function<void(const std::string&, bool)> m_then;	// called on MAIN THREAD once the job is complete
-		};
-
 		std::string m_assetsRoot;
 		std::unique_ptr<Assets::AssetDatabase> m_database;
 		Assets::AssetCreator m_creator;
-
-		// Replace with job system!
-		std::vector<LoadingJobDescriptor> m_pendingJobs;			
-		std::vector<LoadingJobDescriptor> m_completedJobs;
+		JobSystem* m_jobSystem;
 	};
 }
\ No newline at end of file
@@ -15,9 +15,11 @@ namespace SDE
 	{
 	public:
 		typedef std::function<void()> JobThreadFunction;	// Code to be ran on the job thread
+		typedef std::function<void()> MainThreadFunction;	// Continuation, ran on the main thread after the job completes
 
 		Job();
 		Job(JobSystem* parent, JobThreadFunction threadFn);
+		Job(JobSystem* parent, JobThreadFunction threadFn, MainThreadFunction thenFn);
 		~Job() = default;
 		Job(Job&&) = default;
 		Job& operator=(Job&&) = default;
@@ -27,6 +29,7 @@ namespace SDE
 
 	private:
 		JobThreadFunction m_threadFn;
+		MainThreadFunction m_thenFn;
 		JobSystem* m_parent;
 		uint64_t m_padding[8];
 	};
@@ -5,10 +5,12 @@ Matt Hoyle
 #pragma once
 
 #include "job_queue.h"
+#include "main_thread_queue.h"
 #include "core/system.h"
 #include "core/thread_pool.h"
 #include "kernel/semaphore.h"
 #include "kernel/atomics.h"
+#include <functional>
 
 namespace SDE
 {
@@ -22,9 +24,19 @@ namespace SDE
 
 		bool PreInit(Core::ISystemEnumerator& systemEnumerator);
 		bool PostInit();
+		bool Tick();
 		void Shutdown();
 
 		void PushJob(Job::JobThreadFunction threadFn);
+		// thenFn is called on the main thread once threadFn completes (during JobSystem::Tick)
+		void PushJob(Job::JobThreadFunction threadFn, Job::MainThreadFunction thenFn);
+
+		// Runs fn(0..chunkCount-1) across the job threads, the caller takes chunks too and blocks until every chunk is done
+		// Jobs that start after the work is gone return without touching fn
+		void RunInParallel(uint32_t chunkCount, const std::function<void(uint32_t)>& fn);
+
+		// Safe to call from any thread. Callbacks are ran from Tick, within a per-frame time budget
+		void RunOnMainThread(MainThreadQueue::Callback fn);
 
 	private:
 		void LoadConfig(ConfigSystem* cfg);
@@ -32,6 +44,8 @@ namespace SDE
 		class RenderSystem* m_renderSystem;
 		Core::ThreadPool m_threadPool;
 		JobQueue m_pendingJobs;
+		MainThreadQueue m_mainThreadCallbacks;
+		double m_mainThreadBudgetMs;	// max time spent running main thread callbacks each frame
 		Kernel::Semaphore m_jobThreadTrigger;
 		Kernel::AtomicInt32 m_jobThreadStopRequested;
 		int32_t m_threadCount;
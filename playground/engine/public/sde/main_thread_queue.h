@@ -0,0 +1,44 @@
+/*
+SDLEngine
+Matt Hoyle
+*/
+#pragma once
+
+#include "kernel/atomics.h"
+#include <functional>
+
+namespace SDE
+{
+	// Lock-free queue of callbacks to be ran on the main thread
+	// Any thread can push, only the main thread may call RunPending/RemoveAll
+	// Callbacks run in the order they were pushed. RunPending stops once the time budget is
+	// used up, anything left over is kept for the next call
+	class MainThreadQueue
+	{
+	public:
+		typedef std::function<void()> Callback;
+
+		MainThreadQueue();
+		~MainThreadQueue();
+		MainThreadQueue(const MainThreadQueue&) = delete;
+		MainThreadQueue(MainThreadQueue&&) = delete;
+
+		void Push(Callback&& fn);
+		uint32_t RunPending(double budgetSeconds);	// always runs at least one callback if any are pending
+		void RemoveAll();
+		int32_t PendingCount() { return m_pendingCount.Get(); }
+
+	private:
+		struct Node
+		{
+			Callback m_fn;
+			Node* m_next;
+		};
+		void AcquireIncoming();
+
+		Kernel::AtomicPtr m_incoming;		// LIFO stack of new nodes, pushed by any thread
+		Node* m_readyHead;					// FIFO list owned by the main thread
+		Node* m_readyTail;
+		Kernel::AtomicInt32 m_pendingCount;
+	};
+}
\ No newline at end of file
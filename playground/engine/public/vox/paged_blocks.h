@@ -6,7 +6,7 @@ Matt Hoyle
 
 #include "block.h"
 #include <glm/glm.hpp>
-#include <unordered_map>
+#include "core/flat_hash_map.h"
 
 namespace Vox
 {
@@ -31,12 +31,12 @@ namespace Vox
 		uint64_t TotalVoxelMemory() const;
 
 		// Block iterators
-		typename std::unordered_map<uint64_t, BlockType*>::iterator begin() const { return m_blockData.begin(); }
-		typename std::unordered_map<uint64_t, BlockType*>::iterator end() const { return m_blockData.end(); }
+		typename Core::FlatHashMap<uint64_t, BlockType*>::const_iterator begin() const { return m_blockData.begin(); }
+		typename Core::FlatHashMap<uint64_t, BlockType*>::const_iterator end() const { return m_blockData.end(); }
 
 	private:
 		uint64_t HashCoords(const glm::ivec3& coords) const;
-		std::unordered_map<uint64_t, BlockType*> m_blockData;
+		Core::FlatHashMap<uint64_t, BlockType*> m_blockData;
 	};
 }
 
@@ -62,7 +62,7 @@ bool Graphics::PostInit()
 	m_windowSize = glm::ivec2(windowProps.m_sizeX, windowProps.m_sizeY);
 	
 	// add our renderer to the global passes
-	m_renderer = std::make_unique<smol::Renderer>(m_textures.get(), m_models.get(), m_shaders.get(), m_windowSize);
+	m_renderer = std::make_unique<smol::Renderer>(m_textures.get(), m_models.get(), m_shaders.get(), m_windowSize, m_jobSystem);
 	m_renderSystem->AddPass(*m_renderer);
 
 	// expose TextureHandle to lua
@@ -74,6 +74,9 @@ bool Graphics::PostInit()
 	// expose ShaderHandle to lua
 	m_scriptSystem->Globals().new_usertype<smol::ShaderHandle>("ShaderHandle", sol::constructors<smol::ShaderHandle()>());
 
+	// expose RenderInstanceHandle to lua
+	m_scriptSystem->Globals().new_usertype<smol::RenderInstanceHandle>("RenderInstanceHandle", sol::constructors<smol::RenderInstanceHandle()>());
+
 	// expose Graphics namespace functions
 	auto graphics = m_scriptSystem->Globals()["Graphics"].get_or_create<sol::table>();
 	graphics["SetClearColour"] = [this](float r, float g, float b) {
@@ -95,12 +98,30 @@ bool Graphics::PostInit()
 		auto transform = glm::scale(glm::translate(glm::identity<glm::mat4>(), glm::vec3(px, py, pz)), glm::vec3(scale));
 		m_renderer->SubmitInstance(transform, glm::vec4(r,g,b,a), h, sh);
 	};
+	graphics["DrawStaticModel"] = [this](float px, float py, float pz, float r, float g, float b, float a, float scale, smol::ModelHandle h, smol::ShaderHandle sh) {
+		auto transform = glm::scale(glm::translate(glm::identity<glm::mat4>(), glm::vec3(px, py, pz)), glm::vec3(scale));
+		m_renderer->SubmitInstance(transform, glm::vec4(r,g,b,a), h, sh, true);
+	};
+	graphics["CreateModelInstance"] = [this](float px, float py, float pz, float r, float g, float b, float a, float scale, smol::ModelHandle h, smol::ShaderHandle sh, bool isStatic) -> smol::RenderInstanceHandle {
+		auto transform = glm::scale(glm::translate(glm::identity<glm::mat4>(), glm::vec3(px, py, pz)), glm::vec3(scale));
+		return m_renderer->CreateInstance(transform, glm::vec4(r, g, b, a), h, sh, isStatic);
+	};
+	graphics["UpdateModelInstance"] = [this](smol::RenderInstanceHandle instance, float px, float py, float pz, float r, float g, float b, float a, float scale) {
+		auto transform = glm::scale(glm::translate(glm::identity<glm::mat4>(), glm::vec3(px, py, pz)), glm::vec3(scale));
+		m_renderer->UpdateInstance(instance, transform, glm::vec4(r, g, b, a));
+	};
+	graphics["DestroyModelInstance"] = [this](smol::RenderInstanceHandle instance) {
+		m_renderer->DestroyInstance(instance);
+	};
 	graphics["PointLight"] = [this](float px, float py, float pz, float r, float g, float b, float ambient, float attenConst, float attenLinear, float attenQuad) {
 		m_renderer->SetLight(glm::vec4(px, py, pz,1.0f), glm::vec3(r, g, b), ambient, { attenConst , attenLinear , attenQuad });
 	};
 	graphics["DirectionalLight"] = [this](float dx, float dy, float dz, float r, float g, float b, float ambient) {
 		m_renderer->SetLight(glm::vec4(dx, dy, dz, 0.0f), glm::vec3(r, g, b), ambient, { 0.0f,0.0f,0.0f });
 	};
+	graphics["SetFrameLatency"] = [this](int frames) {
+		m_renderer->SetFrameLatency(frames < 0 ? 0 : frames);
+	};
 	graphics["DebugDrawAxis"] = [this](float px, float py, float pz, float size) {
 		m_debugRender->AddAxisAtPoint({ px,py,pz,1.0f }, size);
 	};
@@ -127,7 +148,7 @@ bool Graphics::PostInit()
 	auto& gMenu = g_graphicsMenu.AddSubmenu(ICON_FK_TELEVISION " Graphics");
 	gMenu.AddItem("Reload Shaders", [this]() { m_shaders->ReloadAll(); });
 	gMenu.AddItem("Reload Textures", [this]() { m_textures->ReloadAll(); });
-	gMenu.AddItem("Reload Models", [this]() { m_renderer->Reset(); m_models->ReloadAll(); });
+	gMenu.AddItem("Reload Models", [this]() { m_models->ReloadAll(); });
 	gMenu.AddItem("TextureManager", [this]() { g_showTextureGui = true; });
 	gMenu.AddItem("ModelManager", [this]() { g_showModelGui = true; });
 	auto& camMenu = g_graphicsMenu.AddSubmenu(ICON_FK_CAMERA " Camera (Arcball)");
@@ -215,21 +236,34 @@ bool Graphics::Tick()
 	bool forceOpen = true;
 	m_debugGui->BeginWindow(forceOpen,"Render Stats");
 	sprintf_s(statText, "Total Instances: %zu", fs.m_instancesSubmitted);	m_debugGui->Text(statText);
+	sprintf_s(statText, "Instances Culled: %zu", fs.m_instancesCulled);	m_debugGui->Text(statText);
+	for (uint32_t c = 0; c < smol::Renderer::c_shadowCascadeCount; ++c)
+	{
+		sprintf_s(statText, "Cascade %u Shadow Casters: %zu", c, fs.m_cascadeShadowCasters[c]);	m_debugGui->Text(statText);
+	}
+	sprintf_s(statText, "Cube Shadow Casters: %zu, %zu, %zu, %zu, %zu, %zu", fs.m_cubeShadowCasters[0], fs.m_cubeShadowCasters[1],
+		fs.m_cubeShadowCasters[2], fs.m_cubeShadowCasters[3], fs.m_cubeShadowCasters[4], fs.m_cubeShadowCasters[5]);	m_debugGui->Text(statText);
+	sprintf_s(statText, "Retained Instances: %zu (%zu uploaded)", fs.m_retainedInstances, fs.m_retainedInstancesUploaded);	m_debugGui->Text(statText);
+	sprintf_s(statText, "Static Shadows Redrawn: %zu", fs.m_staticShadowLayersUpdated);	m_debugGui->Text(statText);
+	sprintf_s(statText, "Ring Buffer Waits: %zu", fs.m_ringBufferWaits);	m_debugGui->Text(statText);
+	sprintf_s(statText, "Lights: %zu (%zu cluster indices)", fs.m_lights, fs.m_lightClusterIndices);	m_debugGui->Text(statText);
+	sprintf_s(statText, "State Changes: %zu (%zu filtered)", fs.m_stateChangesIssued, fs.m_stateChangesFiltered);	m_debugGui->Text(statText);
 	sprintf_s(statText, "Shader Binds: %zu", fs.m_shaderBinds);	m_debugGui->Text(statText);
 	sprintf_s(statText, "VA Binds: %zu", fs.m_vertexArrayBinds);	m_debugGui->Text(statText);
 	sprintf_s(statText, "Batches Drawn: %zu", fs.m_batchesDrawn);	m_debugGui->Text(statText);
-	sprintf_s(statText, "Draw calls: %zu", fs.m_drawCalls);	m_debugGui->Text(statText);
+	sprintf_s(statText, "Draw calls: %zu (%zu commands)", fs.m_drawCalls, fs.m_drawCommands);	m_debugGui->Text(statText);
+	sprintf_s(statText, "Commands per multi-draw: %.2f", fs.m_multiDraws > 0 ? (double)fs.m_multiDrawCommands / fs.m_multiDraws : 0.0);	m_debugGui->Text(statText);
 	sprintf_s(statText, "Total Verts: %zu", fs.m_totalVertices);	m_debugGui->Text(statText);
 	sprintf_s(statText, "FPS: %d", framesPerSecond);	m_debugGui->Text(statText);
+	sprintf_s(statText, "Frame Latency: %d", m_renderer->GetFrameLatency());	m_debugGui->Text(statText);
+	m_debugGui->Checkbox("Multi-draw Indirect", &m_renderer->GetUseIndirectDraws());
 	m_debugGui->DragFloat("Exposure", m_renderer->GetExposure(), 0.01f, 0.0f, 100.0f);
 	m_debugGui->DragFloat("Shadow Bias", m_renderer->GetShadowBias(), 0.00001f, 0.0000001f, 1.0f);
 	m_debugGui->DragFloat("Cube Shadow Bias", m_renderer->GetCubeShadowBias(), 0.1f, 0.1f, 5.0f);
+	m_debugGui->DragFloat("LOD Error (pixels)", m_renderer->GetLodErrorPixels(), 0.1f, 0.0f, 64.0f);
+	m_debugGui->DragFloat("Shadow LOD Bias", m_renderer->GetShadowLodBias(), 0.1f, 1.0f, 16.0f);
 	m_debugGui->EndWindow();
 
-	// Process loaded data on main thread
-	m_textures->ProcessLoadedTextures();
-	m_models->ProcessLoadedModels();
-
 	return true;
 }
 
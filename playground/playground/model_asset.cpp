@@ -31,7 +31,7 @@ namespace Assets
 
 		// Process vertices
 		glm::vec3 boundsMin(FLT_MAX);
-		glm::vec3 boundsMax(FLT_MIN);
+		glm::vec3 boundsMax(-FLT_MAX);
 
 		ModelMesh newMesh;
 		newMesh.Transform() = transform;
@@ -57,9 +57,7 @@ namespace Assets
 			boundsMax = glm::max(boundsMax, newVertex.m_position);
 			vertices.push_back(newVertex);
 		}
-		boundsMin = glm::vec3(transform * glm::vec4(boundsMin, 1.0f));
-		boundsMax = glm::vec3(transform * glm::vec4(boundsMax, 1.0f));
-		newMesh.Bounds() = Math::Box3(boundsMin, boundsMax);
+		newMesh.Bounds() = Math::Box3(boundsMin, boundsMax).Transformed(transform);
 
 		// Process indices
 		auto& indices = newMesh.Indices();
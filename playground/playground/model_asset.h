@@ -10,6 +10,7 @@
 
 #include "math/glm_headers.h"
 #include "math/box3.h"
+#include "core/small_vector.h"
 
 #include <vector>
 #include <string>
@@ -37,14 +38,16 @@ namespace Assets
 		MeshMaterial() = default;
 		~MeshMaterial() = default;
 
-		std::vector<std::string>& DiffuseMaps() { return m_diffuseMaps; }
-		const std::vector<std::string>& DiffuseMaps() const { return m_diffuseMaps; }
+		using TexturePaths = Core::SmallVector<std::string, 1>;	// usually 0 or 1 textures per type
 
-		std::vector<std::string>& NormalMaps() { return m_normalMaps; }
-		const std::vector<std::string>& NormalMaps() const { return m_normalMaps; }
+		TexturePaths& DiffuseMaps() { return m_diffuseMaps; }
+		const TexturePaths& DiffuseMaps() const { return m_diffuseMaps; }
 
-		std::vector<std::string>& SpecularMaps() { return m_specularMaps; }
-		const std::vector<std::string>& SpecularMaps() const { return m_specularMaps; }
+		TexturePaths& NormalMaps() { return m_normalMaps; }
+		const TexturePaths& NormalMaps() const { return m_normalMaps; }
+
+		TexturePaths& SpecularMaps() { return m_specularMaps; }
+		const TexturePaths& SpecularMaps() const { return m_specularMaps; }
 
 		float Opacity() const { return m_opacity; }
 		float& Opacity() { return m_opacity; }
@@ -59,9 +62,9 @@ namespace Assets
 		float& ShininessStrength() { return m_shininessStrength; }
 		float ShininessStrength() const { return m_shininessStrength; }
 	private:
-		std::vector<std::string> m_diffuseMaps;
-		std::vector<std::string> m_normalMaps;
-		std::vector<std::string> m_specularMaps;
+		TexturePaths m_diffuseMaps;
+		TexturePaths m_normalMaps;
+		TexturePaths m_specularMaps;
 		glm::vec3 m_diffuseColour;
 		glm::vec3 m_ambientColour;
 		glm::vec3 m_specularColour;
@@ -2,6 +2,7 @@
 
 #include "math/glm_headers.h"
 #include "shader_manager.h"
+#include "renderer.h"
 #include <memory>
 #include <functional>
 
@@ -12,7 +13,6 @@ namespace Render
 
 namespace smol
 {
-	class Renderer;
 	class DebugRender
 	{
 	public:
@@ -34,7 +34,7 @@ namespace smol
 		std::unique_ptr<glm::vec4, std::function<void(glm::vec4*)>> m_posBuffer;
 		std::unique_ptr<glm::vec4, std::function<void(glm::vec4*)>> m_colBuffer;
 		ShaderHandle m_shader;
-		static const uint32_t c_meshBuffers = 2;	// triple-buffered
+		static const uint32_t c_meshBuffers = Renderer::c_maxFrameLatency + 2;	// one being written, one per frame in flight + one being drawn
 		std::unique_ptr<Render::Mesh> m_renderMesh[c_meshBuffers];		
 		uint32_t m_currentWriteMesh;
 	};
@@ -0,0 +1,105 @@
+#include "draw_commands.h"
+#include "core/profiler.h"
+#include "kernel/assert.h"
+#include "render/mesh.h"
+#include <algorithm>
+
+namespace smol
+{
+	static_assert(sizeof(DrawArraysIndirectCommand) == sizeof(uint32_t) * 4, "Indirect commands must be tightly packed");
+	static_assert(sizeof(DrawElementsIndirectCommand) == sizeof(uint32_t) * 5, "Indirect commands must be tightly packed");
+
+	void DrawCommandList::Clear()
+	{
+		m_commands.clear();
+		m_indexedCommands.clear();
+		m_groups.clear();
+	}
+
+	void DrawCommandList::Build(const MeshInstance* instances, const Core::SortKeyIndex* drawOrder, uint32_t first, uint32_t count)
+	{
+		SDE_PROF_EVENT();
+		const size_t firstGroupInRange = m_groups.size();
+		const uint32_t end = first + count;
+		uint32_t runFirst = first;
+		while (runFirst != end)
+		{
+			// a run of instances with the same shader, mesh + lod, contiguous in the instance buffer
+			const MeshInstance& runInstance = instances[drawOrder[runFirst].m_index];
+			const uint64_t runPosition = drawOrder[runFirst].m_key;
+			uint32_t runEnd = runFirst + 1;
+			while (runEnd != end)
+			{
+				const MeshInstance& m = instances[drawOrder[runEnd].m_index];
+				if (m.m_mesh != runInstance.m_mesh || m.m_lod != runInstance.m_lod || m.m_shader.m_index != runInstance.m_shader.m_index || drawOrder[runEnd].m_key != runPosition + (runEnd - runFirst))
+				{
+					break;
+				}
+				++runEnd;
+			}
+
+			// one command per chunk, added to the last group if nothing but the instances or lod changed
+			const uint32_t instanceCount = runEnd - runFirst;
+			if (runInstance.m_mesh != nullptr)
+			{
+				for (const auto& chunk : runInstance.m_mesh->GetLodChunks(runInstance.m_lod))
+				{
+					const bool indexed = chunk.IsIndexed();
+					const bool newGroup = m_groups.size() == firstGroupInRange
+						|| m_groups.back().m_mesh != runInstance.m_mesh
+						|| m_groups.back().m_shader.m_index != runInstance.m_shader.m_index
+						|| m_groups.back().m_primitiveType != chunk.m_primitiveType
+						|| m_groups.back().m_indexed != indexed;
+					if (newGroup)
+					{
+						const size_t firstCommand = indexed ? m_indexedCommands.size() : m_commands.size();
+						m_groups.push_back({ runInstance.m_shader, runInstance.m_mesh, chunk.m_primitiveType, indexed, runFirst, static_cast<uint32_t>(firstCommand), 0, 0 });
+					}
+					auto& group = m_groups.back();
+					if (indexed)
+					{
+						m_indexedCommands.push_back({ chunk.m_indexCount, instanceCount, chunk.m_firstIndex, 0, static_cast<uint32_t>(runPosition) });
+						group.m_vertexCount += static_cast<uint64_t>(chunk.m_indexCount) * instanceCount;
+					}
+					else
+					{
+						m_commands.push_back({ chunk.m_vertexCount, instanceCount, chunk.m_firstVertex, static_cast<uint32_t>(runPosition) });
+						group.m_vertexCount += static_cast<uint64_t>(chunk.m_vertexCount) * instanceCount;
+					}
+					group.m_commandCount++;
+				}
+			}
+			runFirst = runEnd;
+		}
+
+#ifdef SDE_DEBUG
+		// compare the instances drawn by the new commands against what the draw order asked for
+		uint64_t drawOrderInstances = 0;
+		for (uint32_t d = first; d < end; ++d)
+		{
+			const MeshInstance& m = instances[drawOrder[d].m_index];
+			drawOrderInstances += m.m_mesh != nullptr ? m.m_mesh->GetLodChunks(m.m_lod).size() : 0;
+		}
+		uint64_t commandInstances = 0;
+		for (size_t g = firstGroupInRange; g < m_groups.size(); ++g)
+		{
+			const auto& group = m_groups[g];
+			SDE_ASSERT(group.m_firstDrawOrder >= first && group.m_firstDrawOrder < end, "Draw command group outside its range");
+			SDE_ASSERT(g == firstGroupInRange || group.m_firstDrawOrder >= m_groups[g - 1].m_firstDrawOrder, "Draw command groups out of order");
+			for (uint32_t c = group.m_firstCommand; c < group.m_firstCommand + group.m_commandCount; ++c)
+			{
+				commandInstances += group.m_indexed ? m_indexedCommands[c].m_instanceCount : m_commands[c].m_instanceCount;
+			}
+		}
+		SDE_ASSERT(commandInstances == drawOrderInstances, "Draw commands cover %d instances, the draw order needs %d", (int)commandInstances, (int)drawOrderInstances);
+#endif
+	}
+
+	uint32_t DrawCommandList::FindGroup(uint32_t firstDrawOrder) const
+	{
+		auto found = std::lower_bound(m_groups.begin(), m_groups.end(), firstDrawOrder, [](const DrawCommandGroup& g, uint32_t position) {
+			return g.m_firstDrawOrder < position;
+		});
+		return static_cast<uint32_t>(found - m_groups.begin());
+	}
+}
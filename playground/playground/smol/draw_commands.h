@@ -0,0 +1,65 @@
+#pragma once
+#include "mesh_instance.h"
+#include "render/device.h"
+#include "core/radix_sort.h"
+#include <vector>
+
+namespace smol
+{
+	// Same layout as GL DrawArraysIndirectCommand, copied straight into the indirect buffer
+	struct DrawArraysIndirectCommand
+	{
+		uint32_t m_vertexCount;
+		uint32_t m_instanceCount;
+		uint32_t m_firstVertex;
+		uint32_t m_baseInstance;	// position in the instance buffer
+	};
+
+	// Same layout as GL DrawElementsIndirectCommand
+	struct DrawElementsIndirectCommand
+	{
+		uint32_t m_indexCount;
+		uint32_t m_instanceCount;
+		uint32_t m_firstIndex;
+		int32_t m_baseVertex;		// mesh indices are absolute, always 0
+		uint32_t m_baseInstance;
+	};
+
+	// Consecutive commands that can be issued as a single multi-draw
+	// Every mesh owns its vertex array + material, so a group never spans meshes. Lods of a mesh share a group
+	// There is no shared vertex/index arena, so this does not batch different meshes: a multi-draw is usually one
+	// command (one lod chunk, one run of instances). Only multi-chunk meshes or runs split by lods produce more,
+	// see FrameStats::m_multiDrawCommands
+	struct DrawCommandGroup
+	{
+		ShaderHandle m_shader;
+		const Render::Mesh* m_mesh;
+		Render::PrimitiveType m_primitiveType;
+		bool m_indexed;					// commands are in IndexedCommands()
+		uint32_t m_firstDrawOrder;		// first draw order entry covered by the group
+		uint32_t m_firstCommand;
+		uint32_t m_commandCount;
+		uint64_t m_vertexCount;			// vertices or indices summed over every instance, for stats
+	};
+
+	// Builds indirect draw commands from a sorted draw order whose keys are instance buffer positions
+	// Only touches the instances + draw order passed in, so it can run on any thread
+	// Each range passed to Build is grouped on its own, drawing can start at any range boundary
+	// Debug builds check the commands built for a range draw every instance in it once per lod chunk
+	class DrawCommandList
+	{
+	public:
+		void Clear();
+		void Build(const MeshInstance* instances, const Core::SortKeyIndex* drawOrder, uint32_t first, uint32_t count);
+		uint32_t FindGroup(uint32_t firstDrawOrder) const;	// first group at or after a draw order position
+
+		const std::vector<DrawArraysIndirectCommand>& Commands() const { return m_commands; }
+		const std::vector<DrawElementsIndirectCommand>& IndexedCommands() const { return m_indexedCommands; }
+		const std::vector<DrawCommandGroup>& Groups() const { return m_groups; }
+
+	private:
+		std::vector<DrawArraysIndirectCommand> m_commands;
+		std::vector<DrawElementsIndirectCommand> m_indexedCommands;
+		std::vector<DrawCommandGroup> m_groups;
+	};
+}
@@ -0,0 +1,205 @@
+#include "light_clusters.h"
+#include "core/profiler.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <cmath>
+
+namespace smol
+{
+	static_assert(LightClusters::c_gridX % 4 == 0, "Clusters are tested 4 at a time along x");
+
+	// tile containing a normalised device coordinate, clamped to the grid
+	inline uint32_t TileFromNdc(float ndc, uint32_t gridSize)
+	{
+		const float tile = (std::min(std::max(ndc, -1.0f), 1.0f) * 0.5f + 0.5f) * gridSize;
+		return std::min(static_cast<uint32_t>(tile), gridSize - 1);
+	}
+
+	void LightClusters::SetProjection(const glm::mat4& projection, float nearPlane, float farPlane)
+	{
+		if (projection == m_projection && nearPlane == m_nearPlane && farPlane == m_farPlane)
+		{
+			return;
+		}
+		SDE_PROF_EVENT();
+		m_projection = projection;
+		m_nearPlane = nearPlane;
+		m_farPlane = farPlane;
+		m_sliceScale = c_gridZ / std::log(farPlane / nearPlane);
+		m_sliceBias = -std::log(nearPlane) * m_sliceScale;
+
+		// view looks down -z, a view-space point at depth d projects to ndc = x * scale / d
+		const float scaleX = projection[0][0];
+		const float scaleY = projection[1][1];
+		m_minX.resize(c_clusterCount);	m_minY.resize(c_clusterCount);	m_minZ.resize(c_clusterCount);
+		m_maxX.resize(c_clusterCount);	m_maxY.resize(c_clusterCount);	m_maxZ.resize(c_clusterCount);
+		for (uint32_t z = 0; z < c_gridZ; ++z)
+		{
+			const float depth0 = nearPlane * std::pow(farPlane / nearPlane, (float)z / c_gridZ);
+			const float depth1 = nearPlane * std::pow(farPlane / nearPlane, (float)(z + 1) / c_gridZ);
+			for (uint32_t y = 0; y < c_gridY; ++y)
+			{
+				const float ndcY0 = -1.0f + 2.0f * y / c_gridY;
+				const float ndcY1 = -1.0f + 2.0f * (y + 1) / c_gridY;
+				for (uint32_t x = 0; x < c_gridX; ++x)
+				{
+					const float ndcX0 = -1.0f + 2.0f * x / c_gridX;
+					const float ndcX1 = -1.0f + 2.0f * (x + 1) / c_gridX;
+					const uint32_t c = (z * c_gridY + y) * c_gridX + x;
+					m_minX[c] = std::min(ndcX0 * depth0, ndcX0 * depth1) / scaleX;
+					m_maxX[c] = std::max(ndcX1 * depth0, ndcX1 * depth1) / scaleX;
+					m_minY[c] = std::min(ndcY0 * depth0, ndcY0 * depth1) / scaleY;
+					m_maxY[c] = std::max(ndcY1 * depth0, ndcY1 * depth1) / scaleY;
+					m_minZ[c] = -depth1;
+					m_maxZ[c] = -depth0;
+				}
+			}
+		}
+	}
+
+	void LightClusters::Begin(const glm::mat4& view, const glm::vec4* lights, uint32_t lightCount, uint32_t firstLightIndex)
+	{
+		m_view = view;
+		m_frustum = Math::Frustum(m_projection * view);
+		m_lights = lights;
+		m_lightCount = lightCount;
+		m_firstLightIndex = firstLightIndex;
+		if (m_chunkAssignments.size() < ChunkCount())
+		{
+			m_chunkAssignments.resize(ChunkCount());
+		}
+	}
+
+	uint32_t LightClusters::DepthSlice(float viewDepth) const
+	{
+		const float slice = std::log(viewDepth) * m_sliceScale + m_sliceBias;
+		return std::min(static_cast<uint32_t>(std::max(slice, 0.0f)), c_gridZ - 1);
+	}
+
+	void LightClusters::AssignChunk(uint32_t chunk)
+	{
+		SDE_PROF_EVENT();
+		auto& assignments = m_chunkAssignments[chunk];
+		assignments.clear();
+		const uint32_t first = chunk * c_lightsPerChunk;
+		const uint32_t last = std::min(first + c_lightsPerChunk, m_lightCount);
+		for (uint32_t i = first; i < last; i += 4)
+		{
+			// reject lights outside the frustum 4 at a time, anything past the end is padded with the last light
+			const glm::vec4* l[4];
+			for (uint32_t b = 0; b < 4; ++b)
+			{
+				l[b] = &m_lights[std::min(i + b, last - 1)];
+			}
+			Math::Sphere4 spheres;
+			spheres.m_centerX = _mm_set_ps(l[3]->x, l[2]->x, l[1]->x, l[0]->x);
+			spheres.m_centerY = _mm_set_ps(l[3]->y, l[2]->y, l[1]->y, l[0]->y);
+			spheres.m_centerZ = _mm_set_ps(l[3]->z, l[2]->z, l[1]->z, l[0]->z);
+			spheres.m_radius = _mm_set_ps(l[3]->w, l[2]->w, l[1]->w, l[0]->w);
+			const uint32_t visibleMask = m_frustum.AreSpheresVisible(spheres);
+			const uint32_t batchCount = std::min(4u, last - i);
+			for (uint32_t b = 0; b < batchCount; ++b)
+			{
+				if (visibleMask & (1 << b))
+				{
+					AssignLight(i + b, assignments);
+				}
+			}
+		}
+	}
+
+	void LightClusters::AssignLight(uint32_t light, std::vector<uint64_t>& assignments) const
+	{
+		const glm::vec4& l = m_lights[light];
+		const glm::vec3 center = glm::vec3(m_view * glm::vec4(l.x, l.y, l.z, 1.0f));
+		const float radius = l.w;
+		const float depthMin = std::max(-center.z - radius, m_nearPlane);
+		const float depthMax = std::min(-center.z + radius, m_farPlane);
+		if (depthMin > depthMax)
+		{
+			return;
+		}
+
+		// conservative tile range, each edge of the view-space box is projected at the depth that widens it most
+		const float scaleX = m_projection[0][0];
+		const float scaleY = m_projection[1][1];
+		const float minX = center.x - radius, maxX = center.x + radius;
+		const float minY = center.y - radius, maxY = center.y + radius;
+		const uint32_t x0 = TileFromNdc(minX * scaleX / (minX < 0.0f ? depthMin : depthMax), c_gridX);
+		const uint32_t x1 = TileFromNdc(maxX * scaleX / (maxX > 0.0f ? depthMin : depthMax), c_gridX);
+		const uint32_t y0 = TileFromNdc(minY * scaleY / (minY < 0.0f ? depthMin : depthMax), c_gridY);
+		const uint32_t y1 = TileFromNdc(maxY * scaleY / (maxY > 0.0f ? depthMin : depthMax), c_gridY);
+		const uint32_t z0 = DepthSlice(depthMin);
+		const uint32_t z1 = DepthSlice(depthMax);
+
+		// sphere vs box, 4 clusters at a time
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+		const __m128 radiusSq = _mm_set1_ps(radius * radius);
+		const uint32_t lightIndex = m_firstLightIndex + light;
+		for (uint32_t z = z0; z <= z1; ++z)
+		{
+			for (uint32_t y = y0; y <= y1; ++y)
+			{
+				const uint32_t row = (z * c_gridY + y) * c_gridX;
+				for (uint32_t x = x0 & ~3u; x <= x1; x += 4)
+				{
+					const uint32_t c = row + x;
+					const __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minX[c]), cx), zero), _mm_max_ps(_mm_sub_ps(cx, _mm_loadu_ps(&m_maxX[c])), zero));
+					const __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minY[c]), cy), zero), _mm_max_ps(_mm_sub_ps(cy, _mm_loadu_ps(&m_maxY[c])), zero));
+					const __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minZ[c]), cz), zero), _mm_max_ps(_mm_sub_ps(cz, _mm_loadu_ps(&m_maxZ[c])), zero));
+					const __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+					const uint32_t touching = _mm_movemask_ps(_mm_cmple_ps(distanceSq, radiusSq));
+					for (uint32_t b = 0; b < 4; ++b)
+					{
+						if ((touching & (1 << b)) && x + b >= x0 && x + b <= x1)
+						{
+							assignments.push_back(((uint64_t)(c + b) << 32) | lightIndex);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	uint32_t LightClusters::Finish(uint32_t maxIndices)
+	{
+		SDE_PROF_EVENT();
+		const uint32_t chunkCount = ChunkCount();
+		m_clusters.assign(c_clusterCount, { 0, 0 });
+		for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+		{
+			for (uint64_t a : m_chunkAssignments[chunk])
+			{
+				m_clusters[a >> 32].m_lightCount++;
+			}
+		}
+
+		// clusters that don't fit are cut short
+		uint32_t totalIndices = 0;
+		uint32_t droppedIndices = 0;
+		for (auto& c : m_clusters)
+		{
+			const uint32_t fits = std::min(c.m_lightCount, maxIndices - totalIndices);
+			droppedIndices += c.m_lightCount - fits;
+			c = { totalIndices, fits };
+			totalIndices += fits;
+		}
+
+		// chunks are in light order, so each list is too
+		m_lightIndices.resize(totalIndices);
+		m_clusterWriteCounts.assign(c_clusterCount, 0);
+		for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+		{
+			for (uint64_t a : m_chunkAssignments[chunk])
+			{
+				const uint32_t c = static_cast<uint32_t>(a >> 32);
+				if (m_clusterWriteCounts[c] < m_clusters[c].m_lightCount)
+				{
+					m_lightIndices[m_clusters[c].m_firstIndex + m_clusterWriteCounts[c]++] = static_cast<uint32_t>(a);
+				}
+			}
+		}
+		return droppedIndices;
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "math/glm_headers.h"
+#include "math/frustum.h"
+#include <vector>
+
+namespace smol
+{
+	// Froxel grid over the camera frustum, each cluster lists the point lights that touch it
+	// Slices are exponential in view depth so clusters stay roughly cubic
+	// Assignment only reads the lights passed to Begin, chunks of lights can be assigned on any thread before Finish
+	class LightClusters
+	{
+	public:
+		static const uint32_t c_gridX = 16;		// must match CLUSTER_GRID_* in global_uniforms.h
+		static const uint32_t c_gridY = 9;
+		static const uint32_t c_gridZ = 24;
+		static const uint32_t c_clusterCount = c_gridX * c_gridY * c_gridZ;
+		static const uint32_t c_lightsPerChunk = 256;
+
+		struct Cluster
+		{
+			uint32_t m_firstIndex;		// into the light index list
+			uint32_t m_lightCount;
+		};
+
+		// cluster bounds are only rebuilt when the projection changes
+		void SetProjection(const glm::mat4& projection, float nearPlane, float farPlane);
+
+		// lights = world-space position + radius, the indices written to the lists start at firstLightIndex
+		void Begin(const glm::mat4& view, const glm::vec4* lights, uint32_t lightCount, uint32_t firstLightIndex);
+		uint32_t ChunkCount() const { return (m_lightCount + c_lightsPerChunk - 1) / c_lightsPerChunk; }
+		void AssignChunk(uint32_t chunk);
+		uint32_t Finish(uint32_t maxIndices);	// builds the cluster lists, returns how many indices did not fit
+
+		const std::vector<Cluster>& Clusters() const { return m_clusters; }
+		const std::vector<uint32_t>& LightIndices() const { return m_lightIndices; }
+		glm::vec2 GetDepthSliceParams() const { return { m_sliceScale, m_sliceBias }; }	// slice = log(view depth) * x + y
+
+	private:
+		uint32_t DepthSlice(float viewDepth) const;
+		void AssignLight(uint32_t light, std::vector<uint64_t>& assignments) const;
+
+		// view-space bounds of each cluster, x fastest so 4 neighbouring clusters are tested at once
+		std::vector<float> m_minX, m_minY, m_minZ;
+		std::vector<float> m_maxX, m_maxY, m_maxZ;
+		glm::mat4 m_projection = glm::mat4(0.0f);
+		float m_nearPlane = 0.0f;
+		float m_farPlane = 0.0f;
+		float m_sliceScale = 0.0f;
+		float m_sliceBias = 0.0f;
+
+		glm::mat4 m_view;
+		Math::Frustum m_frustum;			// world space
+		const glm::vec4* m_lights = nullptr;
+		uint32_t m_lightCount = 0;
+		uint32_t m_firstLightIndex = 0;
+		std::vector<std::vector<uint64_t>> m_chunkAssignments;	// cluster << 32 | light index, per chunk
+		std::vector<uint32_t> m_clusterWriteCounts;
+		std::vector<Cluster> m_clusters;
+		std::vector<uint32_t> m_lightIndices;
+	};
+}
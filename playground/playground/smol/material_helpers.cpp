@@ -8,32 +8,29 @@ namespace smol
 {
 	uint32_t ApplyMaterial(Render::Device& d, Render::ShaderProgram& shader, const Render::Material& material, TextureManager& tm, const DefaultTextures& defaults, uint32_t textureUnit)
 	{
-		const auto& uniforms = material.GetUniforms();
-		uniforms.Apply(d, shader);
+		// uniform locations are resolved once per material + shader
+		const auto& compiled = material.Compile(shader);
+		compiled.m_uniforms.Apply(d);
 
-		const auto& samplers = material.GetSamplers();
-		for (const auto& s : samplers)
+		for (const auto& s : compiled.m_samplers)
 		{
-			uint32_t uniformHandle = shader.GetUniformHandle(s.second.m_name.c_str());
-			if (uniformHandle != -1)
+			TextureHandle texHandle = { s.m_handle };
+			const auto theTexture = tm.GetTexture({ texHandle });
+			if (theTexture)
 			{
-				TextureHandle texHandle = { static_cast<uint16_t>(s.second.m_handle) };
-				const auto theTexture = tm.GetTexture({ texHandle });
-				if (theTexture)
-				{
-					d.SetSampler(uniformHandle, theTexture->GetHandle(), textureUnit++);
-				}
-				else
+				d.SetSampler(s.m_location, theTexture->GetHandle(), textureUnit++);
+			}
+			else
+			{
+				// set default if one exists
+				const auto& sampler = material.GetSamplers().find(s.m_nameHash);
+				auto foundDefault = defaults.find(sampler->second.m_name);
+				if (foundDefault != defaults.end())
 				{
-					// set default if one exists
-					auto foundDefault = defaults.find(s.second.m_name.c_str());
-					if (foundDefault != defaults.end())
+					const auto defaultTexture = tm.GetTexture({ foundDefault->second });
+					if (defaultTexture != nullptr)
 					{
-						const auto defaultTexture = tm.GetTexture({ foundDefault->second });
-						if (defaultTexture != nullptr)
-						{
-							d.SetSampler(uniformHandle, defaultTexture->GetHandle(), textureUnit++);
-						}
+						d.SetSampler(s.m_location, defaultTexture->GetHandle(), textureUnit++);
 					}
 				}
 			}
@@ -0,0 +1,74 @@
+#include "material_table.h"
+#include "kernel/assert.h"
+#include "kernel/log.h"
+#include <string.h>
+#include <stddef.h>
+
+namespace smol
+{
+	// must match MaterialInfo in data/material_table.h
+	static_assert(sizeof(MaterialTable::Entry) == 48, "Material entries must match the std430 array stride");
+	static_assert(offsetof(MaterialTable::Entry, m_diffuseOpacity) == 0, "Material table layout must match the shaders");
+	static_assert(offsetof(MaterialTable::Entry, m_specular) == 16, "Material table layout must match the shaders");
+	static_assert(offsetof(MaterialTable::Entry, m_shininess) == 32, "Material table layout must match the shaders");
+
+	uint64_t MaterialTable::HashEntry(const Entry& entry)
+	{
+		uint64_t hash = 0;
+		const uint32_t* words = reinterpret_cast<const uint32_t*>(&entry);
+		for (size_t w = 0; w < sizeof(Entry) / sizeof(uint32_t); ++w)
+		{
+			hash = Core::FlatHashMix(hash ^ words[w]);
+		}
+		return hash;
+	}
+
+	MaterialTable::MaterialTable(uint32_t maxEntries, HashFn hashFn)
+		: m_hashFn(hashFn)
+		, m_maxEntries(maxEntries)
+	{
+		SDE_ASSERT(maxEntries > 0);
+		m_entries.reserve(maxEntries);
+		Add(glm::vec4(1.0f), glm::vec4(0.0f), 1.0f);
+	}
+
+	uint32_t MaterialTable::Add(const glm::vec4& diffuseOpacity, const glm::vec4& specular, float shininess)
+	{
+		Entry newEntry = { diffuseOpacity, specular, shininess, { 0.0f, 0.0f, 0.0f } };
+		const uint64_t hash = m_hashFn(newEntry);
+
+		// collisions just get their own entry
+		auto found = m_entryLookup.find(hash);
+		if (found != m_entryLookup.end() && memcmp(&m_entries[found->second], &newEntry, sizeof(Entry)) == 0)
+		{
+			return found->second;
+		}
+		if (m_entries.size() >= m_maxEntries)
+		{
+			SDE_LOG("Material table is full (%d entries), using the default material", m_maxEntries);
+			return 0;
+		}
+
+		const uint32_t index = static_cast<uint32_t>(m_entries.size());
+		m_entries.push_back(newEntry);
+		if (found == m_entryLookup.end())
+		{
+			m_entryLookup.insert({ hash, index });
+		}
+		m_dirtyFirst = HasDirtyRange() ? m_dirtyFirst : index;
+		m_dirtyEnd = index + 1;
+		return index;
+	}
+
+	void MaterialTable::MarkAllDirty()
+	{
+		m_dirtyFirst = 0;
+		m_dirtyEnd = Count();
+	}
+
+	void MaterialTable::ClearDirty()
+	{
+		m_dirtyFirst = 0;
+		m_dirtyEnd = 0;
+	}
+}
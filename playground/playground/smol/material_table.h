@@ -0,0 +1,52 @@
+#pragma once
+#include "math/glm_headers.h"
+#include "core/flat_hash_map.h"
+#include <vector>
+
+namespace smol
+{
+	// CPU side copy of the material constants, drawn with by index (see data/material_table.h)
+	// Entries are laid out as std430 so the table can be copied straight into a storage buffer
+	// Identical materials share an entry. Entries are never removed; reloaded models produce the same values so
+	// they map back to the same entries. Index 0 is the default material. Main thread only
+	class MaterialTable
+	{
+	public:
+		struct Entry
+		{
+			glm::vec4 m_diffuseOpacity;
+			glm::vec4 m_specular;		// rgb, strength
+			float m_shininess;
+			float m_padding[3];			// struct array strides round up to the vec4 alignment
+		};
+
+		// the hash only picks which entry to compare against, tests pass a weak one to force collisions
+		using HashFn = uint64_t(*)(const Entry& entry);
+		static uint64_t HashEntry(const Entry& entry);
+
+		MaterialTable(uint32_t maxEntries, HashFn hashFn = &HashEntry);
+		MaterialTable(const MaterialTable&) = delete;
+		MaterialTable(MaterialTable&&) = delete;
+		~MaterialTable() = default;
+
+		uint32_t Add(const glm::vec4& diffuseOpacity, const glm::vec4& specular, float shininess);	// returns 0 if the table is full
+
+		const Entry* Data() const { return m_entries.data(); }
+		uint32_t Count() const { return static_cast<uint32_t>(m_entries.size()); }
+		uint32_t MaxCount() const { return m_maxEntries; }
+
+		bool HasDirtyRange() const { return m_dirtyFirst < m_dirtyEnd; }
+		uint32_t DirtyFirst() const { return m_dirtyFirst; }
+		uint32_t DirtyEnd() const { return m_dirtyEnd; }
+		void MarkAllDirty();
+		void ClearDirty();
+
+	private:
+		std::vector<Entry> m_entries;
+		Core::FlatHashMap<uint64_t, uint32_t> m_entryLookup;	// hash of the values -> first entry with them
+		HashFn m_hashFn;
+		uint32_t m_maxEntries = 0;
+		uint32_t m_dirtyFirst = 0;
+		uint32_t m_dirtyEnd = 0;
+	};
+}
@@ -16,7 +16,11 @@ namespace smol
 		glm::mat4 m_transform;
 		glm::vec4 m_colour;
 		smol::ShaderHandle m_shader;
+		uint32_t m_materialId;			// see Model::GetMaterialId, only used for sorting
+		uint32_t m_materialIndex;		// into the material table
 		const Render::Mesh* m_mesh;
-		float m_distanceToCamera;
+		uint32_t m_lod;					// level of detail drawn, see Render::Mesh::GetLodChunks
+		glm::vec3 m_boundsCenter;		// world-space bounds for culling
+		glm::vec3 m_boundsExtents;
 	};
 }
\ No newline at end of file
@@ -4,9 +4,50 @@
 #include "render/mesh.h"
 #include "renderer.h"
 #include "core/profiler.h"
+#include "core/string_hashing.h"
+#include "core/flat_hash_map.h"
 
 namespace smol
 {
+	uint32_t Model::CalculatePartFlags(const Render::Mesh& mesh, TextureManager& tm)
+	{
+		const uint32_t c_diffuseSampler = Core::StringHashing::GetHash("DiffuseTexture");
+		uint32_t flags = c_partCastsShadows;
+		uint64_t materialHash = 0;
+		const auto& samplers = mesh.GetMaterial().GetSamplers();
+		for (const auto& sampler : samplers)
+		{
+			// order independent, the hash map iteration order is not stable
+			materialHash += Core::FlatHashMix(((uint64_t)sampler.first << 32) | sampler.second.m_handle);
+		}
+		const auto& diffuseSampler = samplers.find(c_diffuseSampler);
+		if (diffuseSampler != samplers.end())
+		{
+			const auto theTexture = tm.GetTexture({ diffuseSampler->second.m_handle });
+			if (theTexture && theTexture->GetComponentCount() == 4)
+			{
+				flags |= c_partTransparent;
+			}
+		}
+		return flags | (static_cast<uint32_t>(materialHash) << c_partMaterialShift);
+	}
+
+	bool Model::UpdatePartFlags(TextureManager& tm)
+	{
+		bool changed = false;
+		for (auto& part : m_parts)
+		{
+			const uint32_t newFlags = part.m_mesh != nullptr ? CalculatePartFlags(*part.m_mesh, tm) : 0;
+			changed |= newFlags != part.m_flags;
+			part.m_flags = newFlags;
+		}
+		if (changed)
+		{
+			++m_flagsVersion;
+		}
+		return changed;
+	}
+
 	std::unique_ptr<Model> Model::CreateFromAsset(const Assets::Model& m, TextureManager& tm)
 	{
 		char debugName[1024] = { '\0' };
@@ -19,29 +60,33 @@ namespace smol
 		{
 			SDE_PROF_EVENT("BuildMesh");
 			Render::MeshBuilder builder;
-			builder.AddVertexStream(3, mesh.Indices().size());		// position
-			builder.AddVertexStream(3, mesh.Indices().size());		// normal
-			builder.AddVertexStream(3, mesh.Indices().size());		// tangents
-			builder.AddVertexStream(2, mesh.Indices().size());		// uv
-			builder.BeginChunk();
 			const auto& vertices = mesh.Vertices();
 			const auto& indices = mesh.Indices();
+			builder.AddVertexStream(3, vertices.size() * 3, Render::VertexStreamEncoding::BoundedSnorm16);		// position
+			builder.AddVertexStream(3, vertices.size() * 3, Render::VertexStreamEncoding::OctahedralSnorm16);	// normal
+			builder.AddVertexStream(3, vertices.size() * 3, Render::VertexStreamEncoding::OctahedralSnorm16);	// tangents
+			builder.AddVertexStream(2, vertices.size() * 2, Render::VertexStreamEncoding::HalfFloat);			// uv
+			builder.SetBufferLayout(Render::VertexBufferLayout::InterleavedSplitPosition);
+			builder.BeginChunk();
 			{
+				// assimp already joined identical vertices, keep them shared
 				SDE_PROF_EVENT("SetStreamData");
+				for (const auto& v : vertices)
+				{
+					builder.SetVertexData(0, v.m_position);
+					builder.SetVertexData(1, v.m_normal);
+					builder.SetVertexData(2, v.m_tangent);
+					builder.SetVertexData(3, v.m_texCoord0);
+					builder.EndVertex();
+				}
 				for (uint32_t index = 0; index < indices.size(); index += 3)
 				{
-					const auto& v0 = vertices[indices[index]];
-					const auto& v1 = vertices[indices[index + 1]];
-					const auto& v2 = vertices[indices[index + 2]];
-					builder.BeginTriangle();
-					builder.SetStreamData(0, v0.m_position, v1.m_position, v2.m_position);
-					builder.SetStreamData(1, v0.m_normal, v1.m_normal, v2.m_normal);
-					builder.SetStreamData(2, v0.m_tangent, v1.m_tangent, v2.m_tangent);
-					builder.SetStreamData(3, v0.m_texCoord0, v1.m_texCoord0, v2.m_texCoord0);
-					builder.EndTriangle();
+					builder.AddTriangleIndices(indices[index], indices[index + 1], indices[index + 2]);
 				}
 			}
 			builder.EndChunk();
+			builder.Optimise(0);
+			builder.GenerateLods(0, c_lodCount);
 
 			auto newMesh = std::make_unique<Render::Mesh>();
 			builder.CreateMesh(*newMesh);
@@ -54,8 +99,10 @@ namespace smol
 			material.SetSampler("DiffuseTexture", tm.LoadTexture(diffusePath.c_str()).m_index);
 			material.SetSampler("NormalsTexture", tm.LoadTexture(normalPath.c_str()).m_index);
 			material.SetSampler("SpecularTexture", tm.LoadTexture(specPath.c_str()).m_index);
-			resultModel->m_parts.push_back({ std::move(newMesh), mesh.Transform(), mesh.Bounds() });
+			const glm::mat4 partTransform = mesh.Transform() * PositionDecodeTransform(builder.GetStreamDecode(0));
+			resultModel->m_parts.push_back({ std::move(newMesh), partTransform, mesh.Bounds() });
 		}
+		resultModel->UpdatePartFlags(tm);
 		return resultModel;
 	}
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "math/glm_headers.h"
 #include "math/box3.h"
 #include "texture_manager.h"
+#include "core/small_vector.h"
 #include <memory>
 
 namespace Render
@@ -25,15 +26,39 @@ namespace smol
 
 		static std::unique_ptr<Model> CreateFromAsset(const Assets::Model& src, TextureManager& tm);
 
+		// Per-part flags, cached so submission only needs bit tests
+		static const uint32_t c_partTransparent = 1 << 0;		// diffuse texture has alpha
+		static const uint32_t c_partCastsShadows = 1 << 1;
+		static const uint32_t c_partMaterialShift = 8;			// material id (hash of the samplers) in the top 24 bits
+		static uint32_t CalculatePartFlags(const Render::Mesh& mesh, TextureManager& tm);
+		static uint32_t GetMaterialId(uint32_t partFlags) { return partFlags >> c_partMaterialShift; }
+
+		// Parts get the full mesh + up to 3 simplified levels, picked per instance by screen-space error
+		static const uint32_t c_lodCount = 4;
+
+		// Part positions are quantised, the decode (offset + uniform scale) is folded into the part transform
+		static glm::mat4 PositionDecodeTransform(const glm::vec4& decode)
+		{
+			return glm::scale(glm::translate(glm::identity<glm::mat4>(), glm::vec3(decode)), glm::vec3(decode.w));
+		}
+
 		struct Part
 		{
 			std::unique_ptr<Render::Mesh> m_mesh;
-			glm::mat4 m_transform;
+			glm::mat4 m_transform;				// includes the position decode
 			Math::Box3 m_bounds;
+			uint32_t m_flags = 0;
+			uint32_t m_materialIndex = 0;		// into the model manager material table
 		};
-		const std::vector<Part>& Parts() const { return m_parts; }
-		std::vector<Part>& Parts() { return m_parts; }
+		using PartList = Core::SmallVector<Part, 4>;
+		const PartList& Parts() const { return m_parts; }
+		PartList& Parts() { return m_parts; }
+
+		// Recalculates the part flags, returns true and bumps the version if any changed. Main thread only
+		bool UpdatePartFlags(TextureManager& tm);
+		uint32_t GetFlagsVersion() const { return m_flagsVersion; }
 	private:
-		std::vector<Part> m_parts;
+		PartList m_parts;
+		uint32_t m_flagsVersion = 0;
 	};
 }
\ No newline at end of file
@@ -4,15 +4,16 @@
 #include "sde/job_system.h"
 #include "kernel/assert.h"
 #include "core/profiler.h"
-#include "core/scoped_mutex.h"
-#include "kernel/thread.h"
 #include "debug_gui/debug_gui_system.h"
 #include "render/device.h"
 
 namespace smol
 {
+	const uint32_t c_maxMaterials = 1024;	// 48k storage buffer, see data/material_table.h
+
 	ModelManager::ModelManager(TextureManager* tm, SDE::JobSystem* js)
-		: m_textureManager(tm)
+		: m_materials(c_maxMaterials)
+		, m_textureManager(tm)
 		, m_jobSystem(js)
 	{
 	}
@@ -25,9 +26,14 @@ namespace smol
 		sprintf_s(text, "Loading: %d", m_inFlightModels.Get());
 		gui.Text(text);
 		gui.Separator();
-		for (int t = 0; t < m_models.size(); ++t)
+		for (int t = 0; t < m_models.Size(); ++t)
 		{
-			sprintf_s(text, "%d: %s (0x%p)", t, m_models[t].m_name.c_str(), m_models[t].m_model.get());
+			const auto& desc = m_models.ValueAt(t);
+			sprintf_s(text, "%d: %s (0x%p)", t, desc.m_name.c_str(), desc.m_model.get());
+			gui.Text(text);
+			const auto& before = desc.m_optimiseStats.m_before;
+			const auto& after = desc.m_optimiseStats.m_after;
+			sprintf_s(text, "\tACMR %.3f -> %.3f, ATVR %.3f -> %.3f", before.ACMR(), after.ACMR(), before.ATVR(), after.ATVR());
 			gui.Text(text);
 		}
 		gui.EndWindow();
@@ -38,24 +44,50 @@ namespace smol
 	{
 		SDE_PROF_EVENT();
 
-		// wait until all jobs finish, not great but eh
-		while (m_inFlightModels.Get() > 0)
+		// load the models again in place, anything still in flight is out of date and gets dropped when it arrives
+		for (int m = 0; m < m_models.Size(); ++m)
 		{
-			int v = m_inFlightModels.Get();
-			Kernel::Thread::Sleep(1);
+			auto& desc = m_models.ValueAt(m);
+			if (desc.m_model != nullptr)
+			{
+				m_retiredModels.push_back(std::move(desc.m_model));
+			}
+			LoadModelAsync(desc.m_name, { m_models.HandleAt(m) });
 		}
-		// clear out the old results
+	}
+
+	bool ModelManager::TakeRetiredModels(std::vector<std::unique_ptr<Model>>& target)
+	{
+		if (m_retiredModels.size() == 0)
 		{
-			Core::ScopedMutex lock(m_loadedModelsMutex);
-			m_loadedModels.clear();
+			return false;
 		}
-		// now load the models again
-		auto currentModels = std::move(m_models);
-		for (int m = 0; m < currentModels.size(); ++m)
+		for (auto& model : m_retiredModels)
 		{
-			auto newHandle = LoadModel(currentModels[m].m_name.c_str());
-			SDE_ASSERT(m == newHandle.m_index, "Bum");
+			target.push_back(std::move(model));
 		}
+		m_retiredModels.clear();
+		return true;
+	}
+
+	bool ModelManager::UpdatePartFlags()
+	{
+		SDE_PROF_EVENT();
+		if (m_textureGeneration == m_textureManager->GetGeneration())
+		{
+			return false;
+		}
+		m_textureGeneration = m_textureManager->GetGeneration();
+		bool changed = false;
+		for (int m = 0; m < m_models.Size(); ++m)
+		{
+			auto& desc = m_models.ValueAt(m);
+			if (desc.m_model != nullptr)
+			{
+				changed |= desc.m_model->UpdatePartFlags(*m_textureManager);
+			}
+		}
+		return changed;
 	}
 
 	// this must be called on main thread before rendering!
@@ -79,10 +111,18 @@ namespace smol
 				material.SetSampler("NormalsTexture", m_textureManager->LoadTexture(normalPath.c_str()).m_index);
 				material.SetSampler("SpecularTexture", m_textureManager->LoadTexture(specPath.c_str()).m_index);
 
+				// material constants live in the shared table
+				const auto packedSpecular = glm::vec4(mat.SpecularColour(), mat.ShininessStrength());
+				const auto diffuseOpacity = glm::vec4(mat.DiffuseColour(), mat.Opacity());
+				renderModel.Parts()[index].m_materialIndex = m_materials.Add(diffuseOpacity, packedSpecular, mat.Shininess());
+
 				// Create render resources that cannot be shared across contexts
 				meshBuilders[index]->CreateVertexArray(*renderModel.Parts()[index].m_mesh);
 			}
 		}
+
+		// textures may still be loading, UpdatePartFlags catches them when they arrive
+		renderModel.UpdatePartFlags(*m_textureManager);
 	}
 
 	std::unique_ptr<Model> ModelManager::CreateModel(Assets::Model& model, const std::vector<std::unique_ptr<Render::MeshBuilder>>& meshBuilders)
@@ -102,17 +142,9 @@ namespace smol
 			auto newMesh = std::make_unique<Render::Mesh>();
 			meshBuilders[index]->CreateMesh(*newMesh);
 
-			// materials pushed to uniform buffers
-			const auto& mat = mesh.Material();
-			auto& uniforms = newMesh->GetMaterial().GetUniforms();
-			auto packedSpecular = glm::vec4(mat.SpecularColour(), mat.ShininessStrength());
-			uniforms.SetValue("MeshDiffuseOpacity", glm::vec4(mat.DiffuseColour(), mat.Opacity()));
-			uniforms.SetValue("MeshSpecular", packedSpecular);
-			uniforms.SetValue("MeshShininess", mat.Shininess());
-
 			Model::Part newPart;
 			newPart.m_mesh = std::move(newMesh);
-			newPart.m_transform = mesh.Transform();
+			newPart.m_transform = mesh.Transform() * Model::PositionDecodeTransform(meshBuilders[index]->GetStreamDecode(0));
 			newPart.m_bounds = mesh.Bounds();
 			resultModel->Parts().push_back(std::move(newPart));
 		}
@@ -123,104 +155,106 @@ namespace smol
 		return resultModel;
 	}
 
-	void ModelManager::ProcessLoadedModels()
+	// called on the main thread once the load job completes
+	void ModelManager::ProcessLoadedModel(ModelLoadResult& loadedModel)
 	{
 		SDE_PROF_EVENT();
-		
-		std::vector<ModelLoadResult> loadedModels;
-		{
-			Core::ScopedMutex lock(m_loadedModelsMutex);
-			loadedModels = std::move(m_loadedModels);
-		}
-
-		for (auto& loadedModel : loadedModels)
+		SDE_ASSERT(loadedModel.m_destinationHandle.m_index != -1, "Bad index");
+		auto desc = m_models.Get(loadedModel.m_destinationHandle.m_index);
+		if (loadedModel.m_renderModel != nullptr && desc != nullptr && desc->m_loadGeneration == loadedModel.m_loadGeneration)
 		{
-			SDE_ASSERT(loadedModel.m_destinationHandle.m_index != -1, "Bad index");
-			if (loadedModel.m_renderModel != nullptr)
-			{
-				FinaliseModel(*loadedModel.m_model, *loadedModel.m_renderModel, loadedModel.m_meshBuilders);
-				m_models[loadedModel.m_destinationHandle.m_index].m_model = std::move(loadedModel.m_renderModel);
-			}
+			FinaliseModel(*loadedModel.m_model, *loadedModel.m_renderModel, loadedModel.m_meshBuilders);
+			desc->m_model = std::move(loadedModel.m_renderModel);
+			desc->m_optimiseStats = loadedModel.m_optimiseStats;
 		}
 	}
 
-	std::unique_ptr<Render::MeshBuilder> ModelManager::CreateBuilderForPart(const Assets::ModelMesh& mesh)
+	// runs on a job thread, including the optimise + lod passes
+	std::unique_ptr<Render::MeshBuilder> ModelManager::CreateBuilderForPart(const Assets::ModelMesh& mesh, Render::MeshBuilder::OptimiseStats& stats)
 	{
 		SDE_PROF_EVENT();
 
 		auto builder = std::make_unique<Render::MeshBuilder>();
-		builder->AddVertexStream(3, mesh.Indices().size());		// position
-		builder->AddVertexStream(3, mesh.Indices().size());		// normal
-		builder->AddVertexStream(3, mesh.Indices().size());		// tangents
-		builder->AddVertexStream(2, mesh.Indices().size());		// uv
-		builder->BeginChunk();
 		const auto& vertices = mesh.Vertices();
 		const auto& indices = mesh.Indices();
+		builder->AddVertexStream(3, vertices.size() * 3, Render::VertexStreamEncoding::BoundedSnorm16);		// position
+		builder->AddVertexStream(3, vertices.size() * 3, Render::VertexStreamEncoding::OctahedralSnorm16);	// normal
+		builder->AddVertexStream(3, vertices.size() * 3, Render::VertexStreamEncoding::OctahedralSnorm16);	// tangents
+		builder->AddVertexStream(2, vertices.size() * 2, Render::VertexStreamEncoding::HalfFloat);			// uv
+		builder->SetBufferLayout(Render::VertexBufferLayout::InterleavedSplitPosition);
+		builder->BeginChunk();
 		{
+			// assimp already joined identical vertices, keep them shared
 			SDE_PROF_EVENT("SetStreamData");
+			for (const auto& v : vertices)
+			{
+				builder->SetVertexData(0, v.m_position);
+				builder->SetVertexData(1, v.m_normal);
+				builder->SetVertexData(2, v.m_tangent);
+				builder->SetVertexData(3, v.m_texCoord0);
+				builder->EndVertex();
+			}
 			for (uint32_t index = 0; index < indices.size(); index += 3)
 			{
-				const auto& v0 = vertices[indices[index]];
-				const auto& v1 = vertices[indices[index + 1]];
-				const auto& v2 = vertices[indices[index + 2]];
-				builder->BeginTriangle();
-				builder->SetStreamData(0, v0.m_position, v1.m_position, v2.m_position);
-				builder->SetStreamData(1, v0.m_normal, v1.m_normal, v2.m_normal);
-				builder->SetStreamData(2, v0.m_tangent, v1.m_tangent, v2.m_tangent);
-				builder->SetStreamData(3, v0.m_texCoord0, v1.m_texCoord0, v2.m_texCoord0);
-				builder->EndTriangle();
+				builder->AddTriangleIndices(indices[index], indices[index + 1], indices[index + 2]);
 			}
 		}
 		builder->EndChunk();
+
+		// assimp triangle order is arbitrary, reorder for the vertex cache + overdraw
+		const auto partStats = builder->Optimise(0);
+		stats.m_before += partStats.m_before;
+		stats.m_after += partStats.m_after;
+		builder->GenerateLods(0, Model::c_lodCount);
 		return builder;
 	}
 
 	ModelHandle ModelManager::LoadModel(const char* path)
 	{
-		for (uint64_t i = 0; i < m_models.size(); ++i)
+		auto foundExisting = m_pathToHandle.find(path);
+		if (foundExisting != m_pathToHandle.end())
 		{
-			if (m_models[i].m_name == path)
-			{
-				return { static_cast<uint16_t>(i) };
-			}
+			return foundExisting->second;
 		}
 
 		// always make a valid handle
-		m_models.push_back({nullptr, path });
-		auto newHandle = ModelHandle{ static_cast<uint16_t>(m_models.size() - 1) };
-		m_inFlightModels.Add(1);
+		auto newHandle = ModelHandle{ m_models.Insert({ nullptr, path }) };
+		m_pathToHandle[path] = newHandle;
+		LoadModelAsync(path, newHandle);
+		
+		return newHandle;
+	}
 
-		std::string pathString = path;
-		m_jobSystem->PushJob([this, pathString, newHandle]() {
-			auto loadedAsset = Assets::Model::Load(pathString.c_str());
-			if (loadedAsset != nullptr)
+	void ModelManager::LoadModelAsync(std::string pathString, ModelHandle newHandle)
+	{
+		auto desc = m_models.Get(newHandle.m_index);
+		SDE_ASSERT(desc != nullptr, "Bad handle");
+		m_inFlightModels.Add(1);
+		auto loadResult = std::make_shared<ModelLoadResult>();	// shared between the job + continuation
+		loadResult->m_destinationHandle = newHandle;
+		loadResult->m_loadGeneration = ++desc->m_loadGeneration;
+		m_jobSystem->PushJob([this, pathString, loadResult]() {
+			loadResult->m_model = Assets::Model::Load(pathString.c_str());
+			if (loadResult->m_model != nullptr)
 			{
-				std::vector<std::unique_ptr<Render::MeshBuilder>> meshBuilders;
-				for (const auto& part : loadedAsset->Meshes())
+				for (const auto& part : loadResult->m_model->Meshes())
 				{
-					meshBuilders.push_back(CreateBuilderForPart(part));
+					loadResult->m_meshBuilders.push_back(CreateBuilderForPart(part, loadResult->m_optimiseStats));
 				}
 
-				auto theModel = CreateModel(*loadedAsset, meshBuilders);	// this does not create VAOs as they cannot be shared across contexts
-
-				Core::ScopedMutex lock(m_loadedModelsMutex);
-				m_loadedModels.push_back({ std::move(loadedAsset), std::move(theModel), std::move(meshBuilders), newHandle });
-				m_inFlightModels.Add(-1);
+				// this does not create VAOs as they cannot be shared across contexts
+				loadResult->m_renderModel = CreateModel(*loadResult->m_model, loadResult->m_meshBuilders);
 			}
+		}, [this, loadResult]() {
+			// the count drops here rather than in the job, the result isn't installed until now
+			m_inFlightModels.Add(-1);
+			ProcessLoadedModel(*loadResult);
 		});
-		
-		return newHandle;
 	}
 
 	Model* ModelManager::GetModel(const ModelHandle& h)
 	{
-		if (h.m_index != -1 && h.m_index < m_models.size())
-		{
-			return m_models[h.m_index].m_model.get();
-		}
-		else
-		{
-			return nullptr;
-		}
+		auto desc = m_models.Get(h.m_index);
+		return desc != nullptr ? desc->m_model.get() : nullptr;
 	}
 }
\ No newline at end of file
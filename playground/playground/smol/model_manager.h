@@ -1,11 +1,14 @@
 #pragma once
 #include "model.h"
-#include "kernel/mutex.h"
+#include "material_table.h"
+#include "kernel/atomics.h"
 #include "../model_asset.h"
 #include "render/mesh_builder.h"
+#include "core/slot_map.h"
 #include <string>
 #include <vector>
 #include <memory>
+#include <unordered_map>
 
 namespace SDE
 {
@@ -23,8 +26,8 @@ namespace smol
 
 	struct ModelHandle
 	{
-		uint16_t m_index = -1;
-		static ModelHandle Invalid() { return { (uint16_t)-1 }; };
+		uint32_t m_index = -1;		// generation + index, see Core::SlotMap
+		static ModelHandle Invalid() { return { (uint32_t)-1 }; };
 	};
 
 	class ModelManager
@@ -37,36 +40,53 @@ namespace smol
 
 		ModelHandle LoadModel(const char* path);
 		Model* GetModel(const ModelHandle& h);
-		void ProcessLoadedModels();
 
 		bool ShowGui(DebugGui::DebugGuiSystem& gui);
 
+		// Old models are retired rather than freed, frames in flight may still be drawing them
 		void ReloadAll();
 
+		// Moves models retired by ReloadAll into target, the caller frees them once no frame can reference them
+		bool TakeRetiredModels(std::vector<std::unique_ptr<Model>>& target);
+
+		// Recalculates cached part flags if any textures changed. Main thread, returns true if any flags changed
+		bool UpdatePartFlags();
+
+		MaterialTable& GetMaterialTable() { return m_materials; }
+
 	private:
+		void LoadModelAsync(std::string path, ModelHandle destination);
+
 		struct ModelDesc 
 		{
 			std::unique_ptr<Model> m_model;
 			std::string m_name;
+			Render::MeshBuilder::OptimiseStats m_optimiseStats;	// vertex cache stats over every part, before + after optimising
+			uint32_t m_loadGeneration;		// bumped whenever a load starts, older results are dropped
 		};
 		struct ModelLoadResult
 		{
 			std::unique_ptr<Assets::Model> m_model;
 			std::unique_ptr<Model> m_renderModel;
 			std::vector<std::unique_ptr<Render::MeshBuilder>> m_meshBuilders;
+			Render::MeshBuilder::OptimiseStats m_optimiseStats;
 			ModelHandle m_destinationHandle;
+			uint32_t m_loadGeneration;
 		};
-		std::unique_ptr<Render::MeshBuilder> CreateBuilderForPart(const Assets::ModelMesh&);
+		std::unique_ptr<Render::MeshBuilder> CreateBuilderForPart(const Assets::ModelMesh&, Render::MeshBuilder::OptimiseStats& stats);
 		std::unique_ptr<Model> CreateModel(Assets::Model& model, const std::vector<std::unique_ptr<Render::MeshBuilder>>& meshBuilders);
 		void FinaliseModel(Assets::Model& model, Model& renderModel, const std::vector<std::unique_ptr<Render::MeshBuilder>>& meshBuilders);
+		void ProcessLoadedModel(ModelLoadResult& loadedModel);
+
+		Core::SlotMap<ModelDesc> m_models;
+		std::unordered_map<std::string, ModelHandle> m_pathToHandle;	// avoids loading the same model twice
+		std::vector<std::unique_ptr<Model>> m_retiredModels;			// replaced by ReloadAll, see TakeRetiredModels
 
-		std::vector<ModelDesc> m_models;
-	
-		Kernel::Mutex m_loadedModelsMutex;
-		std::vector<ModelLoadResult> m_loadedModels;	// models to process after successful load
 		Kernel::AtomicInt32 m_inFlightModels = 0;
 
+		MaterialTable m_materials;
 		TextureManager* m_textureManager;
+		uint32_t m_textureGeneration = 0;		// texture manager generation when the part flags were last updated
 		SDE::JobSystem* m_jobSystem;
 	};
 }
\ No newline at end of file
@@ -3,25 +3,57 @@
 #include "kernel/log.h"
 #include "core/profiler.h"
 #include "core/string_hashing.h"
+#include "core/scoped_mutex.h"
+#include "sde/job_system.h"
 #include "render/shader_program.h"
 #include "render/shader_binary.h"
 #include "render/device.h"
 #include "render/mesh.h"
 #include "render/material.h"
+#include "render/vertex_array.h"
 #include "mesh_instance.h"
 #include "model_manager.h"
 #include "shader_manager.h"
 #include "model.h"
 #include "material_helpers.h"
+#include "shadow_cascades.h"
+#include "shadow_cache.h"
+#include "retained_instance_list.h"
+#include "sort_keys.h"
+#include <glm/gtc/packing.hpp>
 #include <algorithm>
+#include <string.h>
 #include <map>
 
 namespace smol
 {
 	const uint64_t c_maxInstances = 1024 * 128;
-	const uint64_t c_maxLights = 64;
+	const uint64_t c_maxShadowInstances = c_maxInstances * 2;	// casters can be drawn in more than one pass
+	const uint64_t c_maxInstancesPerFrame = c_maxInstances * 2;	// every list + retained uploads share one ring partition
+	const uint32_t c_ringPartitionCount = Renderer::c_maxFrameLatency + 2;	// in flight + being drawn + one the gpu may still be reading
+	const size_t c_uniformBufferAlignment = 256;	// largest GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT in practice
+	const size_t c_storageBufferAlignment = 256;	// same for GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+	const uint64_t c_maxLights = 16 * 1024;
+	const uint32_t c_maxClusterLightIndices = 1024 * 1024;
+	const float c_lightCutoff = 1.0f / 256.0f;		// point lights are clustered out to where they fall below this
+	const float c_maxLightRadius = 10000.0f;		// lights that never fall off reach this far
 	const int c_shadowMapSize = 2048;
 	const int c_cubeShadowMapSize = 512;
+	const uint32_t c_cullChunkSize = 2048;			// instances culled per job
+	const float c_unboundedExtents = 1.0e30f;		// instances without bounds are never culled
+	const float c_staticCasterLodError = 0.005f;	// static shadow caster lod error, relative to the caster bounds size
+	const float c_cameraFOV = 70.0f;
+	const float c_cameraNearPlane = 0.1f;
+	const float c_cameraFarPlane = 1000.0f;
+	const float c_shadowDistance = 400.0f;			// view distance covered by the shadow cascades
+	const float c_cascadeSplitBlend = 0.75f;		// 0 = uniform splits, 1 = logarithmic
+	const float c_cascadeCasterDistance = 500.0f;	// casters this far towards the light from a cascade still cast into it
+	const int c_cascadeMapSize = c_shadowMapSize / 2;	// cascades are packed 2x2 into the shadow map
+	const uint32_t c_shadowPassCount = Renderer::c_shadowCascadeCount + 6;
+	const uint32_t c_firstCascadeShadowPass = 0;
+	const uint32_t c_firstCubeShadowPass = Renderer::c_shadowCascadeCount;		// 6 faces
+	static_assert(Renderer::c_shadowCascadeCount >= 2 && Renderer::c_shadowCascadeCount <= 4, "Cascades must fit in a 2x2 atlas");
+	static_assert(c_shadowPassCount <= 16, "Shadow pass masks are 16 bit");
 
 	struct LightInfo
 	{
@@ -30,29 +62,260 @@ namespace smol
 		glm::vec3 m_attenuation;		// const, linear, quad
 		glm::vec3 m_shadowParams;		// enabled, far plane, index?
 	};
+	static_assert(sizeof(LightInfo) == 64, "Light info layout must match the std430 LightInfo in global_uniforms.h");
 
 	struct GlobalUniforms
 	{
 		glm::mat4 m_viewProjMat;
 		glm::vec4 m_cameraPosition;		// world-space
-		LightInfo m_lights[c_maxLights];
+		glm::vec4 m_clusterDepthParams;	// x = slice scale, y = slice bias, see LightClusters
 		int m_lightCount;
+		int m_directionalLightCount;	// directional lights come first and light everything, point lights are clustered
 		float m_hdrExposure;
 		float m_shadowBias;
 		float m_cubeShadowBias;
+		glm::mat4 m_shadowCascadeMatrices[Renderer::c_shadowCascadeCount];
+		glm::vec4 m_shadowCascadeSplits;	// far view depth of each cascade
 	};
 
+	// A range of a shadow caster draw order, drawn to one shadow map / cube face
+	struct ShadowCasterRange
+	{
+		uint32_t m_firstInstance = 0;
+		uint32_t m_instanceCount = 0;
+		uint64_t m_hash = 0;			// identifies the casters in the range, used to validate cached static shadows
+	};
+
+	struct ShadowPass
+	{
+		glm::mat4 m_lightSpaceMatrix;
+		ShadowCasterRange m_dynamicCasters;
+		ShadowCasterRange m_staticCasters;
+		ShadowCasterRange m_retainedDynamicCasters;
+		ShadowCasterRange m_retainedStaticCasters;
+		uint64_t m_staticCastersHash;		// immediate + retained static casters
+	};
+
+	// FNV-1a over everything that changes how a caster draws
+	// Static caster lods only depend on the instance (see SelectStaticCasterLod), so camera movement keeps their hash
+	uint64_t HashShadowCaster(uint64_t hash, const MeshInstance& i)
+	{
+		const uint32_t* transform = reinterpret_cast<const uint32_t*>(glm::value_ptr(i.m_transform));
+		for (int w = 0; w < 16; ++w)
+		{
+			hash = (hash ^ transform[w]) * 0x100000001b3ull;
+		}
+		hash = (hash ^ reinterpret_cast<uintptr_t>(i.m_mesh)) * 0x100000001b3ull;
+		hash = (hash ^ i.m_lod) * 0x100000001b3ull;
+		hash = (hash ^ i.m_shader.m_index) * 0x100000001b3ull;
+		return hash;
+	}
+
+	// Screen-space error lod selection, the coarsest level whose error covers no more than the allowed pixels at the
+	// closest point of the bounds. lodErrorScale = allowed error per unit of distance, see Renderer::GetLodErrorScale
+	// Lod errors are in mesh units, the largest axis scale of the transform takes them to world space
+	// Instances without bounds are always drawn at full detail
+	inline uint32_t SelectInstanceLod(const MeshInstance& instance, const glm::vec3& cameraPosition, float lodErrorScale)
+	{
+		if (instance.m_mesh->GetLodCount() == 1)
+		{
+			return 0;
+		}
+		const glm::vec3 toBounds = glm::max(glm::abs(cameraPosition - instance.m_boundsCenter) - instance.m_boundsExtents, glm::vec3(0.0f));
+		const glm::mat3 axes(instance.m_transform);
+		const float scale = glm::max(glm::length(axes[0]), glm::max(glm::length(axes[1]), glm::length(axes[2])));
+		return scale > 0.0f ? instance.m_mesh->SelectLod(glm::length(toBounds) * lodErrorScale / scale) : 0;
+	}
+
+	// Static casters are cached in the shadow maps until the light or the casters change, so their lod can't follow
+	// the camera. They allow a fixed error relative to their own size instead, which only changes with the instance
+	inline uint32_t SelectStaticCasterLod(const MeshInstance& instance)
+	{
+		if (instance.m_mesh->GetLodCount() == 1 || instance.m_boundsExtents.x >= c_unboundedExtents)
+		{
+			return 0;
+		}
+		const glm::mat3 axes(instance.m_transform);
+		const float scale = glm::max(glm::length(axes[0]), glm::max(glm::length(axes[1]), glm::length(axes[2])));
+		return scale > 0.0f ? instance.m_mesh->SelectLod(glm::length(instance.m_boundsExtents) * c_staticCasterLodError / scale) : 0;
+	}
+
+	// Instance data written to the ring buffer, to be copied into a persistent buffer before drawing
+	struct InstanceUpload
+	{
+		size_t m_ringOffset = 0;
+		uint32_t m_firstInstance = 0;	// destination
+		uint32_t m_instanceCount = 0;
+	};
+
+	// Retained instances. The main thread owns the handles and resolves models into parts, the render thread owns
+	// the sorted lists. Changes are passed to the render thread as commands with each packet
+	struct Renderer::RetainedScene
+	{
+		enum ListType { Opaque, ShadowCaster, StaticShadowCaster, Transparent, ListCount };	// first c_retainedBufferCount are uploaded
+		enum class CommandType { Create, Update, Destroy };
+		struct Part
+		{
+			glm::mat4 m_partTransform;
+			Math::Box3 m_bounds;				// model space
+			const Render::Mesh* m_mesh;
+			ShaderHandle m_shader;
+			ShaderHandle m_shadowShader;		// invalid if the part casts no shadows
+			uint32_t m_materialId;
+			uint32_t m_materialIndex;
+			bool m_isTransparent;
+		};
+		struct Command
+		{
+			CommandType m_type;
+			uint32_t m_instanceIndex;			// slot map index of the handle
+			glm::mat4 m_transform;
+			glm::vec4 m_colour;
+			uint32_t m_firstPart;				// create only
+			uint32_t m_partCount;
+			bool m_isStatic;
+		};
+		struct CommandList
+		{
+			void Clear() { m_commands.clear(); m_parts.clear(); }
+			std::vector<Command> m_commands;
+			std::vector<Part> m_parts;
+		};
+
+		// main thread
+		struct Instance
+		{
+			glm::mat4 m_transform;
+			glm::vec4 m_colour;
+			ModelHandle m_model;
+			ShaderHandle m_shader;
+			bool m_isStatic;
+			bool m_isCreated;					// false until the model + shader are loaded
+			uint32_t m_modelFlagsVersion;		// part flags the instance was created with
+		};
+		void ResolveAgain(uint32_t handle, Instance& instance)
+		{
+			const uint32_t index = Core::SlotMap<Instance>::GetIndex(handle);
+			m_pendingCommands.m_commands.push_back({ CommandType::Destroy, index, {}, {}, 0, 0, false });
+			m_unresolved.push_back(handle);
+			instance.m_isCreated = false;
+		}
+		Core::SlotMap<Instance> m_instances;
+		std::vector<uint32_t> m_unresolved;		// handles waiting for their model or shader
+		CommandList m_pendingCommands;
+		bool m_needsFullUpload = false;			// set when packets are discarded along with their uploads
+
+		// render thread
+		struct PartInstance
+		{
+			glm::mat4 m_partTransform;
+			Math::Box3 m_bounds;
+			uint32_t m_list;
+			uint32_t m_slot;
+		};
+		std::vector<std::vector<PartInstance>> m_partInstances;	// by slot map index
+		RetainedInstanceList m_lists[ListCount];
+	};
+
+	// Everything needed to draw a single frame. Filled in by the main thread + submission jobs, then handed to the
+	// render thread which merges + sorts the instances and builds the data to upload.
+	// Nothing may touch a packet while it is in flight
+	struct Renderer::FramePacket
+	{
+		void Clear()
+		{
+			for (uint32_t c = 0; c < m_contextsUsed; ++c)
+			{
+				m_contexts[c]->Clear();
+			}
+			m_contextsUsed = 0;
+			m_opaqueInstances.Clear();
+			m_transparentInstances.Clear();
+			m_shadowCasterInstances.Clear();
+			m_staticShadowCasterInstances.Clear();
+			m_lights.clear();
+			m_retainedCommands.Clear();
+			m_retiredModels.clear();
+		}
+		std::vector<std::unique_ptr<SubmissionContext>> m_contexts;	// kept around with the packet so they can be reused
+		uint32_t m_contextsUsed = 0;
+
+		// instances from all contexts, merged on the render thread
+		InstanceList m_opaqueInstances = { &OpaqueSortKey };
+		InstanceList m_transparentInstances = { &TransparentSortKey };
+		InstanceList m_shadowCasterInstances = { &OpaqueSortKey };
+		InstanceList m_staticShadowCasterInstances = { &OpaqueSortKey };
+		std::vector<Light> m_lights;
+		RetainedScene::CommandList m_retainedCommands;
+		bool m_retainedFullUpload = false;
+		std::vector<std::unique_ptr<Model>> m_retiredModels;	// freed once the packet is drawn, older packets + retained instances may use them
+		Render::Camera m_camera;
+		float m_lodErrorScale;				// retained instances pick their lods on the render thread
+		float m_shadowLodErrorScale;
+		glm::vec4 m_clearColour;
+		float m_hdrExposure;
+		float m_shadowBias;
+		float m_cubeShadowBias;
+
+		// outputs of PreparePacket
+		size_t m_instancesCulled = 0;
+		size_t m_retainedInstanceCount = 0;
+		size_t m_retainedOpaqueCount = 0;
+		InstanceList m_retainedInstances[c_retainedBufferCount] = { { &OpaqueSortKey }, { &OpaqueSortKey }, { &OpaqueSortKey } };	// instances copied on change, only dirty data is built
+		uint32_t m_retainedVersions[c_retainedBufferCount] = { (uint32_t)-1, (uint32_t)-1, (uint32_t)-1 };
+		InstanceUpload m_retainedUploads[c_retainedBufferCount];
+		uint32_t m_ringPartition = 0;		// acquired on the main thread before the packet is prepared
+		size_t m_globalsOffset = 0;
+		GlobalUniforms m_globals;
+		int32_t m_shadowLightIndex = -1;
+		int32_t m_cubeShadowLightIndex = -1;
+		glm::mat4 m_viewMatrix;
+		glm::mat4 m_projectionMatrix;
+		size_t m_lightsOffset = 0;			// light info, cluster list + light indices in the lights ring
+		size_t m_lightsSize = 0;
+		size_t m_lightClustersOffset = 0;
+		size_t m_lightIndicesOffset = 0;
+		size_t m_lightIndicesSize = 0;
+		ShadowPass m_shadowPasses[c_shadowPassCount];
+	};
+
+	// Load the bounds of 4 instances in draw order, anything past the end is padded with the last instance
+	Math::Box4 GatherBounds(const MeshInstance* instances, const Core::SortKeyIndex* drawOrder, uint32_t first, uint32_t end)
+	{
+		const MeshInstance* i[4];
+		for (uint32_t b = 0; b < 4; ++b)
+		{
+			i[b] = &instances[drawOrder[std::min(first + b, end - 1)].m_index];
+		}
+		Math::Box4 boxes;
+		boxes.m_centerX = _mm_set_ps(i[3]->m_boundsCenter.x, i[2]->m_boundsCenter.x, i[1]->m_boundsCenter.x, i[0]->m_boundsCenter.x);
+		boxes.m_centerY = _mm_set_ps(i[3]->m_boundsCenter.y, i[2]->m_boundsCenter.y, i[1]->m_boundsCenter.y, i[0]->m_boundsCenter.y);
+		boxes.m_centerZ = _mm_set_ps(i[3]->m_boundsCenter.z, i[2]->m_boundsCenter.z, i[1]->m_boundsCenter.z, i[0]->m_boundsCenter.z);
+		boxes.m_extentsX = _mm_set_ps(i[3]->m_boundsExtents.x, i[2]->m_boundsExtents.x, i[1]->m_boundsExtents.x, i[0]->m_boundsExtents.x);
+		boxes.m_extentsY = _mm_set_ps(i[3]->m_boundsExtents.y, i[2]->m_boundsExtents.y, i[1]->m_boundsExtents.y, i[0]->m_boundsExtents.y);
+		boxes.m_extentsZ = _mm_set_ps(i[3]->m_boundsExtents.z, i[2]->m_boundsExtents.z, i[1]->m_boundsExtents.z, i[0]->m_boundsExtents.z);
+		return boxes;
+	}
+
 	std::map<std::string, TextureHandle> g_defaultTextures;
 	ShaderHandle g_basicBlitShader;
 
-	Renderer::Renderer(TextureManager* ta, ModelManager* mm, ShaderManager* sm, glm::ivec2 windowSize)
+	Renderer::Renderer(TextureManager* ta, ModelManager* mm, ShaderManager* sm, glm::ivec2 windowSize, SDE::JobSystem* js)
 		: m_textures(ta)
 		, m_models(mm)
+		, m_jobSystem(js)
 		, m_shaders(sm)
 		, m_windowSize(windowSize)
 		, m_mainFramebuffer(windowSize)
 		, m_shadowDepthBuffer(glm::ivec2(c_shadowMapSize, c_shadowMapSize))
 		, m_shadowCubeDepthBuffer(glm::ivec2(c_cubeShadowMapSize, c_cubeShadowMapSize))
+		, m_staticShadowDepthBuffer(glm::ivec2(c_shadowMapSize, c_shadowMapSize))
+		, m_staticShadowCubeDepthBuffer(glm::ivec2(c_cubeShadowMapSize, c_cubeShadowMapSize))
+		, m_shadowCache(c_shadowPassCount)
+		, m_currentPacket(std::make_unique<FramePacket>())
+		, m_retainedScene(std::make_unique<RetainedScene>())
+		, m_packetsToPrepare(0)
+		, m_packetsPrepared(0)
 	{
 		g_defaultTextures["DiffuseTexture"] = m_textures->LoadTexture("white.bmp");
 		g_defaultTextures["NormalsTexture"] = m_textures->LoadTexture("default_normalmap.png");
@@ -60,10 +323,18 @@ namespace smol
 		g_basicBlitShader = m_shaders->LoadShader("Basic Blit", "basic_blit.vs", "basic_blit.fs");
 		{
 			SDE_PROF_EVENT("Create Buffers");
-			CreateInstanceList(m_opaqueInstances, c_maxInstances);
-			CreateInstanceList(m_transparentInstances, c_maxInstances);
-			CreateInstanceList(m_shadowCasterInstances, c_maxInstances);
-			m_globalsUniformBuffer.Create(sizeof(GlobalUniforms), Render::RenderBufferType::UniformData, Render::RenderBufferModification::Dynamic, true);
+			m_instanceRing.Create(c_maxInstancesPerFrame * sizeof(InstanceData), c_ringPartitionCount, sizeof(InstanceData), Render::RenderBufferType::VertexData);
+			m_globalsRing.Create(sizeof(GlobalUniforms), c_ringPartitionCount, c_uniformBufferAlignment, Render::RenderBufferType::UniformData);
+			const size_t lightsPartitionSize = c_maxLights * sizeof(LightInfo) + LightClusters::c_clusterCount * sizeof(LightClusters::Cluster)
+				+ c_maxClusterLightIndices * sizeof(uint32_t) + c_storageBufferAlignment * 2;
+			m_lightsRing.Create(lightsPartitionSize, c_ringPartitionCount, c_storageBufferAlignment, Render::RenderBufferType::StorageData);
+			for (auto& buffer : m_retainedInstanceData)
+			{
+				buffer.Create(c_maxInstances * sizeof(InstanceData), Render::RenderBufferType::VertexData, Render::RenderBufferModification::Dynamic);
+			}
+			const auto& materials = m_models->GetMaterialTable();
+			m_materialTable.Create(materials.MaxCount() * sizeof(MaterialTable::Entry), Render::RenderBufferType::StorageData, Render::RenderBufferModification::Dynamic);
+			m_models->GetMaterialTable().MarkAllDirty();
 		}
 		{
 			SDE_PROF_EVENT("Create render targets");
@@ -83,121 +354,472 @@ namespace smol
 			{
 				SDE_LOG("Failed to create shadow cube depth buffer");
 			}
+			m_staticShadowDepthBuffer.AddDepth();
+			if (!m_staticShadowDepthBuffer.Create())
+			{
+				SDE_LOG("Failed to create static shadow depth buffer");
+			}
+			m_staticShadowCubeDepthBuffer.AddDepthCube();
+			if (!m_staticShadowCubeDepthBuffer.Create())
+			{
+				SDE_LOG("Failed to create static shadow cube depth buffer");
+			}
 		}
+		m_mainContext = &CreateSubmissionContext();
+		m_renderThread.Create("smol::RenderThread", [this]() {
+			return RenderThread();
+		});
 	}
 
-	void Renderer::SetShadowsShader(ShaderHandle lightingShader, ShaderHandle shadowShader)
+	Renderer::~Renderer()
 	{
-		m_shadowShaders[lightingShader.m_index] = shadowShader;
+		FlushFrames();
+		m_stopRenderThread.Set(1);
+		m_packetsToPrepare.Post();
+		m_renderThread.WaitForFinish();
 	}
 
-	void Renderer::CreateInstanceList(InstanceList& newlist, uint32_t maxInstances)
+	int32_t Renderer::RenderThread()
 	{
-		SDE_PROF_EVENT();
-		newlist.m_instances.reserve(maxInstances);
-		newlist.m_transforms.Create(maxInstances * sizeof(glm::mat4), Render::RenderBufferType::VertexData, Render::RenderBufferModification::Dynamic, true);
-		newlist.m_colours.Create(maxInstances * sizeof(glm::vec4), Render::RenderBufferType::VertexData, Render::RenderBufferModification::Dynamic, true);
+		SDE_PROF_THREAD("smol::RenderThread");
+		while (true)
+		{
+			m_packetsToPrepare.Wait();
+			if (m_stopRenderThread.Get() != 0)
+			{
+				break;
+			}
+			FramePacket* packet = nullptr;
+			{
+				Core::ScopedMutex lock(m_prepareQueueLock);
+				SDE_ASSERT(m_prepareQueue.size() > 0);
+				packet = m_prepareQueue.front();
+				m_prepareQueue.pop_front();
+			}
+			PreparePacket(*packet);
+			m_packetsPrepared.Post();
+		}
+		return 0;
+	}
+
+	void Renderer::SetFrameLatency(uint32_t frames)
+	{
+		m_frameLatency = frames < c_maxFrameLatency ? frames : c_maxFrameLatency;
+	}
+
+	void Renderer::SetShadowsShader(ShaderHandle lightingShader, ShaderHandle shadowShader)
+	{
+		m_shadowShaders[lightingShader.m_index] = shadowShader;
 	}
 
 	void Renderer::Reset() 
 	{ 
-		m_opaqueInstances.m_instances.clear();
-		m_transparentInstances.m_instances.clear();
-		m_shadowCasterInstances.m_instances.clear();
-		m_lights.clear();
+		m_currentPacket->Clear();
+		m_mainContext = &CreateSubmissionContext();
+	}
+
+	Renderer::SubmissionContext& Renderer::CreateSubmissionContext()
+	{
+		auto& packet = *m_currentPacket;
+		if (packet.m_contextsUsed == packet.m_contexts.size())
+		{
+			packet.m_contexts.emplace_back(new SubmissionContext(*this));
+		}
+		auto& context = *packet.m_contexts[packet.m_contextsUsed++];
+		context.m_cameraPosition = m_camera.Position();
+		context.m_lodErrorScale = GetLodErrorScale(1.0f);
+		context.m_shadowLodErrorScale = GetLodErrorScale(m_shadowLodBias);
+		return context;
 	}
 
 	void Renderer::SetCamera(const Render::Camera& c)
 	{ 
 		m_camera = c;
+		m_mainContext->m_cameraPosition = c.Position();
+		m_mainContext->m_lodErrorScale = GetLodErrorScale(1.0f);
+		m_mainContext->m_shadowLodErrorScale = GetLodErrorScale(m_shadowLodBias);
+	}
+
+	// World-space error allowed per unit of distance from the camera, for an error of bias * GetLodErrorPixels on screen
+	float Renderer::GetLodErrorScale(float bias) const
+	{
+		const float pixelsPerUnitAtUnitDistance = m_windowSize.y / (2.0f * tanf(glm::radians(c_cameraFOV) * 0.5f));
+		return m_lodErrorPixels * bias / pixelsPerUnitAtUnitDistance;
 	}
 
-	bool IsMeshTransparent(const Render::Mesh& mesh, TextureManager& tm)
+	Renderer::SubmissionContext::SubmissionContext(const Renderer& r)
+		: m_renderer(r)
+		, m_opaqueInstances(&OpaqueSortKey)
+		, m_transparentInstances(&TransparentSortKey)
+		, m_shadowCasterInstances(&OpaqueSortKey)
+		, m_staticShadowCasterInstances(&OpaqueSortKey)
 	{
-		const uint32_t c_diffuseSampler = Core::StringHashing::GetHash("DiffuseTexture");
-		const auto& samplers = mesh.GetMaterial().GetSamplers();
-		const auto& diffuseSampler = samplers.find(c_diffuseSampler);
-		if (diffuseSampler != samplers.end())
+	}
+
+	void Renderer::SubmissionContext::Clear()
+	{
+		m_opaqueInstances.Clear();
+		m_transparentInstances.Clear();
+		m_shadowCasterInstances.Clear();
+		m_staticShadowCasterInstances.Clear();
+	}
+
+	void Renderer::SubmissionContext::SubmitInstance(InstanceList& list, glm::mat4 transform, glm::vec4 colour, const Render::Mesh& mesh, uint32_t materialId, uint32_t materialIndex, const struct ShaderHandle& shader, const Math::Box3* worldBounds, float lodErrorScale)
+	{
+		SDE_PROF_EVENT();
+
+		glm::vec3 boundsCenter = glm::vec3(transform[3]);
+		glm::vec3 boundsExtents = glm::vec3(c_unboundedExtents);
+		if (worldBounds != nullptr)
 		{
-			TextureHandle texHandle = { static_cast<uint16_t>(diffuseSampler->second.m_handle) };
-			const auto theTexture = tm.GetTexture({ texHandle });
-			if (theTexture && theTexture->GetComponentCount() == 4)
-			{
-				return true;
-			}
+			boundsCenter = (worldBounds->Min() + worldBounds->Max()) * 0.5f;
+			boundsExtents = (worldBounds->Max() - worldBounds->Min()) * 0.5f;
 		}
-		return false;
+
+		float distanceToCamera = glm::length(glm::vec3(transform[3]) - m_cameraPosition);
+		uint64_t sortKey = list.m_makeSortKey(shader, materialId, &mesh, distanceToCamera);
+		list.m_drawOrder.push_back({ sortKey, static_cast<uint32_t>(list.m_instances.size()) });
+		MeshInstance instance = { transform, colour, shader, materialId, materialIndex, &mesh, 0, boundsCenter, boundsExtents };
+		const bool isStaticCaster = &list == &m_staticShadowCasterInstances;
+		instance.m_lod = isStaticCaster ? SelectStaticCasterLod(instance) : SelectInstanceLod(instance, m_cameraPosition, lodErrorScale);
+		list.m_instances.push_back(instance);
 	}
 
-	void Renderer::SubmitInstance(InstanceList& list, glm::vec3 cameraPos, glm::mat4 transform, glm::vec4 colour, const Render::Mesh& mesh, const struct ShaderHandle& shader)
+	void Renderer::SubmissionContext::SubmitInstance(glm::mat4 transform, glm::vec4 colour, const Render::Mesh& mesh, const struct ShaderHandle& shader, bool isStatic)
 	{
 		SDE_PROF_EVENT();
 
-		float distanceToCamera = glm::length(glm::vec3(transform[3]) - cameraPos);
-		list.m_instances.push_back({ transform, colour, shader, &mesh, distanceToCamera });
+		// bare meshes have nowhere to cache their flags, and always use the default material
+		const uint32_t flags = Model::CalculatePartFlags(mesh, *m_renderer.m_textures);
+		const uint32_t materialId = Model::GetMaterialId(flags);
+		if (flags & Model::c_partCastsShadows)
+		{
+			const auto& foundShadowShader = m_renderer.m_shadowShaders.find(shader.m_index);
+			if (foundShadowShader != m_renderer.m_shadowShaders.end())
+			{
+				InstanceList& casters = isStatic ? m_staticShadowCasterInstances : m_shadowCasterInstances;
+				SubmitInstance(casters, transform, colour, mesh, materialId, 0, foundShadowShader->second, nullptr, m_shadowLodErrorScale);
+			}
+		}
+
+		const bool isTransparent = colour.a != 1.0f || (flags & Model::c_partTransparent);
+		InstanceList& instances = isTransparent ? m_transparentInstances : m_opaqueInstances;
+		SubmitInstance(instances, transform, colour, mesh, materialId, 0, shader, nullptr, m_lodErrorScale);
 	}
 
-	void Renderer::SubmitInstance(glm::mat4 transform, glm::vec4 colour, const Render::Mesh& mesh, const struct ShaderHandle& shader)
+	void Renderer::SubmissionContext::SubmitInstance(glm::mat4 transform, glm::vec4 colour, const struct ModelHandle& model, const struct ShaderHandle& shader, bool isStatic)
 	{
 		SDE_PROF_EVENT();
 
-		bool castShadow = true;
-		if (castShadow)
+		const auto theModel = m_renderer.m_models->GetModel(model);
+		const auto theShader = m_renderer.m_shaders->GetShader(shader);
+		ShaderHandle shadowShader = ShaderHandle::Invalid();
+		const auto& foundShadowShader = m_renderer.m_shadowShaders.find(shader.m_index);
+		if (foundShadowShader != m_renderer.m_shadowShaders.end())
 		{
-			const auto& foundShadowShader = m_shadowShaders.find(shader.m_index);
-			if (foundShadowShader != m_shadowShaders.end())
+			shadowShader = foundShadowShader->second;
+		}
+
+		if (theModel != nullptr && theShader != nullptr)
+		{
+			InstanceList& casters = isStatic ? m_staticShadowCasterInstances : m_shadowCasterInstances;
+			const bool isTransparentColour = colour.a != 1.0f;
+			for (const auto& part : theModel->Parts())
 			{
-				SubmitInstance(m_shadowCasterInstances, m_camera.Position(), transform, colour, mesh, foundShadowShader->second);
+				// part bounds are in model space, the part transform is already applied
+				const glm::mat4 instanceTransform = transform * part.m_transform;
+				const Math::Box3 worldBounds = part.m_bounds.Transformed(transform);
+				const uint32_t materialId = Model::GetMaterialId(part.m_flags);
+				if (shadowShader.m_index != -1 && (part.m_flags & Model::c_partCastsShadows))
+				{
+					SubmitInstance(casters, instanceTransform, colour, *part.m_mesh, materialId, part.m_materialIndex, shadowShader, &worldBounds, m_shadowLodErrorScale);
+				}
+
+				const bool isTransparent = isTransparentColour || (part.m_flags & Model::c_partTransparent);
+				InstanceList& instances = isTransparent ? m_transparentInstances : m_opaqueInstances;
+				SubmitInstance(instances, instanceTransform, colour, *part.m_mesh, materialId, part.m_materialIndex, shader, &worldBounds, m_lodErrorScale);
 			}
 		}
+	}
+
+	void Renderer::SubmitInstance(glm::mat4 transform, glm::vec4 colour, const Render::Mesh& mesh, const struct ShaderHandle& shader, bool isStatic)
+	{
+		m_mainContext->SubmitInstance(transform, colour, mesh, shader, isStatic);
+	}
+
+	void Renderer::SubmitInstance(glm::mat4 transform, glm::vec4 colour, const struct ModelHandle& model, const struct ShaderHandle& shader, bool isStatic)
+	{
+		m_mainContext->SubmitInstance(transform, colour, model, shader, isStatic);
+	}
 
-		bool isTransparent = colour.a != 1.0f;
-		if (!isTransparent)
+	RenderInstanceHandle Renderer::CreateInstance(glm::mat4 transform, glm::vec4 colour, const struct ModelHandle& model, const struct ShaderHandle& shader, bool isStatic)
+	{
+		auto& scene = *m_retainedScene;
+		const auto handle = scene.m_instances.Insert({ transform, colour, model, shader, isStatic, false, 0 });
+		scene.m_unresolved.push_back(handle);
+		return { handle };
+	}
+
+	void Renderer::UpdateInstance(RenderInstanceHandle h, glm::mat4 transform, glm::vec4 colour)
+	{
+		auto& scene = *m_retainedScene;
+		auto instance = scene.m_instances.Get(h.m_index);
+		if (instance != nullptr)
 		{
-			isTransparent = IsMeshTransparent(mesh, *m_textures);
+			instance->m_transform = transform;
+			instance->m_colour = colour;
+			if (instance->m_isCreated)
+			{
+				const uint32_t index = Core::SlotMap<RetainedScene::Instance>::GetIndex(h.m_index);
+				scene.m_pendingCommands.m_commands.push_back({ RetainedScene::CommandType::Update, index, transform, colour, 0, 0, false });
+			}
 		}
-		InstanceList& instances = isTransparent ? m_transparentInstances : m_opaqueInstances;
-		SubmitInstance(instances, m_camera.Position(), transform, colour, mesh, shader);
 	}
 
-	void Renderer::SubmitInstance(glm::mat4 transform, glm::vec4 colour, const struct ModelHandle& model, const struct ShaderHandle& shader)
+	void Renderer::DestroyInstance(RenderInstanceHandle h)
 	{
-		SDE_PROF_EVENT();
+		auto& scene = *m_retainedScene;
+		auto instance = scene.m_instances.Get(h.m_index);
+		if (instance != nullptr)
+		{
+			if (instance->m_isCreated)
+			{
+				const uint32_t index = Core::SlotMap<RetainedScene::Instance>::GetIndex(h.m_index);
+				scene.m_pendingCommands.m_commands.push_back({ RetainedScene::CommandType::Destroy, index, {}, {}, 0, 0, false });
+			}
+			scene.m_instances.Remove(h.m_index);	// stale handles in the unresolved list are skipped
+		}
+	}
 
-		const auto theModel = m_models->GetModel(model);
-		const auto theShader = m_shaders->GetShader(shader);
-		ShaderHandle shadowShader = ShaderHandle::Invalid();
+	// Meshes are about to be replaced, so destroy the render thread copies + resolve everything again
+	void Renderer::ReloadInstances()
+	{
+		auto& scene = *m_retainedScene;
+		for (size_t i = 0; i < scene.m_instances.Size(); ++i)
+		{
+			auto& instance = scene.m_instances.ValueAt(i);
+			if (instance.m_isCreated)
+			{
+				scene.ResolveAgain(scene.m_instances.HandleAt(i), instance);
+			}
+		}
+	}
 
-		bool castShadow = true;
-		if (castShadow)
+	// Runs on the main thread, creates render thread instances for anything that finished loading
+	// Transparency is decided here, changing the alpha of a created instance will not move it between lists
+	// Instances are created again if their model part flags change (i.e. a texture with alpha finished loading)
+	void Renderer::ResolveRetainedInstances()
+	{
+		SDE_PROF_EVENT();
+		auto& scene = *m_retainedScene;
+		auto& commands = scene.m_pendingCommands;
+		if (m_models->UpdatePartFlags())
 		{
-			const auto& foundShadowShader = m_shadowShaders.find(shader.m_index);
+			for (size_t i = 0; i < scene.m_instances.Size(); ++i)
+			{
+				auto& instance = scene.m_instances.ValueAt(i);
+				const auto theModel = instance.m_isCreated ? m_models->GetModel(instance.m_model) : nullptr;
+				if (theModel != nullptr && theModel->GetFlagsVersion() != instance.m_modelFlagsVersion)
+				{
+					scene.ResolveAgain(scene.m_instances.HandleAt(i), instance);
+				}
+			}
+		}
+		auto resolved = std::remove_if(scene.m_unresolved.begin(), scene.m_unresolved.end(), [&](uint32_t handle) {
+			auto instance = scene.m_instances.Get(handle);
+			if (instance == nullptr)
+			{
+				return true;
+			}
+			const auto theModel = m_models->GetModel(instance->m_model);
+			const auto theShader = m_shaders->GetShader(instance->m_shader);
+			if (theModel == nullptr || theShader == nullptr)
+			{
+				return false;
+			}
+			ShaderHandle shadowShader = ShaderHandle::Invalid();
+			const auto& foundShadowShader = m_shadowShaders.find(instance->m_shader.m_index);
 			if (foundShadowShader != m_shadowShaders.end())
 			{
 				shadowShader = foundShadowShader->second;
 			}
+			const uint32_t index = Core::SlotMap<RetainedScene::Instance>::GetIndex(handle);
+			RetainedScene::Command create = { RetainedScene::CommandType::Create, index, instance->m_transform, instance->m_colour,
+				static_cast<uint32_t>(commands.m_parts.size()), 0, instance->m_isStatic };
+			for (const auto& part : theModel->Parts())
+			{
+				const bool isTransparent = instance->m_colour.a != 1.0f || (part.m_flags & Model::c_partTransparent);
+				const ShaderHandle partShadowShader = (part.m_flags & Model::c_partCastsShadows) ? shadowShader : ShaderHandle::Invalid();
+				commands.m_parts.push_back({ part.m_transform, part.m_bounds, part.m_mesh.get(), instance->m_shader, partShadowShader,
+					Model::GetMaterialId(part.m_flags), part.m_materialIndex, isTransparent });
+			}
+			create.m_partCount = static_cast<uint32_t>(commands.m_parts.size()) - create.m_firstPart;
+			commands.m_commands.push_back(create);
+			instance->m_isCreated = true;
+			instance->m_modelFlagsVersion = theModel->GetFlagsVersion();
+			return true;
+		});
+		scene.m_unresolved.erase(resolved, scene.m_unresolved.end());
+	}
+
+	// Runs on the render thread. Applies the packet commands, then builds the draw lists + any data that changed
+	void Renderer::PrepareRetainedInstances(FramePacket& packet)
+	{
+		SDE_PROF_EVENT();
+		auto& scene = *m_retainedScene;
+		const auto& parts = packet.m_retainedCommands.m_parts;
+		for (const auto& cmd : packet.m_retainedCommands.m_commands)
+		{
+			if (cmd.m_instanceIndex >= scene.m_partInstances.size())
+			{
+				scene.m_partInstances.resize(cmd.m_instanceIndex + 1);
+			}
+			auto& partInstances = scene.m_partInstances[cmd.m_instanceIndex];
+			switch (cmd.m_type)
+			{
+			case RetainedScene::CommandType::Create:
+				SDE_ASSERT(partInstances.size() == 0, "Retained instance created twice");
+				for (uint32_t p = cmd.m_firstPart; p < cmd.m_firstPart + cmd.m_partCount; ++p)
+				{
+					const auto& part = parts[p];
+					const Math::Box3 worldBounds = part.m_bounds.Transformed(cmd.m_transform);
+					MeshInstance instance = { cmd.m_transform * part.m_partTransform, cmd.m_colour, part.m_shader, part.m_materialId, part.m_materialIndex, part.m_mesh, 0,
+						(worldBounds.Min() + worldBounds.Max()) * 0.5f, (worldBounds.Max() - worldBounds.Min()) * 0.5f };
+					if (part.m_shadowShader.m_index != -1)
+					{
+						// keys have no depth, so they never change while the instance is alive
+						const uint32_t casterList = cmd.m_isStatic ? RetainedScene::StaticShadowCaster : RetainedScene::ShadowCaster;
+						MeshInstance caster = instance;
+						caster.m_shader = part.m_shadowShader;
+						const uint32_t slot = scene.m_lists[casterList].Add(caster, OpaqueSortKey(part.m_shadowShader, part.m_materialId, part.m_mesh, 0.0f));
+						partInstances.push_back({ part.m_partTransform, part.m_bounds, casterList, slot });
+					}
+					const uint32_t list = part.m_isTransparent ? RetainedScene::Transparent : RetainedScene::Opaque;
+					const uint32_t slot = scene.m_lists[list].Add(instance, OpaqueSortKey(part.m_shader, part.m_materialId, part.m_mesh, 0.0f));
+					partInstances.push_back({ part.m_partTransform, part.m_bounds, list, slot });
+				}
+				break;
+			case RetainedScene::CommandType::Update:
+				for (const auto& pi : partInstances)
+				{
+					const Math::Box3 worldBounds = pi.m_bounds.Transformed(cmd.m_transform);
+					scene.m_lists[pi.m_list].Update(pi.m_slot, cmd.m_transform * pi.m_partTransform, cmd.m_colour,
+						(worldBounds.Min() + worldBounds.Max()) * 0.5f, (worldBounds.Max() - worldBounds.Min()) * 0.5f);
+				}
+				break;
+			case RetainedScene::CommandType::Destroy:
+				for (const auto& pi : partInstances)
+				{
+					scene.m_lists[pi.m_list].Remove(pi.m_slot);
+				}
+				partInstances.clear();
+				break;
+			}
+		}
+		for (auto& list : scene.m_lists)
+		{
+			list.Commit();
+			if (packet.m_retainedFullUpload)
+			{
+				list.MarkAllDirty();
+			}
 		}
 
-		if (theModel != nullptr && theShader != nullptr)
+		// draw order keys are buffer positions, culling + shadow passes keep them
+		const glm::vec3 cameraPosition = packet.m_camera.Position();
+		packet.m_retainedOpaqueCount = scene.m_lists[RetainedScene::Opaque].Count();
+		packet.m_retainedInstanceCount = packet.m_retainedOpaqueCount + scene.m_lists[RetainedScene::Transparent].Count();
+		for (uint32_t l = 0; l < c_retainedBufferCount; ++l)
 		{
-			uint16_t meshPartIndex = 0;
-			for (const auto& part : theModel->Parts())
+			auto& retained = scene.m_lists[l];
+			auto& list = packet.m_retainedInstances[l];
+			const bool isStaticCasters = l == RetainedScene::StaticShadowCaster;
+			const uint32_t copyVersion = packet.m_retainedVersions[l];
+			if (copyVersion != retained.Version())
 			{
-				if (shadowShader.m_index != -1)
+				// only the slots changed since this packet last copied the list, unless it fell too far behind
+				const auto& instances = retained.Instances();
+				if (retained.ChangeLogCovers(copyVersion))
+				{
+					const auto& changes = retained.ChangeLog();
+					list.m_instances.resize(instances.size());
+					for (size_t c = retained.FirstChangeAfter(copyVersion); c < changes.size(); ++c)
+					{
+						auto& instance = list.m_instances[changes[c].m_slot];
+						instance = instances[changes[c].m_slot];
+						if (isStaticCasters && instance.m_mesh != nullptr)
+						{
+							instance.m_lod = SelectStaticCasterLod(instance);
+						}
+					}
+				}
+				else
 				{
-					SubmitInstance(m_shadowCasterInstances, m_camera.Position(), transform, colour, *part.m_mesh, shadowShader);
+					list.m_instances = instances;
+					if (isStaticCasters)
+					{
+						for (auto& instance : list.m_instances)
+						{
+							if (instance.m_mesh != nullptr)
+							{
+								instance.m_lod = SelectStaticCasterLod(instance);
+							}
+						}
+					}
 				}
+				packet.m_retainedVersions[l] = retained.Version();
+			}
 
-				bool isTransparent = colour.a != 1.0f;
-				if (!isTransparent)
+			// other lods follow the camera, so they are picked again every frame. they don't change the instance data
+			if (!isStaticCasters)
+			{
+				const float lodErrorScale = l == RetainedScene::Opaque ? packet.m_lodErrorScale : packet.m_shadowLodErrorScale;
+				for (auto& instance : list.m_instances)
 				{
-					isTransparent = IsMeshTransparent(*part.m_mesh, *m_textures);
+					if (instance.m_mesh != nullptr)
+					{
+						instance.m_lod = SelectInstanceLod(instance, cameraPosition, lodErrorScale);
+					}
 				}
-				InstanceList& instances = isTransparent ? m_transparentInstances : m_opaqueInstances;
-				const glm::mat4 instanceTransform = transform * part.m_transform;
-				SubmitInstance(instances, m_camera.Position(), instanceTransform, colour, *part.m_mesh, shader);
+			}
+			const auto& drawOrder = retained.DrawOrder();
+			const uint32_t count = static_cast<uint32_t>(drawOrder.size());
+			SDE_ASSERT(count <= c_maxInstances, "Too many retained instances");
+			list.m_drawOrder.resize(count);
+			for (uint32_t p = 0; p < count; ++p)
+			{
+				list.m_drawOrder[p] = { p, drawOrder[p].m_index };
+			}
+
+			// dirty data goes through the ring, if it is full the range stays dirty until next frame
+			auto& upload = packet.m_retainedUploads[l];
+			upload = {};
+			const uint32_t dirtyCount = retained.DirtyEnd() - retained.DirtyFirst();
+			const size_t ringOffset = dirtyCount > 0 ? m_instanceRing.Allocate(packet.m_ringPartition, dirtyCount * sizeof(InstanceData)) : Render::RingBuffer::c_allocationFailed;
+			if (ringOffset != Render::RingBuffer::c_allocationFailed)
+			{
+				auto target = static_cast<InstanceData*>(m_instanceRing.GetWritePointer(ringOffset));
+				for (uint32_t p = retained.DirtyFirst(); p < retained.DirtyEnd(); ++p)
+				{
+					PackInstanceData(retained.Instances()[drawOrder[p].m_index], *target++);
+				}
+				upload = { ringOffset, retained.DirtyFirst(), dirtyCount };
+				retained.ClearDirty();
 			}
 		}
+
+		// transparents are sorted by distance every frame, so they join the immediate list
+		auto& transparents = scene.m_lists[RetainedScene::Transparent];
+		auto& target = packet.m_transparentInstances;
+		for (const auto& sorted : transparents.DrawOrder())
+		{
+			const auto& instance = transparents.Instances()[sorted.m_index];
+			const float distanceToCamera = glm::length(glm::vec3(instance.m_transform[3]) - cameraPosition);
+			target.m_drawOrder.push_back({ target.m_makeSortKey(instance.m_shader, instance.m_materialId, instance.m_mesh, distanceToCamera), static_cast<uint32_t>(target.m_instances.size()) });
+			target.m_instances.push_back(instance);
+			target.m_instances.back().m_lod = SelectInstanceLod(instance, cameraPosition, packet.m_lodErrorScale);
+		}
+		transparents.ClearDirty();
 	}
 
 	void Renderer::SetLight(glm::vec4 positionOrDir, glm::vec3 colour, float ambientStr, glm::vec3 attenuation)
@@ -206,337 +828,852 @@ namespace smol
 		newLight.m_colour = glm::vec4(colour, ambientStr);
 		newLight.m_position = positionOrDir;
 		newLight.m_attenuation = attenuation;
-		m_lights.push_back(newLight);
+		m_currentPacket->m_lights.push_back(newLight);
+	}
+
+	// Transposes the transform so the last (constant) row can be dropped
+	void Renderer::PackInstanceData(const MeshInstance& instance, InstanceData& out)
+	{
+		static_assert(sizeof(InstanceData) == 64, "Instance data layout must match shared.vs");
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int col = 0; col < 4; ++col)
+			{
+				out.m_transformRows[row][col] = instance.m_transform[col][row];
+			}
+		}
+		out.m_colour = glm::packHalf4x16(instance.m_colour);
+		out.m_materialIndex = instance.m_materialIndex;
+		out.m_padding = 0;
 	}
 
-	void Renderer::PopulateInstanceBuffers(InstanceList& list)
+	// Writes instance data straight into this packet's ring partition, the gpu is not using it
+	void Renderer::PrepareInstanceData(InstanceList& list, uint32_t ringPartition)
 	{
 		SDE_PROF_EVENT();
 
-		//static to avoid constant allocations
-		static std::vector<glm::mat4> instanceTransforms;
-		instanceTransforms.reserve(list.m_instances.size());
-		instanceTransforms.clear();
-		static std::vector<glm::vec4> instanceColours;
-		instanceColours.reserve(list.m_instances.size());
-		instanceColours.clear();
+		const uint32_t count = static_cast<uint32_t>(list.m_drawOrder.size());
+		if (count == 0)
+		{
+			return;
+		}
+		const size_t ringOffset = m_instanceRing.Allocate(ringPartition, count * sizeof(InstanceData));
+		if (ringOffset == Render::RingBuffer::c_allocationFailed)
+		{
+			SDE_LOG("Instance ring buffer is full, %u instances not drawn", count);
+			list.m_drawOrder.clear();
+			return;
+		}
+		auto target = static_cast<InstanceData*>(m_instanceRing.GetWritePointer(ringOffset));
+		const uint32_t firstInstance = static_cast<uint32_t>(ringOffset / sizeof(InstanceData));
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			auto& sorted = list.m_drawOrder[i];
+			PackInstanceData(list.m_instances[sorted.m_index], target[i]);
+			sorted.m_key = firstInstance + i;
+		}
+	}
+
+	// Groups the final draw order into indirect commands. Only touches the list, so lists can be built in parallel
+	// Shadow caster lists are grouped per pass, so each pass can be drawn on its own
+	void Renderer::PrepareDrawCommands(InstanceList& list, const ShadowCasterRange* ranges, uint32_t rangeCount)
+	{
+		SDE_PROF_EVENT();
 
-		for (const auto& c : list.m_instances)
+		auto& commands = list.m_drawCommands;
+		commands.Clear();
+		if (ranges == nullptr)
 		{
-			instanceTransforms.push_back(c.m_transform);
-			instanceColours.push_back(c.m_colour);
+			commands.Build(list.m_instances.data(), list.m_drawOrder.data(), 0, static_cast<uint32_t>(list.m_drawOrder.size()));
 		}
+		else
+		{
+			for (uint32_t r = 0; r < rangeCount; ++r)
+			{
+				commands.Build(list.m_instances.data(), list.m_drawOrder.data(), ranges[r].m_firstInstance, ranges[r].m_instanceCount);
+			}
+		}
+	}
 
-		// copy the instance buffers to gpu
-		if (list.m_instances.size() > 0)
+	void Renderer::PrepareGlobals(FramePacket& packet)
+	{
+		SDE_PROF_EVENT();
+
+		const auto& camera = packet.m_camera;
+		packet.m_projectionMatrix = glm::perspectiveFov(glm::radians(c_cameraFOV), (float)m_windowSize.x, (float)m_windowSize.y, c_cameraNearPlane, c_cameraFarPlane);
+		packet.m_viewMatrix = glm::lookAt(camera.Position(), camera.Target(), camera.Up());
+
+		GlobalUniforms& globals = packet.m_globals;
+		globals = {};
+		globals.m_viewProjMat = packet.m_projectionMatrix * packet.m_viewMatrix;
+		globals.m_cameraPosition = glm::vec4(camera.Position(), 0.0);
+		globals.m_hdrExposure = packet.m_hdrExposure;
+		globals.m_shadowBias = packet.m_shadowBias;
+		globals.m_cubeShadowBias = packet.m_cubeShadowBias;
+	}
+
+	// Distance where a point light's attenuation drops below the cutoff
+	float CalculateLightRadius(const Light& light)
+	{
+		const float intensity = glm::compMax(glm::vec3(light.m_colour)) * (1.0f + light.m_colour.w);	// diffuse + ambient
+		const float c = light.m_attenuation.x - intensity / c_lightCutoff;	// solve c + l*d + q*d^2 = intensity / cutoff
+		const float l = light.m_attenuation.y;
+		const float q = light.m_attenuation.z;
+		float radius = c_maxLightRadius;
+		if (c >= 0.0f)
 		{
-			list.m_transforms.SetData(0, instanceTransforms.size() * sizeof(glm::mat4), instanceTransforms.data());
-			list.m_colours.SetData(0, instanceColours.size() * sizeof(glm::vec4), instanceColours.data());
+			radius = 0.0f;		// never bright enough
 		}
+		else if (q > 0.0f)
+		{
+			radius = (-l + sqrtf(l * l - 4.0f * q * c)) / (2.0f * q);
+		}
+		else if (l > 0.0f)
+		{
+			radius = -c / l;
+		}
+		return std::min(radius, c_maxLightRadius);
 	}
 
-	void Renderer::UpdateGlobals(glm::mat4 projectionMat, glm::mat4 viewMat)
+	// Writes every light to the lights ring, then builds the cluster lists for the point lights
+	// Directional lights go first, they light everything and are never clustered
+	void Renderer::PrepareLights(FramePacket& packet)
 	{
 		SDE_PROF_EVENT();
 
-		GlobalUniforms globals;
-		globals.m_viewProjMat = projectionMat * viewMat;
-		const Light* shadowLight = nullptr;
-		const Light* cubeShadowLight = nullptr;
-		for (int l = 0; l < m_lights.size() && l < c_maxLights; ++l)
+		auto& lights = packet.m_lights;
+		if (lights.size() > c_maxLights)
+		{
+			SDE_LOG("Too many lights, %zu not drawn", lights.size() - c_maxLights);
+			lights.resize(c_maxLights);
+		}
+		const auto firstPointLight = std::stable_partition(lights.begin(), lights.end(), [](const Light& l) {
+			return l.m_position.w == 0.0f;
+		});
+		const uint32_t lightCount = static_cast<uint32_t>(lights.size());
+		const uint32_t directionalCount = static_cast<uint32_t>(firstPointLight - lights.begin());
+
+		// the first directional + first point light cast shadows
+		packet.m_shadowLightIndex = directionalCount > 0 ? 0 : -1;
+		packet.m_cubeShadowLightIndex = lightCount > directionalCount ? directionalCount : -1;
+		packet.m_lightsSize = std::max(lightCount, 1u) * sizeof(LightInfo);		// never bind an empty range
+		packet.m_lightsOffset = m_lightsRing.Allocate(packet.m_ringPartition, packet.m_lightsSize);
+		auto lightInfos = static_cast<LightInfo*>(m_lightsRing.GetWritePointer(packet.m_lightsOffset));
+		m_lightBounds.resize(lightCount - directionalCount);
+		for (uint32_t l = 0; l < lightCount; ++l)
 		{
-			globals.m_lights[l].m_colourAndAmbient = m_lights[l].m_colour;
-			globals.m_lights[l].m_position = m_lights[l].m_position;
-			globals.m_lights[l].m_attenuation = m_lights[l].m_attenuation;
-			globals.m_lights[l].m_shadowParams.y = m_lights[l].m_position.w == 0.0f ? 1000.0f : 500.0f;
-			if (shadowLight == nullptr && m_lights[l].m_position.w == 0.0f)
+			const bool castsShadows = static_cast<int32_t>(l) == packet.m_shadowLightIndex || static_cast<int32_t>(l) == packet.m_cubeShadowLightIndex;
+			auto& info = lightInfos[l];
+			info.m_colourAndAmbient = lights[l].m_colour;
+			info.m_position = lights[l].m_position;
+			info.m_attenuation = lights[l].m_attenuation;
+			info.m_shadowParams = glm::vec3(castsShadows ? 1.0f : 0.0f, 0.0f, 0.0f);
+			if (castsShadows)
 			{
-				shadowLight = &m_lights[l];
-				globals.m_lights[l].m_shadowParams.x = 1.0f;
-				
+				info.m_shadowParams.y = l < directionalCount ? 1000.0f : 500.0f;
 			}
-			else if (cubeShadowLight == nullptr && m_lights[l].m_position.w == 1.0f)
+			if (l >= directionalCount)
 			{
-				cubeShadowLight = &m_lights[l];
-				globals.m_lights[l].m_shadowParams.x = 1.0f;
+				m_lightBounds[l - directionalCount] = glm::vec4(glm::vec3(lights[l].m_position), CalculateLightRadius(lights[l]));
 			}
-			else
+		}
+		packet.m_globals.m_lightCount = lightCount;
+		packet.m_globals.m_directionalLightCount = directionalCount;
+
+		// point lights are assigned in parallel, then gathered into one index list per cluster
+		m_lightClusters.SetProjection(packet.m_projectionMatrix, c_cameraNearPlane, c_cameraFarPlane);
+		m_lightClusters.Begin(packet.m_viewMatrix, m_lightBounds.data(), lightCount - directionalCount, directionalCount);
+		RunInParallel(m_lightClusters.ChunkCount(), [this](uint32_t chunk) {
+			m_lightClusters.AssignChunk(chunk);
+		});
+		const uint32_t droppedIndices = m_lightClusters.Finish(c_maxClusterLightIndices);
+		if (droppedIndices > 0)
+		{
+			SDE_LOG("Light cluster lists are full, %u light indices dropped", droppedIndices);
+		}
+		const glm::vec2 sliceParams = m_lightClusters.GetDepthSliceParams();
+		packet.m_globals.m_clusterDepthParams = glm::vec4(sliceParams.x, sliceParams.y, 0.0f, 0.0f);
+
+		const auto& clusters = m_lightClusters.Clusters();
+		const auto& indices = m_lightClusters.LightIndices();
+		packet.m_lightClustersOffset = m_lightsRing.Allocate(packet.m_ringPartition, clusters.size() * sizeof(LightClusters::Cluster));
+		memcpy(m_lightsRing.GetWritePointer(packet.m_lightClustersOffset), clusters.data(), clusters.size() * sizeof(LightClusters::Cluster));
+		packet.m_lightIndicesSize = std::max(indices.size(), (size_t)1) * sizeof(uint32_t);
+		packet.m_lightIndicesOffset = m_lightsRing.Allocate(packet.m_ringPartition, packet.m_lightIndicesSize);
+		if (indices.size() > 0)
+		{
+			memcpy(m_lightsRing.GetWritePointer(packet.m_lightIndicesOffset), indices.data(), indices.size() * sizeof(uint32_t));
+		}
+	}
+
+	// Runs on the render thread
+	void Renderer::PreparePacket(FramePacket& packet)
+	{
+		SDE_PROF_EVENT();
+
+		// gather instances from all submission contexts
+		for (uint32_t c = 0; c < packet.m_contextsUsed; ++c)
+		{
+			auto& context = *packet.m_contexts[c];
+			MergeInstances(packet.m_shadowCasterInstances, context.m_shadowCasterInstances);
+			MergeInstances(packet.m_staticShadowCasterInstances, context.m_staticShadowCasterInstances);
+			MergeInstances(packet.m_opaqueInstances, context.m_opaqueInstances);
+			MergeInstances(packet.m_transparentInstances, context.m_transparentInstances);
+		}
+		PrepareRetainedInstances(packet);
+
+		// frustum cull anything the camera can't see. shadow casters are not culled against the camera
+		PrepareGlobals(packet);
+		PrepareLights(packet);
+		Math::Frustum frustum(packet.m_globals.m_viewProjMat);
+		packet.m_instancesCulled = CullInstances(packet.m_opaqueInstances, frustum);
+		packet.m_instancesCulled += CullInstances(packet.m_transparentInstances, frustum);
+		packet.m_instancesCulled += CullInstances(packet.m_retainedInstances[RetainedScene::Opaque], frustum);
+
+		// prepare instance lists for passes
+		SortInstances(packet.m_shadowCasterInstances);
+		SortInstances(packet.m_staticShadowCasterInstances);
+		SortInstances(packet.m_opaqueInstances);
+		SortInstances(packet.m_transparentInstances);
+		PrepareShadowPasses(packet, frustum);
+
+		// build per-instance data + globals directly in the ring buffers
+		PrepareInstanceData(packet.m_shadowCasterInstances, packet.m_ringPartition);
+		PrepareInstanceData(packet.m_staticShadowCasterInstances, packet.m_ringPartition);
+		PrepareInstanceData(packet.m_opaqueInstances, packet.m_ringPartition);
+		PrepareInstanceData(packet.m_transparentInstances, packet.m_ringPartition);
+		packet.m_globalsOffset = m_globalsRing.Allocate(packet.m_ringPartition, sizeof(GlobalUniforms));
+		memcpy(m_globalsRing.GetWritePointer(packet.m_globalsOffset), &packet.m_globals, sizeof(GlobalUniforms));
+
+		// indirect draw commands once every draw order is final, one job per list
+		ShadowCasterRange passRanges[4][c_shadowPassCount];
+		for (uint32_t p = 0; p < c_shadowPassCount; ++p)
+		{
+			passRanges[0][p] = packet.m_shadowPasses[p].m_dynamicCasters;
+			passRanges[1][p] = packet.m_shadowPasses[p].m_staticCasters;
+			passRanges[2][p] = packet.m_shadowPasses[p].m_retainedDynamicCasters;
+			passRanges[3][p] = packet.m_shadowPasses[p].m_retainedStaticCasters;
+		}
+		struct CommandJob
+		{
+			InstanceList* m_list;
+			const ShadowCasterRange* m_ranges;
+		};
+		const CommandJob commandJobs[] = {
+			{ &packet.m_shadowCasterInstances, passRanges[0] },
+			{ &packet.m_staticShadowCasterInstances, passRanges[1] },
+			{ &packet.m_retainedInstances[RetainedScene::ShadowCaster], passRanges[2] },
+			{ &packet.m_retainedInstances[RetainedScene::StaticShadowCaster], passRanges[3] },
+			{ &packet.m_opaqueInstances, nullptr },
+			{ &packet.m_retainedInstances[RetainedScene::Opaque], nullptr },
+			{ &packet.m_transparentInstances, nullptr },
+		};
+		const uint32_t jobCount = static_cast<uint32_t>(sizeof(commandJobs) / sizeof(commandJobs[0]));
+		RunInParallel(jobCount, [&](uint32_t j) {
+			PrepareDrawCommands(*commandJobs[j].m_list, commandJobs[j].m_ranges, c_shadowPassCount);
+		});
+
+		// the ring allocator is single threaded. if it is full the same commands are drawn directly instead
+		for (const auto& job : commandJobs)
+		{
+			auto& list = *job.m_list;
+			const size_t commandsSize = list.m_drawCommands.Commands().size() * sizeof(DrawArraysIndirectCommand);
+			const size_t indexedCommandsSize = list.m_drawCommands.IndexedCommands().size() * sizeof(DrawElementsIndirectCommand);
+			const size_t totalSize = commandsSize + indexedCommandsSize;
+			list.m_drawCommandsOffset = totalSize > 0 ? m_instanceRing.Allocate(packet.m_ringPartition, totalSize) : Render::RingBuffer::c_allocationFailed;
+			list.m_indexedCommandsOffset = Render::RingBuffer::c_allocationFailed;
+			if (list.m_drawCommandsOffset != Render::RingBuffer::c_allocationFailed)
 			{
-				globals.m_lights[l].m_shadowParams.y = 0.0f;
+				list.m_indexedCommandsOffset = list.m_drawCommandsOffset + commandsSize;
+				uint8_t* writePtr = static_cast<uint8_t*>(m_instanceRing.GetWritePointer(list.m_drawCommandsOffset));
+				memcpy(writePtr, list.m_drawCommands.Commands().data(), commandsSize);
+				memcpy(writePtr + commandsSize, list.m_drawCommands.IndexedCommands().data(), indexedCommandsSize);
 			}
 		}
-		globals.m_lightCount = static_cast<int>(std::min(m_lights.size(), c_maxLights));
-		globals.m_cameraPosition = glm::vec4(m_camera.Position(), 0.0);
-		globals.m_hdrExposure = m_hdrExposure;
-		globals.m_shadowBias = m_shadowBias;
-		globals.m_cubeShadowBias = m_cubeShadowBias;
-		m_globalsUniformBuffer.SetData(0, sizeof(globals), &globals);
 	}
 
-	void Renderer::PrepareShadowInstances(InstanceList& list)
+	void Renderer::MergeInstances(InstanceList& target, InstanceList& source)
 	{
 		SDE_PROF_EVENT();
+		if (target.m_instances.size() == 0)
 		{
-			SDE_PROF_EVENT("Sort");
-			std::sort(list.m_instances.begin(), list.m_instances.end(), [](const smol::MeshInstance& q1, const smol::MeshInstance& q2) -> bool {
-				if (q1.m_shader.m_index < q2.m_shader.m_index)	// shader
-				{
-					return true;
-				}
-				else if (q1.m_shader.m_index > q2.m_shader.m_index)
-				{
-					return false;
-				}
-				auto q1Mesh = reinterpret_cast<uintptr_t>(q1.m_mesh);	// mesh
-				auto q2Mesh = reinterpret_cast<uintptr_t>(q2.m_mesh);
-				if (q1Mesh < q2Mesh)
-				{
-					return true;
-				}
-				else if (q1Mesh > q2Mesh)
-				{
-					return false;
-				}
-				return false;
-			});
+			// take the source lists as-is, the (empty) target storage goes back to the context for reuse
+			std::swap(target.m_instances, source.m_instances);
+			std::swap(target.m_drawOrder, source.m_drawOrder);
+			return;
+		}
+
+		// keys are appended and sorted later, only the indices need fixing up
+		const uint32_t baseIndex = static_cast<uint32_t>(target.m_instances.size());
+		target.m_instances.insert(target.m_instances.end(), source.m_instances.begin(), source.m_instances.end());
+		target.m_drawOrder.reserve(target.m_drawOrder.size() + source.m_drawOrder.size());
+		for (const auto& sorted : source.m_drawOrder)
+		{
+			target.m_drawOrder.push_back({ sorted.m_key, sorted.m_index + baseIndex });
+		}
+	}
+
+	// Runs fn(chunk) for every chunk across the job threads + the calling thread
+	// The caller takes chunks as well, so it never waits on jobs that are stuck behind others in the queue
+	void Renderer::RunInParallel(uint32_t chunkCount, const std::function<void(uint32_t)>& fn)
+	{
+		if (m_jobSystem != nullptr)
+		{
+			m_jobSystem->RunInParallel(chunkCount, fn);
+		}
+		else
+		{
+			for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				fn(chunk);
+			}
 		}
 	}
 
-	void Renderer::PrepareTransparentInstances(InstanceList& list)
+	// Removes instances outside the frustum from the draw order, returns the number culled
+	size_t Renderer::CullInstances(InstanceList& list, const Math::Frustum& frustum)
 	{
 		SDE_PROF_EVENT();
+
+		const uint32_t instanceCount = static_cast<uint32_t>(list.m_drawOrder.size());
+		const uint32_t chunkCount = (instanceCount + c_cullChunkSize - 1) / c_cullChunkSize;
+		if (chunkCount == 0)
 		{
-			SDE_PROF_EVENT("Sort");
-			std::sort(list.m_instances.begin(), list.m_instances.end(), [](const smol::MeshInstance& q1, const smol::MeshInstance& q2) -> bool {
-				if (q1.m_distanceToCamera < q2.m_distanceToCamera)	// back to front
-				{
-					return false;
-				}
-				else if (q1.m_distanceToCamera > q2.m_distanceToCamera)
-				{
-					return true;
-				}
-				if (q1.m_shader.m_index < q2.m_shader.m_index)	// shader
-				{
-					return true;
-				}
-				else if (q1.m_shader.m_index > q2.m_shader.m_index)
-				{
-					return false;
-				}
-				auto q1Mesh = reinterpret_cast<uintptr_t>(q1.m_mesh);	// mesh
-				auto q2Mesh = reinterpret_cast<uintptr_t>(q2.m_mesh);
-				if (q1Mesh < q2Mesh)
-				{
-					return true;
-				}
-				else if (q1Mesh > q2Mesh)
+			return 0;
+		}
+
+		// each chunk compacts its own range of the draw order, tests 4 boxes at a time
+		m_cullChunkCounts.resize(chunkCount);
+		Core::SortKeyIndex* drawOrder = list.m_drawOrder.data();
+		const MeshInstance* instances = list.m_instances.data();
+		uint32_t* chunkCounts = m_cullChunkCounts.data();
+		RunInParallel(chunkCount, [&](uint32_t chunk) {
+			SDE_PROF_EVENT("CullChunk");
+			const uint32_t first = chunk * c_cullChunkSize;
+			const uint32_t last = std::min(first + c_cullChunkSize, instanceCount);
+			uint32_t visibleCount = 0;
+			for (uint32_t i = first; i < last; i += 4)
+			{
+				const uint32_t visibleMask = frustum.AreBoxesVisible(GatherBounds(instances, drawOrder, i, last));
+				const uint32_t batchCount = std::min(4u, last - i);
+				for (uint32_t b = 0; b < batchCount; ++b)
 				{
-					return false;
+					if (visibleMask & (1 << b))
+					{
+						drawOrder[first + visibleCount++] = drawOrder[i + b];
+					}
 				}
-				return false;
-			});
+			}
+			chunkCounts[chunk] = visibleCount;
+		});
+
+		// close the gaps between chunks
+		uint32_t totalVisible = chunkCounts[0];
+		for (uint32_t chunk = 1; chunk < chunkCount; ++chunk)
+		{
+			memmove(drawOrder + totalVisible, drawOrder + chunk * c_cullChunkSize, chunkCounts[chunk] * sizeof(Core::SortKeyIndex));
+			totalVisible += chunkCounts[chunk];
 		}
+		list.m_drawOrder.resize(totalVisible);
+		return instanceCount - totalVisible;
 	}
 
-	void Renderer::PrepareOpaqueInstances(InstanceList& list)
+	// Culls shadow casters per light / cube face, then rebuilds the caster draw order as one range per pass
+	void Renderer::PrepareShadowPasses(FramePacket& packet, const Math::Frustum& cameraFrustum)
 	{
 		SDE_PROF_EVENT();
+
+		// each pass has a light frustum + a frustum that rejects casters that can't shadow anything the camera sees
+		Math::Frustum passFrustums[c_shadowPassCount];
+		Math::Frustum reachFrustums[c_shadowPassCount];
+		uint32_t enabledPasses = 0;
+		if (packet.m_shadowLightIndex != -1)
 		{
-			SDE_PROF_EVENT("Sort");
-			std::sort(list.m_instances.begin(), list.m_instances.end(), [](const smol::MeshInstance& q1, const smol::MeshInstance& q2) -> bool {
-				if (q1.m_shader.m_index < q2.m_shader.m_index)	// shader
-				{
-					return true;
-				}
-				else if (q1.m_shader.m_index > q2.m_shader.m_index)
-				{
-					return false;
-				}
-				auto q1Mesh = reinterpret_cast<uintptr_t>(q1.m_mesh);	// mesh
-				auto q2Mesh = reinterpret_cast<uintptr_t>(q2.m_mesh);
-				if (q1Mesh < q2Mesh)
-				{
-					return true;
-				}
-				else if (q1Mesh > q2Mesh)
+			const auto& camera = packet.m_camera;
+			const float aspect = (float)m_windowSize.x / (float)m_windowSize.y;
+			ShadowCascadeParams params;
+			params.m_cameraView = glm::lookAt(camera.Position(), camera.Target(), camera.Up());
+			params.m_cameraFOV = glm::radians(c_cameraFOV);
+			params.m_cameraAspect = aspect;
+			params.m_cameraNearPlane = c_cameraNearPlane;
+			params.m_shadowDistance = c_shadowDistance;
+			params.m_splitBlend = c_cascadeSplitBlend;
+			params.m_casterDistance = c_cascadeCasterDistance;
+			params.m_lightDirection = -glm::normalize(glm::vec3(packet.m_lights[packet.m_shadowLightIndex].m_position));
+			params.m_cascadeResolution = c_cascadeMapSize;
+			ShadowCascade cascades[c_shadowCascadeCount];
+			FitShadowCascades(params, c_shadowCascadeCount, cascades);
+			for (uint32_t c = 0; c < c_shadowCascadeCount; ++c)
+			{
+				// only cull against the slice of the camera frustum this cascade covers
+				const uint32_t passIndex = c_firstCascadeShadowPass + c;
+				const glm::mat4 sliceProjection = glm::perspective(params.m_cameraFOV, aspect, cascades[c].m_splitNear, cascades[c].m_splitFar);
+				const Math::Frustum sliceFrustum(sliceProjection * params.m_cameraView);
+				packet.m_shadowPasses[passIndex].m_lightSpaceMatrix = cascades[c].m_lightSpaceMatrix;
+				passFrustums[passIndex] = Math::Frustum(cascades[c].m_lightSpaceMatrix);
+				reachFrustums[passIndex] = sliceFrustum.GetDirectionalShadowCasterFrustum(params.m_lightDirection);
+				enabledPasses |= 1 << passIndex;
+				packet.m_globals.m_shadowCascadeMatrices[c] = cascades[c].m_lightSpaceMatrix;
+				packet.m_globals.m_shadowCascadeSplits[c] = cascades[c].m_splitFar;
+			}
+		}
+		if (packet.m_cubeShadowLightIndex != -1)
+		{
+			const glm::vec3 lightPos = glm::vec3(packet.m_lights[packet.m_cubeShadowLightIndex].m_position);
+			float aspect = (float)c_cubeShadowMapSize / (float)c_cubeShadowMapSize;
+			float near = 0.1f;
+			float far = 500.0f;
+			glm::mat4 lightSpaceMatrix = glm::perspective(glm::radians(90.0f), aspect, near, far);
+			const glm::mat4 shadowTransforms[] = {
+				lightSpaceMatrix * glm::lookAt(lightPos, lightPos + glm::vec3(1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0)),
+				lightSpaceMatrix * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0)),
+				lightSpaceMatrix * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 1.0, 0.0), glm::vec3(0.0, 0.0, 1.0)),
+				lightSpaceMatrix * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, -1.0)),
+				lightSpaceMatrix * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, -1.0, 0.0)),
+				lightSpaceMatrix * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, -1.0,0.0f))
+			};
+			const Math::Frustum reachFrustum = cameraFrustum.GetPointShadowCasterFrustum(lightPos);
+			for (uint32_t cubeFace = 0; cubeFace < 6; ++cubeFace)
+			{
+				const uint32_t passIndex = c_firstCubeShadowPass + cubeFace;
+				packet.m_shadowPasses[passIndex].m_lightSpaceMatrix = shadowTransforms[cubeFace];
+				passFrustums[passIndex] = Math::Frustum(shadowTransforms[cubeFace]);
+				reachFrustums[passIndex] = reachFrustum;
+				enabledPasses |= 1 << passIndex;
+			}
+		}
+
+		// static casters are cached, so they can't depend on the camera
+		ShadowCasterRange dynamicRanges[c_shadowPassCount];
+		ShadowCasterRange staticRanges[c_shadowPassCount];
+		CullShadowCasters(packet.m_shadowCasterInstances, passFrustums, reachFrustums, enabledPasses, dynamicRanges);
+		ShadowCasterRange retainedDynamicRanges[c_shadowPassCount];
+		ShadowCasterRange retainedStaticRanges[c_shadowPassCount];
+		CullShadowCasters(packet.m_staticShadowCasterInstances, passFrustums, nullptr, enabledPasses, staticRanges);
+		CullShadowCasters(packet.m_retainedInstances[RetainedScene::ShadowCaster], passFrustums, reachFrustums, enabledPasses, retainedDynamicRanges);
+		CullShadowCasters(packet.m_retainedInstances[RetainedScene::StaticShadowCaster], passFrustums, nullptr, enabledPasses, retainedStaticRanges);
+		for (uint32_t p = 0; p < c_shadowPassCount; ++p)
+		{
+			auto& pass = packet.m_shadowPasses[p];
+			pass.m_dynamicCasters = dynamicRanges[p];
+			pass.m_staticCasters = staticRanges[p];
+			pass.m_retainedDynamicCasters = retainedDynamicRanges[p];
+			pass.m_retainedStaticCasters = retainedStaticRanges[p];
+			pass.m_staticCastersHash = (staticRanges[p].m_hash ^ retainedStaticRanges[p].m_hash) * 0x100000001b3ull;
+		}
+	}
+
+	// Tests every caster against every pass, then rebuilds the draw order as one range per pass
+	void Renderer::CullShadowCasters(InstanceList& casters, const Math::Frustum* passFrustums, const Math::Frustum* reachFrustums, uint32_t enabledPasses, ShadowCasterRange* rangesOut)
+	{
+		SDE_PROF_EVENT();
+
+		const uint32_t casterCount = enabledPasses != 0 ? static_cast<uint32_t>(casters.m_drawOrder.size()) : 0;
+		const uint32_t chunkCount = (casterCount + c_cullChunkSize - 1) / c_cullChunkSize;
+		m_shadowPassMasks.resize(casterCount);
+		uint16_t* passMasks = m_shadowPassMasks.data();
+		const Core::SortKeyIndex* drawOrder = casters.m_drawOrder.data();
+		const MeshInstance* instances = casters.m_instances.data();
+		RunInParallel(chunkCount, [&](uint32_t chunk) {
+			SDE_PROF_EVENT("CullShadowCasterChunk");
+			const uint32_t first = chunk * c_cullChunkSize;
+			const uint32_t last = std::min(first + c_cullChunkSize, casterCount);
+			for (uint32_t i = first; i < last; i += 4)
+			{
+				const Math::Box4 bounds = GatherBounds(instances, drawOrder, i, last);
+				uint32_t visibleMasks[c_shadowPassCount] = { 0 };
+				for (uint32_t p = 0; p < c_shadowPassCount; ++p)
 				{
-					return false;
+					if (enabledPasses & (1 << p))
+					{
+						visibleMasks[p] = passFrustums[p].AreBoxesVisible(bounds);
+						if (reachFrustums != nullptr)
+						{
+							visibleMasks[p] &= reachFrustums[p].AreBoxesVisible(bounds);
+						}
+					}
 				}
-				if (q1.m_distanceToCamera < q2.m_distanceToCamera)	// front to back
+				const uint32_t batchCount = std::min(4u, last - i);
+				for (uint32_t b = 0; b < batchCount; ++b)
 				{
-					return true;
+					uint16_t casterPasses = 0;
+					for (uint32_t p = 0; p < c_shadowPassCount; ++p)
+					{
+						casterPasses |= ((visibleMasks[p] >> b) & 1) << p;
+					}
+					passMasks[i + b] = casterPasses;
 				}
-				else if (q1.m_distanceToCamera > q2.m_distanceToCamera)
+			}
+		});
+
+		// one range per pass, each a subset of the sorted casters so batching still works
+		auto& passDrawOrder = casters.m_sortScratch;
+		passDrawOrder.clear();
+		for (uint32_t p = 0; p < c_shadowPassCount; ++p)
+		{
+			auto& range = rangesOut[p];
+			range.m_firstInstance = static_cast<uint32_t>(passDrawOrder.size());
+			range.m_hash = 0xcbf29ce484222325ull;
+			for (uint32_t i = 0; i < casterCount && passDrawOrder.size() < c_maxShadowInstances; ++i)
+			{
+				if (passMasks[i] & (1 << p))
 				{
-					return false;
+					passDrawOrder.push_back(casters.m_drawOrder[i]);
+					range.m_hash = HashShadowCaster(range.m_hash, instances[casters.m_drawOrder[i].m_index]);
 				}
-				return false;
-			});
+			}
+			range.m_instanceCount = static_cast<uint32_t>(passDrawOrder.size()) - range.m_firstInstance;
 		}
+		std::swap(casters.m_drawOrder, passDrawOrder);
 	}
 
-	void Renderer::DrawInstances(Render::Device& d, const InstanceList& list, Render::UniformBuffer* uniforms, ShaderHandle shaderOverride)
+	void Renderer::SortInstances(InstanceList& list)
 	{
 		SDE_PROF_EVENT();
-		auto firstInstance = list.m_instances.begin();
+		list.m_sortScratch.resize(list.m_drawOrder.size());
+		Core::RadixSort(list.m_drawOrder.data(), list.m_sortScratch.data(), list.m_drawOrder.size());
+	}
+
+	// Draws the command groups built for [first, first + count), the range must match one passed to PrepareDrawCommands
+	void Renderer::DrawInstances(Render::Device& d, const InstanceList& list, const Render::RenderBuffer& instanceData, uint32_t first, uint32_t count, Render::UniformBuffer* uniforms, ShaderHandle shaderOverride)
+	{
+		SDE_PROF_EVENT();
+		const auto& groups = list.m_drawCommands.Groups();
+		const auto& commands = list.m_drawCommands.Commands();
+		const auto& indexedCommands = list.m_drawCommands.IndexedCommands();
+		const bool useIndirect = m_useIndirectDraws && list.m_drawCommandsOffset != Render::RingBuffer::c_allocationFailed;
+		const uint32_t end = first + count;
 		const Render::ShaderProgram* lastShaderUsed = nullptr;	// avoid setting the same shader
+		uint32_t shadowSampler = -1, shadowCubeSampler = -1;	// looked up once per shader
 		Render::ShaderProgram* shaderOverridePtr = m_shaders->GetShader(shaderOverride);
-		while (firstInstance != list.m_instances.end())
+
+		// bind shader + globals UBO
+		auto bindShader = [&](Render::ShaderProgram& shader) {
+			d.BindShaderProgram(shader);
+			d.BindUniformBufferIndex(shader, "Globals", 0);
+			d.SetUniforms(shader, m_globalsRing.GetBuffer(), 0, m_globalsOffset, sizeof(GlobalUniforms));
+			if (uniforms != nullptr)
+			{
+				uniforms->Apply(d, shader);
+			}
+		};
+
+		// bind vertex array + instancing streams immediately after mesh vertex streams, then the mesh material
+		auto bindMesh = [&](Render::ShaderProgram& shader, const Render::Mesh& mesh) {
+			const auto& va = mesh.GetVertexArray();
+			int instancingSlotIndex = va.GetStreamCount();
+			d.BindVertexArray(va);
+			d.BindInstanceBuffer(va, instanceData, instancingSlotIndex++, 4, Render::VertexDataType::Float, 0, sizeof(InstanceData));
+			d.BindInstanceBuffer(va, instanceData, instancingSlotIndex++, 4, Render::VertexDataType::Float, sizeof(float) * 4, sizeof(InstanceData));
+			d.BindInstanceBuffer(va, instanceData, instancingSlotIndex++, 4, Render::VertexDataType::Float, sizeof(float) * 8, sizeof(InstanceData));
+			d.BindInstanceBuffer(va, instanceData, instancingSlotIndex++, 4, Render::VertexDataType::HalfFloat, sizeof(float) * 12, sizeof(InstanceData));
+			d.BindInstanceBuffer(va, instanceData, instancingSlotIndex++, 1, Render::VertexDataType::UnsignedInt, sizeof(float) * 14, sizeof(InstanceData));
+
+			// apply mesh material uniforms and samplers
+			uint32_t textureUnit = 0;
+			if (shadowSampler != -1)
+			{
+				d.SetSampler(shadowSampler, m_shadowDepthBuffer.GetDepthStencil()->GetHandle(), textureUnit++);
+			}
+			if (shadowCubeSampler != -1)
+			{
+				d.SetSampler(shadowCubeSampler, m_shadowCubeDepthBuffer.GetDepthStencil()->GetHandle(), textureUnit++);
+			}
+			smol::ApplyMaterial(d, shader, mesh.GetMaterial(), *m_textures, g_defaultTextures, textureUnit);
+		};
+
+		for (uint32_t g = list.m_drawCommands.FindGroup(first); g < groups.size() && groups[g].m_firstDrawOrder < end; ++g)
 		{
-			// Batch by shader and mesh
-			auto lastMeshInstance = std::find_if(firstInstance, list.m_instances.end(), [firstInstance](const smol::MeshInstance& m) -> bool {
-				return  m.m_mesh != firstInstance->m_mesh || m.m_shader.m_index != firstInstance->m_shader.m_index;
-				});
-			auto instanceCount = (uint32_t)(lastMeshInstance - firstInstance);
-			const Render::Mesh* theMesh = firstInstance->m_mesh;
-			Render::ShaderProgram* theShader = shaderOverridePtr != nullptr ? shaderOverridePtr :m_shaders->GetShader(firstInstance->m_shader);
-			if (theShader != nullptr && theMesh != nullptr)
+			// everything in a group shares the shader + mesh, the instance data for each command is contiguous
+			const auto& group = groups[g];
+			const Render::Mesh* theMesh = group.m_mesh;
+			Render::ShaderProgram* theShader = shaderOverridePtr != nullptr ? shaderOverridePtr : m_shaders->GetShader(group.m_shader);
+			if (theShader != nullptr)
 			{
 				m_frameStats.m_batchesDrawn++;
-
-				// bind shader + globals UBO
 				if (theShader != lastShaderUsed)
 				{
 					m_frameStats.m_shaderBinds++;
-					d.BindShaderProgram(*theShader);
-					d.BindUniformBufferIndex(*theShader, "Globals", 0);
-					d.SetUniforms(*theShader, m_globalsUniformBuffer, 0);
-					if (uniforms != nullptr)
-					{
-						uniforms->Apply(d, *theShader);
-					}
+					bindShader(*theShader);
+					shadowSampler = theShader->GetUniformHandle("ShadowMapTexture");
+					shadowCubeSampler = theShader->GetUniformHandle("ShadowCubeMapTexture");
 					lastShaderUsed = theShader;
 				}
-
-				// bind vertex array + instancing streams immediately after mesh vertex streams
 				m_frameStats.m_vertexArrayBinds++;
-				int instancingSlotIndex = theMesh->GetVertexArray().GetStreamCount();
-				d.BindVertexArray(theMesh->GetVertexArray());
-				d.BindInstanceBuffer(theMesh->GetVertexArray(), list.m_transforms, instancingSlotIndex++, 4, 0, 4);
-				d.BindInstanceBuffer(theMesh->GetVertexArray(), list.m_transforms, instancingSlotIndex++, 4, sizeof(float) * 4, 4);
-				d.BindInstanceBuffer(theMesh->GetVertexArray(), list.m_transforms, instancingSlotIndex++, 4, sizeof(float) * 8, 4);
-				d.BindInstanceBuffer(theMesh->GetVertexArray(), list.m_transforms, instancingSlotIndex++, 4, sizeof(float) * 12, 4);
-				d.BindInstanceBuffer(theMesh->GetVertexArray(), list.m_colours, instancingSlotIndex++, 4, 0);
-
-				// apply mesh material uniforms and samplers
-				uint32_t textureUnit = 0;
-				auto shadowSampler = theShader->GetUniformHandle("ShadowMapTexture");
-				if (shadowSampler != -1)
+				bindMesh(*theShader, *theMesh);
+
+#ifdef SDE_DEBUG
+				// the same state again must be filtered completely, anything issued means the cache is missing some state
+				const auto statsBefore = d.GetStateCacheStats();
+				bindShader(*theShader);
+				bindMesh(*theShader, *theMesh);
+				const auto& statsAfter = d.GetStateCacheStats();
+				SDE_ASSERT(statsAfter.m_callsIssued == statsBefore.m_callsIssued, "Replaying identical draw state issued %d calls", (int)(statsAfter.m_callsIssued - statsBefore.m_callsIssued));
+				m_stateValidationCalls += statsAfter.m_callsFiltered - statsBefore.m_callsFiltered;
+#endif
+
+				// one multi-draw for the whole group, or replay the commands one at a time
+				if (useIndirect && group.m_indexed)
+				{
+					const size_t commandOffset = list.m_indexedCommandsOffset + group.m_firstCommand * sizeof(DrawElementsIndirectCommand);
+					d.DrawPrimitivesIndexedIndirect(group.m_primitiveType, m_instanceRing.GetBuffer(), commandOffset, group.m_commandCount);
+					m_frameStats.m_drawCalls++;
+					m_frameStats.m_multiDraws++;
+					m_frameStats.m_multiDrawCommands += group.m_commandCount;
+				}
+				else if (useIndirect)
 				{
-					d.SetSampler(shadowSampler, m_shadowDepthBuffer.GetDepthStencil()->GetHandle(), textureUnit++);
+					const size_t commandOffset = list.m_drawCommandsOffset + group.m_firstCommand * sizeof(DrawArraysIndirectCommand);
+					d.DrawPrimitivesIndirect(group.m_primitiveType, m_instanceRing.GetBuffer(), commandOffset, group.m_commandCount);
+					m_frameStats.m_drawCalls++;
+					m_frameStats.m_multiDraws++;
+					m_frameStats.m_multiDrawCommands += group.m_commandCount;
 				}
-				auto shadowCubeSampler = theShader->GetUniformHandle("ShadowCubeMapTexture");
-				if (shadowCubeSampler != -1)
+				else if (group.m_indexed)
 				{
-					d.SetSampler(shadowCubeSampler, m_shadowCubeDepthBuffer.GetDepthStencil()->GetHandle(), textureUnit++);
+					for (uint32_t c = group.m_firstCommand; c < group.m_firstCommand + group.m_commandCount; ++c)
+					{
+						const auto& cmd = indexedCommands[c];
+						d.DrawPrimitivesIndexedInstanced(group.m_primitiveType, cmd.m_firstIndex, cmd.m_indexCount, cmd.m_instanceCount, cmd.m_baseInstance);
+						m_frameStats.m_drawCalls++;
+					}
 				}
-				textureUnit = smol::ApplyMaterial(d, *theShader, theMesh->GetMaterial(), *m_textures, g_defaultTextures, textureUnit++);
-
-				// draw the chunks
-				for (const auto& chunk : theMesh->GetChunks())
+				else
 				{
-					uint32_t firstIndex = (uint32_t)(firstInstance - list.m_instances.begin());
-					d.DrawPrimitivesInstanced(chunk.m_primitiveType, chunk.m_firstVertex, chunk.m_vertexCount, instanceCount, firstIndex);
-					m_frameStats.m_drawCalls++;
-					m_frameStats.m_totalVertices += chunk.m_vertexCount * instanceCount;
+					for (uint32_t c = group.m_firstCommand; c < group.m_firstCommand + group.m_commandCount; ++c)
+					{
+						const auto& cmd = commands[c];
+						d.DrawPrimitivesInstanced(group.m_primitiveType, cmd.m_firstVertex, cmd.m_vertexCount, cmd.m_instanceCount, cmd.m_baseInstance);
+						m_frameStats.m_drawCalls++;
+					}
 				}
+				m_frameStats.m_drawCommands += group.m_commandCount;
+				m_frameStats.m_totalVertices += group.m_vertexCount;
 			}
-			firstInstance = lastMeshInstance;
+		}
+	}
+
+	void Renderer::SubmitPacket()
+	{
+		SDE_PROF_EVENT();
+
+		// capture any settings that may change before the packet is drawn
+		m_currentPacket->m_camera = m_camera;
+		m_currentPacket->m_lodErrorScale = GetLodErrorScale(1.0f);
+		m_currentPacket->m_shadowLodErrorScale = GetLodErrorScale(m_shadowLodBias);
+		m_currentPacket->m_clearColour = m_clearColour;
+		m_currentPacket->m_hdrExposure = m_hdrExposure;
+		m_currentPacket->m_shadowBias = m_shadowBias;
+		m_currentPacket->m_cubeShadowBias = m_cubeShadowBias;
+		if (m_models->TakeRetiredModels(m_currentPacket->m_retiredModels))
+		{
+			ReloadInstances();		// this packet destroys the render thread instances that point at the old meshes
+		}
+		ResolveRetainedInstances();
+		std::swap(m_currentPacket->m_retainedCommands, m_retainedScene->m_pendingCommands);
+		m_currentPacket->m_retainedFullUpload = m_retainedScene->m_needsFullUpload;
+		m_retainedScene->m_needsFullUpload = false;
+
+		// waits here if the gpu is still reading the partitions, the render thread can't touch fences
+		m_currentPacket->m_ringPartition = m_instanceRing.AcquirePartition();
+		const uint32_t globalsPartition = m_globalsRing.AcquirePartition();
+		const uint32_t lightsPartition = m_lightsRing.AcquirePartition();
+		SDE_ASSERT(globalsPartition == m_currentPacket->m_ringPartition && lightsPartition == m_currentPacket->m_ringPartition, "Ring buffers out of step");
+		{
+			Core::ScopedMutex lock(m_prepareQueueLock);
+			m_prepareQueue.push_back(m_currentPacket.get());
+		}
+		m_inFlightPackets.push_back(std::move(m_currentPacket));
+		m_packetsToPrepare.Post();
+
+		if (m_freePackets.size() > 0)
+		{
+			m_currentPacket = std::move(m_freePackets.back());
+			m_freePackets.pop_back();
+		}
+		else
+		{
+			m_currentPacket = std::make_unique<FramePacket>();
+		}
+		m_currentPacket->Clear();
+		m_mainContext = &CreateSubmissionContext();
+	}
+
+	std::unique_ptr<Renderer::FramePacket> Renderer::WaitForOldestPacket()
+	{
+		SDE_PROF_STALL("WaitForRenderThread");
+		SDE_ASSERT(m_inFlightPackets.size() > 0);
+
+		// packets are prepared in order, so the oldest one is always ready first
+		m_packetsPrepared.Wait();
+		auto packet = std::move(m_inFlightPackets.front());
+		m_inFlightPackets.pop_front();
+		return packet;
+	}
+
+	void Renderer::FlushFrames()
+	{
+		SDE_PROF_EVENT();
+		while (m_inFlightPackets.size() > 0)
+		{
+			auto packet = WaitForOldestPacket();
+			m_instanceRing.DiscardPartition(packet->m_ringPartition);
+			m_globalsRing.DiscardPartition(packet->m_ringPartition);
+			m_lightsRing.DiscardPartition(packet->m_ringPartition);
+			packet->m_retiredModels.clear();
+			m_freePackets.push_back(std::move(packet));
+			m_retainedScene->m_needsFullUpload = true;	// retained changes were applied but never uploaded
 		}
 	}
 
 	void Renderer::RenderAll(Render::Device& d)
 	{
 		SDE_PROF_EVENT();
-		auto totalInstances = m_opaqueInstances.m_instances.size() + m_transparentInstances.m_instances.size();
-		m_frameStats = { totalInstances,0,0,0,0 };
+
+		// hand this frame to the render thread, then draw whatever is older than the latency allows
+		SubmitPacket();
+		while (m_inFlightPackets.size() > m_frameLatency)
+		{
+			auto packet = WaitForOldestPacket();
+			DrawPacket(d, *packet);
+			packet->m_retiredModels.clear();
+			m_freePackets.push_back(std::move(packet));
+		}
+	}
+
+	void Renderer::DrawPacket(Render::Device& d, const FramePacket& packet)
+	{
+		SDE_PROF_EVENT();
+		auto totalInstances = packet.m_opaqueInstances.m_instances.size() + packet.m_transparentInstances.m_instances.size();
+		m_frameStats = {};
+		d.ResetStateCacheStats();
+		m_stateValidationCalls = 0;
+		m_frameStats.m_instancesSubmitted = totalInstances + packet.m_retainedOpaqueCount;
+		m_frameStats.m_instancesCulled = packet.m_instancesCulled;
+		m_frameStats.m_retainedInstances = packet.m_retainedInstanceCount;
 		{
 			SDE_PROF_EVENT("Clear main framebuffer");
 			// clear targets asap
 			d.SetDepthState(true, true);	// make sure depth write is enabled before clearing!
-			d.ClearFramebufferColourDepth(m_mainFramebuffer, m_clearColour, FLT_MAX);
+			d.ClearFramebufferColourDepth(m_mainFramebuffer, packet.m_clearColour, FLT_MAX);
 		}
 
-		// prepare instance lists for passes
-		PrepareShadowInstances(m_shadowCasterInstances);
-		PrepareOpaqueInstances(m_opaqueInstances);
-		PrepareTransparentInstances(m_transparentInstances);
-
-		// copy instance data to gpu
-		PopulateInstanceBuffers(m_shadowCasterInstances);
-		PopulateInstanceBuffers(m_opaqueInstances);
-		PopulateInstanceBuffers(m_transparentInstances);
+		// new materials are rare (model loads), so the whole dirty range is uploaded directly
+		auto& materials = m_models->GetMaterialTable();
+		if (materials.HasDirtyRange())
+		{
+			const size_t first = materials.DirtyFirst() * sizeof(MaterialTable::Entry);
+			const size_t size = (materials.DirtyEnd() - materials.DirtyFirst()) * sizeof(MaterialTable::Entry);
+			m_materialTable.SetData(first, size, materials.Data() + materials.DirtyFirst());
+			materials.ClearDirty();
+		}
 
-		// setup global constants
-		auto projectionMat = glm::perspectiveFov(glm::radians(70.0f), (float)m_windowSize.x, (float)m_windowSize.y, 0.1f, 1000.0f);
-		auto viewMat = glm::lookAt(m_camera.Position(), m_camera.Target(), m_camera.Up());
-		UpdateGlobals(projectionMat, viewMat);
-		const Light* shadowLight = nullptr;
-		const Light* cubeShadowLight = nullptr;
-		for (int l = 0; l < m_lights.size() && l < c_maxLights; ++l)
+		// instance data + globals were written to the ring by the render thread, only retained changes need copying
+		for (uint32_t l = 0; l < c_retainedBufferCount; ++l)
 		{
-			if (shadowLight == nullptr && m_lights[l].m_position.w == 0.0f)
+			const auto& upload = packet.m_retainedUploads[l];
+			if (upload.m_instanceCount > 0)
 			{
-				shadowLight = &m_lights[l];
-			}
-			else if (cubeShadowLight == nullptr && m_lights[l].m_position.w == 1.0f)
-			{
-				cubeShadowLight = &m_lights[l];
+				d.CopyBufferData(m_instanceRing.GetBuffer(), upload.m_ringOffset, m_retainedInstanceData[l], upload.m_firstInstance * sizeof(InstanceData), upload.m_instanceCount * sizeof(InstanceData));
+				m_frameStats.m_retainedInstancesUploaded += upload.m_instanceCount;
 			}
 		}
-		if (cubeShadowLight)
+		const auto& instanceData = m_instanceRing.GetBuffer();
+		const auto& retainedCasters = packet.m_retainedInstances[RetainedScene::ShadowCaster];
+		const auto& retainedStaticCasters = packet.m_retainedInstances[RetainedScene::StaticShadowCaster];
+		const auto& retainedCasterData = m_retainedInstanceData[RetainedScene::ShadowCaster];
+		const auto& retainedStaticCasterData = m_retainedInstanceData[RetainedScene::StaticShadowCaster];
+		m_globalsOffset = packet.m_globalsOffset;
+		m_frameStats.m_ringBufferWaits = m_instanceRing.WaitCount() + m_globalsRing.WaitCount() + m_lightsRing.WaitCount();
+		m_frameStats.m_lights = packet.m_globals.m_lightCount;
+		m_frameStats.m_lightClusterIndices = packet.m_lightIndicesSize / sizeof(uint32_t);
+
+		// lights, cluster lists + materials are shared by every pass, storage buffer bindings are not per shader
+		const auto& lightsBuffer = m_lightsRing.GetBuffer();
+		d.SetStorageBuffer(lightsBuffer, 0, packet.m_lightsOffset, packet.m_lightsSize);
+		d.SetStorageBuffer(lightsBuffer, 1, packet.m_lightClustersOffset, LightClusters::c_clusterCount * sizeof(LightClusters::Cluster));
+		d.SetStorageBuffer(lightsBuffer, 2, packet.m_lightIndicesOffset, packet.m_lightIndicesSize);
+		d.SetStorageBuffer(m_materialTable, 3, 0, m_materialTable.GetSize());
+		if (packet.m_cubeShadowLightIndex != -1)
 		{
 			Render::UniformBuffer uniforms;
 			SDE_PROF_EVENT("RenderShadowCubemap");
-			auto lightPos = glm::vec3(cubeShadowLight->m_position);
-			float aspect = (float)c_cubeShadowMapSize / (float)c_cubeShadowMapSize;
-			float near = 0.1f;
-			float far = 500.0f;
-			glm::mat4 lightSpaceMatrix = glm::perspective(glm::radians(90.0f), aspect, near, far);
-			const glm::mat4 shadowTransforms[] = {
-				lightSpaceMatrix * glm::lookAt(lightPos, lightPos + glm::vec3(1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0)),
-				lightSpaceMatrix * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0)),
-				lightSpaceMatrix * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 1.0, 0.0), glm::vec3(0.0, 0.0, 1.0)),
-				lightSpaceMatrix * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, -1.0)),
-				lightSpaceMatrix * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, -1.0, 0.0)),
-				lightSpaceMatrix * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, -1.0,0.0f))
-			};
+			d.SetBackfaceCulling(true, true);	// backface culling, ccw order
+			d.SetBlending(false);				// no blending, opaques only (maybe with discard)
+			d.SetScissorEnabled(false);			// (don't) scissor me timbers
 			for (uint32_t cubeFace = 0; cubeFace < 6; ++cubeFace)
 			{
+				const uint32_t passIndex = c_firstCubeShadowPass + cubeFace;
+				const auto& pass = packet.m_shadowPasses[passIndex];
+				uniforms.SetValue("ShadowLightSpaceMatrix", pass.m_lightSpaceMatrix);
+				uniforms.SetValue("ShadowLightIndex", packet.m_cubeShadowLightIndex);
+				if (m_shadowCache.NeedsUpdate(passIndex, pass.m_lightSpaceMatrix, pass.m_staticCastersHash))
+				{
+					d.DrawToFramebuffer(m_staticShadowCubeDepthBuffer, cubeFace);
+					d.SetViewport(glm::ivec2(0, 0), m_staticShadowCubeDepthBuffer.Dimensions());
+					d.ClearFramebufferDepth(m_staticShadowCubeDepthBuffer, FLT_MAX);
+					DrawInstances(d, packet.m_staticShadowCasterInstances, instanceData, pass.m_staticCasters.m_firstInstance, pass.m_staticCasters.m_instanceCount, &uniforms);
+					DrawInstances(d, retainedStaticCasters, retainedStaticCasterData, pass.m_retainedStaticCasters.m_firstInstance, pass.m_retainedStaticCasters.m_instanceCount, &uniforms);
+					m_shadowCache.MarkUpdated(passIndex, pass.m_lightSpaceMatrix, pass.m_staticCastersHash);
+					m_frameStats.m_staticShadowLayersUpdated++;
+				}
+
+				// start from the cached static depth, then add the dynamic casters
+				d.CopyFramebufferDepth(m_staticShadowCubeDepthBuffer, m_shadowCubeDepthBuffer, cubeFace);
 				d.DrawToFramebuffer(m_shadowCubeDepthBuffer, cubeFace);
 				d.SetViewport(glm::ivec2(0, 0), m_shadowCubeDepthBuffer.Dimensions());
-				d.ClearFramebufferDepth(m_shadowCubeDepthBuffer, FLT_MAX);
-				d.SetBackfaceCulling(true, true);	// backface culling, ccw order
-				d.SetBlending(false);				// no blending, opaques only (maybe with discard)
-				d.SetScissorEnabled(false);			// (don't) scissor me timbers
-				uniforms.SetValue("ShadowLightSpaceMatrix", shadowTransforms[cubeFace]);
-				uniforms.SetValue("ShadowLightIndex", (int32_t)(cubeShadowLight - &m_lights[0]));
-				DrawInstances(d, m_shadowCasterInstances, &uniforms);
+				DrawInstances(d, packet.m_shadowCasterInstances, instanceData, pass.m_dynamicCasters.m_firstInstance, pass.m_dynamicCasters.m_instanceCount, &uniforms);
+				DrawInstances(d, retainedCasters, retainedCasterData, pass.m_retainedDynamicCasters.m_firstInstance, pass.m_retainedDynamicCasters.m_instanceCount, &uniforms);
+				m_frameStats.m_cubeShadowCasters[cubeFace] = pass.m_staticCasters.m_instanceCount + pass.m_dynamicCasters.m_instanceCount
+					+ pass.m_retainedStaticCasters.m_instanceCount + pass.m_retainedDynamicCasters.m_instanceCount;
 			}
 		}
 
-		// shadow maps
-		Render::UniformBuffer lightMatUniforms;
+		// shadow maps, one cascade per quarter of the map
 		{
 			SDE_PROF_EVENT("RenderShadowmap");
-			d.DrawToFramebuffer(m_shadowDepthBuffer);
-			d.SetViewport(glm::ivec2(0, 0), m_shadowDepthBuffer.Dimensions());
-			d.ClearFramebufferDepth(m_shadowDepthBuffer, FLT_MAX);
 			d.SetBackfaceCulling(true, true);	// backface culling, ccw order
 			d.SetBlending(false);				// no blending, opaques only (maybe with discard)
 			d.SetScissorEnabled(false);			// (don't) scissor me timbers
-			if (shadowLight)
+			if (packet.m_shadowLightIndex != -1)
 			{
-				static float c_nearPlane = 1.0f;
-				static float c_farPlane = 1000.0f;
-				static float c_orthoDims = 400.0f;
-				glm::mat4 lightProjection = glm::ortho(-c_orthoDims, c_orthoDims, -c_orthoDims, c_orthoDims, c_nearPlane, c_farPlane);
-				glm::mat4 lightView = glm::lookAt(glm::vec3(shadowLight->m_position), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-				glm::mat4 lightSpaceMatrix = lightProjection * lightView;
-				lightMatUniforms.SetValue("ShadowLightSpaceMatrix", lightSpaceMatrix);
-				lightMatUniforms.SetValue("ShadowLightIndex", (int32_t)(shadowLight - &m_lights[0]));
-				DrawInstances(d, m_shadowCasterInstances, &lightMatUniforms);
+				Render::UniformBuffer uniforms;
+				for (uint32_t c = 0; c < c_shadowCascadeCount; ++c)
+				{
+					const uint32_t passIndex = c_firstCascadeShadowPass + c;
+					const auto& pass = packet.m_shadowPasses[passIndex];
+					const glm::ivec2 cascadeOffset = glm::ivec2(c % 2, c / 2) * c_cascadeMapSize;
+					const glm::ivec2 cascadeSize(c_cascadeMapSize, c_cascadeMapSize);
+					uniforms.SetValue("ShadowLightSpaceMatrix", pass.m_lightSpaceMatrix);
+					uniforms.SetValue("ShadowLightIndex", packet.m_shadowLightIndex);
+					if (m_shadowCache.NeedsUpdate(passIndex, pass.m_lightSpaceMatrix, pass.m_staticCastersHash))
+					{
+						// only clear this cascade, the others may still be valid
+						d.DrawToFramebuffer(m_staticShadowDepthBuffer);
+						d.SetViewport(cascadeOffset, cascadeSize);
+						d.SetScissorEnabled(true);
+						d.SetScissorRect(cascadeOffset, cascadeSize);
+						d.ClearFramebufferDepth(m_staticShadowDepthBuffer, FLT_MAX);
+						d.SetScissorEnabled(false);
+						DrawInstances(d, packet.m_staticShadowCasterInstances, instanceData, pass.m_staticCasters.m_firstInstance, pass.m_staticCasters.m_instanceCount, &uniforms);
+						DrawInstances(d, retainedStaticCasters, retainedStaticCasterData, pass.m_retainedStaticCasters.m_firstInstance, pass.m_retainedStaticCasters.m_instanceCount, &uniforms);
+						m_shadowCache.MarkUpdated(passIndex, pass.m_lightSpaceMatrix, pass.m_staticCastersHash);
+						m_frameStats.m_staticShadowLayersUpdated++;
+					}
+
+					// start from the cached static depth, then add the dynamic casters
+					d.CopyFramebufferDepth(m_staticShadowDepthBuffer, m_shadowDepthBuffer, cascadeOffset, cascadeSize);
+					d.DrawToFramebuffer(m_shadowDepthBuffer);
+					d.SetViewport(cascadeOffset, cascadeSize);
+					DrawInstances(d, packet.m_shadowCasterInstances, instanceData, pass.m_dynamicCasters.m_firstInstance, pass.m_dynamicCasters.m_instanceCount, &uniforms);
+					DrawInstances(d, retainedCasters, retainedCasterData, pass.m_retainedDynamicCasters.m_firstInstance, pass.m_retainedDynamicCasters.m_instanceCount, &uniforms);
+					m_frameStats.m_cascadeShadowCasters[c] = pass.m_staticCasters.m_instanceCount + pass.m_dynamicCasters.m_instanceCount
+						+ pass.m_retainedStaticCasters.m_instanceCount + pass.m_retainedDynamicCasters.m_instanceCount;
+				}
+			}
+			else
+			{
+				d.ClearFramebufferDepth(m_shadowDepthBuffer, FLT_MAX);
 			}
 		}
 
@@ -550,12 +1687,16 @@ namespace smol
 			d.SetBackfaceCulling(true, true);	// backface culling, ccw order
 			d.SetBlending(false);				// no blending for opaques
 			d.SetScissorEnabled(false);			// (don't) scissor me timbers
-			DrawInstances(d, m_opaqueInstances, &lightMatUniforms);
+			const auto& opaques = packet.m_opaqueInstances;
+			DrawInstances(d, opaques, instanceData, 0, static_cast<uint32_t>(opaques.m_drawOrder.size()));
+			const auto& retainedOpaques = packet.m_retainedInstances[RetainedScene::Opaque];
+			DrawInstances(d, retainedOpaques, m_retainedInstanceData[RetainedScene::Opaque], 0, static_cast<uint32_t>(retainedOpaques.m_drawOrder.size()));
 
 			// render transparents
 			d.SetDepthState(true, false);		// enable z-test, disable write
 			d.SetBlending(true);
-			DrawInstances(d, m_transparentInstances, &lightMatUniforms);
+			const auto& transparents = packet.m_transparentInstances;
+			DrawInstances(d, transparents, instanceData, 0, static_cast<uint32_t>(transparents.m_drawOrder.size()));
 		}
 
 		// blit main buffer to backbuffer
@@ -566,5 +1707,13 @@ namespace smol
 		{
 			m_targetBlitter.TargetToBackbuffer(d, m_mainFramebuffer, *blitShader, m_windowSize);
 		}
+
+		// fence the partition, it can be reused once the gpu passes this point
+		m_instanceRing.ReleasePartition(packet.m_ringPartition);
+		m_globalsRing.ReleasePartition(packet.m_ringPartition);
+		m_lightsRing.ReleasePartition(packet.m_ringPartition);
+
+		m_frameStats.m_stateChangesIssued = d.GetStateCacheStats().m_callsIssued;
+		m_frameStats.m_stateChangesFiltered = d.GetStateCacheStats().m_callsFiltered - m_stateValidationCalls;	// debug replays don't count
 	}
 }
\ No newline at end of file
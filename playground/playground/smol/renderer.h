@@ -1,15 +1,32 @@
 #pragma once
 #include "render/render_pass.h"
 #include "render/render_buffer.h"
+#include "render/ring_buffer.h"
 #include "render/frame_buffer.h"
 #include "render/camera.h"
 #include "math/glm_headers.h"
+#include "math/frustum.h"
+#include "core/flat_hash_map.h"
+#include "core/radix_sort.h"
+#include "kernel/thread.h"
+#include "kernel/mutex.h"
+#include "kernel/semaphore.h"
+#include "kernel/atomics.h"
 #include "mesh_instance.h"
+#include "draw_commands.h"
+#include "light_clusters.h"
 #include "render_target_blitter.h"
 #include "light.h"
+#include "shadow_cache.h"
 #include <vector>
 #include <memory>
-#include <unordered_map>
+#include <deque>
+#include <functional>
+
+namespace SDE
+{
+	class JobSystem;
+}
 
 namespace Render
 {
@@ -24,70 +41,199 @@ namespace smol
 	class ShaderManager;
 	struct ShaderHandle;
 
+	struct RenderInstanceHandle
+	{
+		uint32_t m_index = -1;		// generation + index, see Core::SlotMap
+		static RenderInstanceHandle Invalid() { return { (uint32_t)-1 }; };
+	};
+
+	// Frames are pipelined; RenderAll captures everything submitted this frame into a packet and hands it to
+	// the render thread, which sorts and builds the instance data while the game simulates the next frame.
+	// GL calls stay on the main thread, prepared packets are drawn up to 'frame latency' frames later
 	class Renderer : public Render::RenderPass
 	{
 	public:
-		Renderer(TextureManager* ta, ModelManager* mm, ShaderManager* sm, glm::ivec2 windowSize);			
-		virtual ~Renderer() = default;
+		static const uint32_t c_maxFrameLatency = 2;
+		static const uint32_t c_shadowCascadeCount = 4;		// 2 to 4, directional light shadows
+
+		Renderer(TextureManager* ta, ModelManager* mm, ShaderManager* sm, glm::ivec2 windowSize, SDE::JobSystem* js);			
+		virtual ~Renderer();
 
 		void Reset();
 		void RenderAll(Render::Device&);
+		void FlushFrames();		// waits for + discards frames in flight, call before freeing anything they reference
+		void SetFrameLatency(uint32_t frames);	// 0 = draw the frame immediately
+		uint32_t GetFrameLatency() const { return m_frameLatency; }
 		void SetCamera(const Render::Camera& c);
-		void SubmitInstance(glm::mat4 transform, glm::vec4 colour, const Render::Mesh& mesh, const struct ShaderHandle& shader);
-		void SubmitInstance(glm::mat4 transform, glm::vec4 colour, const struct ModelHandle& model, const struct ShaderHandle& shader);
+
+		// Instances can be gathered on any thread via submission contexts, see below
+		class SubmissionContext;
+		SubmissionContext& CreateSubmissionContext();
+
+		// Static instances promise not to move or change, their shadows are cached until the light moves
+		void SubmitInstance(glm::mat4 transform, glm::vec4 colour, const Render::Mesh& mesh, const struct ShaderHandle& shader, bool isStatic = false);
+		void SubmitInstance(glm::mat4 transform, glm::vec4 colour, const struct ModelHandle& model, const struct ShaderHandle& shader, bool isStatic = false);
+
+		// Retained instances persist until destroyed, only the changes are sent to the render thread + uploaded
+		// They appear once the model + shader have loaded, and are created again when ModelManager::ReloadAll replaces their model
+		RenderInstanceHandle CreateInstance(glm::mat4 transform, glm::vec4 colour, const struct ModelHandle& model, const struct ShaderHandle& shader, bool isStatic = false);
+		void UpdateInstance(RenderInstanceHandle h, glm::mat4 transform, glm::vec4 colour);
+		void DestroyInstance(RenderInstanceHandle h);
+		void ReloadInstances();
+
 		void SetLight(glm::vec4 positionOrDir,glm::vec3 colour, float ambientStr, glm::vec3 attenuation);
 		void SetClearColour(glm::vec4 c) { m_clearColour = c; }
 		void SetShadowsShader(ShaderHandle lightingShader, ShaderHandle shadowShader);
 		Render::FrameBuffer& GetMainFramebuffer() { return m_mainFramebuffer; }
 		struct FrameStats {
 			size_t m_instancesSubmitted;
+			size_t m_instancesCulled;
+			size_t m_retainedInstances;			// included in submitted
+			size_t m_retainedInstancesUploaded;
+			size_t m_cascadeShadowCasters[c_shadowCascadeCount];
+			size_t m_cubeShadowCasters[6];		// +x, -x, +y, -y, +z, -z
+			size_t m_staticShadowLayersUpdated;	// cascades + cube faces where the cached static shadows were redrawn
+			size_t m_ringBufferWaits;			// total times the cpu waited for the gpu to release a ring buffer partition
+			size_t m_lights;
+			size_t m_lightClusterIndices;		// point light references across all clusters
+			size_t m_stateChangesIssued;		// device state changes that reached GL
+			size_t m_stateChangesFiltered;		// redundant device state changes skipped
 			size_t m_shaderBinds;
 			size_t m_vertexArrayBinds;
 			size_t m_batchesDrawn;
 			size_t m_drawCalls;
+			size_t m_drawCommands;				// individual draws, a multi-draw call issues many
+			size_t m_multiDraws;				// indirect draw calls, each covers one DrawCommandGroup
+			size_t m_multiDrawCommands;			// commands issued by them, see DrawCommandGroup for why this stays low
 			size_t m_totalVertices;
 		};
 		const FrameStats& GetStats() const { return m_frameStats; }
 		float& GetExposure() { return m_hdrExposure; }
 		float& GetShadowBias() { return m_shadowBias; }
 		float& GetCubeShadowBias() { return m_cubeShadowBias; }
+		float& GetLodErrorPixels() { return m_lodErrorPixels; }	// screen-space error allowed when picking mesh lods, 0 = always full detail
+		float& GetShadowLodBias() { return m_shadowLodBias; }		// multiplies the allowed error for dynamic shadow casters, static ones ignore the camera
+		bool& GetUseIndirectDraws() { return m_useIndirectDraws; }	// off = replay the same commands as direct draws
 	private:
+		// Compact per-instance vertex data, unpacked in shared.vs
+		struct InstanceData
+		{
+			float m_transformRows[3][4];	// top 3 rows of an affine transform
+			uint64_t m_colour;				// RGBA16F, colours can go above 1
+			uint32_t m_materialIndex;		// into the material table
+			uint32_t m_padding;
+		};
 		struct InstanceList
 		{
-			std::vector<MeshInstance> m_instances;
-			Render::RenderBuffer m_transforms;
-			Render::RenderBuffer m_colours;
+			using SortKeyFn = uint64_t(*)(const ShaderHandle& shader, uint32_t materialId, const Render::Mesh* mesh, float distanceToCamera);
+			InstanceList(SortKeyFn makeKey) : m_makeSortKey(makeKey) {}
+			void Clear() { m_instances.clear(); m_drawOrder.clear(); m_drawCommands.Clear(); }
+			SortKeyFn m_makeSortKey;
+			std::vector<MeshInstance> m_instances;			// submission order, never sorted
+			std::vector<Core::SortKeyIndex> m_drawOrder;	// key built on submit + sorted, then replaced with the instance buffer position
+			std::vector<Core::SortKeyIndex> m_sortScratch;
+			DrawCommandList m_drawCommands;					// built from the final draw order
+			size_t m_drawCommandsOffset = Render::RingBuffer::c_allocationFailed;	// commands copied into the instance ring
+			size_t m_indexedCommandsOffset = Render::RingBuffer::c_allocationFailed;	// directly after the non-indexed commands
 		};
-		using ShadowShaders = std::unordered_map<uint32_t, ShaderHandle>;
+		struct FramePacket;		// see renderer.cpp
+		struct RetainedScene;
+		static const uint32_t c_retainedBufferCount = 3;	// opaque, shadow casters, static shadow casters
+		using ShadowShaders = Core::FlatHashMap<uint32_t, ShaderHandle>;
 
-		void SubmitInstance(InstanceList& list, glm::vec3 cameraPos, glm::mat4 transform, glm::vec4 colour, const Render::Mesh& mesh, const struct ShaderHandle& shader);
-		void CreateInstanceList(InstanceList& newlist, uint32_t maxInstances);
-		void PrepareOpaqueInstances(InstanceList& list);
-		void PrepareTransparentInstances(InstanceList& list);
-		void PrepareShadowInstances(InstanceList& list);
-		void PopulateInstanceBuffers(InstanceList& list);
-		void DrawInstances(Render::Device& d, const InstanceList& list, Render::UniformBuffer* uniforms = nullptr, ShaderHandle shaderOverride = ShaderHandle::Invalid());
-		void UpdateGlobals(glm::mat4 projectionMat, glm::mat4 viewMat);
+		void MergeInstances(InstanceList& target, InstanceList& source);
+		size_t CullInstances(InstanceList& list, const Math::Frustum& frustum);
+		void ResolveRetainedInstances();
+		void PrepareRetainedInstances(FramePacket& packet);
+		void PrepareShadowPasses(FramePacket& packet, const Math::Frustum& cameraFrustum);
+		void CullShadowCasters(InstanceList& casters, const Math::Frustum* passFrustums, const Math::Frustum* reachFrustums, uint32_t enabledPasses, struct ShadowCasterRange* rangesOut);
+		void SortInstances(InstanceList& list);
+		static void PackInstanceData(const MeshInstance& instance, InstanceData& out);
+		void PrepareInstanceData(InstanceList& list, uint32_t ringPartition);
+		void PrepareDrawCommands(InstanceList& list, const struct ShadowCasterRange* ranges, uint32_t rangeCount);
+		void PrepareGlobals(FramePacket& packet);
+		void PrepareLights(FramePacket& packet);
+		void PreparePacket(FramePacket& packet);
+		void DrawInstances(Render::Device& d, const InstanceList& list, const Render::RenderBuffer& instanceData, uint32_t first, uint32_t count, Render::UniformBuffer* uniforms = nullptr, ShaderHandle shaderOverride = ShaderHandle::Invalid());
+		void DrawPacket(Render::Device& d, const FramePacket& packet);
+		void SubmitPacket();
+		std::unique_ptr<FramePacket> WaitForOldestPacket();
+		int32_t RenderThread();
+		void RunInParallel(uint32_t chunkCount, const std::function<void(uint32_t)>& fn);
+		float GetLodErrorScale(float bias) const;
 
 		FrameStats m_frameStats;
+		uint64_t m_stateValidationCalls = 0;		// filtered by the debug state replay in DrawInstances, not real traffic
 		float m_hdrExposure = 1.0f;
-		std::vector<Light> m_lights;
-		InstanceList m_opaqueInstances;
-		InstanceList m_transparentInstances;
-		InstanceList m_shadowCasterInstances;
+		bool m_useIndirectDraws = true;
+		std::unique_ptr<FramePacket> m_currentPacket;			// filled by the main thread this frame
+		SubmissionContext* m_mainContext = nullptr;				// owned by the current packet, used by SubmitInstance
+		std::deque<std::unique_ptr<FramePacket>> m_inFlightPackets;	// submitted to the render thread, oldest first
+		std::vector<std::unique_ptr<FramePacket>> m_freePackets;
+		uint32_t m_frameLatency = 1;
+		Render::RingBuffer m_instanceRing;		// per-frame instance data, written directly by the render thread
+		Render::RingBuffer m_globalsRing;
+		Render::RingBuffer m_lightsRing;		// light info + cluster lists, shader storage
+		size_t m_globalsOffset = 0;				// into m_globalsRing for the packet being drawn
+		Render::RenderBuffer m_retainedInstanceData[c_retainedBufferCount];	// dirty ranges are copied in from the ring on the gpu
+		Render::RenderBuffer m_materialTable;	// copy of the model manager material table
+		std::unique_ptr<RetainedScene> m_retainedScene;
 		glm::vec4 m_clearColour = { 0.0f,0.0f,0.0f,1.0f };
 		float m_shadowBias = 0.01f;
 		float m_cubeShadowBias = 0.7f;
+		float m_lodErrorPixels = 1.0f;
+		float m_shadowLodBias = 4.0f;		// shadow maps are lower resolution than the screen + soft filtered
 		ShadowShaders m_shadowShaders;	// map of lighting shader handle index -> shadow shader
 		ShaderManager* m_shaders;
 		smol::TextureManager* m_textures;
 		smol::ModelManager* m_models;
+		SDE::JobSystem* m_jobSystem;
 		RenderTargetBlitter m_targetBlitter;
-		Render::RenderBuffer m_globalsUniformBuffer;
 		Render::FrameBuffer m_mainFramebuffer;
 		Render::FrameBuffer m_shadowDepthBuffer;
 		Render::FrameBuffer m_shadowCubeDepthBuffer;
+		Render::FrameBuffer m_staticShadowDepthBuffer;		// static casters only, copied to the shadow maps each frame
+		Render::FrameBuffer m_staticShadowCubeDepthBuffer;
+		ShadowCache m_shadowCache;
 		Render::Camera m_camera;
 		glm::ivec2 m_windowSize;
+
+		// render thread. only ever touches packets it has been given
+		Kernel::Thread m_renderThread;
+		Kernel::Mutex m_prepareQueueLock;
+		std::deque<FramePacket*> m_prepareQueue;
+		Kernel::Semaphore m_packetsToPrepare;
+		Kernel::Semaphore m_packetsPrepared;
+		Kernel::AtomicInt32 m_stopRenderThread = 0;
+		std::vector<uint32_t> m_cullChunkCounts;
+		std::vector<uint16_t> m_shadowPassMasks;		// bit per shadow pass for each caster
+		std::vector<glm::vec4> m_lightBounds;			// point light position + radius
+		LightClusters m_lightClusters;
+	};
+
+	// Collects instances for the current frame from a single thread at a time
+	// Create one per job on the main thread, then fill them in parallel. All jobs must finish before RenderAll,
+	// everything submitted is merged + sorted on the render thread.
+	// Submission reads from the model/texture/shader managers, so don't load assets while jobs are submitting
+	class Renderer::SubmissionContext
+	{
+	public:
+		void SubmitInstance(glm::mat4 transform, glm::vec4 colour, const Render::Mesh& mesh, const struct ShaderHandle& shader, bool isStatic = false);
+		void SubmitInstance(glm::mat4 transform, glm::vec4 colour, const struct ModelHandle& model, const struct ShaderHandle& shader, bool isStatic = false);
+
+	private:
+		friend class Renderer;
+		SubmissionContext(const Renderer& r);
+		void Clear();
+		void SubmitInstance(InstanceList& list, glm::mat4 transform, glm::vec4 colour, const Render::Mesh& mesh, uint32_t materialId, uint32_t materialIndex, const struct ShaderHandle& shader, const Math::Box3* worldBounds, float lodErrorScale);
+
+		const Renderer& m_renderer;
+		glm::vec3 m_cameraPosition = { 0.0f, 0.0f, 0.0f };
+		float m_lodErrorScale = 0.0f;			// see SelectInstanceLod
+		float m_shadowLodErrorScale = 0.0f;
+		InstanceList m_opaqueInstances;
+		InstanceList m_transparentInstances;
+		InstanceList m_shadowCasterInstances;
+		InstanceList m_staticShadowCasterInstances;
 	};
 }
@@ -142,7 +142,7 @@ namespace smol
 				});
 
 			// use the texture or our in built white texture
-			smol::TextureHandle texture = firstQuad->m_texture.m_index != (uint64_t)-1 ? firstQuad->m_texture : smol::TextureHandle{ 0 };
+			smol::TextureHandle texture = firstQuad->m_texture.m_index != TextureHandle::Invalid().m_index ? firstQuad->m_texture : smol::TextureHandle{ 0 };
 			if (samplerHandle != -1)
 			{
 				d.SetSampler(samplerHandle, m_textures->GetTexture(texture)->GetHandle(), 0);
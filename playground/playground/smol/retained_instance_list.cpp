@@ -0,0 +1,160 @@
+#include "retained_instance_list.h"
+#include "kernel/assert.h"
+#include "core/profiler.h"
+#include <algorithm>
+
+namespace smol
+{
+	const uint32_t c_notCommitted = (uint32_t)-1;	// slot position before the first Commit
+	const size_t c_minChangeLogSize = 1024;			// small lists don't restart the log every few changes
+
+	uint32_t RetainedInstanceList::Add(const MeshInstance& instance, uint64_t sortKey)
+	{
+		SDE_ASSERT(instance.m_mesh != nullptr, "Retained instances need a mesh");
+		uint32_t slot = 0;
+		if (m_freeSlots.size() > 0)
+		{
+			slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+			m_instances[slot] = instance;
+			m_slotPositions[slot] = c_notCommitted;
+		}
+		else
+		{
+			slot = static_cast<uint32_t>(m_instances.size());
+			m_instances.push_back(instance);
+			m_slotPositions.push_back(c_notCommitted);
+		}
+		m_added.push_back({ sortKey, slot });
+		LogChange(slot);
+		return slot;
+	}
+
+	void RetainedInstanceList::Update(uint32_t slot, const glm::mat4& transform, const glm::vec4& colour, const glm::vec3& boundsCenter, const glm::vec3& boundsExtents)
+	{
+		SDE_ASSERT(slot < m_instances.size() && m_instances[slot].m_mesh != nullptr, "Bad retained instance slot");
+		auto& instance = m_instances[slot];
+		instance.m_transform = transform;
+		instance.m_colour = colour;
+		instance.m_boundsCenter = boundsCenter;
+		instance.m_boundsExtents = boundsExtents;
+		const uint32_t position = m_slotPositions[slot];
+		if (position != c_notCommitted)		// new instances are uploaded when they are merged
+		{
+			MarkDirty(position, position + 1);
+		}
+		LogChange(slot);
+	}
+
+	void RetainedInstanceList::Remove(uint32_t slot)
+	{
+		SDE_ASSERT(slot < m_instances.size() && m_instances[slot].m_mesh != nullptr, "Bad retained instance slot");
+		m_instances[slot].m_mesh = nullptr;	// slots are only reused after the next Commit
+		m_removed.push_back(slot);
+		LogChange(slot);
+	}
+
+	void RetainedInstanceList::Commit()
+	{
+		SDE_PROF_EVENT();
+		if (m_added.size() == 0 && m_removed.size() == 0)
+		{
+			return;
+		}
+
+		// anything added + removed before a commit never makes it into the draw order
+		m_added.erase(std::remove_if(m_added.begin(), m_added.end(), [this](const Core::SortKeyIndex& k) {
+			return m_instances[k.m_index].m_mesh == nullptr;
+		}), m_added.end());
+
+		// removals close the gap, everything after the first removed instance moves down
+		uint32_t firstChanged = static_cast<uint32_t>(m_drawOrder.size());
+		if (m_removed.size() > 0)
+		{
+			for (uint32_t slot : m_removed)
+			{
+				firstChanged = std::min(firstChanged, m_slotPositions[slot]);	// uncommitted slots are -1, never the min
+			}
+			auto firstRemoved = m_drawOrder.begin() + std::min(firstChanged, static_cast<uint32_t>(m_drawOrder.size()));
+			m_drawOrder.erase(std::remove_if(firstRemoved, m_drawOrder.end(), [this](const Core::SortKeyIndex& k) {
+				return m_instances[k.m_index].m_mesh == nullptr;
+			}), m_drawOrder.end());
+			for (uint32_t slot : m_removed)
+			{
+				m_slotPositions[slot] = c_notCommitted;
+				m_freeSlots.push_back(slot);
+			}
+			m_removed.clear();
+		}
+
+		// sort the new keys + merge them in, existing instances with equal keys stay in front
+		if (m_added.size() > 0)
+		{
+			auto keyLess = [](const Core::SortKeyIndex& a, const Core::SortKeyIndex& b) {
+				return a.m_key < b.m_key;
+			};
+			std::sort(m_added.begin(), m_added.end(), keyLess);
+			auto firstInsert = std::upper_bound(m_drawOrder.begin(), m_drawOrder.end(), m_added[0], keyLess);
+			firstChanged = std::min(firstChanged, static_cast<uint32_t>(firstInsert - m_drawOrder.begin()));
+			const size_t oldCount = m_drawOrder.size();
+			m_drawOrder.insert(m_drawOrder.end(), m_added.begin(), m_added.end());
+			std::inplace_merge(m_drawOrder.begin() + firstChanged, m_drawOrder.begin() + oldCount, m_drawOrder.end(), keyLess);
+			m_added.clear();
+		}
+
+		const uint32_t newCount = static_cast<uint32_t>(m_drawOrder.size());
+		for (uint32_t p = firstChanged; p < newCount; ++p)
+		{
+			m_slotPositions[m_drawOrder[p].m_index] = p;
+		}
+		MarkDirty(firstChanged, newCount);
+		m_dirtyEnd = std::min(m_dirtyEnd, newCount);
+		++m_version;
+	}
+
+	size_t RetainedInstanceList::FirstChangeAfter(uint32_t version) const
+	{
+		auto first = std::upper_bound(m_changeLog.begin(), m_changeLog.end(), version, [](uint32_t v, const SlotChange& c) {
+			return v < c.m_version;
+		});
+		return first - m_changeLog.begin();
+	}
+
+	void RetainedInstanceList::LogChange(uint32_t slot)
+	{
+		// once the log is longer than the list a full copy is cheaper, start again
+		if (m_changeLog.size() >= std::max(m_instances.size(), c_minChangeLogSize))
+		{
+			m_changeLog.clear();
+			m_changeLogVersion = m_version;
+		}
+		++m_version;
+		m_changeLog.push_back({ m_version, slot });
+	}
+
+	void RetainedInstanceList::MarkAllDirty()
+	{
+		m_dirtyFirst = 0;
+		m_dirtyEnd = static_cast<uint32_t>(m_drawOrder.size());
+	}
+
+	void RetainedInstanceList::ClearDirty()
+	{
+		m_dirtyFirst = 0;
+		m_dirtyEnd = 0;
+	}
+
+	void RetainedInstanceList::MarkDirty(uint32_t first, uint32_t end)
+	{
+		if (m_dirtyFirst < m_dirtyEnd)
+		{
+			m_dirtyFirst = std::min(m_dirtyFirst, first);
+			m_dirtyEnd = std::max(m_dirtyEnd, end);
+		}
+		else
+		{
+			m_dirtyFirst = first;
+			m_dirtyEnd = end;
+		}
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "mesh_instance.h"
+#include "core/radix_sort.h"
+#include <vector>
+
+namespace smol
+{
+	// Persistent instances kept in draw order across frames, with dirty tracking
+	// An instance keeps its position in the instance buffer until something is added or removed in front of it,
+	// so only the changed range needs uploading each frame. Owned by the render thread
+	class RetainedInstanceList
+	{
+	public:
+		struct SlotChange
+		{
+			uint32_t m_version;		// Version() after the change
+			uint32_t m_slot;
+		};
+
+		uint32_t Add(const MeshInstance& instance, uint64_t sortKey);	// returns a slot, stable until removed
+		void Update(uint32_t slot, const glm::mat4& transform, const glm::vec4& colour, const glm::vec3& boundsCenter, const glm::vec3& boundsExtents);
+		void Remove(uint32_t slot);
+		void Commit();		// merges any adds + removes into the draw order
+
+		void MarkAllDirty();
+		void ClearDirty();
+		bool HasDirtyRange() const { return m_dirtyFirst < m_dirtyEnd; }
+		uint32_t DirtyFirst() const { return m_dirtyFirst; }
+		uint32_t DirtyEnd() const { return m_dirtyEnd; }
+		uint32_t Version() const { return m_version; }		// changes whenever any instance or the draw order changes
+
+		const std::vector<MeshInstance>& Instances() const { return m_instances; }			// by slot, removed slots have no mesh
+		const std::vector<Core::SortKeyIndex>& DrawOrder() const { return m_drawOrder; }	// sorted, index = slot
+		size_t Count() const { return m_drawOrder.size(); }
+
+		// Slots changed by Add/Update/Remove in version order, so a copy of Instances() can be brought up to date
+		// without copying everything. The log restarts once it outgrows the list, older copies need a full copy
+		const std::vector<SlotChange>& ChangeLog() const { return m_changeLog; }
+		bool ChangeLogCovers(uint32_t version) const { return version >= m_changeLogVersion && version <= m_version; }
+		size_t FirstChangeAfter(uint32_t version) const;	// index into ChangeLog()
+
+	private:
+		void MarkDirty(uint32_t first, uint32_t end);
+		void LogChange(uint32_t slot);		// bumps the version
+
+		std::vector<MeshInstance> m_instances;
+		std::vector<uint32_t> m_slotPositions;		// slot -> position in the draw order
+		std::vector<uint32_t> m_freeSlots;
+		std::vector<Core::SortKeyIndex> m_drawOrder;
+		std::vector<Core::SortKeyIndex> m_added;	// waiting for Commit
+		std::vector<uint32_t> m_removed;
+		std::vector<SlotChange> m_changeLog;
+		uint32_t m_changeLogVersion = 0;		// every change after this version is in the log
+		uint32_t m_dirtyFirst = 0;
+		uint32_t m_dirtyEnd = 0;
+		uint32_t m_version = 0;
+	};
+}
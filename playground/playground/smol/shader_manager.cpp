@@ -9,62 +9,65 @@ namespace smol
 	void ShaderManager::ReloadAll()
 	{
 		SDE_PROF_EVENT();
-		auto currentShaders = std::move(m_shaders);
-		for (auto &s : currentShaders)
+		for (auto &s : m_shaders)
 		{
-			auto newHandle = LoadShader(s.m_name.c_str(), s.m_vsPath.c_str(), s.m_fsPath.c_str());
-			if (newHandle.m_index == ShaderHandle::Invalid().m_index)	// if compilation failed use the old shader
+			auto newShader = CompileShader(s.m_vsPath.c_str(), s.m_fsPath.c_str());
+			if (newShader != nullptr)	// if compilation failed keep using the old shader
 			{
-				m_shaders.emplace_back(std::move(s));
+				s.m_shader = std::move(newShader);
 			}
 		}
 	}
 
-	ShaderHandle ShaderManager::LoadShader(const char* name, const char* vsPath, const char* fsPath)
+	std::unique_ptr<Render::ShaderProgram> ShaderManager::CompileShader(const char* vsPath, const char* fsPath)
 	{
 		SDE_PROF_EVENT();
-		for (uint64_t i = 0; i < m_shaders.size(); ++i)
-		{
-			if (m_shaders[i].m_name == name)
-			{
-				return { static_cast<uint16_t>(i) };
-			}
-		}
-
 		auto shader = std::make_unique<Render::ShaderProgram>();
 		auto vertexShader = std::make_unique<Render::ShaderBinary>();
 		std::string errorText;
 		if (!vertexShader->CompileFromFile(Render::ShaderType::VertexShader, vsPath, errorText))
 		{
 			SDE_LOG("Vertex shader compilation failed - %s\n%s", vsPath,errorText.c_str());
-			return ShaderHandle::Invalid();
+			return nullptr;
 		}
 		auto fragmentShader = std::make_unique<Render::ShaderBinary>();
 		if (!fragmentShader->CompileFromFile(Render::ShaderType::FragmentShader, fsPath, errorText))
 		{
 			SDE_LOG("Fragment shader compilation failed - %s\n%s", fsPath, errorText.c_str());
-			return ShaderHandle::Invalid();
+			return nullptr;
 		}
 
 		if (!shader->Create(*vertexShader, *fragmentShader, errorText))
 		{
 			SDE_LOG("Shader linkage failed - %s", errorText.c_str());
-			return ShaderHandle::Invalid();
+			return nullptr;
 		}
-
-		m_shaders.push_back({ std::move(shader), name, vsPath, fsPath });
-		return ShaderHandle{ static_cast<uint16_t>(m_shaders.size() - 1) };
+		return shader;
 	}
 
-	Render::ShaderProgram* ShaderManager::GetShader(const ShaderHandle& h)
+	ShaderHandle ShaderManager::LoadShader(const char* name, const char* vsPath, const char* fsPath)
 	{
-		if (h.m_index != -1 && h.m_index < m_shaders.size())
+		SDE_PROF_EVENT();
+		auto foundExisting = m_nameToHandle.find(name);
+		if (foundExisting != m_nameToHandle.end())
 		{
-			return m_shaders[h.m_index].m_shader.get();
+			return foundExisting->second;
 		}
-		else
+
+		auto shader = CompileShader(vsPath, fsPath);
+		if (shader == nullptr)
 		{
-			return nullptr;
+			return ShaderHandle::Invalid();
 		}
+
+		auto newHandle = ShaderHandle{ m_shaders.Insert({ std::move(shader), name, vsPath, fsPath }) };
+		m_nameToHandle[name] = newHandle;
+		return newHandle;
+	}
+
+	Render::ShaderProgram* ShaderManager::GetShader(const ShaderHandle& h)
+	{
+		auto desc = m_shaders.Get(h.m_index);
+		return desc != nullptr ? desc->m_shader.get() : nullptr;
 	}
 }
\ No newline at end of file
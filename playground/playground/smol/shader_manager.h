@@ -3,6 +3,8 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <unordered_map>
+#include "core/slot_map.h"
 
 namespace Render
 {
@@ -13,8 +15,8 @@ namespace smol
 {
 	struct ShaderHandle
 	{
-		uint16_t m_index = -1;
-		static ShaderHandle Invalid() { return { (uint16_t)-1 }; };
+		uint32_t m_index = -1;		// generation + index, see Core::SlotMap
+		static ShaderHandle Invalid() { return { (uint32_t)-1 }; };
 	};
 
 	class ShaderManager
@@ -31,12 +33,15 @@ namespace smol
 		void ReloadAll();
 
 	private:
+		std::unique_ptr<Render::ShaderProgram> CompileShader(const char* vsPath, const char* fsPath);
+
 		struct ShaderDesc {
 			std::unique_ptr<Render::ShaderProgram> m_shader;
 			std::string m_name;
 			std::string m_vsPath;
 			std::string m_fsPath;
 		};
-		std::vector<ShaderDesc> m_shaders;
+		Core::SlotMap<ShaderDesc> m_shaders;
+		std::unordered_map<std::string, ShaderHandle> m_nameToHandle;
 	};
 }
\ No newline at end of file
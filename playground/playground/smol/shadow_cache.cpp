@@ -0,0 +1,40 @@
+#include "shadow_cache.h"
+#include "kernel/assert.h"
+
+namespace smol
+{
+	ShadowCache::ShadowCache(uint32_t layerCount)
+		: m_layers(layerCount)
+	{
+	}
+
+	bool ShadowCache::NeedsUpdate(uint32_t layer, const glm::mat4& lightSpaceMatrix, uint64_t staticCastersHash) const
+	{
+		SDE_ASSERT(layer < m_layers.size(), "Bad shadow cache layer");
+		const Layer& l = m_layers[layer];
+		return !l.m_isValid || l.m_staticCastersHash != staticCastersHash || l.m_lightSpaceMatrix != lightSpaceMatrix;
+	}
+
+	void ShadowCache::MarkUpdated(uint32_t layer, const glm::mat4& lightSpaceMatrix, uint64_t staticCastersHash)
+	{
+		SDE_ASSERT(layer < m_layers.size(), "Bad shadow cache layer");
+		Layer& l = m_layers[layer];
+		l.m_lightSpaceMatrix = lightSpaceMatrix;
+		l.m_staticCastersHash = staticCastersHash;
+		l.m_isValid = true;
+	}
+
+	void ShadowCache::Invalidate(uint32_t layer)
+	{
+		SDE_ASSERT(layer < m_layers.size(), "Bad shadow cache layer");
+		m_layers[layer].m_isValid = false;
+	}
+
+	void ShadowCache::InvalidateAll()
+	{
+		for (auto& l : m_layers)
+		{
+			l.m_isValid = false;
+		}
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "math/glm_headers.h"
+#include <stdint.h>
+#include <vector>
+
+namespace smol
+{
+	// Tracks which cached static shadow depth layers (a cascade or cube face) are still valid
+	// A layer is redrawn when its light matrix or the static casters inside it change
+	// Only book-keeping, the renderer does the drawing + copying (tested in tests/smol_tests.cpp)
+	class ShadowCache
+	{
+	public:
+		ShadowCache(uint32_t layerCount);
+		~ShadowCache() = default;
+
+		bool NeedsUpdate(uint32_t layer, const glm::mat4& lightSpaceMatrix, uint64_t staticCastersHash) const;
+		void MarkUpdated(uint32_t layer, const glm::mat4& lightSpaceMatrix, uint64_t staticCastersHash);
+		void Invalidate(uint32_t layer);
+		void InvalidateAll();
+		uint32_t LayerCount() const { return static_cast<uint32_t>(m_layers.size()); }
+
+	private:
+		struct Layer
+		{
+			glm::mat4 m_lightSpaceMatrix;
+			uint64_t m_staticCastersHash = 0;
+			bool m_isValid = false;
+		};
+		std::vector<Layer> m_layers;
+	};
+}
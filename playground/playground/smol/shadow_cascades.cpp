@@ -0,0 +1,77 @@
+#include "shadow_cascades.h"
+#include "kernel/assert.h"
+#include <cmath>
+
+namespace smol
+{
+	void CalculateCascadeSplits(float nearPlane, float farPlane, float splitBlend, uint32_t cascadeCount, float* splitsOut)
+	{
+		// 'practical' split scheme, blends between logarithmic (even texel density) and uniform splits
+		splitsOut[0] = nearPlane;
+		for (uint32_t c = 1; c < cascadeCount; ++c)
+		{
+			const float t = (float)c / (float)cascadeCount;
+			const float logSplit = nearPlane * powf(farPlane / nearPlane, t);
+			const float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+			splitsOut[c] = splitBlend * logSplit + (1.0f - splitBlend) * uniformSplit;
+		}
+		splitsOut[cascadeCount] = farPlane;
+	}
+
+	ShadowCascade FitShadowCascade(const ShadowCascadeParams& params, float splitNear, float splitFar)
+	{
+		// frustum slice corners in world space
+		const float tanHalfFov = tanf(params.m_cameraFOV * 0.5f);
+		const glm::mat4 inverseView = glm::inverse(params.m_cameraView);
+		glm::vec3 corners[8];
+		glm::vec3 center(0.0f);
+		for (int i = 0; i < 8; ++i)
+		{
+			const float depth = (i & 4) ? splitFar : splitNear;
+			const float x = ((i & 1) ? 1.0f : -1.0f) * depth * tanHalfFov * params.m_cameraAspect;
+			const float y = ((i & 2) ? 1.0f : -1.0f) * depth * tanHalfFov;
+			corners[i] = glm::vec3(inverseView * glm::vec4(x, y, -depth, 1.0f));
+			center += corners[i];
+		}
+		center = center / 8.0f;
+
+		// the centre always lies on the view axis, so the radius only depends on the projection
+		float radius = 0.0f;
+		for (int i = 0; i < 8; ++i)
+		{
+			radius = glm::max(radius, glm::length(corners[i] - center));
+		}
+		radius = ceilf(radius * 16.0f) / 16.0f;	// quantise so float noise never changes the texel size
+
+		// light view has a fixed orientation, only the ortho bounds move with the camera
+		const glm::vec3 up = fabsf(params.m_lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		const glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), params.m_lightDirection, up);
+		glm::vec3 centerLightSpace = glm::vec3(lightView * glm::vec4(center, 1.0f));
+		const float texelSize = (2.0f * radius) / (float)params.m_cascadeResolution;
+		centerLightSpace.x = floorf(centerLightSpace.x / texelSize) * texelSize;
+		centerLightSpace.y = floorf(centerLightSpace.y / texelSize) * texelSize;
+
+		// view space looks down -z, extend the near plane towards the light to catch casters outside the slice
+		const float nearPlane = -centerLightSpace.z - radius - params.m_casterDistance;
+		const float farPlane = -centerLightSpace.z + radius;
+		const glm::mat4 lightProjection = glm::ortho(centerLightSpace.x - radius, centerLightSpace.x + radius,
+			centerLightSpace.y - radius, centerLightSpace.y + radius, nearPlane, farPlane);
+
+		ShadowCascade result;
+		result.m_lightSpaceMatrix = lightProjection * lightView;
+		result.m_splitNear = splitNear;
+		result.m_splitFar = splitFar;
+		return result;
+	}
+
+	void FitShadowCascades(const ShadowCascadeParams& params, uint32_t cascadeCount, ShadowCascade* cascadesOut)
+	{
+		float splits[16];
+		SDE_ASSERT(cascadeCount < 16, "Too many cascades");
+		CalculateCascadeSplits(params.m_cameraNearPlane, params.m_shadowDistance, params.m_splitBlend, cascadeCount, splits);
+		for (uint32_t c = 0; c < cascadeCount; ++c)
+		{
+			cascadesOut[c] = FitShadowCascade(params, splits[c], splits[c + 1]);
+		}
+	}
+}
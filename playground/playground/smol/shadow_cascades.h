@@ -0,0 +1,38 @@
+#pragma once
+#include "math/glm_headers.h"
+#include <stdint.h>
+
+namespace smol
+{
+	// Cascaded shadow map fitting for directional lights
+	// Only does maths on the camera parameters, no device access, so it runs without a window (see tests/smol_tests.cpp)
+	struct ShadowCascade
+	{
+		glm::mat4 m_lightSpaceMatrix;	// world -> cascade clip space
+		float m_splitNear;				// view depth range covered by this cascade
+		float m_splitFar;
+	};
+
+	struct ShadowCascadeParams
+	{
+		glm::mat4 m_cameraView;
+		float m_cameraFOV;				// vertical, radians
+		float m_cameraAspect;
+		float m_cameraNearPlane;
+		float m_shadowDistance;			// cascades cover [near plane, shadow distance]
+		float m_splitBlend;				// 0 = uniform splits, 1 = logarithmic
+		float m_casterDistance;			// how far behind each cascade casters are still drawn
+		glm::vec3 m_lightDirection;		// direction the light travels
+		int m_cascadeResolution;		// texels along each side of a cascade
+	};
+
+	// Split the view depth range, splitsOut must have room for cascadeCount + 1 values
+	void CalculateCascadeSplits(float nearPlane, float farPlane, float splitBlend, uint32_t cascadeCount, float* splitsOut);
+
+	// Fits an ortho projection around the bounding sphere of the camera frustum slice [splitNear, splitFar]
+	// The sphere size does not change as the camera rotates, and the centre is snapped to whole texels in light space,
+	// so shadow edges don't shimmer as the camera moves
+	ShadowCascade FitShadowCascade(const ShadowCascadeParams& params, float splitNear, float splitFar);
+
+	void FitShadowCascades(const ShadowCascadeParams& params, uint32_t cascadeCount, ShadowCascade* cascadesOut);
+}
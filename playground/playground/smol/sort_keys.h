@@ -0,0 +1,52 @@
+#pragma once
+#include "shader_manager.h"
+#include "core/flat_hash_map.h"
+#include "core/slot_map.h"
+#include "kernel/assert.h"
+#include <stdint.h>
+#include <string.h>
+
+namespace Render
+{
+	class Mesh;
+}
+
+namespace smol
+{
+	// Instance lists are drawn in order of a 64 bit key built at submit time
+	// shader = slot index of the shader handle (16 bits), mesh = material id (12 bits) + hash of the mesh pointer (12 bits)
+	// depth = top 24 bits of the distance to camera; non-negative floats sort the same as their bit patterns
+	// Meshes sharing textures end up next to each other. Hash collisions only cost an extra batch, instances are
+	// still grouped by the real mesh when drawn
+	inline uint64_t SortKeyShader(const ShaderHandle& shader)
+	{
+		// the generation bits are dropped, two live shaders never share an index
+		const uint32_t index = Core::SlotMap<ShaderHandle>::GetIndex(shader.m_index);
+		SDE_ASSERT(index <= 0xffff || shader.m_index == ShaderHandle::Invalid().m_index, "Shader index %d does not fit in the sort key", index);
+		return index & 0xffff;
+	}
+
+	inline uint64_t SortKeyMesh(uint32_t materialId, const Render::Mesh* mesh)
+	{
+		return ((uint64_t)(materialId & 0xfff) << 12) | (Core::FlatHashMix(reinterpret_cast<uintptr_t>(mesh)) & 0xfff);
+	}
+
+	inline uint64_t SortKeyDepth(float distanceToCamera)
+	{
+		uint32_t bits = 0;
+		memcpy(&bits, &distanceToCamera, sizeof(bits));
+		return (bits >> 7) & 0xffffff;
+	}
+
+	// shader -> mesh -> front to back
+	inline uint64_t OpaqueSortKey(const ShaderHandle& shader, uint32_t materialId, const Render::Mesh* mesh, float distanceToCamera)
+	{
+		return (SortKeyShader(shader) << 48) | (SortKeyMesh(materialId, mesh) << 24) | SortKeyDepth(distanceToCamera);
+	}
+
+	// back to front -> shader -> mesh
+	inline uint64_t TransparentSortKey(const ShaderHandle& shader, uint32_t materialId, const Render::Mesh* mesh, float distanceToCamera)
+	{
+		return ((0xffffff - SortKeyDepth(distanceToCamera)) << 40) | (SortKeyShader(shader) << 24) | SortKeyMesh(materialId, mesh);
+	}
+}
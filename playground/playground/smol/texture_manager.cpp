@@ -2,8 +2,6 @@
 #include "sde/job_system.h"
 #include "../stb_image.h"
 #include "core/profiler.h"
-#include "core/scoped_mutex.h"
-#include "kernel/thread.h"
 #include "debug_gui/debug_gui_system.h"
 #include "render/device.h"
 
@@ -23,16 +21,17 @@ namespace smol
 		sprintf_s(text, "Loading: %d", m_inFlightTextures.Get());
 		gui.Text(text);
 		gui.Separator();
-		for (int t=0;t<m_textures.size();++t)
+		for (int t=0;t<m_textures.Size();++t)
 		{
+			const auto& desc = m_textures.ValueAt(t);
 			sprintf_s(text, "%d: %s (0x%p) - %d components", 
 				t, 
-				m_textures[t].m_path.c_str(),
-				m_textures[t].m_texture.get(),
-				m_textures[t].m_texture ? m_textures[t].m_texture->GetComponentCount() : 0);
+				desc.m_path.c_str(),
+				desc.m_texture.get(),
+				desc.m_texture ? desc.m_texture->GetComponentCount() : 0);
 			if (gui.Button(text))
 			{
-				s_showTexture = { static_cast<uint16_t>(t) };
+				s_showTexture = { m_textures.HandleAt(t) };
 			}
 		}
 		gui.EndWindow();
@@ -43,12 +42,12 @@ namespace smol
 			if (previewTexture != nullptr)
 			{
 				bool show = true;
-				gui.BeginWindow(show, m_textures[s_showTexture.m_index].m_path.c_str());
+				gui.BeginWindow(show, m_textures.Get(s_showTexture.m_index)->m_path.c_str());
 				gui.Image(*previewTexture, glm::vec2(512, 512));
 				gui.EndWindow();
 				if (!show)
 				{
-					s_showTexture = {(uint16_t)-1};
+					s_showTexture = TextureHandle::Invalid();
 				}
 			}
 		}
@@ -60,46 +59,11 @@ namespace smol
 	{
 		SDE_PROF_EVENT();
 
-		// wait until all jobs finish, not great but eh
-		while (m_inFlightTextures.Get() > 0)
+		// load the textures again in place, old textures are used until the new ones arrive
+		// anything still in flight is out of date and gets dropped when it arrives
+		for (int t = 0; t < m_textures.Size(); ++t)
 		{
-			int v = m_inFlightTextures.Get();
-			Kernel::Thread::Sleep(1);
-		}
-		// clear out the old results
-		{
-			Core::ScopedMutex lock(m_loadedTexturesMutex);
-			m_loadedTextures.clear();
-		}
-		// now load the textures again
-		auto currentTextures = std::move(m_textures);
-		for (int t=0;t<currentTextures.size();++t)
-		{
-			auto newHandle = LoadTexture(currentTextures[t].m_path.c_str());
-			SDE_ASSERT(t == newHandle.m_index, "Bum");
-		}
-	}
-
-	void TextureManager::ProcessLoadedTextures()
-	{
-		SDE_PROF_EVENT();
-
-		std::vector<LoadedTexture> loadedTextures;
-		{
-			SDE_PROF_EVENT("AcquireLoadedTextures");
-			Core::ScopedMutex lock(m_loadedTexturesMutex);
-			loadedTextures = std::move(m_loadedTextures);
-		}
-
-		{
-			SDE_PROF_EVENT("CreateTextures");
-			for (auto& tex : loadedTextures)
-			{
-				if(tex.m_texture != nullptr)
-				{
-					m_textures[tex.m_destination.m_index].m_texture = std::move(tex.m_texture);
-				}
-			}
+			LoadTextureAsync(m_textures.ValueAt(t).m_path, { m_textures.HandleAt(t) });
 		}
 	}
 
@@ -110,20 +74,27 @@ namespace smol
 			return TextureHandle::Invalid();
 		}
 
-		for (uint64_t i = 0; i < m_textures.size(); ++i)
+		auto foundExisting = m_pathToHandle.find(path);
+		if (foundExisting != m_pathToHandle.end())
 		{
-			if (m_textures[i].m_path == path)
-			{
-				return { static_cast<uint16_t>(i) };
-			}
+			return foundExisting->second;
 		}
 
-		m_textures.push_back({nullptr, path });
-		auto newHandle = TextureHandle{ static_cast<uint16_t>(m_textures.size() - 1) };
-		m_inFlightTextures.Add(1);
+		auto newHandle = TextureHandle{ m_textures.Insert({ nullptr, path }) };
+		m_pathToHandle[path] = newHandle;
+		LoadTextureAsync(path, newHandle);
+
+		return newHandle;
+	}
 
-		std::string pathString = path;
-		m_jobSystem->PushJob([this, pathString, newHandle]() {
+	void TextureManager::LoadTextureAsync(std::string pathString, TextureHandle newHandle)
+	{
+		auto desc = m_textures.Get(newHandle.m_index);
+		SDE_ASSERT(desc != nullptr, "Bad handle");
+		const uint32_t loadGeneration = ++desc->m_loadGeneration;
+		m_inFlightTextures.Add(1);
+		auto loadedTexture = std::make_shared<std::unique_ptr<Render::Texture>>();	// shared between the job + continuation
+		m_jobSystem->PushJob([this, pathString, loadedTexture]() {
 			char debugName[1024] = { '\0' };
 			sprintf_s(debugName, "LoadTexture(\"%s\")", pathString.c_str());
 			SDE_PROF_EVENT_DYN(debugName);
@@ -133,7 +104,6 @@ namespace smol
 			unsigned char* loadedData = stbi_load(pathString.c_str(), &w, &h, &components, 0);
 			if (loadedData == nullptr)
 			{
-				m_inFlightTextures.Add(-1);
 				return;
 			}
 
@@ -164,29 +134,24 @@ namespace smol
 			{
 				// Ensure any writes are shared with all contexts
 				Render::Device::FlushContext();
-
-				SDE_PROF_EVENT("PushToResultsList");
-				Core::ScopedMutex lock(m_loadedTexturesMutex);
-				{
-					m_loadedTextures.push_back({ std::move(newTex), newHandle });
-				}
+				*loadedTexture = std::move(newTex);
 			}
+		}, [this, loadedTexture, newHandle, loadGeneration]() {
+			// main thread, handle may have been invalidated or reloaded since the load started
 			m_inFlightTextures.Add(-1);
+			auto desc = m_textures.Get(newHandle.m_index);
+			if (*loadedTexture != nullptr && desc != nullptr && desc->m_loadGeneration == loadGeneration)
+			{
+				desc->m_texture = std::move(*loadedTexture);
+				++m_generation;
+			}
 		});
-
-		return newHandle;
 	}
 
 	Render::Texture* TextureManager::GetTexture(const TextureHandle& h)
 	{
-		if (h.m_index != -1 && h.m_index < m_textures.size())
-		{
-			return m_textures[h.m_index].m_texture.get();
-		}
-		else
-		{
-			return nullptr;
-		}
+		auto desc = m_textures.Get(h.m_index);
+		return desc != nullptr ? desc->m_texture.get() : nullptr;
 	}
 
 }
\ No newline at end of file
@@ -3,10 +3,11 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <unordered_map>
 #include "render/texture.h"
 #include "render/texture_source.h"
-#include "kernel/mutex.h"
 #include "kernel/atomics.h"
+#include "core/slot_map.h"
 
 namespace SDE
 {
@@ -22,8 +23,8 @@ namespace smol
 {
 	struct TextureHandle
 	{
-		uint16_t m_index = -1;
-		static TextureHandle Invalid() { return { (uint16_t)-1 }; };
+		uint32_t m_index = -1;		// generation + index, see Core::SlotMap
+		static TextureHandle Invalid() { return { (uint32_t)-1 }; };
 	};
 
 	class TextureManager
@@ -36,27 +37,27 @@ namespace smol
 
 		TextureHandle LoadTexture(std::string path);
 		Render::Texture* GetTexture(const TextureHandle& h);
-		void ProcessLoadedTextures();
 
 		bool ShowGui(DebugGui::DebugGuiSystem& gui);
 
 		void ReloadAll();
 
+		// Changes whenever a texture is loaded or reloaded, anything caching texture properties should check it
+		uint32_t GetGeneration() const { return m_generation; }
+
 	private:
+		void LoadTextureAsync(std::string path, TextureHandle destination);
+
 		struct TextureDesc {
 			std::unique_ptr<Render::Texture> m_texture;
 			std::string m_path;
+			uint32_t m_loadGeneration;		// bumped whenever a load starts, older results are dropped
 		};
-		std::vector<TextureDesc> m_textures;
+		Core::SlotMap<TextureDesc> m_textures;
+		std::unordered_map<std::string, TextureHandle> m_pathToHandle;	// avoids loading the same texture twice
 
-		struct LoadedTexture
-		{
-			std::unique_ptr<Render::Texture> m_texture;
-			TextureHandle m_destination;
-		};
-		Kernel::Mutex m_loadedTexturesMutex;
-		std::vector<LoadedTexture> m_loadedTextures;
 		Kernel::AtomicInt32 m_inFlightTextures = 0;
+		uint32_t m_generation = 0;		// main thread only
 		SDE::JobSystem* m_jobSystem = nullptr;
 	};
 }
\ No newline at end of file
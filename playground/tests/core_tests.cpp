@@ -0,0 +1,143 @@
+#include "test.h"
+#include "core/flat_hash_map.h"
+#include "core/slot_map.h"
+#include "core/timer.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <stdio.h>
+
+namespace
+{
+	const uint32_t c_hashBenchmarkRuns = 3;		// fastest run is reported
+
+	struct HashBenchmarkResult
+	{
+		double m_insertSeconds = 1.0e10;
+		double m_hitSeconds = 1.0e10;
+		double m_missSeconds = 1.0e10;
+		double m_eraseSeconds = 1.0e10;
+	};
+
+	// keys are random, lookups + erases are shuffled so they don't follow insertion order
+	template< class Container, class InsertFn >
+	HashBenchmarkResult BenchmarkHashContainer(const std::vector<uint64_t>& keys, const std::vector<uint64_t>& lookupOrder, const std::vector<uint64_t>& missingKeys, InsertFn insertFn)
+	{
+		HashBenchmarkResult result;
+		for (uint32_t run = 0; run < c_hashBenchmarkRuns; ++run)
+		{
+			double seconds = 0.0;
+			Container c;
+			{
+				Core::ScopedTimer timer(seconds);
+				for (uint64_t k : keys)
+				{
+					insertFn(c, k);
+				}
+			}
+			result.m_insertSeconds = std::min(result.m_insertSeconds, seconds);
+			SDE_CHECK(c.size() == keys.size());
+
+			size_t found = 0;
+			{
+				Core::ScopedTimer timer(seconds);
+				for (uint64_t k : lookupOrder)
+				{
+					found += c.find(k) != c.end() ? 1 : 0;
+				}
+			}
+			result.m_hitSeconds = std::min(result.m_hitSeconds, seconds);
+			SDE_CHECK(found == lookupOrder.size());
+
+			found = 0;
+			{
+				Core::ScopedTimer timer(seconds);
+				for (uint64_t k : missingKeys)
+				{
+					found += c.find(k) != c.end() ? 1 : 0;
+				}
+			}
+			result.m_missSeconds = std::min(result.m_missSeconds, seconds);
+			SDE_CHECK(found == 0);
+
+			{
+				Core::ScopedTimer timer(seconds);
+				for (uint64_t k : lookupOrder)
+				{
+					c.erase(k);
+				}
+			}
+			result.m_eraseSeconds = std::min(result.m_eraseSeconds, seconds);
+			SDE_CHECK(c.size() == 0);
+		}
+		return result;
+	}
+
+	void PrintHashBenchmark(const char* name, size_t keyCount, const HashBenchmarkResult& r)
+	{
+		const double toNs = 1.0e9 / keyCount;
+		printf("\t%-24s %8zu keys: insert %6.1f, hit %6.1f, miss %6.1f, erase %6.1f ns/op\n", name, keyCount,
+			r.m_insertSeconds * toNs, r.m_hitSeconds * toNs, r.m_missSeconds * toNs, r.m_eraseSeconds * toNs);
+	}
+}
+
+SDE_TEST(SlotMapRetiresSlotsBeforeGenerationsWrap)
+{
+	using IntMap = Core::SlotMap<int>;
+	IntMap map;
+	const IntMap::Handle first = map.Insert(0);
+	IntMap::Handle h = first;
+	for (uint32_t reuse = 1; reuse <= IntMap::c_generationMask; ++reuse)
+	{
+		SDE_CHECK(map.Remove(h));
+		h = map.Insert(static_cast<int>(reuse));
+		SDE_CHECK(IntMap::GetIndex(h) == IntMap::GetIndex(first));
+		SDE_CHECK(IntMap::GetGeneration(h) == reuse);
+		SDE_CHECK(!map.IsValid(first));
+	}
+
+	// the slot is on its last generation, so removing it retires the slot instead of wrapping back to the first handle
+	SDE_CHECK(map.Remove(h));
+	const IntMap::Handle next = map.Insert(1234);
+	SDE_CHECK(IntMap::GetIndex(next) != IntMap::GetIndex(first));
+	SDE_CHECK(!map.IsValid(first) && map.Get(first) == nullptr);
+	SDE_CHECK(!map.IsValid(h) && map.Get(h) == nullptr);
+	SDE_CHECK(map.Get(next) != nullptr && *map.Get(next) == 1234);
+
+	// Clear keeps retired slots off the free list
+	map.Clear();
+	const IntMap::Handle afterClear = map.Insert(5);
+	SDE_CHECK(IntMap::GetIndex(afterClear) == IntMap::GetIndex(next));
+	SDE_CHECK(!map.IsValid(first) && !map.IsValid(h) && !map.IsValid(next));
+	SDE_CHECK(map.Size() == 1 && *map.Get(afterClear) == 5);
+}
+
+// uint64 keys, the same as the vox block coordinate hashes
+SDE_BENCHMARK(FlatHashMapVsUnorderedMap)
+{
+	std::mt19937_64 random(1234);
+	for (size_t keyCount : { 4 * 1024, 64 * 1024, 1024 * 1024 })
+	{
+		std::vector<uint64_t> keys(keyCount);
+		std::vector<uint64_t> missingKeys(keyCount);
+		for (size_t k = 0; k < keyCount; ++k)
+		{
+			keys[k] = random() | 1;				// odd keys are inserted, even ones always miss
+			missingKeys[k] = random() & ~1ull;
+		}
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+		std::shuffle(keys.begin(), keys.end(), random);
+		std::vector<uint64_t> lookupOrder = keys;
+		std::shuffle(lookupOrder.begin(), lookupOrder.end(), random);
+
+		auto insertPair = [](auto& c, uint64_t k) { c.insert({ k, static_cast<uint32_t>(k) }); };
+		auto insertKey = [](auto& c, uint64_t k) { c.insert(k); };
+		PrintHashBenchmark("std::unordered_map", keys.size(), BenchmarkHashContainer<std::unordered_map<uint64_t, uint32_t>>(keys, lookupOrder, missingKeys, insertPair));
+		PrintHashBenchmark("Core::FlatHashMap", keys.size(), BenchmarkHashContainer<Core::FlatHashMap<uint64_t, uint32_t>>(keys, lookupOrder, missingKeys, insertPair));
+		PrintHashBenchmark("std::unordered_set", keys.size(), BenchmarkHashContainer<std::unordered_set<uint64_t>>(keys, lookupOrder, missingKeys, insertKey));
+		PrintHashBenchmark("Core::FlatHashSet", keys.size(), BenchmarkHashContainer<Core::FlatHashSet<uint64_t>>(keys, lookupOrder, missingKeys, insertKey));
+	}
+}
@@ -0,0 +1,70 @@
+#include "test.h"
+#include "core/timer.h"
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+namespace Tests
+{
+	struct RegisteredTest
+	{
+		const char* m_name;
+		TestFn m_fn;
+		bool m_isBenchmark;
+	};
+
+	// function static so registration from other translation units doesn't depend on init order
+	std::vector<RegisteredTest>& GetRegisteredTests()
+	{
+		static std::vector<RegisteredTest> s_tests;
+		return s_tests;
+	}
+
+	uint32_t s_failureCount = 0;
+
+	Registrar::Registrar(const char* name, TestFn fn, bool isBenchmark)
+	{
+		GetRegisteredTests().push_back({ name, fn, isBenchmark });
+	}
+
+	void ReportFailure(const char* file, int line, const char* condition)
+	{
+		printf("\t%s(%d): check failed: %s\n", file, line, condition);
+		++s_failureCount;
+	}
+
+	double AverageMs(uint32_t iterations, const std::function<void()>& fn)
+	{
+		fn();
+		Core::Timer timer;
+		const uint64_t startTicks = timer.GetTicks();
+		for (uint32_t i = 0; i < iterations; ++i)
+		{
+			fn();
+		}
+		const double seconds = (double)(timer.GetTicks() - startTicks) / (double)timer.GetFrequency();
+		return seconds * 1000.0 / iterations;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const bool runBenchmarks = argc > 1 && strcmp(argv[1], "bench") == 0;
+	const char* nameFilter = argc > 2 ? argv[2] : nullptr;
+	uint32_t testsRan = 0;
+	uint32_t testsFailed = 0;
+	for (const auto& test : Tests::GetRegisteredTests())
+	{
+		if (test.m_isBenchmark != runBenchmarks || (nameFilter != nullptr && strstr(test.m_name, nameFilter) == nullptr))
+		{
+			continue;
+		}
+		printf("%s\n", test.m_name);
+		const uint32_t failuresBefore = Tests::s_failureCount;
+		test.m_fn();
+		++testsRan;
+		testsFailed += Tests::s_failureCount != failuresBefore ? 1 : 0;
+	}
+	printf("%u ran, %u failed\n", testsRan, testsFailed);
+	return testsFailed == 0 ? 0 : 1;
+}
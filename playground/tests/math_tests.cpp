@@ -0,0 +1,87 @@
+#include "test.h"
+#include "math/frustum.h"
+#include <random>
+
+namespace
+{
+	Math::Frustum MakeTestFrustum()
+	{
+		const glm::mat4 projection = glm::perspectiveFov(glm::radians(70.0f), 1280.0f, 720.0f, 0.1f, 200.0f);
+		const glm::mat4 view = glm::lookAt(glm::vec3(10.0f, 5.0f, -20.0f), glm::vec3(0.0f, 0.0f, 30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		return Math::Frustum(projection * view);
+	}
+
+	// the scalar + SSE paths add in a different order, so a box touching a plane may round either way
+	bool IsBoxOnPlane(const Math::Frustum& f, const glm::vec3& center, const glm::vec3& extents)
+	{
+		return f.IsBoxVisible(center, extents * 1.0001f) != f.IsBoxVisible(center, extents * 0.9999f);
+	}
+
+	bool IsSphereOnPlane(const Math::Frustum& f, const glm::vec3& center, float radius)
+	{
+		return f.IsSphereVisible(center, radius * 1.0001f) != f.IsSphereVisible(center, radius * 0.9999f);
+	}
+}
+
+SDE_TEST(FrustumAreBoxesVisibleMatchesIsBoxVisible)
+{
+	const Math::Frustum frustum = MakeTestFrustum();
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-250.0f, 250.0f), size(0.0f, 20.0f);
+	uint32_t visibleCount = 0;
+	for (uint32_t test = 0; test < 100000; ++test)
+	{
+		glm::vec3 centers[4], extents[4];
+		for (int b = 0; b < 4; ++b)
+		{
+			centers[b] = { position(random), position(random), position(random) };
+			extents[b] = { size(random), size(random), size(random) };
+		}
+		Math::Box4 boxes;
+		boxes.m_centerX = _mm_setr_ps(centers[0].x, centers[1].x, centers[2].x, centers[3].x);
+		boxes.m_centerY = _mm_setr_ps(centers[0].y, centers[1].y, centers[2].y, centers[3].y);
+		boxes.m_centerZ = _mm_setr_ps(centers[0].z, centers[1].z, centers[2].z, centers[3].z);
+		boxes.m_extentsX = _mm_setr_ps(extents[0].x, extents[1].x, extents[2].x, extents[3].x);
+		boxes.m_extentsY = _mm_setr_ps(extents[0].y, extents[1].y, extents[2].y, extents[3].y);
+		boxes.m_extentsZ = _mm_setr_ps(extents[0].z, extents[1].z, extents[2].z, extents[3].z);
+		const uint32_t mask = frustum.AreBoxesVisible(boxes);
+		for (int b = 0; b < 4; ++b)
+		{
+			const bool visible = frustum.IsBoxVisible(centers[b], extents[b]);
+			SDE_CHECK(visible == ((mask & (1 << b)) != 0) || IsBoxOnPlane(frustum, centers[b], extents[b]));
+			visibleCount += visible ? 1 : 0;
+		}
+	}
+	SDE_CHECK(visibleCount > 0 && visibleCount < 400000);		// both sides of the frustum were covered
+}
+
+SDE_TEST(FrustumAreSpheresVisibleMatchesIsSphereVisible)
+{
+	const Math::Frustum frustum = MakeTestFrustum();
+	std::mt19937 random(5678);
+	std::uniform_real_distribution<float> position(-250.0f, 250.0f), size(0.0f, 20.0f);
+	uint32_t visibleCount = 0;
+	for (uint32_t test = 0; test < 100000; ++test)
+	{
+		glm::vec3 centers[4];
+		float radius[4];
+		for (int s = 0; s < 4; ++s)
+		{
+			centers[s] = { position(random), position(random), position(random) };
+			radius[s] = size(random);
+		}
+		Math::Sphere4 spheres;
+		spheres.m_centerX = _mm_setr_ps(centers[0].x, centers[1].x, centers[2].x, centers[3].x);
+		spheres.m_centerY = _mm_setr_ps(centers[0].y, centers[1].y, centers[2].y, centers[3].y);
+		spheres.m_centerZ = _mm_setr_ps(centers[0].z, centers[1].z, centers[2].z, centers[3].z);
+		spheres.m_radius = _mm_setr_ps(radius[0], radius[1], radius[2], radius[3]);
+		const uint32_t mask = frustum.AreSpheresVisible(spheres);
+		for (int s = 0; s < 4; ++s)
+		{
+			const bool visible = frustum.IsSphereVisible(centers[s], radius[s]);
+			SDE_CHECK(visible == ((mask & (1 << s)) != 0) || IsSphereOnPlane(frustum, centers[s], radius[s]));
+			visibleCount += visible ? 1 : 0;
+		}
+	}
+	SDE_CHECK(visibleCount > 0 && visibleCount < 400000);
+}
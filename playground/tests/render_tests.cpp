@@ -0,0 +1,315 @@
+#include "test.h"
+#include "render/ring_buffer_allocator.h"
+#include "render/mesh_builder.h"
+#include "render/vertex_encoding.h"
+#include "math/glm_headers.h"
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <random>
+#include <math.h>
+#include <cmath>
+#include <float.h>
+
+namespace
+{
+	// (width + 1) * (depth + 1) vertices on the xz plane, 2 triangles per quad. heights are optional
+	void BuildGrid(uint32_t width, uint32_t depth, std::vector<float>& positions, std::vector<uint32_t>& indices, float bumpHeight = 0.0f)
+	{
+		positions.clear();
+		indices.clear();
+		for (uint32_t z = 0; z <= depth; ++z)
+		{
+			for (uint32_t x = 0; x <= width; ++x)
+			{
+				positions.push_back((float)x);
+				positions.push_back(bumpHeight * sinf(x * 0.7f) * cosf(z * 0.9f));
+				positions.push_back((float)z);
+			}
+		}
+		for (uint32_t z = 0; z < depth; ++z)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const uint32_t v = z * (width + 1) + x;
+				const uint32_t tris[] = { v, v + width + 1, v + 1, v + 1, v + width + 1, v + width + 2 };
+				indices.insert(indices.end(), tris, tris + 6);
+			}
+		}
+	}
+
+	// triangles rotated so the smallest index is first, winding is kept
+	std::vector<std::array<uint32_t, 3>> SortedTriangles(const std::vector<uint32_t>& indices)
+	{
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			std::array<uint32_t, 3> t = { indices[i], indices[i + 1], indices[i + 2] };
+			std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+			triangles.push_back(t);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+}
+
+SDE_TEST(RingBufferAllocatorPartitionsWrapAndWaitOnFences)
+{
+	using Allocator = Render::RingBufferAllocator<Render::NullFence>;
+	Allocator ring(100, 3, 64);
+	SDE_CHECK(ring.PartitionSize() == 128);		// rounded up so every partition starts aligned
+	SDE_CHECK(ring.TotalSize() == 384);
+
+	// partitions are handed out in order, allocations are aligned offsets into the whole buffer
+	const uint32_t p0 = ring.AcquirePartition();
+	const uint32_t p1 = ring.AcquirePartition();
+	SDE_CHECK(p0 == 0 && p1 == 1);
+	SDE_CHECK(ring.Allocate(p1, 10) == 128);
+	SDE_CHECK(ring.Allocate(p1, 10) == 192);
+	SDE_CHECK(ring.UsedSize(p1) == 74);
+	SDE_CHECK(ring.Allocate(p1, 1) == Allocator::c_allocationFailed);	// the next aligned offset is past the end
+	SDE_CHECK(ring.UsedSize(p1) == 74);
+	SDE_CHECK(ring.Allocate(p0, 128) == 0);
+	SDE_CHECK(ring.Allocate(p0, 1) == Allocator::c_allocationFailed);
+
+	// released partitions are fenced, discarded ones are not
+	ring.ReleasePartition(p0);
+	ring.DiscardPartition(p1);
+	SDE_CHECK(ring.GetFence(p0).IsPending());
+	SDE_CHECK(!ring.GetFence(p1).IsPending());
+	const uint32_t p2 = ring.AcquirePartition();
+	SDE_CHECK(p2 == 2 && ring.Allocate(p2, 129) == Allocator::c_allocationFailed);
+	ring.ReleasePartition(p2);
+	SDE_CHECK(ring.WaitCount() == 0);
+
+	// wrapping around waits for the gpu to finish with the partition, then starts it empty
+	SDE_CHECK(ring.AcquirePartition() == 0);
+	SDE_CHECK(ring.WaitCount() == 1);
+	SDE_CHECK(!ring.GetFence(0).IsPending());
+	SDE_CHECK(ring.UsedSize(0) == 0);
+	SDE_CHECK(ring.Allocate(0, 16) == 0);
+	SDE_CHECK(ring.AcquirePartition() == 1);
+	SDE_CHECK(ring.WaitCount() == 1);
+	SDE_CHECK(ring.AcquirePartition() == 2);
+	SDE_CHECK(ring.WaitCount() == 2);
+}
+
+SDE_TEST(MeshBuilderWeldsACubeSoup)
+{
+	// 6 faces of 2 triangles, each face has its own normal so only the 4 corners of a face are shared
+	Render::MeshBuilder builder;
+	const uint32_t positionStream = builder.AddVertexStream(3);
+	const uint32_t normalStream = builder.AddVertexStream(3);
+	for (int32_t chunk = 0; chunk < 2; ++chunk)
+	{
+		builder.BeginChunk();
+		for (int32_t face = chunk * 3; face < chunk * 3 + 3; ++face)
+		{
+			glm::vec3 normal(0.0f);
+			normal[face % 3] = face < 3 ? 1.0f : -1.0f;
+			const glm::vec3 u(normal.z, normal.x, normal.y);
+			const glm::vec3 v = glm::cross(normal, u);
+			const glm::vec3 corners[] = { normal - u - v, normal + u - v, normal + u + v, normal - u + v };
+			builder.BeginTriangle();
+			builder.SetStreamData(positionStream, corners[0], corners[1], corners[2]);
+			builder.SetStreamData(normalStream, normal, normal, normal);
+			builder.EndTriangle();
+			builder.BeginTriangle();
+			builder.SetStreamData(positionStream, corners[0], corners[2], corners[3]);
+			builder.SetStreamData(normalStream, normal, normal, normal);
+			builder.EndTriangle();
+		}
+		builder.EndChunk();
+	}
+	const std::vector<float> soupPositions = builder.GetStreamData(positionStream);
+	const std::vector<float> soupNormals = builder.GetStreamData(normalStream);
+	SDE_CHECK(soupPositions.size() == 36 * 3 && builder.GetIndices().empty());
+
+	SDE_CHECK(builder.WeldVertices() == 24);
+	const std::vector<float>& positions = builder.GetStreamData(positionStream);
+	const std::vector<float>& normals = builder.GetStreamData(normalStream);
+	const std::vector<uint32_t>& indices = builder.GetIndices();
+	SDE_CHECK(positions.size() == 24 * 3 && normals.size() == 24 * 3);
+	SDE_CHECK(indices.size() == 36);
+
+	// every index fetches exactly what the soup vertex it replaced held
+	std::vector<uint32_t> useCount(24, 0);
+	for (uint32_t i = 0; i < indices.size(); ++i)
+	{
+		SDE_CHECK(indices[i] < 24);
+		useCount[indices[i]]++;
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			SDE_CHECK(positions[indices[i] * 3 + c] == soupPositions[i * 3 + c]);
+			SDE_CHECK(normals[indices[i] * 3 + c] == soupNormals[i * 3 + c]);
+		}
+	}
+
+	// the diagonal corners of each face are used twice, the others once
+	for (uint32_t v = 0; v < 24; ++v)
+	{
+		SDE_CHECK(useCount[v] == 1 || useCount[v] == 2);
+	}
+}
+
+SDE_TEST(MeshBuilderOptimiseKeepsTheTrianglesOfAGrid)
+{
+	// a long strip whose rows fit in the cache, so every vertex can be transformed exactly once
+	// triangles are added in a random order so the cache starts out cold. a second stream holds the original vertex id
+	// so the output can be compared after the vertices are reordered
+	std::vector<float> positions;
+	std::vector<uint32_t> indices;
+	BuildGrid(4, 64, positions, indices);
+	std::vector<uint32_t> triangleOrder(indices.size() / 3);
+	for (uint32_t t = 0; t < triangleOrder.size(); ++t)
+	{
+		triangleOrder[t] = t;
+	}
+	std::shuffle(triangleOrder.begin(), triangleOrder.end(), std::mt19937(1234));
+	std::vector<uint32_t> shuffled;
+	for (uint32_t t : triangleOrder)
+	{
+		shuffled.insert(shuffled.end(), &indices[t * 3], &indices[t * 3] + 3);
+	}
+
+	Render::MeshBuilder builder;
+	const uint32_t positionStream = builder.AddVertexStream(3);
+	const uint32_t idStream = builder.AddVertexStream(1);
+	builder.BeginChunk();
+	const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / 3);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+	{
+		builder.SetVertexData(positionStream, glm::vec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]));
+		builder.SetVertexData(idStream, (float)v);
+		builder.EndVertex();
+	}
+	for (size_t i = 0; i < shuffled.size(); i += 3)
+	{
+		builder.AddTriangleIndices(shuffled[i], shuffled[i + 1], shuffled[i + 2]);
+	}
+	builder.EndChunk();
+
+	const Render::MeshBuilder::OptimiseStats stats = builder.Optimise(positionStream);
+	printf("\tACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", stats.m_before.ACMR(), stats.m_after.ACMR(), stats.m_before.ATVR(), stats.m_after.ATVR());
+	SDE_CHECK(stats.m_before.m_triangleCount == stats.m_after.m_triangleCount);
+	SDE_CHECK(stats.m_after.ACMR() <= stats.m_before.ACMR());
+	SDE_CHECK(stats.m_after.ATVR() == 1.0f);
+
+	// the same triangles with the same winding, only the order + vertex ids changed
+	const std::vector<float>& ids = builder.GetStreamData(idStream);
+	SDE_CHECK(ids.size() == vertexCount);
+	std::vector<uint32_t> outputIndices;
+	for (uint32_t i : builder.GetIndices())
+	{
+		outputIndices.push_back(static_cast<uint32_t>(ids[i]));
+	}
+	SDE_CHECK(SortedTriangles(outputIndices) == SortedTriangles(indices));
+	const std::vector<float>& outputPositions = builder.GetStreamData(positionStream);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+	{
+		const uint32_t id = static_cast<uint32_t>(ids[v]);
+		SDE_CHECK(outputPositions[v * 3] == positions[id * 3] && outputPositions[v * 3 + 2] == positions[id * 3 + 2]);
+	}
+}
+
+SDE_TEST(SimplifyMeshStopsAtTheTargetCountOrErrorBudget)
+{
+	std::vector<float> positions;
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> simplified;
+	float error = -1.0f;
+
+	// a flat grid collapses for free, so only the target count stops it
+	BuildGrid(32, 32, positions, indices);
+	const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / 3);
+	simplified.resize(indices.size());
+	const size_t targetCount = indices.size() / 4;
+	size_t count = Render::SimplifyMesh(simplified.data(), indices.data(), indices.size(), positions.data(), sizeof(float) * 3, vertexCount, targetCount, 0.01f, &error);
+	printf("\tflat: %zu -> %zu indices (target %zu), error %f\n", indices.size(), count, targetCount, error);
+	SDE_CHECK(count % 3 == 0 && count <= targetCount && count > 0);
+	SDE_CHECK(error >= 0.0f && error <= 0.01f);
+	for (size_t i = 0; i < count; ++i)
+	{
+		SDE_CHECK(simplified[i] < vertexCount);
+	}
+
+	// bumps cost error to remove. with no target count the budget is the only thing that stops it
+	// and a larger budget must go further
+	BuildGrid(32, 32, positions, indices, 1.0f);
+	size_t previousCount = indices.size();
+	for (float budget : { 0.01f, 0.1f, 0.5f })
+	{
+		count = Render::SimplifyMesh(simplified.data(), indices.data(), indices.size(), positions.data(), sizeof(float) * 3, vertexCount, 0, budget, &error);
+		printf("\tbumpy: budget %.2f -> %zu indices, error %f\n", budget, count, error);
+		SDE_CHECK(count % 3 == 0 && count > 0);
+		SDE_CHECK(count < previousCount);
+		SDE_CHECK(error >= 0.0f && error <= budget);
+		previousCount = count;
+	}
+}
+
+SDE_TEST(VertexEncodingStaysWithinItsErrorBounds)
+{
+	// every snorm16 step between -1 and 1, plus points between them where rounding is worst
+	const uint32_t c_snormSteps = 32767 * 8;
+	const float c_snormMaxError = 0.5f / 32767.0f + FLT_EPSILON;
+	for (uint32_t i = 0; i <= c_snormSteps * 2; ++i)
+	{
+		const float v = glm::clamp((float)((double)i / c_snormSteps - 1.0), -1.0f, 1.0f);
+		SDE_CHECK(glm::abs(Render::DecodeSnorm16(Render::EncodeSnorm16(v)) - v) <= c_snormMaxError);
+	}
+	SDE_CHECK(Render::DecodeSnorm16(Render::EncodeSnorm16(-1.0f)) == -1.0f);
+	SDE_CHECK(Render::DecodeSnorm16(Render::EncodeSnorm16(0.0f)) == 0.0f);
+	SDE_CHECK(Render::DecodeSnorm16(Render::EncodeSnorm16(1.0f)) == 1.0f);
+
+	// half floats across the whole normal range, both signs
+	const float c_halfMaxRelativeError = 1.0f / 2048.0f;
+	for (float v = 1.0f / 16384.0f; v <= 65504.0f; v *= 1.0001f)
+	{
+		SDE_CHECK(glm::abs(Render::DecodeHalf(Render::EncodeHalf(v)) - v) <= v * c_halfMaxRelativeError);
+		SDE_CHECK(glm::abs(Render::DecodeHalf(Render::EncodeHalf(-v)) + v) <= v * c_halfMaxRelativeError);
+	}
+	SDE_CHECK(Render::DecodeHalf(Render::EncodeHalf(65504.0f)) == 65504.0f);
+	SDE_CHECK(Render::DecodeHalf(Render::EncodeHalf(0.0f)) == 0.0f && !std::signbit(Render::DecodeHalf(Render::EncodeHalf(0.0f))));
+	SDE_CHECK(Render::DecodeHalf(Render::EncodeHalf(-0.0f)) == 0.0f && std::signbit(Render::DecodeHalf(Render::EncodeHalf(-0.0f))));
+
+	// octahedral, unquantised + quantised to snorm16 the way mesh streams store it
+	const float c_octahedralMaxError = 1.0e-6f;
+	const float c_octahedralSnormMaxError = 1.0e-4f;
+	auto checkOctahedral = [&](const glm::vec3& n) {
+		const glm::vec3 unit = glm::normalize(n);
+		const glm::vec2 e = Render::OctahedralEncode(n);
+		SDE_CHECK(glm::abs(e.x) <= 1.0f && glm::abs(e.y) <= 1.0f);
+		SDE_CHECK(n.z >= 0.0f || glm::abs(e.x) + glm::abs(e.y) >= 1.0f - FLT_EPSILON);		// the lower half folds into the corners
+		SDE_CHECK(glm::length(Render::OctahedralDecode(e) - unit) <= c_octahedralMaxError);
+		const glm::vec2 q(Render::DecodeSnorm16(Render::EncodeSnorm16(e.x)), Render::DecodeSnorm16(Render::EncodeSnorm16(e.y)));
+		SDE_CHECK(glm::length(Render::OctahedralDecode(q) - unit) <= c_octahedralSnormMaxError);
+	};
+
+	// fibonacci sphere, half of it below z = 0
+	const uint32_t c_sphereSamples = 1000000;
+	for (uint32_t i = 0; i < c_sphereSamples; ++i)
+	{
+		const float z = 1.0f - 2.0f * (i + 0.5f) / c_sphereSamples;
+		const float r = sqrtf(glm::max(0.0f, 1.0f - z * z));
+		const float phi = i * 2.39996323f;
+		checkOctahedral(glm::vec3(r * cosf(phi), r * sinf(phi), z));
+	}
+
+	// poles, the equator where the fold meets, and every sign of zero on them
+	for (float zero : { 0.0f, -0.0f })
+	{
+		for (float one : { 1.0f, -1.0f })
+		{
+			checkOctahedral(glm::vec3(zero, zero, one));
+			checkOctahedral(glm::vec3(zero, -zero, one));
+			checkOctahedral(glm::vec3(one, zero, zero));
+			checkOctahedral(glm::vec3(zero, one, -zero));
+			checkOctahedral(glm::vec3(0.6f * one, -0.8f, zero));
+			checkOctahedral(glm::vec3(0.6f, 0.8f * one, zero));
+			checkOctahedral(glm::vec3(one, one, one));
+			checkOctahedral(glm::vec3(zero, one, -1.0f));
+			checkOctahedral(glm::vec3(one, zero, -1.0f));
+		}
+	}
+}
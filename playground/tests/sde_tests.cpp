@@ -0,0 +1,30 @@
+#include "test.h"
+#include "sde/job_system.h"
+#include "kernel/atomics.h"
+#include <vector>
+
+SDE_TEST(JobSystemRunInParallelRunsEveryChunkOnce)
+{
+	SDE::JobSystem jobs;		// no render or config systems, the job threads get no gl context
+	SDE_CHECK(jobs.PostInit());
+	for (uint32_t chunkCount : { 0u, 1u, 7u, 1000u })
+	{
+		for (uint32_t repeat = 0; repeat < 20; ++repeat)
+		{
+			std::vector<Kernel::AtomicInt32> runs(chunkCount);
+			Kernel::AtomicInt32 total = 0;
+			jobs.RunInParallel(chunkCount, [&](uint32_t chunk) {
+				runs[chunk].Add(1);
+				total.Add(1);
+			});
+
+			// everything is finished by the time RunInParallel returns
+			SDE_CHECK(total.Get() == static_cast<int32_t>(chunkCount));
+			for (uint32_t c = 0; c < chunkCount; ++c)
+			{
+				SDE_CHECK(runs[c].Get() == 1);
+			}
+		}
+	}
+	jobs.Shutdown();
+}
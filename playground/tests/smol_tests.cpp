@@ -0,0 +1,389 @@
+#include "test.h"
+#include "smol/mesh_instance.h"
+#include "smol/sort_keys.h"
+#include "smol/shadow_cascades.h"
+#include "smol/shadow_cache.h"
+#include "smol/material_table.h"
+#include "smol/draw_commands.h"
+#include "smol/light_clusters.h"
+#include "render/mesh.h"
+#include "sde/job_system.h"
+#include "core/radix_sort.h"
+#include "core/timer.h"
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+namespace
+{
+	const uint32_t c_sortBenchmarkRuns = 5;		// fastest run is reported
+
+	// the comparator the opaque lists were sorted with before they used keys
+	bool OldOpaqueLess(const smol::MeshInstance& q1, const smol::MeshInstance& q2)
+	{
+		if (q1.m_shader.m_index != q2.m_shader.m_index)
+		{
+			return q1.m_shader.m_index < q2.m_shader.m_index;
+		}
+		auto q1Mesh = reinterpret_cast<uintptr_t>(q1.m_mesh);
+		auto q2Mesh = reinterpret_cast<uintptr_t>(q2.m_mesh);
+		if (q1Mesh != q2Mesh)
+		{
+			return q1Mesh < q2Mesh;
+		}
+		return q1.m_boundsCenter.z < q2.m_boundsCenter.z;		// distance to camera
+	}
+
+	// a few hundred meshes + a handful of shaders, the same spread as the test scenes
+	std::vector<smol::MeshInstance> MakeRandomInstances(size_t count, std::mt19937& random)
+	{
+		static char s_fakeMeshes[256];		// only the addresses are used
+		using ShaderMap = Core::SlotMap<smol::ShaderHandle>;
+		std::uniform_int_distribution<uint32_t> shaders(0, 15), meshes(0, 255), materials(0, 63);
+		std::uniform_real_distribution<float> distances(0.0f, 1000.0f);
+		std::vector<smol::MeshInstance> instances(count);
+		for (auto& i : instances)
+		{
+			i.m_shader = { ShaderMap::MakeHandle(shaders(random), 3) };
+			i.m_mesh = reinterpret_cast<const Render::Mesh*>(&s_fakeMeshes[meshes(random)]);
+			i.m_materialId = materials(random);
+			i.m_boundsCenter = { 0.0f, 0.0f, distances(random) };
+		}
+		return instances;
+	}
+
+	smol::ShadowCascadeParams MakeCascadeParams(const glm::vec3& cameraPosition)
+	{
+		smol::ShadowCascadeParams params;
+		params.m_cameraView = glm::lookAt(cameraPosition, cameraPosition + glm::vec3(0.3f, -0.2f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		params.m_cameraFOV = glm::radians(70.0f);
+		params.m_cameraAspect = 16.0f / 9.0f;
+		params.m_cameraNearPlane = 0.1f;
+		params.m_shadowDistance = 200.0f;
+		params.m_splitBlend = 0.75f;
+		params.m_casterDistance = 50.0f;
+		params.m_lightDirection = glm::normalize(glm::vec3(0.4f, -1.0f, 0.25f));
+		params.m_cascadeResolution = 2048;
+		return params;
+	}
+
+	// position of a world-space point in a cascade, in texels
+	glm::vec2 CascadeTexel(const smol::ShadowCascade& cascade, const glm::vec3& p, int resolution)
+	{
+		const glm::vec4 clip = cascade.m_lightSpaceMatrix * glm::vec4(p, 1.0f);
+		return (glm::vec2(clip) * 0.5f + 0.5f) * (float)resolution;
+	}
+}
+
+SDE_TEST(SortKeyShaderDropsTheGeneration)
+{
+	using ShaderMap = Core::SlotMap<smol::ShaderHandle>;
+	const smol::ShaderHandle a = { ShaderMap::MakeHandle(7, 1) };
+	const smol::ShaderHandle b = { ShaderMap::MakeHandle(7, 200) };
+	const smol::ShaderHandle c = { ShaderMap::MakeHandle(0xffff, 1) };
+	SDE_CHECK(smol::SortKeyShader(a) == 7 && smol::SortKeyShader(b) == 7);
+	SDE_CHECK(smol::SortKeyShader(c) == 0xffff);
+	SDE_CHECK(smol::OpaqueSortKey(a, 0, nullptr, 1.0f) < smol::OpaqueSortKey(c, 0, nullptr, 0.0f));
+	SDE_CHECK(smol::OpaqueSortKey(a, 0, nullptr, 1.0f) < smol::OpaqueSortKey(a, 0, nullptr, 2.0f));		// front to back
+	SDE_CHECK(smol::TransparentSortKey(a, 0, nullptr, 2.0f) < smol::TransparentSortKey(a, 0, nullptr, 1.0f));	// back to front
+}
+
+// key build + radix sort of (key, index) pairs, against std::sort of the instances with the old comparator
+SDE_BENCHMARK(InstanceSortKeysVsStdSort)
+{
+	std::mt19937 random(1234);
+	for (size_t count : { 10 * 1000, 100 * 1000, 128 * 1024 })
+	{
+		const std::vector<smol::MeshInstance> source = MakeRandomInstances(count, random);
+		double stdSortSeconds = 1.0e10, radixSeconds = 1.0e10;
+		for (uint32_t run = 0; run < c_sortBenchmarkRuns; ++run)
+		{
+			std::vector<smol::MeshInstance> instances = source;
+			double seconds = 0.0;
+			{
+				Core::ScopedTimer timer(seconds);
+				std::sort(instances.begin(), instances.end(), OldOpaqueLess);
+			}
+			stdSortSeconds = std::min(stdSortSeconds, seconds);
+
+			std::vector<Core::SortKeyIndex> drawOrder(count), scratch(count);
+			{
+				Core::ScopedTimer timer(seconds);
+				for (size_t i = 0; i < count; ++i)
+				{
+					const auto& inst = source[i];
+					drawOrder[i] = { smol::OpaqueSortKey(inst.m_shader, inst.m_materialId, inst.m_mesh, inst.m_boundsCenter.z), static_cast<uint32_t>(i) };
+				}
+				Core::RadixSort(drawOrder.data(), scratch.data(), count);
+			}
+			radixSeconds = std::min(radixSeconds, seconds);
+
+			for (size_t i = 1; i < count; ++i)
+			{
+				SDE_CHECK(drawOrder[i - 1].m_key <= drawOrder[i].m_key);
+				SDE_CHECK(OldOpaqueLess(instances[i], instances[i - 1]) == false);
+			}
+		}
+		printf("\t%8zu instances: std::sort %7.2f ms, keys + radix sort %7.2f ms (%.1fx)\n", count,
+			stdSortSeconds * 1000.0, radixSeconds * 1000.0, stdSortSeconds / radixSeconds);
+	}
+}
+
+SDE_TEST(CascadeSplitsCoverNearToFar)
+{
+	const uint32_t c_cascadeCount = 4;
+	for (float blend : { 0.0f, 0.5f, 0.75f, 1.0f })
+	{
+		float splits[c_cascadeCount + 1];
+		smol::CalculateCascadeSplits(0.1f, 200.0f, blend, c_cascadeCount, splits);
+		SDE_CHECK(splits[0] == 0.1f);
+		SDE_CHECK(splits[c_cascadeCount] == 200.0f);
+		for (uint32_t c = 0; c < c_cascadeCount; ++c)
+		{
+			SDE_CHECK(splits[c] < splits[c + 1]);
+		}
+	}
+
+	// each cascade picks up where the last one ended
+	smol::ShadowCascade cascades[c_cascadeCount];
+	const auto params = MakeCascadeParams(glm::vec3(0.0f));
+	smol::FitShadowCascades(params, c_cascadeCount, cascades);
+	SDE_CHECK(cascades[0].m_splitNear == params.m_cameraNearPlane);
+	SDE_CHECK(cascades[c_cascadeCount - 1].m_splitFar == params.m_shadowDistance);
+	for (uint32_t c = 1; c < c_cascadeCount; ++c)
+	{
+		SDE_CHECK(cascades[c].m_splitNear == cascades[c - 1].m_splitFar);
+	}
+}
+
+// moving the camera must only ever move a cascade by whole texels, otherwise shadow edges shimmer
+SDE_TEST(CascadeTexelSnappingIsStableUnderCameraTranslation)
+{
+	const uint32_t c_cascadeCount = 4;
+	const glm::vec3 worldPoints[] = { { 0.0f, 0.0f, 0.0f }, { 12.3f, 4.5f, 30.7f }, { -8.1f, 0.2f, 65.4f } };
+	const auto startParams = MakeCascadeParams(glm::vec3(1.0f, 10.0f, -5.0f));
+	smol::ShadowCascade start[c_cascadeCount];
+	smol::FitShadowCascades(startParams, c_cascadeCount, start);
+	for (int step = 1; step <= 50; ++step)
+	{
+		const glm::vec3 offset = glm::vec3(0.137f, 0.021f, 0.389f) * (float)step;	// never a whole number of texels
+		const auto params = MakeCascadeParams(glm::vec3(1.0f, 10.0f, -5.0f) + offset);
+		smol::ShadowCascade moved[c_cascadeCount];
+		smol::FitShadowCascades(params, c_cascadeCount, moved);
+		for (uint32_t c = 0; c < c_cascadeCount; ++c)
+		{
+			// the cascade size depends on the projection only, so the light space scale is unchanged
+			for (int col = 0; col < 3; ++col)
+			{
+				SDE_CHECK(moved[c].m_lightSpaceMatrix[col][0] == start[c].m_lightSpaceMatrix[col][0]);
+				SDE_CHECK(moved[c].m_lightSpaceMatrix[col][1] == start[c].m_lightSpaceMatrix[col][1]);
+			}
+			for (const auto& p : worldPoints)
+			{
+				const glm::vec2 texelMove = CascadeTexel(moved[c], p, params.m_cascadeResolution) - CascadeTexel(start[c], p, params.m_cascadeResolution);
+				SDE_CHECK(fabsf(texelMove.x - roundf(texelMove.x)) < 0.01f);
+				SDE_CHECK(fabsf(texelMove.y - roundf(texelMove.y)) < 0.01f);
+			}
+		}
+	}
+}
+
+SDE_TEST(ShadowCacheNeedsUpdateUntilMarked)
+{
+	smol::ShadowCache cache(6);
+	const glm::mat4 matrix = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 0.1f, 100.0f);
+	const uint64_t hash = 0x1234;
+	for (uint32_t layer = 0; layer < cache.LayerCount(); ++layer)
+	{
+		SDE_CHECK(cache.NeedsUpdate(layer, matrix, hash));		// nothing is cached to start with
+	}
+	cache.MarkUpdated(2, matrix, hash);
+	SDE_CHECK(!cache.NeedsUpdate(2, matrix, hash));
+	SDE_CHECK(cache.NeedsUpdate(1, matrix, hash) && cache.NeedsUpdate(3, matrix, hash));
+
+	// any change to the light matrix or the static casters redraws the layer
+	glm::mat4 moved = matrix;
+	moved[3][0] += 0.001f;
+	SDE_CHECK(cache.NeedsUpdate(2, moved, hash));
+	SDE_CHECK(cache.NeedsUpdate(2, matrix, hash + 1));
+	SDE_CHECK(!cache.NeedsUpdate(2, matrix, hash));
+	cache.MarkUpdated(2, moved, hash + 1);
+	SDE_CHECK(!cache.NeedsUpdate(2, moved, hash + 1));
+	SDE_CHECK(cache.NeedsUpdate(2, matrix, hash));
+
+	cache.MarkUpdated(4, matrix, hash);
+	cache.Invalidate(2);
+	SDE_CHECK(cache.NeedsUpdate(2, moved, hash + 1));
+	SDE_CHECK(!cache.NeedsUpdate(4, matrix, hash));
+	cache.InvalidateAll();
+	SDE_CHECK(cache.NeedsUpdate(4, matrix, hash));
+}
+
+SDE_TEST(MaterialTableSharesIdenticalEntries)
+{
+	smol::MaterialTable table(16);
+	SDE_CHECK(table.Count() == 1);		// the default material
+	SDE_CHECK(table.HasDirtyRange() && table.DirtyFirst() == 0 && table.DirtyEnd() == 1);
+	table.ClearDirty();
+	SDE_CHECK(!table.HasDirtyRange());
+
+	const glm::vec4 red(1.0f, 0.0f, 0.0f, 1.0f), blue(0.0f, 0.0f, 1.0f, 1.0f), specular(1.0f, 1.0f, 1.0f, 0.5f);
+	const uint32_t a = table.Add(red, specular, 32.0f);
+	SDE_CHECK(a == 1);
+	SDE_CHECK(table.Add(red, specular, 32.0f) == a);
+	SDE_CHECK(table.Add(red, specular, 64.0f) == 2);		// every value is part of the key
+	SDE_CHECK(table.Add(blue, specular, 32.0f) == 3);
+	SDE_CHECK(table.Add(glm::vec4(1.0f), glm::vec4(0.0f), 1.0f) == 0);	// matches the default
+	SDE_CHECK(table.Count() == 4);
+	SDE_CHECK(table.Data()[3].m_diffuseOpacity == blue && table.Data()[3].m_shininess == 32.0f);
+
+	// new entries extend one dirty range, shared ones leave it alone
+	SDE_CHECK(table.DirtyFirst() == 1 && table.DirtyEnd() == 4);
+	table.ClearDirty();
+	SDE_CHECK(table.Add(blue, specular, 32.0f) == 3);
+	SDE_CHECK(!table.HasDirtyRange());
+	SDE_CHECK(table.Add(blue, specular, 16.0f) == 4);
+	SDE_CHECK(table.DirtyFirst() == 4 && table.DirtyEnd() == 5);
+	table.MarkAllDirty();
+	SDE_CHECK(table.DirtyFirst() == 0 && table.DirtyEnd() == table.Count());
+}
+
+SDE_TEST(MaterialTableFallsBackToTheDefaultWhenFull)
+{
+	smol::MaterialTable table(3);
+	SDE_CHECK(table.Add(glm::vec4(0.1f), glm::vec4(0.0f), 1.0f) == 1);
+	SDE_CHECK(table.Add(glm::vec4(0.2f), glm::vec4(0.0f), 1.0f) == 2);
+	table.ClearDirty();
+	SDE_CHECK(table.Add(glm::vec4(0.3f), glm::vec4(0.0f), 1.0f) == 0);
+	SDE_CHECK(table.Count() == 3 && !table.HasDirtyRange());
+	SDE_CHECK(table.Add(glm::vec4(0.2f), glm::vec4(0.0f), 1.0f) == 2);		// existing entries are still found
+}
+
+// with every hash colliding, only the bytes can tell entries apart
+SDE_TEST(MaterialTableComparesEntriesOnHashCollisions)
+{
+	smol::MaterialTable table(16, [](const smol::MaterialTable::Entry&) -> uint64_t { return 42; });
+	const uint32_t a = table.Add(glm::vec4(0.5f), glm::vec4(0.0f), 8.0f);
+	const uint32_t b = table.Add(glm::vec4(0.7f), glm::vec4(0.0f), 8.0f);
+	SDE_CHECK(a == 1 && b == 2);		// not merged with the default material they collide with
+	SDE_CHECK(table.Data()[a].m_diffuseOpacity == glm::vec4(0.5f));
+	SDE_CHECK(table.Data()[b].m_diffuseOpacity == glm::vec4(0.7f));
+
+	// the lookup remembers the first entry with a hash, that one is still shared
+	SDE_CHECK(table.Add(glm::vec4(1.0f), glm::vec4(0.0f), 1.0f) == 0);
+
+	// later colliding values can't be found, so they get another entry instead of a wrong one
+	const uint32_t aAgain = table.Add(glm::vec4(0.5f), glm::vec4(0.0f), 8.0f);
+	SDE_CHECK(aAgain == 3 && table.Count() == 4);
+	SDE_CHECK(table.Data()[aAgain].m_diffuseOpacity == glm::vec4(0.5f));
+}
+
+SDE_TEST(DrawCommandsGroupRunsOfTheSameMesh)
+{
+	// no gpu objects are created, the commands only need the chunks
+	Render::Mesh indexedMesh, arraysMesh;
+	indexedMesh.GetChunks().push_back(Render::MeshChunk(0, 24, 0, 36, Render::PrimitiveType::Triangles));
+	indexedMesh.GetLods().push_back({});
+	indexedMesh.GetLods()[0].m_chunks.push_back(Render::MeshChunk(0, 24, 36, 12, Render::PrimitiveType::Triangles));
+	arraysMesh.GetChunks().push_back(Render::MeshChunk(0, 30, Render::PrimitiveType::Triangles));
+	arraysMesh.GetChunks().push_back(Render::MeshChunk(30, 6, Render::PrimitiveType::Triangles));
+
+	// draw order keys are instance buffer positions, there is a gap after position 2
+	const smol::ShaderHandle shader = { 5 };
+	std::vector<smol::MeshInstance> instances(9);
+	std::vector<Core::SortKeyIndex> drawOrder;
+	const uint32_t positions[] = { 0, 1, 2, 4, 5, 6, 7, 8, 9 };
+	for (uint32_t i = 0; i < 9; ++i)
+	{
+		instances[i].m_shader = shader;
+		instances[i].m_mesh = i < 5 ? &indexedMesh : &arraysMesh;
+		instances[i].m_lod = i == 4 ? 1 : 0;
+		drawOrder.push_back({ positions[i], i });
+	}
+
+	smol::DrawCommandList list;
+	list.Build(instances.data(), drawOrder.data(), 0, 9);
+	const auto& groups = list.Groups();
+	SDE_CHECK(groups.size() == 2);
+
+	// runs split on the gap + the lod change, but share the group of their mesh
+	SDE_CHECK(groups[0].m_mesh == &indexedMesh && groups[0].m_indexed && groups[0].m_firstDrawOrder == 0 && groups[0].m_commandCount == 3);
+	const auto& indexed = list.IndexedCommands();
+	SDE_CHECK(indexed.size() == 3);
+	SDE_CHECK(indexed[0].m_instanceCount == 3 && indexed[0].m_baseInstance == 0 && indexed[0].m_indexCount == 36);
+	SDE_CHECK(indexed[1].m_instanceCount == 1 && indexed[1].m_baseInstance == 4 && indexed[1].m_indexCount == 36);
+	SDE_CHECK(indexed[2].m_instanceCount == 1 && indexed[2].m_baseInstance == 5 && indexed[2].m_firstIndex == 36 && indexed[2].m_indexCount == 12);
+	SDE_CHECK(groups[0].m_vertexCount == 36 * 4 + 12);
+
+	// one command per chunk for each run
+	SDE_CHECK(groups[1].m_mesh == &arraysMesh && !groups[1].m_indexed && groups[1].m_firstDrawOrder == 5 && groups[1].m_commandCount == 2);
+	const auto& arrays = list.Commands();
+	SDE_CHECK(arrays.size() == 2);
+	SDE_CHECK(arrays[0].m_instanceCount == 4 && arrays[0].m_baseInstance == 6 && arrays[0].m_vertexCount == 30);
+	SDE_CHECK(arrays[1].m_instanceCount == 4 && arrays[1].m_baseInstance == 6 && arrays[1].m_firstVertex == 30);
+
+	// a second range never joins the last group, so it can be drawn on its own
+	list.Clear();
+	list.Build(instances.data(), drawOrder.data(), 0, 2);
+	list.Build(instances.data(), drawOrder.data(), 2, 7);
+	SDE_CHECK(list.Groups().size() == 3);
+	SDE_CHECK(list.FindGroup(0) == 0 && list.FindGroup(2) == 1 && list.FindGroup(9) == 3);
+	SDE_CHECK(list.Groups()[1].m_mesh == &indexedMesh && list.Groups()[1].m_firstDrawOrder == 2);
+}
+
+// one frame of light assignment as PrepareLights runs it, with the same camera + grid as the renderer
+SDE_BENCHMARK(LightClustersAssignment)
+{
+	const float c_nearPlane = 0.1f, c_farPlane = 1000.0f;
+	const uint32_t c_maxIndices = 1024 * 1024;
+	const glm::mat4 projection = glm::perspectiveFov(glm::radians(70.0f), 1280.0f, 720.0f, c_nearPlane, c_farPlane);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 10.0f, -150.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	SDE::JobSystem jobs;
+	SDE_CHECK(jobs.PostInit());
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f), height(0.0f, 20.0f), radius(2.0f, 15.0f);
+	for (uint32_t lightCount : { 1000u, 5000u, 10000u })
+	{
+		std::vector<glm::vec4> lights(lightCount);
+		for (auto& l : lights)
+		{
+			l = glm::vec4(position(random), height(random), position(random), radius(random));
+		}
+
+		smol::LightClusters serial, parallel;
+		uint32_t dropped = 0;
+		const double serialMs = Tests::AverageMs(50, [&]() {
+			serial.SetProjection(projection, c_nearPlane, c_farPlane);
+			serial.Begin(view, lights.data(), lightCount, 0);
+			for (uint32_t chunk = 0; chunk < serial.ChunkCount(); ++chunk)
+			{
+				serial.AssignChunk(chunk);
+			}
+			dropped = serial.Finish(c_maxIndices);
+		});
+		const double parallelMs = Tests::AverageMs(50, [&]() {
+			parallel.SetProjection(projection, c_nearPlane, c_farPlane);
+			parallel.Begin(view, lights.data(), lightCount, 0);
+			jobs.RunInParallel(parallel.ChunkCount(), [&](uint32_t chunk) {
+				parallel.AssignChunk(chunk);
+			});
+			dropped += parallel.Finish(c_maxIndices);
+		});
+		SDE_CHECK(dropped == 0);
+
+		// the job threads must build exactly the same lists
+		SDE_CHECK(serial.LightIndices() == parallel.LightIndices());
+		bool clustersMatch = serial.Clusters().size() == parallel.Clusters().size();
+		for (size_t c = 0; clustersMatch && c < serial.Clusters().size(); ++c)
+		{
+			clustersMatch = serial.Clusters()[c].m_firstIndex == parallel.Clusters()[c].m_firstIndex && serial.Clusters()[c].m_lightCount == parallel.Clusters()[c].m_lightCount;
+		}
+		SDE_CHECK(clustersMatch);
+		printf("\t%6u lights, %4u chunks: serial %6.3f ms, RunInParallel %6.3f ms per frame (%zu cluster indices)\n", lightCount,
+			serial.ChunkCount(), serialMs, parallelMs, serial.LightIndices().size());
+	}
+	jobs.Shutdown();
+}
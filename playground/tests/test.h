@@ -0,0 +1,33 @@
+#pragma once
+#include "kernel/base_types.h"
+#include <functional>
+
+// Headless tests + benchmarks for code that doesn't need a window or GL context
+// "tests" runs every test, "tests bench" runs the benchmarks. A second argument only runs names containing it
+// Checks are active in every config, so release builds are tested too
+namespace Tests
+{
+	using TestFn = void(*)();
+
+	struct Registrar
+	{
+		Registrar(const char* name, TestFn fn, bool isBenchmark);
+	};
+
+	void ReportFailure(const char* file, int line, const char* condition);
+
+	// Calls fn iterations times after one warm up call, returns the average time per call in ms
+	double AverageMs(uint32_t iterations, const std::function<void()>& fn);
+}
+
+#define SDE_CHECK(condition)	do { if (!(condition)) { Tests::ReportFailure(__FILE__, __LINE__, #condition); } } while (0)
+
+#define SDE_TEST(name)	\
+	static void name();	\
+	static Tests::Registrar s_registrar_##name(#name, name, false);	\
+	static void name()
+
+#define SDE_BENCHMARK(name)	\
+	static void name();	\
+	static Tests::Registrar s_registrar_##name(#name, name, true);	\
+	static void name()